@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+/* runs one remux and appends what it cost to a results file as a JSON
+ * line: throughput over the input size, CPU time, peak RSS and the time
+ * until the first byte of the output shows up */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+/* how often the output is looked at for its first byte */
+#define POLL_INTERVAL_US 1000
+
+static gdouble
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static gdouble
+timeval_seconds (const struct timeval *tv)
+{
+  return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static gint64
+file_size (const gchar * filename)
+{
+  struct stat st;
+
+  if (!filename || stat (filename, &st) < 0)
+    return -1;
+  return st.st_size;
+}
+
+static void
+usage (void)
+{
+  g_print ("benchrun - measures a remux for the benchmark suite\n"
+      "Usage: benchrun [OPTION...] -- command [argument...]\n"
+      "  -n, --name=NAME        name of the run in the results\n"
+      "  -i, --input=FILE       input the throughput is measured against\n"
+      "  -O, --output=FILE      output watched for the first byte\n"
+      "  -o, --results=FILE     JSON lines file to append to (stdout)\n"
+      "  -r, --runs=N           repeat the command N times (1)\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option options[] = {
+    {"name", required_argument, NULL, 'n'},
+    {"input", required_argument, NULL, 'i'},
+    {"output", required_argument, NULL, 'O'},
+    {"results", required_argument, NULL, 'o'},
+    {"runs", required_argument, NULL, 'r'},
+    {"help", no_argument, NULL, '?'},
+    {NULL, 0, NULL, 0}
+  };
+  const gchar *name = "remux", *input = NULL, *output = NULL;
+  const gchar *results = NULL;
+  FILE *f = stdout;
+  gint runs = 1, run, failed = 0;
+  gint64 input_size;
+  int opt;
+
+  while ((opt = getopt_long (argc, argv, "n:i:O:o:r:?", options, NULL)) >= 0) {
+    switch (opt) {
+      case 'n':
+        name = optarg;
+        break;
+      case 'i':
+        input = optarg;
+        break;
+      case 'O':
+        output = optarg;
+        break;
+      case 'o':
+        results = optarg;
+        break;
+      case 'r':
+        runs = MAX (atoi (optarg), 1);
+        break;
+      default:
+        usage ();
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    usage ();
+    return 1;
+  }
+  input_size = file_size (input);
+
+  if (results) {
+    f = fopen (results, "a");
+    if (!f) {
+      g_fprintf (stderr, "can't open %s: %s\n", results, g_strerror (errno));
+      return 1;
+    }
+  }
+
+  for (run = 0; run < runs; run++) {
+    struct rusage usage;
+    gdouble start, end, ttfb = -1.0, wall, cpu;
+    gint64 output_size;
+    pid_t pid;
+    int status;
+
+    if (output)
+      unlink (output);
+    start = now ();
+    pid = fork ();
+    if (pid < 0) {
+      g_fprintf (stderr, "can't fork: %s\n", g_strerror (errno));
+      return 1;
+    }
+    if (pid == 0) {
+      execvp (argv[optind], argv + optind);
+      g_fprintf (stderr, "can't run %s: %s\n", argv[optind],
+          g_strerror (errno));
+      _exit (127);
+    }
+
+    /* the child's rusage comes with wait4, the first byte is polled */
+    for (;;) {
+      pid_t ret = wait4 (pid, &status, WNOHANG, &usage);
+      if (ret == pid)
+        break;
+      if (ret < 0 && errno != EINTR) {
+        g_fprintf (stderr, "can't wait for %s: %s\n", argv[optind],
+            g_strerror (errno));
+        return 1;
+      }
+      if (ttfb < 0 && file_size (output) > 0)
+        ttfb = now () - start;
+      usleep (POLL_INTERVAL_US);
+    }
+    end = now ();
+    wall = end - start;
+    cpu = timeval_seconds (&usage.ru_utime) + timeval_seconds (&usage.ru_stime);
+    output_size = file_size (output);
+    if (ttfb < 0 && output_size > 0)
+      ttfb = wall;
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+      failed++;
+
+    g_fprintf (f, "{\"name\": \"%s\", \"run\": %i, \"status\": %i, "
+        "\"input_bytes\": %" G_GINT64_FORMAT ", "
+        "\"output_bytes\": %" G_GINT64_FORMAT ", "
+        "\"wall_s\": %.3f, \"user_s\": %.3f, \"sys_s\": %.3f, "
+        "\"cpu_s\": %.3f, \"mb_per_s\": %.2f, \"max_rss_kb\": %li, "
+        "\"ttfb_s\": %.3f}\n", name, run,
+        WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status),
+        input_size, output_size, wall, timeval_seconds (&usage.ru_utime),
+        timeval_seconds (&usage.ru_stime), cpu,
+        input_size > 0 && wall > 0 ? input_size / wall / (1024 * 1024) : 0.0,
+        usage.ru_maxrss, ttfb);
+    fflush (f);
+  }
+
+  if (f != stdout)
+    fclose (f);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# bdremux benchmark suite: generates synthetic transport streams with tsgen
+# and measures the remux of each of them in every mode with benchrun, the
+# results are appended to a JSON lines file, one line per run. with
+# SCANBENCH the packet scanning kernels are measured on each stream as well
+#
+# usage: run-bench.sh BDREMUX TSGEN BENCHRUN [SCANBENCH]
+#
+# BENCH_RESULTS   results file (bench-results.jsonl)
+# BENCH_DIR       where the streams and outputs go (bench-data)
+# BENCH_DURATION  length of the generated streams in seconds (120)
+# BENCH_RUNS      runs per mode (3)
+
+set -e
+
+if [ $# -ne 3 ] && [ $# -ne 4 ]; then
+	echo "usage: $0 BDREMUX TSGEN BENCHRUN [SCANBENCH]" >&2
+	exit 1
+fi
+bdremux=$1
+tsgen=$2
+benchrun=$3
+scanbench=$4
+
+results=${BENCH_RESULTS:-bench-results.jsonl}
+dir=${BENCH_DIR:-bench-data}
+duration=${BENCH_DURATION:-120}
+runs=${BENCH_RUNS:-3}
+failed=0
+
+mkdir -p "$dir"
+
+# name, then the tsgen options of each stream
+streams="
+mpeg2-1a|-v mpeg2 -a mpeg
+h264-3a-cuts|-v h264 -a mpeg,ac3,dts -c 3
+h264-7a-disc|-v h264 -a mpeg,ac3,dts,mpeg,ac3,mpeg,ac3 -D 30
+"
+
+# name, then the bdremux options of each mode, cutlist modes only run on
+# streams that come with a cutlist
+modes="
+auto|
+pids|-s 0x101,0x102 -r 0x1011,0x1100
+entrypoints|-e
+queue-8m|-q 8388608
+queue-128m|-q 134217728
+fast|-f
+fast-entrypoints|-f -e
+cuts|-c
+cuts-fast-j4|-c -f -j 4
+"
+
+echo "$streams" | while IFS='|' read -r stream options; do
+	[ -n "$stream" ] || continue
+	input="$dir/$stream.ts"
+	if [ ! -f "$input" ]; then
+		echo "generating $input"
+		# shellcheck disable=SC2086
+		"$tsgen" -d "$duration" $options "$input"
+	fi
+	if [ -n "$scanbench" ]; then
+		echo "$stream/scan"
+		"$scanbench" -n "$stream/scan" -o "$results" "$input" || exit 1
+	fi
+	echo "$modes" | while IFS='|' read -r mode remux_options; do
+		[ -n "$mode" ] || continue
+		case "$mode" in
+		cuts*)
+			[ -f "$input.cuts" ] || continue
+			;;
+		esac
+		output="$dir/$stream.m2ts"
+		echo "$stream/$mode"
+		# shellcheck disable=SC2086
+		if ! "$benchrun" -n "$stream/$mode" -i "$input" -O "$output" \
+			-o "$results" -r "$runs" -- \
+			"$bdremux" "$input" "$output" $remux_options >/dev/null; then
+			echo "$stream/$mode failed" >&2
+			exit 1
+		fi
+		rm -f "$output"
+	done || exit 1
+done || failed=1
+
+echo "results appended to $results"
+exit $failed
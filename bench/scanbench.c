@@ -0,0 +1,212 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+/* measures the packet scanning kernels on a stream held in memory, so
+ * that neither the disk nor the page cache is what's timed. every kernel
+ * the CPU runs classifies all packets and searches all start codes of the
+ * stream, one JSON line per kernel and task goes to the results file */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include "tsscan.h"
+
+/* the least time a kernel is run for to get a stable rate */
+#define MIN_SECONDS 0.5
+#define CLASSIFY_PACKETS 256
+
+static gdouble
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+usage (void)
+{
+  g_print ("scanbench - measures the packet scanning kernels\n"
+      "Usage: scanbench [OPTION...] stream.ts\n"
+      "  -n, --name=NAME        name of the stream in the results\n"
+      "  -o, --results=FILE     JSON lines file to append to (stdout)\n"
+      "  -s, --size=MB          most of the stream read into memory (256)\n");
+}
+
+/* the same work as the index scan: the PID and unit start flag of every
+ * packet, returns how many units of the video PID were started */
+static guint64
+classify_all (const guint8 * data, gsize len, guint16 video_pid)
+{
+  guint16 packets[CLASSIFY_PACKETS];
+  gsize pos = 0;
+  guint64 starts = 0;
+
+  while (pos + TS_PACKET_SIZE <= len) {
+    guint n = MIN ((len - pos) / TS_PACKET_SIZE, CLASSIFY_PACKETS), i;
+
+    ts_scan_classify (data + pos, n, TS_PACKET_SIZE, packets);
+    for (i = 0; i < n; i++)
+      if ((packets[i] & (TS_SCAN_LOST | TS_SCAN_PUSI | TS_SCAN_PID_MASK))
+          == (TS_SCAN_PUSI | video_pid))
+        starts++;
+    pos += n * TS_PACKET_SIZE;
+  }
+  return starts;
+}
+
+static guint64
+start_codes_all (const guint8 * data, gsize len)
+{
+  const guint8 *end = data + len, *sc = data;
+  guint64 found = 0;
+
+  while ((sc = ts_scan_start_code (sc, end - sc))) {
+    found++;
+    sc += 3;
+  }
+  return found;
+}
+
+static void
+report (FILE * f, const gchar * name, const gchar * task,
+    TsScanKernel kernel, gsize len, guint runs, gdouble seconds,
+    guint64 result)
+{
+  g_fprintf (f, "{\"name\": \"%s\", \"task\": \"%s\", \"kernel\": \"%s\", "
+      "\"bytes\": %" G_GSIZE_FORMAT ", \"runs\": %u, \"wall_s\": %.3f, "
+      "\"mb_per_s\": %.2f, \"result\": %" G_GUINT64_FORMAT "}\n", name, task,
+      ts_scan_kernel_name (kernel), len, runs, seconds,
+      seconds > 0 ? (gdouble) len * runs / seconds / (1024 * 1024) : 0.0,
+      result);
+  fflush (f);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option options[] = {
+    {"name", required_argument, NULL, 'n'},
+    {"results", required_argument, NULL, 'o'},
+    {"size", required_argument, NULL, 's'},
+    {"help", no_argument, NULL, '?'},
+    {NULL, 0, NULL, 0}
+  };
+  const gchar *name = NULL, *results = NULL;
+  gsize max_size = 256 * 1024 * 1024, len;
+  FILE *f = stdout, *in;
+  TsScanKernel kernel;
+  guint16 video_pid = TS_PID_NULL;
+  guint8 *data;
+  gint first;
+  int opt;
+
+  while ((opt = getopt_long (argc, argv, "n:o:s:?", options, NULL)) >= 0) {
+    switch (opt) {
+      case 'n':
+        name = optarg;
+        break;
+      case 'o':
+        results = optarg;
+        break;
+      case 's':
+        max_size = (gsize) MAX (atoi (optarg), 1) * 1024 * 1024;
+        break;
+      default:
+        usage ();
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    usage ();
+    return 1;
+  }
+  if (!name)
+    name = argv[optind];
+
+  in = fopen (argv[optind], "rb");
+  if (!in) {
+    g_fprintf (stderr, "can't open %s: %s\n", argv[optind],
+        g_strerror (errno));
+    return 1;
+  }
+  data = g_malloc (max_size);
+  len = fread (data, 1, max_size, in);
+  fclose (in);
+  first = ts_find_sync (data, len);
+  if (first < 0) {
+    g_fprintf (stderr, "%s isn't a transport stream\n", argv[optind]);
+    return 1;
+  }
+  len = (len - first) / TS_PACKET_SIZE * TS_PACKET_SIZE;
+  memmove (data, data + first, len);
+  /* the PID with the most unit starts stands in for the video */
+  {
+    guint *starts = g_new0 (guint, TS_MAX_PID);
+    gsize pos;
+
+    for (pos = 0; pos < len; pos += TS_PACKET_SIZE)
+      if (ts_pusi (data + pos)
+          && ++starts[ts_pid (data + pos)] > starts[video_pid])
+        video_pid = ts_pid (data + pos);
+    g_free (starts);
+  }
+
+  if (results) {
+    f = fopen (results, "a");
+    if (!f) {
+      g_fprintf (stderr, "can't open %s: %s\n", results, g_strerror (errno));
+      return 1;
+    }
+  }
+
+  for (kernel = TS_SCAN_SCALAR; kernel < TS_SCAN_N_KERNELS; kernel++) {
+    gdouble start, seconds;
+    guint64 result = 0;
+    guint runs;
+
+    if (!ts_scan_set_kernel (kernel))
+      continue;
+
+    start = now ();
+    for (runs = 0; runs == 0 || (seconds = now () - start) < MIN_SECONDS;
+        runs++)
+      result = classify_all (data, len, video_pid);
+    report (f, name, "classify", kernel, len, runs, seconds, result);
+
+    start = now ();
+    for (runs = 0; runs == 0 || (seconds = now () - start) < MIN_SECONDS;
+        runs++)
+      result = start_codes_all (data, len);
+    report (f, name, "start-codes", kernel, len, runs, seconds, result);
+  }
+
+  if (f != stdout)
+    fclose (f);
+  g_free (data);
+  return 0;
+}
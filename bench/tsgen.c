@@ -0,0 +1,807 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+/* writes deterministic synthetic transport streams for benchmarking: an
+ * MPEG-2 or H.264 video PID and up to seven MPEG, AC3 or DTS audio PIDs
+ * with real elementary stream headers, so the parsers lock on like they
+ * do on a recording, plus an optional enigma2 .ap/.cuts pair */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include "tspacket.h"
+#include "tspsi.h"
+
+#define TSGEN_MAX_AUDIO 7
+#define TSGEN_PROGRAM_NUMBER 1
+#define TSGEN_PMT_PID 0x0100
+#define TSGEN_VIDEO_PID 0x0101
+#define TSGEN_FRAME_DURATION 3600       /* 25 fps */
+/* PAT and PMT go out before every fourth video frame */
+#define TSGEN_PSI_INTERVAL 4
+/* the PCR runs this far ahead of the PTS of the frame it's sent with */
+#define TSGEN_PCR_DELAY 45000
+/* a discontinuity moves the timestamps this far ahead */
+#define TSGEN_DISCONTINUITY_JUMP (30 * 90000)
+
+typedef struct _Stream
+{
+  guint16 pid;
+  guint8 stream_id;
+  guint8 stream_type;
+  TsCodec codec;
+  const gchar *language;
+  guint8 cc;
+  gboolean discontinuity;
+  guint64 time;                 /* next frame, relative to the start */
+  guint frame_duration;
+  guint frame_size;
+  guint frames;
+} Stream;
+
+typedef struct _Generator
+{
+  FILE *out;
+  FILE *ap;
+  gchar *filename;
+  Stream streams[1 + TSGEN_MAX_AUDIO];
+  guint n_streams;
+  guint bitrate;
+  guint gop_size;
+  guint64 duration;
+  guint64 discontinuity_interval;
+  guint64 next_discontinuity;
+  guint n_cuts;
+  guint32 seed;
+  guint64 base_pts;
+  guint64 pts_offset;
+  guint64 offset;
+  guint8 pat_cc;
+  guint8 pmt_cc;
+  guint8 *frame;
+} Generator;
+
+typedef struct _BitWriter
+{
+  guint8 *data;
+  guint pos;                    /* in bits */
+} BitWriter;
+
+static const gchar *languages[TSGEN_MAX_AUDIO] =
+    { "deu", "eng", "fra", "ita", "spa", "nld", "pol" };
+
+static void
+bits_put (BitWriter * bw, guint32 value, guint n)
+{
+  while (n--) {
+    guint8 *byte = bw->data + bw->pos / 8;
+    if (bw->pos % 8 == 0)
+      *byte = 0;
+    if (value & (1u << n))
+      *byte |= 0x80 >> (bw->pos % 8);
+    bw->pos++;
+  }
+}
+
+static void
+bits_put_ue (BitWriter * bw, guint32 value)
+{
+  guint n = 0;
+
+  while ((value + 1) >> (n + 1))
+    n++;
+  bits_put (bw, 0, n);
+  bits_put (bw, value + 1, n + 1);
+}
+
+/* pads to the next byte with the rbsp stop bit, returns the length */
+static guint
+bits_finish (BitWriter * bw, gboolean stop_bit)
+{
+  if (stop_bit)
+    bits_put (bw, 1, 1);
+  if (bw->pos % 8)
+    bits_put (bw, 0, 8 - bw->pos % 8);
+  return bw->pos / 8;
+}
+
+static guint32
+next_random (Generator * gen)
+{
+  gen->seed = gen->seed * 1103515245 + 12345;
+  return gen->seed >> 8;
+}
+
+/* fills with bytes that are never zero so no start codes can appear */
+static void
+fill_payload (Generator * gen, guint8 * data, guint len)
+{
+  guint i;
+
+  for (i = 0; i < len; i++)
+    data[i] = 1 + next_random (gen) % 255;
+}
+
+/* copies an H.264 NAL unit after a start code, inserting the emulation
+ * prevention bytes */
+static guint
+put_nal (guint8 * data, guint8 header, const guint8 * rbsp, guint len)
+{
+  guint i, pos = 0, zeros = 0;
+
+  data[pos++] = 0x00;
+  data[pos++] = 0x00;
+  data[pos++] = 0x01;
+  data[pos++] = header;
+  for (i = 0; i < len; i++) {
+    if (zeros >= 2 && rbsp[i] <= 0x03) {
+      data[pos++] = 0x03;
+      zeros = 0;
+    }
+    data[pos++] = rbsp[i];
+    zeros = rbsp[i] ? 0 : zeros + 1;
+  }
+  return pos;
+}
+
+/* 1920x1080 main profile, 25 fps */
+static guint
+write_h264_headers (guint8 * data)
+{
+  guint8 rbsp[64];
+  BitWriter bw = { rbsp, 0 };
+  guint len;
+
+  bits_put (&bw, 77, 8);        /* profile_idc */
+  bits_put (&bw, 0x40, 8);      /* constraint_set1 */
+  bits_put (&bw, 40, 8);        /* level_idc */
+  bits_put_ue (&bw, 0);         /* seq_parameter_set_id */
+  bits_put_ue (&bw, 0);         /* log2_max_frame_num_minus4 */
+  bits_put_ue (&bw, 2);         /* pic_order_cnt_type */
+  bits_put_ue (&bw, 1);         /* max_num_ref_frames */
+  bits_put (&bw, 0, 1);
+  bits_put_ue (&bw, 1920 / 16 - 1);
+  bits_put_ue (&bw, 1088 / 16 - 1);
+  bits_put (&bw, 1, 1);         /* frame_mbs_only_flag */
+  bits_put (&bw, 1, 1);         /* direct_8x8_inference_flag */
+  bits_put (&bw, 1, 1);         /* frame_cropping_flag */
+  bits_put_ue (&bw, 0);
+  bits_put_ue (&bw, 0);
+  bits_put_ue (&bw, 0);
+  bits_put_ue (&bw, 4);         /* 1088 - 2 * 4 lines */
+  bits_put (&bw, 1, 1);         /* vui_parameters_present_flag */
+  bits_put (&bw, 1, 1);         /* aspect_ratio_info_present_flag */
+  bits_put (&bw, 1, 8);         /* square pixels */
+  bits_put (&bw, 0, 1);         /* overscan_info_present_flag */
+  bits_put (&bw, 0, 1);         /* video_signal_type_present_flag */
+  bits_put (&bw, 0, 1);         /* chroma_loc_info_present_flag */
+  bits_put (&bw, 1, 1);         /* timing_info_present_flag */
+  bits_put (&bw, 1, 32);        /* num_units_in_tick */
+  bits_put (&bw, 50, 32);       /* time_scale */
+  bits_put (&bw, 1, 1);         /* fixed_frame_rate_flag */
+  bits_put (&bw, 0, 5);         /* no HRD, pic_struct or restrictions */
+  len = put_nal (data, 0x67, rbsp, bits_finish (&bw, TRUE));
+
+  bw.pos = 0;
+  bits_put_ue (&bw, 0);         /* pic_parameter_set_id */
+  bits_put_ue (&bw, 0);         /* seq_parameter_set_id */
+  bits_put (&bw, 0, 2);         /* CAVLC, no bottom_field_pic_order */
+  bits_put_ue (&bw, 0);         /* num_slice_groups_minus1 */
+  bits_put_ue (&bw, 0);
+  bits_put_ue (&bw, 0);
+  bits_put (&bw, 0, 3);         /* no weighted prediction */
+  bits_put_ue (&bw, 0);         /* pic_init_qp_minus26, se(0) */
+  bits_put_ue (&bw, 0);
+  bits_put_ue (&bw, 0);
+  bits_put (&bw, 1, 1);         /* deblocking_filter_control_present_flag */
+  bits_put (&bw, 0, 2);
+  len += put_nal (data + len, 0x68, rbsp, bits_finish (&bw, TRUE));
+  return len;
+}
+
+static guint
+write_h264_frame (Generator * gen, Stream * s, guint8 * data, guint size,
+    gboolean key)
+{
+  static const guint8 aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+  guint8 rbsp[16];
+  BitWriter bw = { rbsp, 0 };
+  guint len;
+
+  memcpy (data, aud, sizeof (aud));
+  len = sizeof (aud);
+  if (key)
+    len += write_h264_headers (data + len);
+
+  bits_put_ue (&bw, 0);         /* first_mb_in_slice */
+  bits_put_ue (&bw, key ? 7 : 5);       /* slice_type I or P */
+  bits_put_ue (&bw, 0);         /* pic_parameter_set_id */
+  bits_put (&bw, (s->frames % gen->gop_size) & 0x0F, 4);  /* frame_num */
+  if (key)
+    bits_put_ue (&bw, 0);       /* idr_pic_id */
+  len += put_nal (data + len, key ? 0x65 : 0x41, rbsp,
+      bits_finish (&bw, FALSE));
+
+  if (size > len)
+    fill_payload (gen, data + len, size - len);
+  return MAX (size, len);
+}
+
+/* 720x576 main profile at main level, 25 fps */
+static guint
+write_mpeg2_frame (Generator * gen, Stream * s, guint8 * data, guint size,
+    gboolean key)
+{
+  BitWriter bw = { data, 0 };
+  guint temporal_reference = s->frames % gen->gop_size;
+  guint len;
+
+  if (key) {
+    bits_put (&bw, 0x000001B3, 32);
+    bits_put (&bw, 720, 12);
+    bits_put (&bw, 576, 12);
+    bits_put (&bw, 2, 4);       /* 4:3 */
+    bits_put (&bw, 3, 4);       /* 25 fps */
+    bits_put (&bw, gen->bitrate * 1000 / 400, 18);
+    bits_put (&bw, 1, 1);       /* marker */
+    bits_put (&bw, 112, 10);    /* vbv_buffer_size */
+    bits_put (&bw, 0, 3);       /* no constraints or matrices */
+
+    bits_put (&bw, 0x000001B5, 32);
+    bits_put (&bw, 1, 4);       /* sequence extension */
+    bits_put (&bw, 0x48, 8);    /* main profile at main level */
+    bits_put (&bw, 1, 1);       /* progressive_sequence */
+    bits_put (&bw, 1, 2);       /* 4:2:0 */
+    bits_put (&bw, 0, 16);      /* size and bitrate extensions */
+    bits_put (&bw, 1, 1);       /* marker */
+    bits_put (&bw, 0, 16);      /* vbv extension, low_delay, frame rate */
+
+    bits_put (&bw, 0x000001B8, 32);
+    bits_put (&bw, 1 << 12, 25);        /* time code with marker bit */
+    bits_put (&bw, 1, 1);       /* closed_gop */
+    bits_put (&bw, 0, 6);
+  }
+
+  bits_put (&bw, 0x00000100, 32);
+  bits_put (&bw, temporal_reference, 10);
+  bits_put (&bw, key ? 1 : 2, 3);
+  bits_put (&bw, 0xFFFF, 16);   /* vbv_delay */
+  if (!key)
+    bits_put (&bw, 7, 4);       /* full_pel_forward_vector, f_code */
+  bits_finish (&bw, FALSE);
+
+  bits_put (&bw, 0x000001B5, 32);
+  bits_put (&bw, 8, 4);         /* picture coding extension */
+  bits_put (&bw, key ? 0xFFFF : 0x11FF, 16);    /* f_codes */
+  bits_put (&bw, 0, 2);         /* intra_dc_precision */
+  bits_put (&bw, 3, 2);         /* frame picture */
+  bits_put (&bw, 0x41, 8);      /* frame_pred_frame_dct, chroma_420_type */
+  bits_put (&bw, 1, 1);         /* progressive_frame */
+  bits_put (&bw, 0, 1);
+  len = bits_finish (&bw, FALSE);
+
+  data[len++] = 0x00;
+  data[len++] = 0x00;
+  data[len++] = 0x01;
+  data[len++] = 0x01;           /* first slice */
+  if (size > len)
+    fill_payload (gen, data + len, size - len);
+  return MAX (size, len);
+}
+
+static guint
+write_audio_frame (Generator * gen, Stream * s, guint8 * data)
+{
+  BitWriter bw = { data, 0 };
+  guint len;
+
+  switch (s->codec) {
+    case TS_CODEC_AC3:
+      /* 192 kbit/s, 48 kHz, 2/0 */
+      data[0] = 0x0B;
+      data[1] = 0x77;
+      data[2] = 0x00;           /* crc1 */
+      data[3] = 0x00;
+      data[4] = 0x14;           /* fscod, frmsizecod */
+      data[5] = 0x40;           /* bsid 8, bsmod 0 */
+      data[6] = 0x40;           /* acmod 2 */
+      len = 7;
+      break;
+    case TS_CODEC_DTS:
+      /* core only, 768 kbit/s, 48 kHz, stereo, 512 samples */
+      bits_put (&bw, 0x7FFE8001, 32);
+      bits_put (&bw, 1, 1);     /* normal frame */
+      bits_put (&bw, 31, 5);    /* deficit sample count */
+      bits_put (&bw, 0, 1);     /* no CRC */
+      bits_put (&bw, 15, 7);    /* NBLKS */
+      bits_put (&bw, s->frame_size - 1, 14);
+      bits_put (&bw, 2, 6);     /* AMODE L+R */
+      bits_put (&bw, 13, 4);    /* SFREQ */
+      bits_put (&bw, 15, 5);    /* RATE */
+      bits_put (&bw, 0, 10);
+      bits_put (&bw, 7, 4);     /* VERNUM */
+      bits_put (&bw, 0, 2);     /* CHIST */
+      bits_put (&bw, 6, 3);     /* 24 bit source */
+      bits_put (&bw, 0, 6);
+      len = bits_finish (&bw, FALSE);
+      break;
+    default:
+      /* layer II, 192 kbit/s, 48 kHz, stereo, no CRC */
+      data[0] = 0xFF;
+      data[1] = 0xFD;
+      data[2] = 0xA4;
+      data[3] = 0x04;
+      len = 4;
+      break;
+  }
+  fill_payload (gen, data + len, s->frame_size - len);
+  return s->frame_size;
+}
+
+static void
+put_timestamp (guint8 * p, guint8 marker, guint64 ts)
+{
+  p[0] = marker | ((ts >> 29) & 0x0E) | 0x01;
+  p[1] = (ts >> 22) & 0xFF;
+  p[2] = ((ts >> 14) & 0xFE) | 0x01;
+  p[3] = (ts >> 7) & 0xFF;
+  p[4] = ((ts << 1) & 0xFE) | 0x01;
+}
+
+static void
+write_packet (Generator * gen, const guint8 * packet)
+{
+  fwrite (packet, TS_PACKET_SIZE, 1, gen->out);
+  gen->offset += TS_PACKET_SIZE;
+}
+
+/* splits a PES packet into transport packets, the first one carries the
+ * PCR, the random access and discontinuity flags when asked for */
+static void
+write_pes (Generator * gen, Stream * s, guint64 pts, const guint8 * es,
+    guint es_len, gboolean with_pcr, gboolean key)
+{
+  guint8 header[14];
+  guint8 packet[TS_PACKET_SIZE];
+  guint header_len = 14, pes_len, done = 0;
+  gboolean first = TRUE;
+
+  pts &= (G_GUINT64_CONSTANT (1) << 33) - 1;
+  header[0] = 0x00;
+  header[1] = 0x00;
+  header[2] = 0x01;
+  header[3] = s->stream_id;
+  pes_len = es_len + header_len - 6;
+  if (pes_len > 0xFFFF)
+    pes_len = 0;                /* unbounded video PES */
+  header[4] = pes_len >> 8;
+  header[5] = pes_len & 0xFF;
+  header[6] = 0x80 | (key ? 0x04 : 0x00);       /* data_alignment */
+  header[7] = 0x80;             /* PTS only */
+  header[8] = 5;
+  put_timestamp (header + 9, 0x20, pts);
+
+  while (done < header_len + es_len) {
+    guint room, af_len = 0, n, pos;
+    gboolean pcr = first && with_pcr;
+    gboolean flags = first && (pcr || key || s->discontinuity);
+
+    packet[0] = TS_SYNC_BYTE;
+    packet[1] = (first ? 0x40 : 0x00) | (s->pid >> 8);
+    packet[2] = s->pid & 0xFF;
+    packet[3] = s->cc;
+    s->cc = (s->cc + 1) & 0x0F;
+
+    if (flags)
+      af_len = pcr ? 8 : 2;
+    room = TS_PACKET_SIZE - 4 - af_len;
+    n = MIN (room, header_len + es_len - done);
+    if (n < room && !af_len)
+      af_len = 1;
+    if (af_len)
+      af_len = TS_PACKET_SIZE - 4 - n;
+
+    pos = 4;
+    if (af_len) {
+      packet[3] |= 0x30;
+      packet[4] = af_len - 1;
+      if (af_len > 1) {
+        packet[5] = 0x00;
+        if (first && s->discontinuity)
+          packet[5] |= 0x80;
+        if (first && key)
+          packet[5] |= 0x40;
+        if (pcr) {
+          guint64 base = (pts - TSGEN_PCR_DELAY) &
+              ((G_GUINT64_CONSTANT (1) << 33) - 1);
+          packet[5] |= 0x10;
+          packet[6] = base >> 25;
+          packet[7] = base >> 17;
+          packet[8] = base >> 9;
+          packet[9] = base >> 1;
+          packet[10] = ((base & 1) << 7) | 0x7E;
+          packet[11] = 0x00;
+          memset (packet + 12, 0xFF, af_len - 8);
+        } else
+          memset (packet + 6, 0xFF, af_len - 2);
+      }
+      pos += af_len;
+    } else
+      packet[3] |= 0x10;
+
+    while (pos < TS_PACKET_SIZE) {
+      if (done < header_len)
+        packet[pos++] = header[done++];
+      else {
+        guint chunk = TS_PACKET_SIZE - pos;
+        memcpy (packet + pos, es + done - header_len, chunk);
+        pos += chunk;
+        done += chunk;
+      }
+    }
+    write_packet (gen, packet);
+    first = FALSE;
+  }
+  s->discontinuity = FALSE;
+}
+
+static void
+write_psi (Generator * gen)
+{
+  guint8 packet[TS_PACKET_SIZE];
+  guint8 *s;
+  guint len, i;
+  guint32 crc;
+
+  ts_write_pat (packet, TSGEN_PROGRAM_NUMBER, TSGEN_PMT_PID, gen->pat_cc);
+  gen->pat_cc = (gen->pat_cc + 1) & 0x0F;
+  write_packet (gen, packet);
+
+  /* a DVB style PMT, the audio PIDs carry ISO 639 descriptors and the
+   * private ones are told apart by their AC3 or DTS descriptor */
+  memset (packet, 0xFF, TS_PACKET_SIZE);
+  packet[0] = TS_SYNC_BYTE;
+  packet[1] = 0x40 | (TSGEN_PMT_PID >> 8);
+  packet[2] = TSGEN_PMT_PID & 0xFF;
+  packet[3] = 0x10 | gen->pmt_cc;
+  packet[4] = 0x00;
+  gen->pmt_cc = (gen->pmt_cc + 1) & 0x0F;
+  s = packet + 5;
+  s[0] = 0x02;
+  s[3] = TSGEN_PROGRAM_NUMBER >> 8;
+  s[4] = TSGEN_PROGRAM_NUMBER & 0xFF;
+  s[5] = 0xC1;
+  s[6] = 0x00;
+  s[7] = 0x00;
+  s[8] = 0xE0 | (TSGEN_VIDEO_PID >> 8);
+  s[9] = TSGEN_VIDEO_PID & 0xFF;
+  s[10] = 0xF0;
+  s[11] = 0x00;
+  len = 12;
+  for (i = 0; i < gen->n_streams; i++) {
+    const Stream *stream = &gen->streams[i];
+    guint8 *es = s + len;
+    guint dlen = 0;
+
+    es[0] = stream->stream_type;
+    es[1] = 0xE0 | (stream->pid >> 8);
+    es[2] = stream->pid & 0xFF;
+    if (stream->language) {
+      es[5 + dlen++] = 0x0A;
+      es[5 + dlen++] = 4;
+      memcpy (es + 5 + dlen, stream->language, 3);
+      dlen += 3;
+      es[5 + dlen++] = 0x00;
+    }
+    if (stream->codec == TS_CODEC_AC3 || stream->codec == TS_CODEC_DTS) {
+      es[5 + dlen++] = stream->codec == TS_CODEC_AC3 ? 0x6A : 0x7B;
+      es[5 + dlen++] = 1;
+      es[5 + dlen++] = 0x00;
+    }
+    es[3] = 0xF0;
+    es[4] = dlen;
+    len += 5 + dlen;
+  }
+  s[1] = 0xB0 | ((len + 1) >> 8);
+  s[2] = (len + 1) & 0xFF;
+  crc = ts_crc32 (s, len);
+  s[len] = crc >> 24;
+  s[len + 1] = crc >> 16;
+  s[len + 2] = crc >> 8;
+  s[len + 3] = crc;
+  write_packet (gen, packet);
+}
+
+static void
+write_be64 (FILE * f, guint64 val)
+{
+  guint8 b[8];
+  guint i;
+
+  for (i = 0; i < 8; i++)
+    b[i] = val >> (56 - 8 * i);
+  fwrite (b, sizeof (b), 1, f);
+}
+
+static void
+write_video_frame (Generator * gen, Stream * s)
+{
+  gboolean key = s->frames % gen->gop_size == 0;
+  guint64 pts;
+  guint avg, size, len;
+
+  if (key && gen->discontinuity_interval && s->time >= gen->next_discontinuity) {
+    guint i;
+    gen->pts_offset += TSGEN_DISCONTINUITY_JUMP;
+    gen->next_discontinuity += gen->discontinuity_interval;
+    for (i = 0; i < gen->n_streams; i++) {
+      gen->streams[i].discontinuity = TRUE;
+      /* the continuity counters may restart on a discontinuity */
+      gen->streams[i].cc = (gen->streams[i].cc + 5) & 0x0F;
+    }
+  }
+  if (s->frames % TSGEN_PSI_INTERVAL == 0)
+    write_psi (gen);
+
+  /* I frames are three times the size of P frames */
+  avg = gen->bitrate * 1000 / 8 / 25;
+  if (gen->gop_size == 1)
+    size = avg;
+  else if (key)
+    size = avg * gen->gop_size * 3 / (gen->gop_size + 2);
+  else
+    size = avg * gen->gop_size / (gen->gop_size + 2);
+  size += next_random (gen) % (size / 8 + 1);
+
+  if (s->codec == TS_CODEC_H264)
+    len = write_h264_frame (gen, s, gen->frame, size, key);
+  else
+    len = write_mpeg2_frame (gen, s, gen->frame, size, key);
+
+  pts = gen->base_pts + gen->pts_offset + s->time;
+  if (key && gen->ap) {
+    write_be64 (gen->ap, gen->offset);
+    write_be64 (gen->ap, pts & ((G_GUINT64_CONSTANT (1) << 33) - 1));
+  }
+  write_pes (gen, s, pts, gen->frame, len, TRUE, key);
+}
+
+static gboolean
+write_cuts (Generator * gen)
+{
+  gchar *filename = g_strconcat (gen->filename, ".cuts", NULL);
+  FILE *f = fopen (filename, "wb");
+  guint64 part = gen->duration / (2 * gen->n_cuts + 1);
+  guint i;
+
+  g_free (filename);
+  if (!f)
+    return FALSE;
+  /* keeps every other part of the recording */
+  for (i = 0; i < gen->n_cuts; i++) {
+    guint8 type[4] = { 0, 0, 0, 0 };
+    write_be64 (f, part * (2 * i + 1));
+    fwrite (type, sizeof (type), 1, f);
+    type[3] = 1;
+    write_be64 (f, part * (2 * i + 2));
+    fwrite (type, sizeof (type), 1, f);
+  }
+  return fclose (f) == 0;
+}
+
+static gboolean
+add_audio (Generator * gen, const gchar * name)
+{
+  guint index = gen->n_streams - 1;
+  Stream *s = &gen->streams[gen->n_streams];
+
+  if (index >= TSGEN_MAX_AUDIO)
+    return FALSE;
+  s->pid = TSGEN_VIDEO_PID + 1 + index;
+  s->language = languages[index];
+  if (!g_ascii_strcasecmp (name, "mpeg")) {
+    s->codec = TS_CODEC_MPEG_AUDIO;
+    s->stream_type = 0x03;
+    s->stream_id = 0xC0 + index;
+    s->frame_size = 576;
+    s->frame_duration = 2160;
+  } else if (!g_ascii_strcasecmp (name, "ac3")) {
+    s->codec = TS_CODEC_AC3;
+    s->stream_type = 0x06;
+    s->stream_id = 0xBD;
+    s->frame_size = 768;
+    s->frame_duration = 2880;
+  } else if (!g_ascii_strcasecmp (name, "dts")) {
+    s->codec = TS_CODEC_DTS;
+    s->stream_type = 0x06;
+    s->stream_id = 0xBD;
+    s->frame_size = 1024;
+    s->frame_duration = 960;
+  } else
+    return FALSE;
+  gen->n_streams++;
+  return TRUE;
+}
+
+static void
+usage (void)
+{
+  g_print ("tsgen - writes synthetic transport streams for benchmarking\n"
+      "Usage: tsgen [OPTION...] output.ts\n"
+      "  -v, --video=mpeg2|h264         video codec (h264)\n"
+      "  -a, --audio=LIST               comma separated audio codecs out of\n"
+      "                                 mpeg, ac3 and dts, up to seven (mpeg)\n"
+      "  -d, --duration=SECONDS         length of the stream (60)\n"
+      "  -b, --bitrate=KBITS            average video bitrate (8000)\n"
+      "  -g, --gop=FRAMES               frames from one I frame to the next (12)\n"
+      "  -D, --discontinuity=SECONDS    jump the timestamps every SECONDS\n"
+      "  -c, --cuts=SEGMENTS            write a .cuts file keeping SEGMENTS\n"
+      "                                 parts and the .ap access points\n"
+      "  -S, --seed=N                   seed of the payload generator (1)\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option options[] = {
+    {"video", required_argument, NULL, 'v'},
+    {"audio", required_argument, NULL, 'a'},
+    {"duration", required_argument, NULL, 'd'},
+    {"bitrate", required_argument, NULL, 'b'},
+    {"gop", required_argument, NULL, 'g'},
+    {"discontinuity", required_argument, NULL, 'D'},
+    {"cuts", required_argument, NULL, 'c'},
+    {"seed", required_argument, NULL, 'S'},
+    {"help", no_argument, NULL, '?'},
+    {NULL, 0, NULL, 0}
+  };
+  Generator gen;
+  const gchar *video = "h264", *audio = "mpeg";
+  gchar **codecs;
+  guint64 end;
+  guint i;
+  int opt;
+
+  memset (&gen, 0, sizeof (gen));
+  gen.bitrate = 8000;
+  gen.gop_size = 12;
+  gen.duration = 60 * 90000;
+  gen.seed = 1;
+
+  while ((opt = getopt_long (argc, argv, "v:a:d:b:g:D:c:S:?", options,
+              NULL)) >= 0) {
+    switch (opt) {
+      case 'v':
+        video = optarg;
+        break;
+      case 'a':
+        audio = optarg;
+        break;
+      case 'd':
+        gen.duration = (guint64) atoi (optarg) * 90000;
+        break;
+      case 'b':
+        gen.bitrate = atoi (optarg);
+        break;
+      case 'g':
+        gen.gop_size = MAX (atoi (optarg), 1);
+        break;
+      case 'D':
+        gen.discontinuity_interval = (guint64) atoi (optarg) * 90000;
+        break;
+      case 'c':
+        gen.n_cuts = atoi (optarg);
+        break;
+      case 'S':
+        gen.seed = strtoul (optarg, NULL, 0);
+        break;
+      default:
+        usage ();
+        return 1;
+    }
+  }
+  if (optind != argc - 1 || !gen.bitrate || !gen.duration) {
+    usage ();
+    return 1;
+  }
+  gen.filename = argv[optind];
+
+  gen.streams[0].pid = TSGEN_VIDEO_PID;
+  gen.streams[0].stream_id = 0xE0;
+  gen.streams[0].frame_duration = TSGEN_FRAME_DURATION;
+  if (!g_ascii_strcasecmp (video, "h264")) {
+    gen.streams[0].codec = TS_CODEC_H264;
+    gen.streams[0].stream_type = 0x1B;
+  } else if (!g_ascii_strcasecmp (video, "mpeg2")) {
+    gen.streams[0].codec = TS_CODEC_MPEG_VIDEO;
+    gen.streams[0].stream_type = 0x02;
+  } else {
+    g_fprintf (stderr, "unknown video codec %s\n", video);
+    return 1;
+  }
+  gen.n_streams = 1;
+  codecs = g_strsplit (audio, ",", -1);
+  for (i = 0; codecs[i]; i++) {
+    if (!add_audio (&gen, codecs[i])) {
+      g_fprintf (stderr, "can't add %s audio stream\n", codecs[i]);
+      return 1;
+    }
+  }
+  g_strfreev (codecs);
+
+  gen.out = fopen (gen.filename, "wb");
+  if (!gen.out) {
+    g_fprintf (stderr, "can't open %s\n", gen.filename);
+    return 1;
+  }
+  setvbuf (gen.out, NULL, _IOFBF, 1024 * 1024);
+  if (gen.n_cuts) {
+    gchar *ap_filename = g_strconcat (gen.filename, ".ap", NULL);
+    gen.ap = fopen (ap_filename, "wb");
+    g_free (ap_filename);
+    if (!gen.ap || !write_cuts (&gen)) {
+      g_fprintf (stderr, "can't write the cutlist of %s\n", gen.filename);
+      return 1;
+    }
+  }
+
+  /* every run of the same options gives the same stream */
+  gen.base_pts = 90000 * (10 + next_random (&gen) % 3600);
+  gen.next_discontinuity = gen.discontinuity_interval;
+  gen.frame = g_malloc (gen.bitrate * 1000 / 8 / 25 * 4 + 1024);
+
+  /* sends the frames of all streams in the order of their timestamps */
+  end = gen.duration;
+  for (;;) {
+    Stream *next = &gen.streams[0];
+    guint len;
+
+    for (i = 1; i < gen.n_streams; i++)
+      if (gen.streams[i].time < next->time)
+        next = &gen.streams[i];
+    if (next->time >= end)
+      break;
+    if (next == &gen.streams[0])
+      write_video_frame (&gen, next);
+    else {
+      len = write_audio_frame (&gen, next, gen.frame);
+      write_pes (&gen, next, gen.base_pts + gen.pts_offset + next->time,
+          gen.frame, len, FALSE, FALSE);
+    }
+    next->time += next->frame_duration;
+    next->frames++;
+  }
+
+  g_free (gen.frame);
+  if (gen.ap && fclose (gen.ap) != 0) {
+    g_fprintf (stderr, "can't write the access points of %s\n",
+        gen.filename);
+    return 1;
+  }
+  if (fclose (gen.out) != 0) {
+    g_fprintf (stderr, "can't write %s\n", gen.filename);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+
+#include "common.h"
+#include "accesspoints.h"
+#include "tspacket.h"
+
+#define AP_PTS_WRAP (G_GUINT64_CONSTANT (1) << 33)
+/* PTS steps between access points beyond this are discontinuities */
+#define AP_MAX_GAP (10 * 90000)
+
+static guint64
+read_be64 (const guint8 * p)
+{
+  guint64 val = 0;
+  guint i;
+
+  for (i = 0; i < 8; i++)
+    val = (val << 8) | p[i];
+  return val;
+}
+
+/* reads the big endian offset/PTS pairs enigma2 records for every GOP and
+ * puts them on a continuous timeline the way enigma2 fixes up cut times */
+GArray *
+access_points_load (const gchar * filename)
+{
+  FILE *f;
+  GArray *points;
+  guint8 record[16];
+  guint64 last_pts = 0, step = 0;
+  AccessPoint ap;
+
+  f = fopen (filename, "rb");
+  if (!f)
+    return NULL;
+
+  points = g_array_new (FALSE, FALSE, sizeof (AccessPoint));
+  ap.time = 0;
+  while (fread (record, sizeof (record), 1, f) == 1) {
+    guint64 pts = read_be64 (record + 8);
+
+    ap.offset = read_be64 (record);
+    ap.offset -= ap.offset % TS_PACKET_SIZE;
+    if (points->len) {
+      guint64 delta = (pts - last_pts) & (AP_PTS_WRAP - 1);
+      if (delta > AP_MAX_GAP) {
+        GST_DEBUG ("access point PTS discontinuity at offset %"
+            G_GUINT64_FORMAT, ap.offset);
+        delta = step;
+      }
+      ap.time += delta;
+      step = delta;
+    }
+    last_pts = pts;
+    g_array_append_val (points, ap);
+  }
+  fclose (f);
+
+  GST_INFO ("loaded %i access points from %s", points->len, filename);
+  if (!points->len) {
+    g_array_free (points, TRUE);
+    return NULL;
+  }
+  return points;
+}
+
+/* widens [in_time, out_time) to whole GOPs: the range starts at the last
+ * access point at or before in_time and ends at the first one after
+ * out_time, out_time G_MAXUINT64 means up to the end of the file */
+void
+access_points_get_range (GArray * points, guint64 in_time, guint64 out_time,
+    ByteRange * range)
+{
+  guint lo = 0, hi = points->len;
+
+  /* last point with time <= in_time */
+  while (hi - lo > 1) {
+    guint mid = (lo + hi) / 2;
+    if (g_array_index (points, AccessPoint, mid).time <= in_time)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  range->start = g_array_index (points, AccessPoint, lo).offset;
+  if (lo == 0 && g_array_index (points, AccessPoint, 0).time >= in_time)
+    range->start = 0;
+
+  range->end = G_MAXUINT64;
+  if (out_time == G_MAXUINT64)
+    return;
+  /* first point with time > out_time */
+  hi = points->len;
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+    if (g_array_index (points, AccessPoint, mid).time <= out_time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < points->len)
+    range->end = g_array_index (points, AccessPoint, lo).offset;
+}
@@ -0,0 +1,37 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_ACCESSPOINTS_H__
+#define __BDREMUX_ACCESSPOINTS_H__
+
+#include "rangereader.h"
+
+/* one entry of enigma2's .ap file, time is on the continuous timeline the
+ * .cuts file uses: starting at 0 and corrected for PTS wraps and jumps */
+typedef struct _AccessPoint
+{
+  guint64 offset;
+  guint64 time;
+} AccessPoint;
+
+GArray *access_points_load (const gchar * filename);
+void access_points_get_range (GArray * points, guint64 in_time,
+    guint64 out_time, ByteRange * range);
+
+#endif /* __BDREMUX_ACCESSPOINTS_H__ */
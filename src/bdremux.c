@@ -17,560 +17,389 @@
  *                                                                         *
  ***************************************************************************/
 
-// gcc -Wall -g `pkg-config gstreamer-0.10 --cflags --libs` bdremux.c -o bdremux
+
+// gcc -Wall -g `pkg-config gstreamer-0.10 --cflags --libs` *.c -o bdremux
 
 #include <gst/gst.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <string.h>
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <getopt.h>
+#include <errno.h>
+#include <unistd.h>
 
-#include <byteswap.h>
-#include <netinet/in.h>
-
-#ifndef BYTE_ORDER
-#error no byte order defined!
-#endif
-
-#define CLOCK_BASE 9LL
-#define CLOCK_FREQ (CLOCK_BASE * 10000)
-
-#define MPEGTIME_TO_GSTTIME(time) (gst_util_uint64_scale ((time), \
-            GST_MSECOND/10, CLOCK_BASE))
-#define GSTTIME_TO_MPEGTIME(time) (gst_util_uint64_scale ((time), \
-            CLOCK_BASE, GST_MSECOND/10))
-
-#define MAX_PIDS 8
-#define DEFAULT_QUEUE_SIZE 48*1024*1024
+#include "bdremux.h"
+#include "common.h"
+#include "epmap.h"
 
-GST_DEBUG_CATEGORY (bdremux_debug);
-#define GST_CAT_DEFAULT bdremux_debug
+typedef struct _Batch Batch;
 
-typedef struct _App App;
+/* where the tool reports to, stderr once stdout carries the result */
+static FILE *f_messages;
 
-typedef struct _Segment
+/* a further result of the job, set up by the options following -o */
+typedef struct _CliResult
 {
-  int index;
-  guint64 in_pts;
-  guint64 out_pts;
-} segment_t;
-
-struct _App
-{
-  gchar *in_filename;
   gchar *out_filename;
+  gint source_pids[MAX_PIDS], sink_pids[MAX_PIDS];
+  guint n_source_pids, n_sink_pids;
   gchar *cuts_filename;
+  gchar *clpi_filename;
+  gchar *mpls_filename;
+
+  gboolean enable_indexing;
   gchar *epmap_filename;
+  FILE *f_epmap;
+  EpMapWriter *epmap;
+} CliResult;
+
+/* one job slot of the command line tool: the job and what goes to stdout
+ * or the entry point map file for it */
+typedef struct _Cli
+{
+  BdremuxJob *job;
+  guint n_jobs;
+  gchar *batch_filename;
+  FILE *f_messages;             /* like f_messages, for the job of the slot */
+
   gboolean enable_indexing;
-  gboolean enable_cutlist;
-  GstElement *pipeline;
-  GstElement *filesrc;
-  GstElement *tsdemux;
-  GstElement *queue;
-  GstElement *videoparser;
-  GstElement *audioparsers[MAX_PIDS];
-  GstElement *m2tsmux;
-  GstElement *filesink;
-  GstIndex *index;
-  gulong buffer_handler_id;
-  gint a_source_pids[MAX_PIDS], a_sink_pids[MAX_PIDS];
-  guint no_source_pids, no_sink_pids;
-  guint requested_pid_count;
-  gboolean auto_pids;
-
-  GMainLoop *loop;
-  gboolean is_seekable;
-  int current_segment;
-  int segment_count;
-  segment_t *seek_segments;
-
-  guint queue_cb_handler_id;
-  guint queue_size;
-  
+  gchar *epmap_filename;
+  EpMapFormat epmap_format;
   FILE *f_epmap;
+  EpMapWriter *epmap;
+  gboolean follow;
+  gboolean index_only;
+  gboolean probe;
+  gboolean verify;
+  CliResult results[BDREMUX_MAX_RESULTS - 1];
+  guint n_results;
+
+  gboolean enable_stats;
+  gchar *stats_filename;
+  FILE *f_stats;
+
+  Batch *batch;
+  guint job_id;
+} Cli;
+
+/* the jobs of a batch manifest, shared by all slots */
+struct _Batch
+{
+  GPtrArray *jobs;
+  guint next_job;
+  guint running, failed;
+  GAsyncQueue *done;            /* of Cli slots whose job has finished */
 };
 
-App s_app;
-
 static void
 bdremux_errout(gchar *string)
 {
-  g_fprintf(stdout, "ERROR: %s\n", string);
-  fflush(stdout);
+  g_fprintf(f_messages, "ERROR: %s\n", string);
+  fflush(f_messages);
   GST_ERROR (string);
   exit(1);
 }
 
-static gboolean
-load_cutlist (App * app)
+static void
+linked_cb (BdremuxJob * job, guint source_pid, guint sink_pid,
+    gpointer user_data)
 {
-  FILE *f;
-  int segment_i = 0;
-
-  f = fopen (app->cuts_filename, "rb");
-
-  if (f) {
-    GST_INFO ("cutfile found! loading cuts...");
-    while (1) {
-      unsigned long long where;
-      unsigned int what;
+  Cli *cli = user_data;
 
-      if (!fread (&where, sizeof (where), 1, f))
-        break;
-      if (!fread (&what, sizeof (what), 1, f))
-        break;
+  g_fprintf (cli->f_messages, "linked: Source PID %d to sink_%d\n",
+      source_pid, sink_pid);
+  fflush (cli->f_messages);
+}
 
-#if BYTE_ORDER == LITTLE_ENDIAN
-      where = bswap_64 (where);
-#endif
-      what = ntohl (what);
-      GST_DEBUG ("where= %lld, what=%i", where, what);
-      if (what > 3)
-        break;
+static void
+caps_cb (BdremuxJob * job, guint sink_pid, const gchar * caps,
+    gpointer user_data)
+{
+  Cli *cli = user_data;
 
-      if (what == 0) {
-        app->segment_count++;
-        app->seek_segments =
-            (segment_t *) realloc (app->seek_segments,
-            app->segment_count * sizeof (segment_t));
-        app->seek_segments[segment_i].index = segment_i;
-        app->seek_segments[segment_i].in_pts = where;
-        app->seek_segments[segment_i].out_pts = -1;
-      }
-      if (what == 1 && segment_i < app->segment_count) {
-        app->seek_segments[segment_i].out_pts = where;
-        segment_i++;
-      }
-    }
-    fclose (f);
-  } else
-    GST_WARNING ("cutfile not found!");
-// 
-  return TRUE;
+  g_fprintf (cli->f_messages, "m2tsmux:sink_%d has CAPS: %s\n", sink_pid,
+      caps);
+  fflush (cli->f_messages);
 }
 
-static gboolean
-do_seek (App * app)
+static void
+entry_point_cb (BdremuxJob * job, guint64 spn, gint64 pts, gpointer user_data)
 {
-  gint64 in_pos, out_pos;
-  gfloat rate = 1.0;
-  GstFormat fmt = GST_FORMAT_TIME;
-  GstSeekFlags flags = 0;
-  int ret;
-
-  if (app->current_segment >= app->segment_count) {
-    GST_WARNING ("seek segment not found!");
-    return FALSE;
+  Cli *cli = user_data;
+
+  epmap_writer_add (cli->epmap, spn, pts);
+  /* a recording in progress gets its map as it goes */
+  if (cli->follow) {
+    epmap_writer_flush (cli->epmap);
+    fflush (cli->f_epmap);
   }
+}
 
-  GST_INFO ("do_seek...");
-  flags |= GST_SEEK_FLAG_FLUSH;
-//      flags |= GST_SEEK_FLAG_ACCURATE;
-  flags |= GST_SEEK_FLAG_KEY_UNIT;
-  flags |= GST_SEEK_FLAG_SEGMENT;
+static void
+result_entry_point_cb (BdremuxJob * job, guint result, guint64 spn,
+    gint64 pts, gpointer user_data)
+{
+  Cli *cli = user_data;
+  CliResult *r = &cli->results[result - 1];
 
-  gst_element_query_position ((app->pipeline), &fmt, &in_pos);
-  GST_DEBUG ("do_seek::initial gst_element_query_position = %lld ms",
-      in_pos / 1000000);
+  epmap_writer_add (r->epmap, spn, pts);
+  if (cli->follow) {
+    epmap_writer_flush (r->epmap);
+    fflush (r->f_epmap);
+  }
+}
 
-  in_pos =
-      MPEGTIME_TO_GSTTIME (app->seek_segments[app->current_segment].in_pts);
-  GST_DEBUG ("do_seek::in_time for segment %i = %lld ms", app->current_segment,
-      in_pos / 1000000);
+static void
+finished_cb (BdremuxJob * job, const gchar * error, gpointer user_data)
+{
+  Cli *cli = user_data;
 
-  out_pos = -1;
-//       MPEGTIME_TO_GSTTIME (app->seek_segments[app->current_segment].out_pts);
-  GST_DEBUG ("do_seek::out_time for segment %i = %lld ms", app->current_segment,
-      out_pos / 1000000);
+  if (cli->batch)
+    g_async_queue_push (cli->batch->done, cli);
+}
 
-  ret = gst_element_seek ((app->pipeline), rate, GST_FORMAT_TIME, flags,
-      GST_SEEK_TYPE_SET, in_pos, GST_SEEK_TYPE_SET, out_pos);
+/* 90 kHz times in seconds, null if unknown */
+static void
+append_time (GString * line, const gchar * name, gint64 time)
+{
+  if (time < 0)
+    g_string_append_printf (line, ", \"%s\": null", name);
+  else
+    g_string_append_printf (line, ", \"%s\": %.3f", name, time / 90000.0);
+}
 
-  gst_element_query_position ((app->pipeline), &fmt, &in_pos);
-  GST_DEBUG
-      ("do_seek::seek command returned %i. new gst_element_query_position = %lld ms",
-      ret, in_pos / 1000000);
+/* the whole probe result as one JSON object on stdout */
+static void
+print_probe (const gchar * filename)
+{
+  BdremuxProbe probe;
+  GString *json;
+  gchar *error = NULL;
+  guint i;
+
+  if (!filename)
+    bdremux_errout (g_strdup ("no stream to probe!"));
+  if (!bdremux_probe (filename, &probe, &error))
+    bdremux_errout (error);
+
+  json = g_string_sized_new (2048);
+  g_string_append_printf (json, "{\"size\": %" G_GUINT64_FORMAT
+      ", \"packet_size\": %u, \"program_number\": %u, \"pmt_pid\": %u, "
+      "\"pcr_pid\": %u", probe.size, probe.packet_size, probe.program_number,
+      probe.pmt_pid, probe.pcr_pid);
+  append_time (json, "duration", probe.duration);
+  g_string_append_printf (json, ", \"bitrate\": %" G_GUINT64_FORMAT
+      ", \"streams\": [", probe.bitrate);
+  for (i = 0; i < probe.n_streams; i++) {
+    const BdremuxProbeStream *s = &probe.streams[i];
+    g_string_append_printf (json, "%s{\"pid\": %u, \"stream_type\": %u, "
+        "\"caps\": \"%s\"", i ? ", " : "", s->pid, s->stream_type, s->caps);
+    if (g_ascii_isalpha (s->language[0]) && g_ascii_isalpha (s->language[1])
+        && g_ascii_isalpha (s->language[2]))
+      g_string_append_printf (json, ", \"language\": \"%s\"", s->language);
+    else
+      g_string_append (json, ", \"language\": null");
+    append_time (json, "first_pts", s->first_pts);
+    append_time (json, "last_pts", s->last_pts);
+    g_string_append (json, "}");
+  }
+  g_string_append (json, "]}\n");
 
-  if (ret)
-    app->current_segment++;
+  fputs (json->str, stdout);
+  g_string_free (json, TRUE);
+}
 
-  return ret;
+/* the verdict as one JSON object on stdout, the exit status tells whether
+ * the stream matches its manifest */
+static int
+print_verify (const gchar * filename)
+{
+  static const gchar *names[] = { "none", "xxh64", "crc32c", "sha256" };
+  BdremuxVerify verify;
+  gchar *error = NULL;
+
+  if (!filename)
+    bdremux_errout (g_strdup ("no stream to verify!"));
+  if (!bdremux_verify (filename, &verify, &error))
+    bdremux_errout (error);
+
+  g_print ("{\"ok\": %s, \"size\": %" G_GUINT64_FORMAT
+      ", \"expected_size\": %" G_GUINT64_FORMAT ", \"checksum\": \"%s\", "
+      "\"checksum_ok\": %s, \"units\": %" G_GUINT64_FORMAT
+      ", \"bad_units\": %" G_GUINT64_FORMAT,
+      verify.ok ? "true" : "false", verify.size, verify.expected_size,
+      names[verify.checksum], verify.checksum_ok ? "true" : "false",
+      verify.n_units, verify.bad_units);
+  if (verify.first_bad_unit < 0)
+    g_print (", \"first_bad_offset\": null");
+  else
+    g_print (", \"first_bad_offset\": %" G_GINT64_FORMAT,
+        verify.first_bad_unit * BDREMUX_ALIGNED_UNIT_SIZE);
+  g_print (", \"mb_per_s\": %.1f}\n", verify.seconds > 0
+      ? verify.size / verify.seconds / (1024 * 1024) : 0.0);
+  return verify.ok ? 0 : 1;
 }
 
-static gboolean
-bus_message (GstBus * bus, GstMessage * message, App * app)
+/* one JSON object per line, written in one go so the lines of jobs
+ * running at the same time don't get mixed up */
+static void
+stats_cb (BdremuxJob * job, const BdremuxStats * stats, gpointer user_data)
 {
-  gchar *sourceName;
-  GstObject *source;
-  gchar *string;
-  GstState current_state;
+  Cli *cli = user_data;
+  GString *line = g_string_sized_new (1024);
+  guint i;
+
+  g_string_append_printf (line, "{\"job\": %u, \"elapsed\": %.3f, "
+      "\"bytes_read\": %" G_GUINT64_FORMAT ", \"bytes_total\": %"
+      G_GUINT64_FORMAT ", \"bytes_written\": %" G_GUINT64_FORMAT,
+      cli->job_id, stats->elapsed, stats->bytes_read, stats->bytes_total,
+      stats->bytes_written);
+  append_time (line, "position", stats->position);
+  append_time (line, "duration", stats->duration);
+  if (stats->eta < 0)
+    g_string_append (line, ", \"eta\": null");
+  else
+    g_string_append_printf (line, ", \"eta\": %.1f", stats->eta);
+  g_string_append_printf (line, ", \"entry_points\": %u, \"pool\": {"
+      "\"size\": %" G_GUINT64_FORMAT ", \"in_use\": %" G_GUINT64_FORMAT
+      ", \"peak\": %" G_GUINT64_FORMAT ", \"allocs\": %" G_GUINT64_FORMAT
+      ", \"fallbacks\": %" G_GUINT64_FORMAT "}, \"streams\": [",
+      stats->entry_points, stats->pool_size, stats->pool_in_use,
+      stats->pool_peak, stats->pool_allocs, stats->pool_fallbacks);
+  for (i = 0; i < stats->n_streams; i++) {
+    const BdremuxStreamStats *s = &stats->streams[i];
+    g_string_append_printf (line, "%s{\"source_pid\": %u, \"sink_pid\": %u, "
+        "\"buffers\": %" G_GUINT64_FORMAT ", \"bytes\": %" G_GUINT64_FORMAT
+        ", \"buffers_per_s\": %.1f, \"bytes_per_s\": %.0f, "
+        "\"queue_buffers\": %u, \"queue_bytes\": %" G_GUINT64_FORMAT,
+        i ? ", " : "", s->source_pid, s->sink_pid, s->buffers, s->bytes,
+        s->buffers_per_second, s->bytes_per_second, s->queue_buffers,
+        s->queue_bytes);
+    append_time (line, "queue_time", s->queue_time);
+    g_string_append_printf (line, ", \"blocked\": %s}",
+        s->blocked ? "true" : "false");
+  }
+  g_string_append (line, "]}\n");
 
-  if (!message)
-    return FALSE;
-  source = GST_MESSAGE_SRC (message);
-  if (!GST_IS_OBJECT (source))
-    return FALSE;
-  sourceName = gst_object_get_name (source);
+  fputs (line->str, cli->f_stats);
+  fflush (cli->f_stats);
+  g_string_free (line, TRUE);
+}
 
-  if (gst_message_get_structure (message))
-    string = gst_structure_to_string (gst_message_get_structure (message));
-  else
-    string = g_strdup (GST_MESSAGE_TYPE_NAME (message));
-  GST_DEBUG("gst_message from %s: %s", sourceName, string);
-  g_free (string);
-
-  switch (GST_MESSAGE_TYPE (message)) {
-    case GST_MESSAGE_ERROR:
-    {
-      GError *gerror;
-      gchar *debug;
-
-      gst_message_parse_error (message, &gerror, &debug);
-      gst_object_default_error (GST_MESSAGE_SRC (message), gerror, debug);
-      g_error_free (gerror);
-      g_free (debug);
-
-      g_main_loop_quit (app->loop);
-      break;
-    }
-    case GST_MESSAGE_WARNING:
-    {
-      GError *gerror;
-      gchar *debug;
+static const BdremuxCallbacks cli_callbacks = {
+  linked_cb,
+  caps_cb,
+  entry_point_cb,
+  NULL,
+  finished_cb,
+  NULL,
+  result_entry_point_cb
+};
 
-      gst_message_parse_warning (message, &gerror, &debug);
-      gst_object_default_error (GST_MESSAGE_SRC (message), gerror, debug);
-      g_error_free (gerror);
-      g_free (debug);
+/* the library only collects stats if there is a callback for them */
+static void
+set_callbacks (Cli * cli)
+{
+  BdremuxCallbacks callbacks = cli_callbacks;
 
-//       g_main_loop_quit (app->loop);
-      break;
-    }
-    case GST_MESSAGE_EOS:
-      g_message ("received EOS");
-      g_main_loop_quit (app->loop);
-      break;
-    case GST_MESSAGE_ASYNC_DONE:
-      break;
-    case GST_MESSAGE_ELEMENT:
-    {
-      const GstStructure *msgstruct = gst_message_get_structure (message);
-      if (msgstruct) {
-        const gchar *eventname = gst_structure_get_name (msgstruct);
-        if (!strcmp (eventname, "seekable"))
-          app->is_seekable = TRUE;
-      }
-      break;
-    }
-    case GST_MESSAGE_STATE_CHANGED:
-    {
-      GstState old_state, new_state;
-      GstStateChange transition;
-      if (GST_MESSAGE_SRC (message) != GST_OBJECT (app->tsdemux))
-        break;
+  if (cli->enable_stats)
+    callbacks.stats = stats_cb;
+  bdremux_job_set_callbacks (cli->job, &callbacks, cli);
+}
 
-      gst_message_parse_state_changed (message, &old_state, &new_state, NULL);
-      transition = (GstStateChange) GST_STATE_TRANSITION (old_state, new_state);
+static gboolean
+open_epmap (Cli * cli, gchar ** error)
+{
+  guint i;
 
-      switch (transition) {
-        case GST_STATE_CHANGE_NULL_TO_READY:
-          break;
-        case GST_STATE_CHANGE_READY_TO_PAUSED:
-          break;
-        case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
-        {
+  for (i = 0; i < cli->n_results; i++) {
+    CliResult *r = &cli->results[i];
 
-        }
-          break;
-        case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
-          break;
-        case GST_STATE_CHANGE_PAUSED_TO_READY:
-          break;
-        case GST_STATE_CHANGE_READY_TO_NULL:
-          break;
-      }
-      break;
+    if (!r->enable_indexing)
+      continue;
+    r->f_epmap = fopen (r->epmap_filename, "w");
+    if (!r->f_epmap) {
+      *error = g_strdup_printf ("could not open %s for writing entry point map! (%i)", r->epmap_filename, errno);
+      return FALSE;
     }
-    case GST_MESSAGE_SEGMENT_DONE:
-    {
-      GST_DEBUG ("GST_MESSAGE_SEGMENT_DONE!!!");
-      do_seek (app);
-    }
-    default:
-      break;
+    r->epmap = epmap_writer_new (r->f_epmap, cli->epmap_format);
   }
-  gst_element_get_state (app->pipeline, &current_state, NULL, 0);
-  if (app->current_segment == 0 && app->segment_count /*&& app->is_seekable*/
-      && current_state == GST_STATE_PLAYING)
-    do_seek (app);
-  GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(app->pipeline),GST_DEBUG_GRAPH_SHOW_ALL,"bdremux_pipelinegraph_message");
-  return TRUE;
-}
 
+  if (!cli->enable_indexing)
+    return TRUE;
 
-static void
-entry_added (GstIndex * index, GstIndexEntry * entry, App * app)
-{
-  switch (entry->type) {
-    case GST_INDEX_ENTRY_ID:
-      GST_DEBUG ("id %d describes writer %s\n", entry->id,
-          GST_INDEX_ID_DESCRIPTION (entry));
-      break;
-    case GST_INDEX_ENTRY_FORMAT:
-      GST_DEBUG ("%d: registered format %d for %s\n", entry->id,
-          GST_INDEX_FORMAT_FORMAT (entry), GST_INDEX_FORMAT_KEY (entry));
-      break;
-    case GST_INDEX_ENTRY_ASSOCIATION:
-    {
-      gint i;
-      if (entry->id == 1 && GST_INDEX_NASSOCS (entry) == 2 && GST_INDEX_ASSOC_VALUE (entry, 1) != -1) {
-        g_fprintf (app->f_epmap, "entrypoint: %" G_GINT64_FORMAT " ",
-            GST_INDEX_ASSOC_VALUE (entry, 0));
-        g_fprintf (app->f_epmap, "%" G_GINT64_FORMAT "\n", GST_INDEX_ASSOC_VALUE (entry, 1));
-        fflush(app->f_epmap);
-      } else {
-        GST_DEBUG ("GST_INDEX_ENTRY_ASSOCIATION %p, %d: %08x ", entry, entry->id,
-            GST_INDEX_ASSOC_FLAGS (entry));
-        for (i = 0; i < GST_INDEX_NASSOCS (entry); i++) {
-          GST_DEBUG ("%d %" G_GINT64_FORMAT " ", GST_INDEX_ASSOC_FORMAT (entry,
-                  i), GST_INDEX_ASSOC_VALUE (entry, i));
-        }
-      }
-      break;
-    }
-    default:
-      break;
+  if (cli->epmap_filename) {
+  cli->f_epmap = fopen (cli->epmap_filename, "w");
   }
-}
-
-static void
-pad_block_cb (GstPad * pad, gboolean blocked, App * app)
-{
-  GST_DEBUG("pad_block_cb %s:%s = %i", GST_DEBUG_PAD_NAME(pad), blocked);
+  else if (cli->index_only)
+    cli->f_epmap = stdout;
+  else
+    cli->f_epmap = cli->f_messages;
 
-  if (!blocked)
-    return;
+  if (!cli->f_epmap) {
+    *error = g_strdup_printf("could not open %s for writing entry point map! (%i)", cli->epmap_filename, errno);
+    return FALSE;
+  }
 
-//   gst_pad_set_blocked_async (pad, FALSE, pad_block_cb, NULL);
+  cli->epmap = epmap_writer_new (cli->f_epmap, cli->epmap_format);
+  return TRUE;
 }
 
-static void mux_pad_has_caps_cb(GstPad *pad, GParamSpec * unused, App * app)
+static gboolean
+open_stats (Cli * cli, gchar ** error)
 {
-        GstCaps *caps;
+  if (!cli->enable_stats)
+    return TRUE;
 
-        g_object_get (G_OBJECT (pad), "caps", &caps, NULL);
+  /* appended to, the jobs of a batch may share the file */
+  if (cli->stats_filename)
+    cli->f_stats = fopen (cli->stats_filename, "a");
+  else
+    cli->f_stats = cli->f_messages;
 
-        if (caps)
-        {
-                 g_fprintf(stdout, "%s:%s has CAPS: %s\n", GST_DEBUG_PAD_NAME(pad), gst_caps_to_string(caps));
-                 fflush(stdout);
-                 gst_caps_unref (caps);
-        }
+  if (!cli->f_stats) {
+    *error = g_strdup_printf ("could not open %s for writing statistics! (%i)", cli->stats_filename, errno);
+    return FALSE;
+  }
+  return TRUE;
 }
 
 static void
-queue_filled_cb (GstElement * element, App * app)
+close_stats (Cli * cli)
 {
-  GST_DEBUG ("queue_filled_cb requested_pid_count=%i, no_sink_pids=%i app->no_source_pids=%i", app->requested_pid_count, app->no_sink_pids, app->no_source_pids);
-  if (app->auto_pids || app->requested_pid_count == app->no_sink_pids)
-  {
-    GstPad *queue_srcpad = NULL;
-    gchar srcpadname[9];
-    int i, ret;
-    GST_INFO ("First time queue overrun -> UNBLOCKING all pads and start muxing! (have %i PIDS @ mux)", app->requested_pid_count);
-     for (i = 0; i < app->no_sink_pids; i++)
-     {
-       g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
-       queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
-       ret = gst_pad_set_blocked_async (queue_srcpad, FALSE, (GstPadBlockCallback) pad_block_cb, app);
-       GST_DEBUG ("UNBLOCKING %s returned %i", srcpadname, ret);
-     }
-  }
-  if (app->requested_pid_count >= app->no_sink_pids)
-  {
-    GST_DEBUG
-        ("Disconnect queue_filled_cb! requested_pid_count=%i, no_sink_pids=%i", app->requested_pid_count, app->no_sink_pids);
-    g_signal_handler_disconnect(G_OBJECT(element), app->queue_cb_handler_id);
-  }
+  if (cli->f_stats && cli->stats_filename)
+    fclose (cli->f_stats);
+  cli->f_stats = NULL;
 }
 
 static void
-demux_pad_added_cb (GstElement * element, GstPad * demuxpad, App * app)
+close_epmap (Cli * cli)
 {
-  GstPad *parser_sinkpad = NULL, *parser_srcpad = NULL, *queue_sinkpad = NULL, *queue_srcpad = NULL, *mux_sinkpad = NULL;
-  GstStructure *s;
-  GstCaps *caps = gst_pad_get_caps (demuxpad);
-
-  gchar *demuxpadname, sinkpadname[10], srcpadname[9];
-  guint sourcepid;
-  int i, ret;
-
-  s = gst_caps_get_structure (caps, 0);
-  demuxpadname = gst_pad_get_name (demuxpad);
-  GST_DEBUG ("demux_pad_added_cb %s:%s", GST_DEBUG_PAD_NAME(demuxpad));
-
-  if (g_ascii_strncasecmp (demuxpadname, "video", 5) == 0) {
-    sscanf (demuxpadname + 6, "%x", &sourcepid);
-    if (app->auto_pids) {
-      app->a_source_pids[0] = sourcepid;
-      if (app->a_sink_pids[0] == -1)
-      {
-        app->a_sink_pids[0] = sourcepid;
-        app->no_sink_pids++;
-      }
-      app->no_source_pids++;
-    }
-    if (sourcepid == app->a_source_pids[0] && app->videoparser == NULL) {
-      if (gst_structure_has_name (s, "video/mpeg")) {
-        app->videoparser = gst_element_factory_make ("mpegvideoparse", "videoparse");
-	if (!app->videoparser) {
-	  bdremux_errout("mpegvideoparse not found! please install gst-plugin-mpegvideoparse!");
-	}
-      }
-      else if (gst_structure_has_name (s, "video/x-h264")) {
-        app->videoparser = gst_element_factory_make ("h264parse", "videoparse");
-	if (!app->videoparser) {
-	  bdremux_errout("h264parse not found! please install gst-plugin-videoparsersbad!");
-	}
-      }
-      gst_bin_add (GST_BIN (app->pipeline), app->videoparser);
-      gst_element_set_state (app->videoparser, GST_STATE_PLAYING);
-      parser_sinkpad = gst_element_get_static_pad (app->videoparser, "sink");
-      parser_srcpad = gst_element_get_static_pad (app->videoparser, "src");
-      g_sprintf (sinkpadname, "sink%d", app->a_sink_pids[0]);
-      g_sprintf (srcpadname, "src%d", app->a_sink_pids[0]);
-      queue_sinkpad = gst_element_get_request_pad (app->queue, sinkpadname);
-      queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
-      g_sprintf (sinkpadname, "sink_%d", app->a_sink_pids[0]);
-      mux_sinkpad = gst_element_get_request_pad (app->m2tsmux, sinkpadname);
-      app->requested_pid_count++;
-      if (app->requested_pid_count <= app->no_source_pids)
-	{
-	         ret = gst_pad_set_blocked_async (queue_srcpad, TRUE, (GstPadBlockCallback) pad_block_cb, app);
-		 GST_DEBUG ("BLOCKING %s returned %i", srcpadname, ret);
-	}
-      if (gst_pad_link (demuxpad, parser_sinkpad) == 0)
-      {
-        if (gst_pad_link (parser_srcpad, queue_sinkpad) == 0)
-        {
-          if (gst_pad_link (queue_srcpad, mux_sinkpad) == 0) {
-            g_fprintf
-                (stdout, "linked: Source PID %d to %s\n",
-                app->a_source_pids[0], sinkpadname);
-                g_signal_connect (G_OBJECT (mux_sinkpad), "notify::caps", G_CALLBACK (mux_pad_has_caps_cb), app);
-            fflush(stdout);
-          } else {
-	    bdremux_errout(g_strdup_printf("Couldn't link %s:%s to %s:%s", GST_DEBUG_PAD_NAME(queue_srcpad), GST_DEBUG_PAD_NAME(mux_sinkpad)));
-	  }
-        } else {
-          bdremux_errout(g_strdup_printf("Couldn't link %s:%s to %s:%s @%p", GST_DEBUG_PAD_NAME(parser_srcpad), GST_DEBUG_PAD_NAME(queue_sinkpad), queue_sinkpad));
-	}
-      } else {
-        bdremux_errout(g_strdup_printf("Couldn't link %s:%s to %s:%s", GST_DEBUG_PAD_NAME(demuxpad), GST_DEBUG_PAD_NAME(parser_sinkpad)));
-      }
-    }
-  } else if (g_ascii_strncasecmp (demuxpadname, "audio", 5) == 0) {
-    sscanf (demuxpadname + 6, "%x", &sourcepid);
-    if (app->auto_pids)
-    {
-      if (app->no_source_pids == 0)
-        i = 1;
-      else
-        i = app->no_source_pids;
-      app->a_source_pids[i] = sourcepid;
-      if (app->a_sink_pids[i] == -1)
-      {
-        app->a_sink_pids[i] = sourcepid;
-        app->no_sink_pids++;
-      }
-      app->no_source_pids++;
-    }
-    for (i = 1; i < app->no_source_pids; i++) {
-      if (sourcepid == app->a_source_pids[i]) {
-        if (gst_structure_has_name (s, "audio/mpeg")) {
-          app->audioparsers[i] = gst_element_factory_make ("mpegaudioparse", NULL);
-	  if (!app->audioparsers[i]) {
-	    bdremux_errout("mpegaudioparse not found! please install gst-plugin-mpegaudioparse!");
-	  }
-        }
-        else if (gst_structure_has_name (s, "audio/x-ac3")) {
-          app->audioparsers[i] = gst_element_factory_make ("ac3parse", NULL);
-	  if (!app->audioparsers[i]) {
-	    bdremux_errout("mpegaudioparse not found! please install gst-plugin-audioparses!");
-	  }
-        }
-        else if (gst_structure_has_name (s, "audio/x-dts")) {
-          app->audioparsers[i] = gst_element_factory_make ("dcaparse", NULL);
-	  if (!app->audioparsers[i]) {
-	    bdremux_errout("dcaparse not found! please install gst-plugin-audioparses!");
-	  }
-        }
-        else {
-	  bdremux_errout(g_strdup_printf("could not find parser for audio stream with pid 0x%04x!", sourcepid));
-	}
-        gst_bin_add (GST_BIN (app->pipeline), app->audioparsers[i]);
-        gst_element_set_state (app->audioparsers[i], GST_STATE_PLAYING);
-        parser_sinkpad = gst_element_get_static_pad (app->audioparsers[i], "sink");
-        parser_srcpad = gst_element_get_static_pad (app->audioparsers[i], "src");
-        g_sprintf (sinkpadname, "sink%d", app->a_sink_pids[i]);
-        g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
-        queue_sinkpad = gst_element_get_request_pad (app->queue, sinkpadname);
-        queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
-        g_sprintf (sinkpadname, "sink_%d", app->a_sink_pids[i]);
-        mux_sinkpad = gst_element_get_request_pad (app->m2tsmux, sinkpadname);
-        app->requested_pid_count++;
-        if (app->requested_pid_count <= app->no_source_pids)
-	{
-	         ret = gst_pad_set_blocked_async (queue_srcpad, TRUE, (GstPadBlockCallback) pad_block_cb, app);
-          GST_DEBUG ("BLOCKING %s returned %i", srcpadname, ret);
-	}
-        if (gst_pad_link (demuxpad, parser_sinkpad) == 0
-            && gst_pad_link (parser_srcpad, queue_sinkpad) == 0
-            && gst_pad_link (queue_srcpad, mux_sinkpad) == 0) {
-          g_print
-              ("linked: Source PID %d to %s\n",
-              app->a_source_pids[i], sinkpadname);
-              g_signal_connect (G_OBJECT (mux_sinkpad), "notify::caps", G_CALLBACK (mux_pad_has_caps_cb), app);
-        } else
-          bdremux_errout (g_strdup_printf("Couldn't link audio PID 0x%04x to sink PID 0x%04x",
-              app->a_source_pids[i], app->a_sink_pids[i]));
-        break;
-      }
-    }
-  } else
-    GST_INFO ("Ignoring pad %s!", demuxpadname);
-  
-  if (parser_sinkpad)
-    gst_object_unref (parser_sinkpad);
-  if (parser_srcpad)
-    gst_object_unref (parser_srcpad);
-  if (queue_sinkpad)
-    gst_object_unref (queue_sinkpad);
-  if (queue_srcpad)
-    gst_object_unref (queue_srcpad);
-  if (mux_sinkpad)
-    gst_object_unref (mux_sinkpad);
-  if (caps)
-    gst_caps_unref (caps);
-
-//   g_print("app->requested_pid_count = %i, app->no_source_pids = %i\n", app->requested_pid_count, app->no_source_pids);
-  if (!app->auto_pids && app->requested_pid_count == app->no_source_pids)
-  {
-     GST_INFO("All %i source PIDs have been linked to the mux -> UNBLOCKING all pads and start muxing", app->requested_pid_count);
-     for (i = 0; i < app->no_sink_pids; i++)
-     {
-       g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
-       queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
-       ret = gst_pad_set_blocked_async (queue_srcpad, FALSE, (GstPadBlockCallback) pad_block_cb, app);
-       GST_DEBUG ("UNBLOCKING %s returned %i", srcpadname, ret);
-     }
+  guint i;
+
+  for (i = 0; i < cli->n_results; i++) {
+    CliResult *r = &cli->results[i];
+
+    if (!r->epmap)
+      continue;
+    if (!epmap_writer_finish (r->epmap))
+      GST_ERROR ("could not write entry point map %s!", r->epmap_filename);
+    epmap_writer_free (r->epmap);
+    r->epmap = NULL;
+    fclose (r->f_epmap);
   }
 
-  g_free (demuxpadname);
-  GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(app->pipeline),GST_DEBUG_GRAPH_SHOW_ALL,"bdremux_pipelinegraph_pad_added");
+  if (!cli->epmap)
+    return;
+
+  if (!epmap_writer_finish (cli->epmap))
+    GST_ERROR ("could not write entry point map!");
+  epmap_writer_free (cli->epmap);
+  cli->epmap = NULL;
+  if (cli->epmap_filename)
+    fclose (cli->f_epmap);
 }
 
 static gint
@@ -603,16 +432,96 @@ parse_pid_list (gint * array, guint * count, char *string)
   GST_DEBUG("parse_pid_list %s, count=%i", string, *count);
 }
 
+/* "R,M,W" where an empty or "-" entry leaves that thread unpinned */
+static void
+parse_cpu_list (gint * cpus, guint n, const char *string)
+{
+  gchar **split;
+  guint i;
+
+  split = g_strsplit (string, ",", n);
+  for (i = 0; i < n && split[i]; i++) {
+    if (strlen (split[i]) == 0 || strcmp (split[i], "-") == 0)
+      cpus[i] = BDREMUX_ANY_CPU;
+    else
+      cpus[i] = atoi (split[i]);
+  }
+  g_strfreev (split);
+}
+
+static void
+clear_results (Cli * cli)
+{
+  guint i;
+
+  for (i = 0; i < cli->n_results; i++) {
+    g_free (cli->results[i].out_filename);
+    g_free (cli->results[i].cuts_filename);
+    g_free (cli->results[i].clpi_filename);
+    g_free (cli->results[i].mpls_filename);
+    g_free (cli->results[i].epmap_filename);
+  }
+  cli->n_results = 0;
+}
+
+/* sets up the job of this slot from a command line. a line of a batch
+ * only fails, the command line of the tool may print the usage and exit */
 static gboolean
-parse_options (int argc, char *argv[], App * app)
+parse_options (int argc, char *argv[], Cli * cli, gchar ** error)
 {
+  gint a_source_pids[MAX_PIDS], a_sink_pids[MAX_PIDS];
+  guint no_source_pids = 0, no_sink_pids = 0;
+  gchar *in_filename = NULL, *cuts_filename;
+  gchar *clpi_filename = NULL, *mpls_filename = NULL;
+  gboolean direct_io = FALSE, preallocate = FALSE;
+  BdremuxSyncPolicy sync = BDREMUX_SYNC_NONE;
+  BdremuxReadAhead read_ahead = BDREMUX_READ_AHEAD_NONE;
+  gsize block_size = 0;
+  guint read_depth = 0;
+  guint follow_timeout = 0;
+  gboolean checkpoint = FALSE, resume = FALSE;
+  guint checkpoint_interval = 0;
+  gboolean threaded = FALSE;
+  gint cpus[3] = { BDREMUX_ANY_CPU, BDREMUX_ANY_CPU, BDREMUX_ANY_CPU };
+  gboolean background = FALSE;
+  guint background_rate = 0;
+  BdremuxChecksum checksum = BDREMUX_CHECKSUM_NONE;
+  gboolean unit_crcs = FALSE;
+  CliResult *result = NULL;
+  guint i;
   int opt;
 
-  const gchar *optionsString = "vecq:s:r:?";
+  const gchar *optionsString = "vecfIpVa:o:j:b:F:C:M:T::L::k::KX::G::H:UDPS:R:B:d:q:t:s:r:?";
   struct option optionsTable[] = {
     {"entrypoints", optional_argument, NULL, 'e'},
     {"cutlist", optional_argument, NULL, 'c'},
+    {"fast", no_argument, NULL, 'f'},
+    {"index-only", no_argument, NULL, 'I'},
+    {"probe", no_argument, NULL, 'p'},
+    {"verify", no_argument, NULL, 'V'},
+    {"audio", required_argument, NULL, 'a'},
+    {"output", required_argument, NULL, 'o'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"batch", required_argument, NULL, 'b'},
+    {"epmap-format", required_argument, NULL, 'F'},
+    {"clpi", required_argument, NULL, 'C'},
+    {"mpls", required_argument, NULL, 'M'},
+    {"stats", optional_argument, NULL, 'T'},
+    {"follow", optional_argument, NULL, 'L'},
+    {"checkpoint", optional_argument, NULL, 'k'},
+    {"resume", no_argument, NULL, 'K'},
+    {"pipeline", optional_argument, NULL, 'X'},
+    {"background", optional_argument, NULL, 'G'},
+    {"checksum", required_argument, NULL, 'H'},
+    {"unit-crcs", no_argument, NULL, 'U'},
+    {"direct-io", no_argument, NULL, 'D'},
+    {"preallocate", no_argument, NULL, 'P'},
+    {"sync", required_argument, NULL, 'S'},
+    {"read-ahead", required_argument, NULL, 'R'},
+    {"block-size", required_argument, NULL, 'B'},
+    {"read-depth", required_argument, NULL, 'd'},
     {"queue-size", required_argument, NULL, 'q'},
+    {"queue-time", required_argument, NULL, 't'},
     {"source-pids", required_argument, NULL, 's'},
     {"result-pids", required_argument, NULL, 'r'},
     {"help", no_argument, NULL, '?'},
@@ -624,17 +533,45 @@ parse_options (int argc, char *argv[], App * app)
     goto usage;
 
   if (argc > 2)
-    app->in_filename = g_strdup (argv[1]);
-  app->out_filename = g_strdup (argv[2]);
+    in_filename = argv[1];
+  cli->f_messages = argc > 2 && !strcmp (argv[2], "-") ? stderr : stdout;
+  if (cli->job)
+    bdremux_job_reset (cli->job, in_filename, argv[2]);
+  else
+    cli->job = bdremux_job_new (in_filename, argv[2]);
+
+  g_free (cli->epmap_filename);
+  cli->epmap_filename = NULL;
+  cli->enable_indexing = FALSE;
+  cli->epmap_format = EPMAP_FORMAT_TEXT;
+  g_free (cli->stats_filename);
+  cli->stats_filename = NULL;
+  cli->enable_stats = FALSE;
+  cli->follow = FALSE;
+  cli->index_only = FALSE;
+  cli->probe = FALSE;
+  cli->verify = FALSE;
+  clear_results (cli);
+  cli->n_jobs = 1;
 
   while ((opt =
           getopt_long (argc, argv, optionsString, optionsTable, NULL)) >= 0) {
     switch (opt) {
       case 'e':
-        app->enable_indexing = TRUE;
+        if (result) {
+          if (!optarg) {
+            *error = g_strdup_printf ("the entry point map of %s needs a file name!", result->out_filename);
+            goto fail;
+          }
+          result->enable_indexing = TRUE;
+          result->epmap_filename = g_strdup (optarg);
+          break;
+        }
+        cli->enable_indexing = TRUE;
+        bdremux_job_set_entry_points (cli->job, TRUE);
 	if (optarg != NULL) {
-	  app->epmap_filename = g_strdup(optarg);
-	  GST_DEBUG ("arbitrary epmap_filename=%s", app->epmap_filename);
+	  cli->epmap_filename = g_strdup(optarg);
+	  GST_DEBUG ("arbitrary epmap_filename=%s", cli->epmap_filename);
 	}
 	else
 	{
@@ -642,32 +579,195 @@ parse_options (int argc, char *argv[], App * app)
 	}
         break;
       case 'c':
-        app->enable_cutlist = TRUE;
+        if (result) {
+          result->cuts_filename = optarg ? g_strdup (optarg)
+              : g_strconcat (in_filename, ".cuts", NULL);
+          break;
+        }
 		if (optarg != NULL) {
-	  app->cuts_filename = g_strdup(optarg);
-	  GST_DEBUG ("arbitrary cuts_filename=%s", app->cuts_filename);
+	  cuts_filename = g_strdup(optarg);
+	  GST_DEBUG ("arbitrary cuts_filename=%s", cuts_filename);
 		}
 	  else {
-	    app->cuts_filename = g_strconcat (app->in_filename, ".cuts", NULL);   
-	    GST_DEBUG ("enigma2-style cuts_filename=%s", app->cuts_filename);
+	    cuts_filename = g_strconcat (in_filename, ".cuts", NULL);   
+	    GST_DEBUG ("enigma2-style cuts_filename=%s", cuts_filename);
 	  }
+	  bdremux_job_set_cutlist (cli->job, cuts_filename);
+	  g_free (cuts_filename);
 	  
+        break;
+      case 'f':
+        bdremux_job_set_fast (cli->job, TRUE);
+        break;
+      case 'I':
+        cli->index_only = TRUE;
+        break;
+      case 'p':
+        cli->probe = TRUE;
+        break;
+      case 'V':
+        cli->verify = TRUE;
+        break;
+      case 'o':
+        if (cli->n_results == BDREMUX_MAX_RESULTS - 1) {
+          *error = g_strdup_printf ("at most %i results can be remuxed at once!", BDREMUX_MAX_RESULTS);
+          goto fail;
+        }
+        result = &cli->results[cli->n_results++];
+        memset (result, 0, sizeof (CliResult));
+        result->out_filename = g_strdup (optarg);
+        break;
+      case 'j':
+        cli->n_jobs = atoi (optarg);
+        if (cli->n_jobs == 0)
+          cli->n_jobs = MAX (sysconf (_SC_NPROCESSORS_ONLN), 1);
+        break;
+      case 'b':
+        if (cli->batch) {
+          *error = g_strdup ("a batch job can't run a batch!");
+          goto fail;
+        }
+        g_free (cli->batch_filename);
+        cli->batch_filename = g_strdup (optarg);
+        break;
+      case 'F':
+        if (!epmap_parse_format (optarg, &cli->epmap_format)) {
+          *error = g_strdup_printf ("unknown entry point map format %s!", optarg);
+          goto fail;
+        }
+        break;
+      case 'C':
+        if (result) {
+          g_free (result->clpi_filename);
+          result->clpi_filename = g_strdup (optarg);
+          break;
+        }
+        g_free (clpi_filename);
+        clpi_filename = g_strdup (optarg);
+        break;
+      case 'M':
+        if (result) {
+          g_free (result->mpls_filename);
+          result->mpls_filename = g_strdup (optarg);
+          break;
+        }
+        g_free (mpls_filename);
+        mpls_filename = g_strdup (optarg);
+        break;
+      case 'T':
+        cli->enable_stats = TRUE;
+        g_free (cli->stats_filename);
+        cli->stats_filename = g_strdup (optarg);
+        break;
+      case 'L':
+        cli->follow = TRUE;
+        follow_timeout = optarg ? atoi (optarg) * 1000 : 0;
+        break;
+      case 'k':
+        checkpoint = TRUE;
+        checkpoint_interval = optarg ? atoi (optarg) * 1000 : 0;
+        break;
+      case 'K':
+        resume = TRUE;
+        break;
+      case 'X':
+        threaded = TRUE;
+        if (optarg)
+          parse_cpu_list (cpus, G_N_ELEMENTS (cpus), optarg);
+        break;
+      case 'H':
+        if (!strcmp (optarg, "xxh64"))
+          checksum = BDREMUX_CHECKSUM_XXH64;
+        else if (!strcmp (optarg, "crc32c"))
+          checksum = BDREMUX_CHECKSUM_CRC32C;
+        else if (!strcmp (optarg, "sha256"))
+          checksum = BDREMUX_CHECKSUM_SHA256;
+        else {
+          *error = g_strdup_printf ("unknown checksum %s!", optarg);
+          goto fail;
+        }
+        break;
+      case 'U':
+        unit_crcs = TRUE;
+        break;
+      case 'G':
+        background = TRUE;
+        background_rate = optarg ? atoi (optarg) : 0;
+        break;
+      case 'D':
+        direct_io = TRUE;
+        break;
+      case 'P':
+        preallocate = TRUE;
+        break;
+      case 'a':
+        if (!strcmp (optarg, "parse"))
+          bdremux_job_set_audio_mode (cli->job, BDREMUX_AUDIO_PARSE);
+        else if (!strcmp (optarg, "pass"))
+          bdremux_job_set_audio_mode (cli->job, BDREMUX_AUDIO_PASSTHROUGH);
+        else {
+          *error = g_strdup_printf ("unknown audio mode %s!", optarg);
+          goto fail;
+        }
+        break;
+      case 'S':
+        if (!strcmp (optarg, "none"))
+          sync = BDREMUX_SYNC_NONE;
+        else if (!strcmp (optarg, "close"))
+          sync = BDREMUX_SYNC_CLOSE;
+        else if (!strcmp (optarg, "stream"))
+          sync = BDREMUX_SYNC_STREAM;
+        else {
+          *error = g_strdup_printf ("unknown sync policy %s!", optarg);
+          goto fail;
+        }
+        break;
+      case 'R':
+        if (!strcmp (optarg, "none"))
+          read_ahead = BDREMUX_READ_AHEAD_NONE;
+        else if (!strcmp (optarg, "thread"))
+          read_ahead = BDREMUX_READ_AHEAD_THREAD;
+        else if (!strcmp (optarg, "uring"))
+          read_ahead = BDREMUX_READ_AHEAD_URING;
+        else {
+          *error = g_strdup_printf ("unknown read ahead mode %s!", optarg);
+          goto fail;
+        }
+        break;
+      case 'B':
+        block_size = atoi (optarg);
+        break;
+      case 'd':
+        read_depth = atoi (optarg);
         break;
       case 'q':
-        app->queue_size = atoi(optarg);
-	GST_DEBUG("arbitrary queue size=%i", app->queue_size);
+        bdremux_job_set_queue_size (cli->job, atoi(optarg));
+	GST_DEBUG("arbitrary queue size=%i", atoi(optarg));
+        break;
+      case 't':
+        bdremux_job_set_queue_time (cli->job, atoi (optarg));
         break;
       case 's':
-        parse_pid_list (app->a_source_pids, &app->no_source_pids, optarg);
-        app->auto_pids = FALSE;
+        if (result)
+          parse_pid_list (result->source_pids, &result->n_source_pids, optarg);
+        else
+          parse_pid_list (a_source_pids, &no_source_pids, optarg);
         break;
       case 'r':
-        parse_pid_list (app->a_sink_pids, &app->no_sink_pids, optarg);
+        if (result)
+          parse_pid_list (result->sink_pids, &result->n_sink_pids, optarg);
+        else
+          parse_pid_list (a_sink_pids, &no_sink_pids, optarg);
         break;
       case 'v':
       {
         const gchar *nano_str;
         guint major, minor, micro, nano;
+
+        if (cli->batch) {
+          *error = g_strdup ("--version is not a batch job!");
+          goto fail;
+        }
         gst_version (&major, &minor, &micro, &nano);
 
         if (nano == 1)
@@ -682,31 +782,151 @@ parse_options (int argc, char *argv[], App * app)
         exit (0);
       }
       case '?':
+        /* getopt has told what is wrong with it */
+        if (cli->batch) {
+          *error = g_strdup_printf ("invalid option %s!", argv[optind - 1]);
+          goto fail;
+        }
         goto usage;
         break;
       default:
         break;
     }
   }
+  /* they print instead of remuxing */
+  if (cli->batch && (cli->probe || cli->verify)) {
+    *error = g_strdup_printf ("%s is not a batch job!",
+        cli->probe ? "--probe" : "--verify");
+    goto fail;
+  }
+  /* with --batch -j counts the jobs running at once, the threads of a job
+   * come from its own line */
+  if (!cli->batch_filename) {
+    bdremux_job_set_threads (cli->job, cli->n_jobs);
+    GST_DEBUG ("remuxing segments on %i threads", cli->n_jobs);
+  }
+  bdremux_job_set_pids (cli->job, a_source_pids, no_source_pids, a_sink_pids,
+      no_sink_pids);
+  bdremux_job_set_clip_info (cli->job, clpi_filename, mpls_filename);
+  bdremux_job_set_input (cli->job, read_ahead, block_size, read_depth);
+  bdremux_job_set_follow (cli->job, cli->follow, follow_timeout);
+  bdremux_job_set_checkpoint (cli->job, checkpoint || resume,
+      checkpoint_interval, resume);
+  bdremux_job_set_output (cli->job, direct_io, preallocate, sync);
+  bdremux_job_set_pipeline (cli->job, threaded, cpus[0], cpus[1], cpus[2]);
+  bdremux_job_set_background (cli->job, background, background_rate);
+  /* unit CRCs alone come with the fastest checksum */
+  if (unit_crcs && checksum == BDREMUX_CHECKSUM_NONE)
+    checksum = BDREMUX_CHECKSUM_XXH64;
+  bdremux_job_set_checksum (cli->job, checksum, unit_crcs);
+  for (i = 0; i < cli->n_results; i++) {
+    CliResult *r = &cli->results[i];
+    guint n = bdremux_job_add_result (cli->job, r->out_filename);
+
+    bdremux_job_set_result_pids (cli->job, n, r->source_pids,
+        r->n_source_pids, r->sink_pids, r->n_sink_pids);
+    bdremux_job_set_result_cutlist (cli->job, n, r->cuts_filename);
+    bdremux_job_set_result_entry_points (cli->job, n, r->enable_indexing);
+    bdremux_job_set_result_clip_info (cli->job, n, r->clpi_filename,
+        r->mpls_filename);
+  }
+  /* the second file is where the map of the indexed stream goes */
+  if (cli->index_only) {
+    bdremux_job_set_index_only (cli->job, TRUE);
+    bdremux_job_set_entry_points (cli->job, TRUE);
+    cli->enable_indexing = TRUE;
+    if (!cli->epmap_filename && argc > 2 && strcmp (argv[2], "-"))
+      cli->epmap_filename = g_strdup (argv[2]);
+  }
+  g_free (clpi_filename);
+  g_free (mpls_filename);
   return TRUE;
 
+fail:
+  g_free (clpi_filename);
+  g_free (mpls_filename);
+  return FALSE;
+
 usage:
   g_print
       ("bdremux - a blu-ray movie stream remuxer <fraxinas@opendreambox.org>\n"
       "\n"
       "Usage: %s source_stream.ts output_stream.m2ts [OPTION...]\n"
+      "       %s stream.m2ts map.txt --index-only [OPTION...]\n"
+      "       %s source_stream.ts --probe\n"
+      "       %s stream.m2ts --verify\n"
+      "\n"
+      "Either stream may be - for stdin or stdout, or fd:N for the inherited\n"
+      "file descriptor N, to remux within a pipe.\n"
       "\n"
       "Optional arguments:\n"
       "  -e, --entrypoints               Generate and display the SPN/PTS map\n"
+      "  -F, --epmap-format=FORMAT       write the SPN/PTS map as text (default) or binary\n"
+      "  -C, --clpi=FILE                 write a BD-ROM clip information file\n"
+      "  -M, --mpls=FILE                 write a BD-ROM playlist for the clip\n"
+      "  -T, --stats[=FILE]              append a JSON line with progress, rates\n"
+      "                                  and queue levels every second to FILE\n"
+      "                                  (default stdout)\n"
+      "  -L, --follow[=SECONDS]          remux a recording still in progress, waiting\n"
+      "                                  at its end until the recorder closes it or\n"
+      "                                  nothing is appended for SECONDS (default=%i)\n"
+      "  -k, --checkpoint[=SECONDS]      note every SECONDS (default=%i) where an\n"
+      "                                  interrupted fast remux can be resumed, in\n"
+      "                                  output_stream.m2ts.checkpoint\n"
+      "  -K, --resume                    continue from the last checkpoint, if any\n"
+      "  -X, --pipeline[=R,M,W]          read, remux and write on three threads linked\n"
+      "                                  by lock-free rings, pinned to the CPUs R, M\n"
+      "                                  and W if given (- for any)\n"
+      "  -G, --background[=MB/S]         run with idle CPU and I/O priority, reading\n"
+      "                                  and writing at most MB/S (default=%i) and\n"
+      "                                  slower while the disk is busy\n"
+      "  -R, --read-ahead=MODE           none (default), thread or uring to read the\n"
+      "                                  source in large blocks ahead of the demuxer\n"
+      "  -B, --block-size=BYTES          size of the blocks read ahead (default=%i)\n"
+      "  -d, --read-depth=INT            number of blocks read ahead (default=%i)\n"
+      "  -D, --direct-io                 write the result with O_DIRECT\n"
+      "  -P, --preallocate               reserve the estimated size of the result\n"
+      "  -S, --sync=POLICY               none (default), close to sync the result at\n"
+      "                                  the end or stream to write it back\n"
+      "                                  continuously, keeping it out of the cache\n"
       "  -c, --cutlist                   use enigma2's $source_stream.ts.cuts file\n"
+      "  -I, --index-only                rebuild the SPN/PTS map (and with -C/-M the\n"
+      "                                  clip information) of a remuxed stream.m2ts\n"
+      "                                  into map.txt (- for stdout) without remuxing\n"
+      "  -p, --probe                     print the streams, codecs, PTS range and\n"
+      "                                  bitrate of source_stream.ts as JSON, reading\n"
+      "                                  only its PMT, head and tail\n"
+      "  -H, --checksum=ALGO             hash the result with xxh64, crc32c or sha256\n"
+      "                                  while writing it, for a manifest next to it\n"
+      "  -U, --unit-crcs                 add a CRC32C of every aligned unit to it\n"
+      "  -V, --verify                    check stream.m2ts against its manifest\n"
+      "  -o, --output=FILE               remux into FILE as well, in the same pass over\n"
+      "                                  the source (fast mode only). -s, -r, -c, -e,\n"
+      "                                  -C and -M following it apply to FILE\n"
+      "  -f, --fast                      remux transport packets natively instead of\n"
+      "                                  using the GStreamer demuxer, parsers and muxer\n"
+      "  -a, --audio=MODE                parse (default) to frame MPEG, AC3 and DTS\n"
+      "                                  audio with the GStreamer parsers, or pass to\n"
+      "                                  hand the audio PES to the muxer as demuxed\n"
+      "  -j, --jobs=INT                  remux the segments of a cutlist on INT threads\n"
+      "                                  in fast mode (0 = one per CPU), with --batch\n"
+      "                                  the number of jobs running at the same time\n"
+      "  -b, --batch=FILE                run the jobs listed in FILE, one command line\n"
+      "                                  (source, output and options) per line\n"
       "  -q, --queue-size=INT            max size of queue in bytes (default=%i)\n"
+      "  -t, --queue-time=MS             queue MS of each stream for the mux once all\n"
+      "                                  are linked, the byte limit follows their\n"
+      "                                  bitrates (default=%i, 0 = queue size only)\n"
       "  -s, --source-pids=STRING        list of PIDs to be considered\n"
       "  -r, --result-pids=STRING        list of PIDs in resulting stream\n"
       "     PIDs can be supplied in decimal or hexadecimal form (0x prefixed)\n"
       "     the lists are supposed to be comma-seperated with the Video PID\n"
       "     as the first element followed by 1-7 Audio PIDs.\n"
-      "     If omitted, the first video and all audio elementary streams are\n"
-      "     carried over, keeping their PIDs (this may require a larger queue size).\n"
+      "     If omitted, the first video and all MPEG, AC3 and DTS audio elementary\n"
+      "     streams announced in the PMT are carried over, keeping their PIDs, with\n"
+      "     --audio=pass or --fast AAC, E-AC3 and LPCM as well. Only\n"
+      "     if no PMT is found in the first 8 MB the streams are detected while\n"
+      "     the queue fills up (this may require a larger queue size).\n"
       "\n"
       "Help options:\n"
       "  -?, --help                      Show this help message\n"
@@ -718,140 +938,187 @@ usage:
       "  remultiplexed streams with PID numbers 0x1011 for video and 0x1100\n"
       "  and 0x1101 for audio into the file out.m2ts while showing a map\n"
       "  of entrypoints on stdout.\n",
-      argv[0], DEFAULT_QUEUE_SIZE, argv[0]);
+      argv[0], argv[0], argv[0], argv[0], BDREMUX_DEFAULT_FOLLOW_TIMEOUT / 1000,
+      BDREMUX_DEFAULT_CHECKPOINT_INTERVAL / 1000,
+      BDREMUX_DEFAULT_BACKGROUND_RATE,
+      BDREMUX_DEFAULT_READ_BLOCK_SIZE, BDREMUX_DEFAULT_READ_DEPTH,
+      BDREMUX_DEFAULT_QUEUE_SIZE, BDREMUX_DEFAULT_QUEUE_TIME, argv[0]);
   exit (0);
   return TRUE;
 }
 
-int
-main (int argc, char *argv[])
+/* takes the next line of the manifest and starts it on this slot */
+static void
+start_next_job (Cli * cli)
 {
-  App *app = &s_app;
-  GstBus *bus;
-  int i;
-
-  app->is_seekable = FALSE;
-  app->enable_cutlist = FALSE;
-  app->segment_count = 0;
-  app->current_segment = 0;
-
-  app->epmap_filename = NULL;
-  app->f_epmap = NULL;
-  
-  app->no_source_pids = 0;
-  app->no_sink_pids = 0;
-  app->requested_pid_count = 0;
-  app->auto_pids = TRUE;
-  for (i = 0; i < MAX_PIDS; i++) {
-    app->a_sink_pids[i] = -1;
-  }
-  app->queue_size = DEFAULT_QUEUE_SIZE;
-
-  gst_init (NULL, NULL);
-  GST_DEBUG_CATEGORY_INIT (bdremux_debug, "BDREMUX", GST_DEBUG_BOLD|GST_DEBUG_FG_YELLOW|GST_DEBUG_BG_BLUE, "blu-ray movie stream remuxer");
-  parse_options (argc, argv, app);
-
-  
-  if (app->epmap_filename) {
-  app->f_epmap = fopen (app->epmap_filename, "w");
-  }
-  else
-    app->f_epmap = stdout;
+  Batch *batch = cli->batch;
+  GError *gerror = NULL;
+  gchar **argv, *line, *error = NULL;
+  gboolean ok;
+  gint argc;
+
+  while (batch->next_job < batch->jobs->len) {
+    cli->job_id = batch->next_job++;
+    line = g_strconcat ("bdremux ", g_ptr_array_index (batch->jobs,
+            cli->job_id), NULL);
+    if (!g_shell_parse_argv (line, &argc, &argv, &gerror)) {
+      g_fprintf (stdout, "job %u: ERROR: %s\n", cli->job_id, gerror->message);
+      g_clear_error (&gerror);
+      g_free (line);
+      batch->failed++;
+      continue;
+    }
+    g_free (line);
+
+    optind = 0;
+    ok = parse_options (argc, argv, cli, &error);
+    g_strfreev (argv);
+    if (!ok) {
+      g_fprintf (stdout, "job %u: ERROR: %s\n", cli->job_id, error);
+      g_free (error);
+      error = NULL;
+      batch->failed++;
+      continue;
+    }
 
-  if (!app->f_epmap) {
-    bdremux_errout (g_strdup_printf("could not open %s for writing entry point map! (%i)", app->epmap_filename, errno));
-  }
-    
-  if (app->enable_cutlist)
-    load_cutlist (app);
-
-  for (i = 0; i < app->segment_count; i++) {
-    GST_INFO ("segment count %i index %i in_pts %lld out_pts %lld", i,
-        app->seek_segments[i].index, app->seek_segments[i].in_pts,
-        app->seek_segments[i].out_pts);
+    g_fprintf (stdout, "job %u: %s -> %s\n", cli->job_id,
+        bdremux_job_get_in_filename (cli->job),
+        bdremux_job_get_out_filename (cli->job));
+    fflush (stdout);
+    set_callbacks (cli);
+    if (!open_epmap (cli, &error) || !open_stats (cli, &error)
+        || !bdremux_job_start (cli->job, &error)) {
+      g_fprintf (stdout, "job %u: ERROR: %s\n", cli->job_id, error);
+      g_free (error);
+      error = NULL;
+      close_epmap (cli);
+      close_stats (cli);
+      batch->failed++;
+      continue;
+    }
+    batch->running++;
+    return;
   }
+}
 
-  for (i = 0; i < app->no_source_pids; i++) {
-    if (app->no_sink_pids <= i)
-      app->a_sink_pids[app->no_sink_pids++] = app->a_source_pids[i];
-    GST_DEBUG
-        ("source pid [%i] = 0x%04x, sink pid [%i] = 0x%04x app->no_sink_pids=%i",
-        i, app->a_source_pids[i], i, app->a_sink_pids[i], app->no_sink_pids);
+/* runs every line of the manifest as a job of its own, n_slots of them at
+ * the same time. each slot keeps its pipeline across jobs */
+static int
+run_batch (const gchar * filename, guint n_slots)
+{
+  Batch batch;
+  Cli *slots;
+  GError *gerror = NULL;
+  gchar *contents, **lines;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &gerror))
+    bdremux_errout (g_strdup_printf ("could not read batch manifest %s! (%s)",
+            filename, gerror->message));
+
+  memset (&batch, 0, sizeof (batch));
+  batch.jobs = g_ptr_array_new ();
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    g_strstrip (lines[i]);
+    if (lines[i][0] && lines[i][0] != '#')
+      g_ptr_array_add (batch.jobs, lines[i]);
   }
+  g_free (contents);
 
-  app->loop = g_main_loop_new (NULL, TRUE);
-
-  app->pipeline = gst_pipeline_new ("blu-ray movie stream remuxer");
-  g_assert (app->pipeline);
-
-  app->filesrc = gst_element_factory_make ("filesrc", "filesrc");
-  app->tsdemux = gst_element_factory_make ("mpegtsdemux", "tsdemux");
-  if (!app->tsdemux) {
-    bdremux_errout("mpegtsdemux not found! please install gst-plugin-mpegtsdemux!");
-  }
+  batch.done = g_async_queue_new ();
 
-  app->m2tsmux = gst_element_factory_make ("mpegtsmux", "m2tsmux");
-  if (!app->m2tsmux) {
-    bdremux_errout("mpegtsmux not found! please install gst-plugin-mpegtsmux!");
+  GST_INFO ("running %u jobs from %s, %u at a time", batch.jobs->len,
+      filename, n_slots);
+  slots = g_new0 (Cli, n_slots);
+  for (i = 0; i < n_slots; i++) {
+    slots[i].batch = &batch;
+    start_next_job (&slots[i]);
   }
-
-  app->filesink = gst_element_factory_make ("filesink", "filesink");
-
-  app->queue = gst_element_factory_make ("multiqueue", "multiqueue");
-
-  app->videoparser = NULL;
-
-  gst_bin_add_many (GST_BIN (app->pipeline), app->filesrc, app->tsdemux, app->queue,
-      app->m2tsmux, app->filesink, NULL);
-
-  g_object_set (G_OBJECT (app->filesrc), "location", app->in_filename, NULL);
-
-  g_object_set (G_OBJECT (app->queue), "max-size-bytes", app->queue_size, NULL);
-  g_object_set (G_OBJECT (app->queue), "max-size-buffers", 0, NULL);
-  g_object_set (G_OBJECT (app->queue), "max-size-time", 0, NULL);
-
-  g_object_set (G_OBJECT (app->m2tsmux), "m2ts-mode", TRUE, NULL);
-  g_object_set (G_OBJECT (app->m2tsmux), "alignment", 32, NULL);
-
-  g_object_set (G_OBJECT (app->filesink), "location", app->out_filename, NULL);
-
-  gst_element_link (app->filesrc, app->tsdemux);
-
-  gst_element_link (app->m2tsmux, app->filesink);
-
-  g_signal_connect (app->tsdemux, "pad-added", G_CALLBACK (demux_pad_added_cb),
-      app);
-
-  app->queue_cb_handler_id = g_signal_connect (app->queue, "overrun", G_CALLBACK (queue_filled_cb), app);
-
-  if (app->enable_indexing) {
-    app->index = gst_index_factory_make ("memindex");
-    if (app->index) {
-      g_signal_connect (G_OBJECT (app->index), "entry_added",
-          G_CALLBACK (entry_added), app);
-      g_object_set (G_OBJECT (app->index), "resolver", 1, NULL);
-      gst_element_set_index (app->m2tsmux, app->index);
+  while (batch.running) {
+    Cli *cli = g_async_queue_pop (batch.done);
+    gboolean ok = bdremux_job_wait (cli->job);
+
+    close_epmap (cli);
+    close_stats (cli);
+    if (!ok) {
+      g_fprintf (stdout, "job %u: ERROR: %s\n", cli->job_id,
+          bdremux_job_get_error (cli->job));
+      batch.failed++;
     }
+    g_fprintf (stdout, "job %u: %s\n", cli->job_id, ok ? "done" : "FAILED");
+    fflush (stdout);
+    batch.running--;
+    start_next_job (cli);
   }
 
-  bus = gst_pipeline_get_bus (GST_PIPELINE (app->pipeline));
-
-  gst_bus_add_watch (bus, (GstBusFunc) bus_message, app);
-
-  gst_element_set_state (app->pipeline, GST_STATE_PLAYING);
-
-  g_main_loop_run (app->loop);
-
-  g_message ("stopping");
+  g_fprintf (stdout, "batch finished: %u jobs, %u failed\n", batch.jobs->len,
+      batch.failed);
+  fflush (stdout);
+
+  for (i = 0; i < n_slots; i++) {
+    if (slots[i].job)
+      bdremux_job_free (slots[i].job);
+    g_free (slots[i].epmap_filename);
+    clear_results (&slots[i]);
+    g_free (slots[i].stats_filename);
+    g_free (slots[i].batch_filename);
+  }
+  g_async_queue_unref (batch.done);
+  g_ptr_array_free (batch.jobs, TRUE);
+  g_strfreev (lines);
+  g_free (slots);
+  return batch.failed ? 1 : 0;
+}
 
-  gst_element_set_state (app->pipeline, GST_STATE_NULL);
+int
+main (int argc, char *argv[])
+{
+  Cli cli;
+  gchar *error = NULL;
+  gboolean ok;
+
+  memset (&cli, 0, sizeof (cli));
+  f_messages = stdout;
+
+  bdremux_init (NULL, NULL);
+  ok = parse_options (argc, argv, &cli, &error);
+  f_messages = cli.f_messages;
+  if (!ok)
+    bdremux_errout (error);
+
+  if (cli.probe) {
+    print_probe (bdremux_job_get_in_filename (cli.job));
+    bdremux_job_free (cli.job);
+    return 0;
+  }
 
-  gst_object_unref (bus);
-  g_main_loop_unref (app->loop);
+  if (cli.verify) {
+    int status = print_verify (bdremux_job_get_in_filename (cli.job));
+    bdremux_job_free (cli.job);
+    return status;
+  }
 
-  if (app->epmap_filename) {
-    fclose (app->f_epmap);
+  if (cli.batch_filename) {
+    bdremux_job_free (cli.job);
+    return run_batch (cli.batch_filename, cli.n_jobs);
   }
 
+  if (!open_epmap (&cli, &error) || !open_stats (&cli, &error))
+    bdremux_errout (error);
+  set_callbacks (&cli);
+  if (!bdremux_job_start (cli.job, &error))
+    bdremux_errout (error);
+  ok = bdremux_job_wait (cli.job);
+  close_epmap (&cli);
+  close_stats (&cli);
+
+  if (!ok)
+    bdremux_errout (g_strdup (bdremux_job_get_error (cli.job)));
+
+  bdremux_job_free (cli.job);
+  g_free (cli.epmap_filename);
+  clear_results (&cli);
+  g_free (cli.stats_filename);
   return 0;
 }
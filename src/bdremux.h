@@ -0,0 +1,255 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_H__
+#define __BDREMUX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define BDREMUX_MAX_PIDS 8
+#define BDREMUX_MAX_PROBE_STREAMS 32
+#define BDREMUX_MAX_RESULTS 8
+#define BDREMUX_DEFAULT_QUEUE_SIZE 48*1024*1024
+#define BDREMUX_DEFAULT_QUEUE_TIME 3000
+#define BDREMUX_DEFAULT_READ_BLOCK_SIZE (188*8192)
+#define BDREMUX_DEFAULT_READ_DEPTH 4
+#define BDREMUX_DEFAULT_STATS_INTERVAL 1000
+#define BDREMUX_DEFAULT_FOLLOW_TIMEOUT 30000
+#define BDREMUX_DEFAULT_CHECKPOINT_INTERVAL 60000
+#define BDREMUX_DEFAULT_BACKGROUND_RATE 16
+/* 32 source packets, a manifest's unit CRCs are taken over units this size */
+#define BDREMUX_ALIGNED_UNIT_SIZE 6144
+#define BDREMUX_ANY_CPU -1
+
+typedef enum
+{
+  BDREMUX_SYNC_NONE,            /* leave the write back to the kernel */
+  BDREMUX_SYNC_CLOSE,           /* sync the result when the job ends */
+  BDREMUX_SYNC_STREAM           /* write back continuously and keep the
+                                 * result out of the page cache */
+} BdremuxSyncPolicy;
+
+typedef enum
+{
+  BDREMUX_READ_AHEAD_NONE,      /* the source is read on demand */
+  BDREMUX_READ_AHEAD_THREAD,    /* blocks are read ahead on a thread */
+  BDREMUX_READ_AHEAD_URING      /* blocks are read ahead with io_uring */
+} BdremuxReadAhead;
+
+typedef enum
+{
+  BDREMUX_AUDIO_PARSE,          /* frame MPEG, AC3 and DTS audio with the
+                                 * parsers, pass the others through */
+  BDREMUX_AUDIO_PASSTHROUGH     /* hand every audio PES to the mux as it
+                                 * comes from the demuxer */
+} BdremuxAudioMode;
+
+/* how the result is hashed while it's written, for the manifest next to
+ * it */
+typedef enum
+{
+  BDREMUX_CHECKSUM_NONE,
+  BDREMUX_CHECKSUM_XXH64,
+  BDREMUX_CHECKSUM_CRC32C,
+  BDREMUX_CHECKSUM_SHA256
+} BdremuxChecksum;
+
+/* one remux job: a source stream, the result stream and the options to
+ * get from one to the other. a job can be run again with new settings
+ * after bdremux_job_reset, keeping its pipeline */
+typedef struct _BdremuxJob BdremuxJob;
+
+/* what happened to one elementary stream since the job started */
+typedef struct _BdremuxStreamStats
+{
+  guint source_pid;
+  guint sink_pid;
+  /* buffers (transport packets in fast mode) and bytes passed to the mux,
+   * the rates are averaged over the time since the previous snapshot */
+  guint64 buffers;
+  guint64 bytes;
+  gdouble buffers_per_second;
+  gdouble bytes_per_second;
+  /* fill level of the multiqueue src pad feeding the mux, the time is the
+   * timestamp distance of its first and last buffer, -1 if unknown */
+  guint queue_buffers;
+  guint64 queue_bytes;
+  gint64 queue_time;
+  gboolean blocked;
+} BdremuxStreamStats;
+
+/* a snapshot of a running job, times in 90 kHz units, -1 if unknown */
+typedef struct _BdremuxStats
+{
+  gdouble elapsed;              /* seconds since the job started */
+  guint64 bytes_read;
+  guint64 bytes_total;          /* 0 if unknown */
+  guint64 bytes_written;
+  gint64 position;
+  gint64 duration;
+  gdouble eta;                  /* seconds, -1 if unknown */
+  guint entry_points;           /* written to the entry point map */
+  /* bytes of the pipeline's buffer pool reserved in slabs, handed out now
+   * and at most, how many buffers it allocated and how many of them came
+   * from the heap. 0 in fast mode, which allocates nothing per packet */
+  guint64 pool_size;
+  guint64 pool_in_use;
+  guint64 pool_peak;
+  guint64 pool_allocs;
+  guint64 pool_fallbacks;
+  guint n_streams;
+  BdremuxStreamStats streams[BDREMUX_MAX_PIDS];
+} BdremuxStats;
+
+/* one elementary stream announced in the PMT of a probed stream */
+typedef struct _BdremuxProbeStream
+{
+  guint pid;
+  guint stream_type;
+  /* the media type of the demuxer pad the stream will show up on */
+  const gchar *caps;
+  gchar language[4];            /* empty if not announced */
+  gint64 first_pts;             /* 90 kHz, -1 if unknown */
+  gint64 last_pts;
+} BdremuxProbeStream;
+
+/* what bdremux_probe found out from PAT/PMT and the head and tail of a
+ * stream, times in 90 kHz units, -1 if unknown */
+typedef struct _BdremuxProbe
+{
+  guint64 size;
+  guint packet_size;            /* 188 for TS, 192 for M2TS */
+  guint program_number;
+  guint pmt_pid;
+  guint pcr_pid;
+  gint64 duration;
+  guint64 bitrate;              /* bits per second, 0 if unknown */
+  guint n_streams;
+  BdremuxProbeStream streams[BDREMUX_MAX_PROBE_STREAMS];
+} BdremuxProbe;
+
+/* what bdremux_verify found comparing a result with its manifest */
+typedef struct _BdremuxVerify
+{
+  gboolean ok;                  /* size, checksum and unit CRCs match */
+  BdremuxChecksum checksum;
+  guint64 size;                 /* bytes read */
+  guint64 expected_size;        /* according to the manifest */
+  gboolean checksum_ok;
+  guint64 n_units;              /* aligned units with a CRC, 0 if none */
+  guint64 bad_units;
+  gint64 first_bad_unit;        /* -1 if none, counted in
+                                 * BDREMUX_ALIGNED_UNIT_SIZE */
+  gdouble seconds;
+} BdremuxVerify;
+
+/* any of the callbacks may be NULL. they are invoked from the threads
+ * doing the work, never from the one which started the job */
+typedef struct _BdremuxCallbacks
+{
+  /* an elementary stream has been connected to the muxer */
+  void (*linked) (BdremuxJob * job, guint source_pid, guint sink_pid,
+      gpointer user_data);
+  /* the format of a result stream is known, caps as GStreamer string */
+  void (*caps) (BdremuxJob * job, guint sink_pid, const gchar * caps,
+      gpointer user_data);
+  /* a video random access point has been written at source packet spn */
+  void (*entry_point) (BdremuxJob * job, guint64 spn, gint64 pts,
+      gpointer user_data);
+  /* position bytes out of total of the input have been consumed, total
+   * is 0 if unknown */
+  void (*progress) (BdremuxJob * job, guint64 position, guint64 total,
+      gpointer user_data);
+  /* the job is over, error is NULL if it succeeded */
+  void (*finished) (BdremuxJob * job, const gchar * error,
+      gpointer user_data);
+  /* a snapshot taken every stats interval and once at the end */
+  void (*stats) (BdremuxJob * job, const BdremuxStats * stats,
+      gpointer user_data);
+  /* entry_point for the results added with bdremux_job_add_result */
+  void (*result_entry_point) (BdremuxJob * job, guint result, guint64 spn,
+      gint64 pts, gpointer user_data);
+} BdremuxCallbacks;
+
+void bdremux_init (int *argc, char **argv[]);
+
+gboolean bdremux_probe (const gchar * filename, BdremuxProbe * probe,
+    gchar ** error);
+gboolean bdremux_verify (const gchar * filename, BdremuxVerify * verify,
+    gchar ** error);
+
+BdremuxJob *bdremux_job_new (const gchar * in_filename,
+    const gchar * out_filename);
+void bdremux_job_reset (BdremuxJob * job, const gchar * in_filename,
+    const gchar * out_filename);
+void bdremux_job_free (BdremuxJob * job);
+
+void bdremux_job_set_pids (BdremuxJob * job, const gint * source_pids,
+    guint n_source_pids, const gint * sink_pids, guint n_sink_pids);
+void bdremux_job_set_cutlist (BdremuxJob * job, const gchar * cuts_filename);
+void bdremux_job_set_fast (BdremuxJob * job, gboolean fast);
+void bdremux_job_set_index_only (BdremuxJob * job, gboolean index_only);
+void bdremux_job_set_audio_mode (BdremuxJob * job, BdremuxAudioMode mode);
+void bdremux_job_set_threads (BdremuxJob * job, guint n_threads);
+void bdremux_job_set_queue_size (BdremuxJob * job, guint queue_size);
+void bdremux_job_set_queue_time (BdremuxJob * job, guint queue_time_ms);
+void bdremux_job_set_entry_points (BdremuxJob * job, gboolean enable);
+void bdremux_job_set_input (BdremuxJob * job, BdremuxReadAhead read_ahead,
+    gsize block_size, guint depth);
+void bdremux_job_set_follow (BdremuxJob * job, gboolean follow,
+    guint idle_timeout_ms);
+void bdremux_job_set_checkpoint (BdremuxJob * job, gboolean enable,
+    guint interval_ms, gboolean resume);
+void bdremux_job_set_output (BdremuxJob * job, gboolean direct_io,
+    gboolean preallocate, BdremuxSyncPolicy sync);
+void bdremux_job_set_pipeline (BdremuxJob * job, gboolean threaded,
+    gint reader_cpu, gint remux_cpu, gint writer_cpu);
+void bdremux_job_set_background (BdremuxJob * job, gboolean background,
+    guint max_rate);
+void bdremux_job_set_checksum (BdremuxJob * job, BdremuxChecksum checksum,
+    gboolean unit_crcs);
+void bdremux_job_set_clip_info (BdremuxJob * job, const gchar * clpi_filename,
+    const gchar * mpls_filename);
+void bdremux_job_set_callbacks (BdremuxJob * job,
+    const BdremuxCallbacks * callbacks, gpointer user_data);
+void bdremux_job_set_stats_interval (BdremuxJob * job, guint interval_ms);
+
+guint bdremux_job_add_result (BdremuxJob * job, const gchar * out_filename);
+void bdremux_job_set_result_pids (BdremuxJob * job, guint result,
+    const gint * source_pids, guint n_source_pids, const gint * sink_pids,
+    guint n_sink_pids);
+void bdremux_job_set_result_cutlist (BdremuxJob * job, guint result,
+    const gchar * cuts_filename);
+void bdremux_job_set_result_entry_points (BdremuxJob * job, guint result,
+    gboolean enable);
+void bdremux_job_set_result_clip_info (BdremuxJob * job, guint result,
+    const gchar * clpi_filename, const gchar * mpls_filename);
+
+const gchar *bdremux_job_get_in_filename (BdremuxJob * job);
+const gchar *bdremux_job_get_out_filename (BdremuxJob * job);
+
+gboolean bdremux_job_start (BdremuxJob * job, gchar ** error);
+gboolean bdremux_job_wait (BdremuxJob * job);
+const gchar *bdremux_job_get_error (BdremuxJob * job);
+
+G_END_DECLS
+
+#endif /* __BDREMUX_H__ */
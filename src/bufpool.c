@@ -0,0 +1,306 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "bufpool.h"
+#include "tspacket.h"
+
+typedef struct _PoolSlab PoolSlab;
+
+/* sits in front of the memory handed out, the free function only gets
+ * that pointer */
+typedef struct _PoolChunk
+{
+  BufPool *pool;
+  PoolSlab *slab;               /* NULL if allocated outside the slabs */
+  struct _PoolChunk *next;
+  gint size_class;              /* -1 if allocated outside the slabs */
+  guint size;
+} PoolChunk;
+
+/* heads the chunks it is cut into, keeping those that are free */
+struct _PoolSlab
+{
+  PoolSlab *prev, *next;        /* among the slabs of the class with free
+                                 * chunks */
+  PoolChunk *free_chunks;
+  guint n_chunks, n_free;
+  gsize size;
+};
+
+#define CHUNK_HEADER_SIZE ((sizeof (PoolChunk) + 31) & ~31)
+#define CHUNK_DATA(c) ((guint8 *) (c) + CHUNK_HEADER_SIZE)
+#define DATA_CHUNK(d) ((PoolChunk *) ((guint8 *) (d) - CHUNK_HEADER_SIZE))
+#define SLAB_HEADER_SIZE ((sizeof (PoolSlab) + 31) & ~31)
+
+struct _BufPool
+{
+  CompatMutex lock;
+  volatile gint refcount;
+  gsize limit;
+  /* the slabs with free chunks: allocations take from the head, a slab
+   * getting a chunk back goes to the tail and so has time to empty */
+  PoolSlab *slabs[BUF_POOL_CLASSES], *last_slabs[BUF_POOL_CLASSES];
+  guint n_empty[BUF_POOL_CLASSES];
+  BufPoolStats stats;
+};
+
+static guint
+class_size (gint size_class)
+{
+  return M2TS_ALIGNED_UNIT_SIZE << size_class;
+}
+
+BufPool *
+buf_pool_new (gsize limit)
+{
+  BufPool *pool = g_new0 (BufPool, 1);
+
+  MUTEX_INIT (pool->lock);
+  pool->refcount = 1;
+  pool->limit = limit;
+  return pool;
+}
+
+static BufPool *
+buf_pool_ref (BufPool * pool)
+{
+  g_atomic_int_inc (&pool->refcount);
+  return pool;
+}
+
+void
+buf_pool_unref (BufPool * pool)
+{
+  PoolSlab *slab;
+  gint i;
+
+  if (!g_atomic_int_dec_and_test (&pool->refcount))
+    return;
+  GST_DEBUG ("buffer pool: %" G_GUINT64_FORMAT " bytes in slabs, peak %"
+      G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT " allocations, %"
+      G_GUINT64_FORMAT " from the heap", pool->stats.size, pool->stats.peak,
+      pool->stats.allocs, pool->stats.fallbacks);
+  /* every chunk is back, so every slab is on its list */
+  for (i = 0; i < BUF_POOL_CLASSES; i++)
+    while ((slab = pool->slabs[i])) {
+      pool->slabs[i] = slab->next;
+      g_free (slab);
+    }
+  MUTEX_CLEAR (pool->lock);
+  g_free (pool);
+}
+
+static void
+link_slab (BufPool * pool, gint size_class, PoolSlab * slab, gboolean head)
+{
+  if (head) {
+    slab->prev = NULL;
+    slab->next = pool->slabs[size_class];
+    if (slab->next)
+      slab->next->prev = slab;
+    else
+      pool->last_slabs[size_class] = slab;
+    pool->slabs[size_class] = slab;
+  } else {
+    slab->next = NULL;
+    slab->prev = pool->last_slabs[size_class];
+    if (slab->prev)
+      slab->prev->next = slab;
+    else
+      pool->slabs[size_class] = slab;
+    pool->last_slabs[size_class] = slab;
+  }
+}
+
+static void
+unlink_slab (BufPool * pool, gint size_class, PoolSlab * slab)
+{
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    pool->slabs[size_class] = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  else
+    pool->last_slabs[size_class] = slab->prev;
+}
+
+/* cuts a new slab into free chunks of a size class, if the limit allows */
+static gboolean
+add_slab (BufPool * pool, gint size_class)
+{
+  gsize stride = CHUNK_HEADER_SIZE + class_size (size_class);
+  guint n = MAX ((BUF_POOL_SLAB_SIZE - SLAB_HEADER_SIZE) / stride, 1);
+  gsize size = SLAB_HEADER_SIZE + n * stride;
+  PoolSlab *slab;
+  guint i;
+
+  if (pool->stats.size + size > pool->limit)
+    return FALSE;
+  slab = g_malloc (size);
+  slab->free_chunks = NULL;
+  slab->n_chunks = slab->n_free = n;
+  slab->size = size;
+  for (i = 0; i < n; i++) {
+    PoolChunk *chunk = (PoolChunk *) ((guint8 *) slab + SLAB_HEADER_SIZE
+        + i * stride);
+    chunk->pool = pool;
+    chunk->slab = slab;
+    chunk->size_class = size_class;
+    chunk->size = class_size (size_class);
+    chunk->next = slab->free_chunks;
+    slab->free_chunks = chunk;
+  }
+  link_slab (pool, size_class, slab, TRUE);
+  pool->n_empty[size_class]++;
+  pool->stats.size += size;
+  return TRUE;
+}
+
+static PoolChunk *
+take_chunk (BufPool * pool, gint size_class)
+{
+  PoolSlab *slab = pool->slabs[size_class];
+  PoolChunk *chunk = slab->free_chunks;
+
+  slab->free_chunks = chunk->next;
+  if (slab->n_free-- == slab->n_chunks)
+    pool->n_empty[size_class]--;
+  if (!slab->n_free)
+    unlink_slab (pool, size_class, slab);
+  return chunk;
+}
+
+/* a slab whose chunks all came back is given back as well, unless it's
+ * the only idle one of its class. the queues filling up while the pads
+ * were blocked thus don't keep their memory for the whole remux */
+static void
+return_chunk (BufPool * pool, PoolChunk * chunk)
+{
+  PoolSlab *slab = chunk->slab;
+  gint size_class = chunk->size_class;
+
+  chunk->next = slab->free_chunks;
+  slab->free_chunks = chunk;
+  if (slab->n_free++ == 0)
+    link_slab (pool, size_class, slab, FALSE);
+  if (slab->n_free < slab->n_chunks)
+    return;
+  if (!pool->n_empty[size_class]) {
+    pool->n_empty[size_class]++;
+    return;
+  }
+  unlink_slab (pool, size_class, slab);
+  pool->stats.size -= slab->size;
+  g_free (slab);
+}
+
+static gpointer
+pool_alloc (BufPool * pool, guint size)
+{
+  PoolChunk *chunk = NULL;
+  gint size_class;
+
+  for (size_class = 0; size_class < BUF_POOL_CLASSES; size_class++)
+    if (size <= class_size (size_class))
+      break;
+
+  MUTEX_LOCK (pool->lock);
+  if (size_class < BUF_POOL_CLASSES && (pool->slabs[size_class]
+          || add_slab (pool, size_class)))
+    chunk = take_chunk (pool, size_class);
+  pool->stats.allocs++;
+  if (!chunk)
+    pool->stats.fallbacks++;
+  pool->stats.in_use += chunk ? chunk->size : size;
+  pool->stats.peak = MAX (pool->stats.peak, pool->stats.in_use);
+  MUTEX_UNLOCK (pool->lock);
+
+  if (!chunk) {
+    chunk = g_malloc (CHUNK_HEADER_SIZE + size);
+    chunk->pool = pool;
+    chunk->slab = NULL;
+    chunk->size_class = -1;
+    chunk->size = size;
+  }
+  buf_pool_ref (pool);
+  return CHUNK_DATA (chunk);
+}
+
+static void
+pool_free (gpointer data)
+{
+  PoolChunk *chunk = DATA_CHUNK (data);
+  BufPool *pool = chunk->pool;
+  PoolSlab *slab = chunk->slab;
+
+  MUTEX_LOCK (pool->lock);
+  pool->stats.in_use -= chunk->size;
+  /* the slab may be gone once the chunk is back */
+  if (slab)
+    return_chunk (pool, chunk);
+  MUTEX_UNLOCK (pool->lock);
+  if (!slab)
+    g_free (chunk);
+  buf_pool_unref (pool);
+}
+
+GstBuffer *
+buf_pool_new_buffer (BufPool * pool, guint size)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+  guint8 *data = pool_alloc (pool, size);
+
+  GST_BUFFER_MALLOCDATA (buffer) = data;
+  GST_BUFFER_DATA (buffer) = data;
+  GST_BUFFER_SIZE (buffer) = size;
+  GST_BUFFER_FREE_FUNC (buffer) = pool_free;
+  return buffer;
+}
+
+void
+buf_pool_get_stats (BufPool * pool, BufPoolStats * stats)
+{
+  MUTEX_LOCK (pool->lock);
+  *stats = pool->stats;
+  MUTEX_UNLOCK (pool->lock);
+}
+
+static GstFlowReturn
+pool_bufferalloc (GstPad * pad, guint64 offset, guint size, GstCaps * caps,
+    GstBuffer ** buf)
+{
+  BufPool *pool = g_object_get_data (G_OBJECT (pad), "buffer-pool");
+
+  *buf = buf_pool_new_buffer (pool, size);
+  GST_BUFFER_OFFSET (*buf) = offset;
+  if (caps)
+    gst_buffer_set_caps (*buf, caps);
+  return GST_FLOW_OK;
+}
+
+/* the queue in front of the pad passes the allocations of the demuxer and
+ * parsers on to it, the pad keeps a reference to the pool */
+void
+buf_pool_serve_pad (BufPool * pool, GstPad * pad)
+{
+  g_object_set_data_full (G_OBJECT (pad), "buffer-pool",
+      buf_pool_ref (pool), (GDestroyNotify) buf_pool_unref);
+  gst_pad_set_bufferalloc_function (pad, pool_bufferalloc);
+}
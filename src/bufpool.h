@@ -0,0 +1,56 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_BUFPOOL_H__
+#define __BDREMUX_BUFPOOL_H__
+
+#include "common.h"
+
+/* the smallest size class is an aligned unit, each further one doubles
+ * it up to a read chunk. larger requests are allocated one by one */
+#define BUF_POOL_CLASSES 6
+#define BUF_POOL_SLAB_SIZE (1024 * 1024)
+
+/* recycles the memory of GstBuffers in fixed size classes carved out of
+ * slabs, so a long remux doesn't malloc and free every PES. the slabs
+ * together never exceed the limit given, whatever doesn't fit comes from
+ * the heap, and all but one idle slab per class are freed again. the
+ * pool lives until its last buffer has been freed */
+typedef struct _BufPool BufPool;
+
+typedef struct _BufPoolStats
+{
+  guint64 size;                 /* bytes currently reserved in slabs */
+  guint64 in_use;               /* bytes handed out and not freed yet */
+  guint64 peak;
+  guint64 allocs;
+  guint64 fallbacks;            /* allocations the slabs couldn't serve */
+} BufPoolStats;
+
+BufPool *buf_pool_new (gsize limit);
+void buf_pool_unref (BufPool * pool);
+
+/* a buffer of size bytes which returns its memory to the pool */
+GstBuffer *buf_pool_new_buffer (BufPool * pool, guint size);
+void buf_pool_get_stats (BufPool * pool, BufPoolStats * stats);
+
+/* lets the buffers allocated downstream of pad come from the pool */
+void buf_pool_serve_pad (BufPool * pool, GstPad * pad);
+
+#endif /* __BDREMUX_BUFPOOL_H__ */
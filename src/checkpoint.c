@@ -0,0 +1,407 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "tspacket.h"
+
+/* the job line carries both file names, a checkpoint line every STC
+ * sequence */
+#define CHECKPOINT_LINE_MAX 32768
+
+typedef enum
+{
+  FIELD_UINT64,
+  FIELD_INT64,
+  FIELD_UINT,
+  FIELD_BOOLEAN
+} FieldType;
+
+typedef struct _StateField
+{
+  const gchar *name;
+  FieldType type;
+  glong offset;
+} StateField;
+
+/* written as name=value, the source PIDs follow as es=PID,PID,..., their
+ * continuity counters as cc=PID:DELTA:NEXT,... and the STC sequences as
+ * stc=SPN:FIRST_PTS:LAST_PTS,... */
+static const StateField state_fields[] = {
+  {"spn", FIELD_UINT64, G_STRUCT_OFFSET (CheckpointState, spn)},
+  {"input", FIELD_UINT64, G_STRUCT_OFFSET (CheckpointState, input_offset)},
+  {"packet", FIELD_UINT64, G_STRUCT_OFFSET (CheckpointState, packet_index)},
+  {"pat_cc", FIELD_UINT, G_STRUCT_OFFSET (CheckpointState, pat_cc)},
+  {"pmt_cc", FIELD_UINT, G_STRUCT_OFFSET (CheckpointState, pmt_cc)},
+  {"have_pcr", FIELD_BOOLEAN, G_STRUCT_OFFSET (CheckpointState, have_pcr)},
+  {"pcr_discont", FIELD_BOOLEAN,
+      G_STRUCT_OFFSET (CheckpointState, pcr_discont)},
+  {"new_timebase", FIELD_BOOLEAN,
+      G_STRUCT_OFFSET (CheckpointState, new_timebase)},
+  {"last_pcr", FIELD_INT64, G_STRUCT_OFFSET (CheckpointState, last_pcr)},
+  {"last_arrival", FIELD_INT64,
+      G_STRUCT_OFFSET (CheckpointState, last_arrival)},
+  {"last_pcr_index", FIELD_UINT64,
+      G_STRUCT_OFFSET (CheckpointState, last_pcr_index)},
+  {"rate_ticks", FIELD_INT64, G_STRUCT_OFFSET (CheckpointState, rate_ticks)},
+  {"rate_packets", FIELD_INT64,
+      G_STRUCT_OFFSET (CheckpointState, rate_packets)},
+  {"first_ats", FIELD_INT64, G_STRUCT_OFFSET (CheckpointState, first_ats)},
+  {"last_ats", FIELD_INT64, G_STRUCT_OFFSET (CheckpointState, last_ats)},
+};
+
+static void
+append_state (GString * s, const CheckpointState * state)
+{
+  const guint8 *base = (const guint8 *) state;
+  guint i;
+
+  g_string_append (s, "checkpoint");
+  for (i = 0; i < G_N_ELEMENTS (state_fields); i++) {
+    const StateField *f = &state_fields[i];
+    const guint8 *field = base + f->offset;
+
+    switch (f->type) {
+      case FIELD_UINT64:
+        g_string_append_printf (s, " %s=%" G_GUINT64_FORMAT, f->name,
+            *(const guint64 *) field);
+        break;
+      case FIELD_INT64:
+        g_string_append_printf (s, " %s=%" G_GINT64_FORMAT, f->name,
+            *(const gint64 *) field);
+        break;
+      case FIELD_UINT:
+        g_string_append_printf (s, " %s=%u", f->name, *(const guint *) field);
+        break;
+      case FIELD_BOOLEAN:
+        g_string_append_printf (s, " %s=%i", f->name,
+            *(const gboolean *) field ? 1 : 0);
+        break;
+    }
+  }
+  g_string_append (s, " es=");
+  for (i = 0; i < state->n_es_pids; i++)
+    g_string_append_printf (s, "%s%u", i ? "," : "", state->es_pids[i]);
+  g_string_append (s, " cc=");
+  for (i = 0; i < state->n_cc_pids; i++)
+    g_string_append_printf (s, "%s%u:%u:%u", i ? "," : "", state->cc_pids[i],
+        state->cc_delta[i], state->next_cc[i]);
+  g_string_append (s, " stc=");
+  for (i = 0; i < state->n_stc; i++)
+    g_string_append_printf (s, "%s%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT
+        ":%" G_GINT64_FORMAT, i ? "," : "", state->stc[i].spn,
+        state->stc[i].first_pts, state->stc[i].last_pts);
+  g_string_append_c (s, '\n');
+}
+
+static gboolean
+parse_es_pids (const gchar * value, CheckpointState * state)
+{
+  gchar **pids = g_strsplit (value, ",", 0);
+  gboolean ok = TRUE;
+  guint i;
+
+  for (i = 0; pids[i] && *pids[i] && ok; i++) {
+    gchar *end;
+    guint64 pid = g_ascii_strtoull (pids[i], &end, 10);
+    ok = *end == '\0' && pid < TS_MAX_PID && state->n_es_pids < MAX_PIDS;
+    if (ok)
+      state->es_pids[state->n_es_pids++] = pid;
+  }
+  g_strfreev (pids);
+  return ok;
+}
+
+static gboolean
+parse_cc (const gchar * value, CheckpointState * state)
+{
+  gchar **pids = g_strsplit (value, ",", 0);
+  gboolean ok = TRUE;
+  guint i;
+
+  for (i = 0; pids[i] && *pids[i] && ok; i++) {
+    guint64 pid, delta = 0, next = 0;
+    gchar *end;
+
+    pid = g_ascii_strtoull (pids[i], &end, 10);
+    ok = *end == ':';
+    if (ok)
+      delta = g_ascii_strtoull (end + 1, &end, 10);
+    ok = ok && *end == ':';
+    if (ok)
+      next = g_ascii_strtoull (end + 1, &end, 10);
+    ok = ok && *end == '\0' && pid < TS_MAX_PID && delta < 16 && next < 16
+        && state->n_cc_pids < MAX_PIDS;
+    if (ok) {
+      state->cc_pids[state->n_cc_pids] = pid;
+      state->cc_delta[state->n_cc_pids] = delta;
+      state->next_cc[state->n_cc_pids++] = next;
+    }
+  }
+  g_strfreev (pids);
+  return ok;
+}
+
+static gboolean
+parse_stc (const gchar * value, CheckpointState * state)
+{
+  gchar **sequences = g_strsplit (value, ",", 0);
+  gboolean ok = TRUE;
+  guint i;
+
+  for (i = 0; sequences[i] && ok; i++) {
+    ClipStcSequence *seq = &state->stc[state->n_stc];
+    gchar *end;
+
+    ok = state->n_stc < CLIP_MAX_STC_SEQUENCES;
+    if (!ok)
+      break;
+    seq->spn = g_ascii_strtoull (sequences[i], &end, 10);
+    ok = *end == ':';
+    if (ok)
+      seq->first_pts = g_ascii_strtoll (end + 1, &end, 10);
+    ok = ok && *end == ':';
+    if (ok)
+      seq->last_pts = g_ascii_strtoll (end + 1, &end, 10);
+    ok = ok && *end == '\0';
+    state->n_stc++;
+  }
+  g_strfreev (sequences);
+  return ok && state->n_stc > 0;
+}
+
+/* FALSE unless every field is there */
+static gboolean
+parse_state (const gchar * line, CheckpointState * state)
+{
+  gchar **tokens = g_strsplit (line, " ", 0);
+  guint8 *base = (guint8 *) state;
+  guint i, j, n_found = 0;
+  gboolean ok = TRUE;
+
+  memset (state, 0, sizeof (*state));
+  for (i = 1; tokens[i] && ok; i++) {
+    gchar *value = strchr (tokens[i], '='), *end;
+
+    if (!value)
+      break;
+    *value++ = '\0';
+    if (!strcmp (tokens[i], "es")) {
+      ok = parse_es_pids (value, state);
+      n_found++;
+      continue;
+    }
+    if (!strcmp (tokens[i], "cc")) {
+      ok = parse_cc (value, state);
+      n_found++;
+      continue;
+    }
+    if (!strcmp (tokens[i], "stc")) {
+      ok = parse_stc (value, state);
+      n_found++;
+      continue;
+    }
+    for (j = 0; j < G_N_ELEMENTS (state_fields); j++)
+      if (!strcmp (tokens[i], state_fields[j].name))
+        break;
+    if (j == G_N_ELEMENTS (state_fields))
+      break;
+    switch (state_fields[j].type) {
+      case FIELD_UINT64:
+        *(guint64 *) (base + state_fields[j].offset) =
+            g_ascii_strtoull (value, &end, 10);
+        break;
+      case FIELD_INT64:
+        *(gint64 *) (base + state_fields[j].offset) =
+            g_ascii_strtoll (value, &end, 10);
+        break;
+      case FIELD_UINT:
+        *(guint *) (base + state_fields[j].offset) =
+            g_ascii_strtoull (value, &end, 10);
+        break;
+      case FIELD_BOOLEAN:
+        *(gboolean *) (base + state_fields[j].offset) =
+            g_ascii_strtoull (value, &end, 10) != 0;
+        break;
+    }
+    ok = end != value && *end == '\0';
+    n_found++;
+  }
+  g_strfreev (tokens);
+  return ok && n_found == G_N_ELEMENTS (state_fields) + 3;
+}
+
+/* a line without its newline, FALSE at the end of the file and for a line
+ * cut short by a crash */
+static gboolean
+read_line (FILE * f, gchar * line)
+{
+  gsize len;
+
+  if (!fgets (line, CHECKPOINT_LINE_MAX, f))
+    return FALSE;
+  len = strlen (line);
+  if (len == 0 || line[len - 1] != '\n')
+    return FALSE;
+  line[len - 1] = '\0';
+  return TRUE;
+}
+
+/* reads up to the last complete checkpoint, end stays 0 if there is none.
+ * FALSE if the journal belongs to another job */
+static gboolean
+read_journal (FILE * f, const gchar * job, CheckpointState * state,
+    GArray * entries, long *end)
+{
+  gchar *line = g_malloc (CHECKPOINT_LINE_MAX);
+  CheckpointState parsed;
+  guint n_entries = 0;
+  gboolean ok = TRUE;
+
+  *end = 0;
+  if (!read_line (f, line))
+    goto out;
+  if (strcmp (line, CHECKPOINT_MAGIC)) {
+    ok = FALSE;
+    goto out;
+  }
+  if (!read_line (f, line))
+    goto out;
+  if (!g_str_has_prefix (line, "job ") || strcmp (line + 4, job)) {
+    ok = FALSE;
+    goto out;
+  }
+
+  while (read_line (f, line)) {
+    EpMapEntry e;
+
+    if (sscanf (line, "entry %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT,
+            &e.spn, &e.pts) == 2)
+      g_array_append_val (entries, e);
+    else if (g_str_has_prefix (line, "checkpoint ")
+        && parse_state (line, &parsed)) {
+      *state = parsed;
+      n_entries = entries->len;
+      *end = ftell (f);
+    } else
+      break;
+  }
+  g_array_set_size (entries, n_entries);
+
+out:
+  g_free (line);
+  return ok;
+}
+
+static gboolean
+sync_journal (FILE * f)
+{
+  return fflush (f) == 0 && fdatasync (fileno (f)) == 0;
+}
+
+/* opens the journal of a job, a description of it (file names, streams,
+ * ranges) makes sure nobody resumes from another one. with resume the last
+ * checkpoint is returned in state and the entry points written before it
+ * are appended to entries. resumed is FALSE if there was none, the journal
+ * is started over then */
+CheckpointJournal *
+checkpoint_journal_open (const gchar * filename, const gchar * job,
+    gboolean resume, CheckpointState * state, GArray * entries,
+    gboolean * resumed, gchar ** error)
+{
+  CheckpointJournal *j;
+  FILE *f = NULL;
+  long end = 0;
+
+  *resumed = FALSE;
+  if (resume && (f = fopen (filename, "r+"))) {
+    if (!read_journal (f, job, state, entries, &end)) {
+      *error = g_strdup_printf ("%s was written by another remux!", filename);
+      fclose (f);
+      return NULL;
+    }
+    if (end == 0) {
+      GST_WARNING ("no complete checkpoint in %s, starting over", filename);
+      fclose (f);
+      f = NULL;
+    } else if (ftruncate (fileno (f), end) < 0
+        || fseek (f, end, SEEK_SET) < 0) {
+      *error = g_strdup_printf ("could not truncate %s! (%i)", filename,
+          errno);
+      fclose (f);
+      return NULL;
+    } else {
+      GST_INFO ("resuming at SPN %" G_GUINT64_FORMAT " from %s with %u "
+          "entry points", state->spn, filename, entries->len);
+      *resumed = TRUE;
+    }
+  } else if (resume)
+    GST_WARNING ("no checkpoint %s, starting over", filename);
+
+  if (!f) {
+    f = fopen (filename, "w");
+    if (!f || fprintf (f, "%s\njob %s\n", CHECKPOINT_MAGIC, job) < 0
+        || !sync_journal (f)) {
+      *error = g_strdup_printf ("could not write %s! (%i)", filename, errno);
+      if (f)
+        fclose (f);
+      return NULL;
+    }
+  }
+
+  j = g_new0 (CheckpointJournal, 1);
+  j->filename = g_strdup (filename);
+  j->f = f;
+  return j;
+}
+
+/* the caller must have synced the result up to the checkpoint before */
+gboolean
+checkpoint_journal_append (CheckpointJournal * j, const EpMapEntry * entries,
+    guint n_entries, const CheckpointState * state, gchar ** error)
+{
+  GString *s = g_string_sized_new (256 + n_entries * 32);
+  gboolean ok;
+  guint i;
+
+  for (i = 0; i < n_entries; i++)
+    g_string_append_printf (s, "entry %" G_GUINT64_FORMAT " %"
+        G_GINT64_FORMAT "\n", entries[i].spn, entries[i].pts);
+  append_state (s, state);
+  ok = fwrite (s->str, s->len, 1, j->f) == 1 && sync_journal (j->f);
+  if (!ok)
+    *error = g_strdup_printf ("could not write %s! (%i)", j->filename, errno);
+  g_string_free (s, TRUE);
+  return ok;
+}
+
+/* remove once the result is complete, otherwise it's kept for resuming */
+void
+checkpoint_journal_close (CheckpointJournal * j, gboolean remove)
+{
+  fclose (j->f);
+  if (remove && unlink (j->filename) < 0)
+    GST_WARNING ("could not remove %s (%i)", j->filename, errno);
+  g_free (j->filename);
+  g_free (j);
+}
@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_CHECKPOINT_H__
+#define __BDREMUX_CHECKPOINT_H__
+
+#include <stdio.h>
+
+#include "clipinfo.h"
+#include "common.h"
+#include "epmap.h"
+
+/* the journal is kept next to the result under this name */
+#define CHECKPOINT_SUFFIX ".checkpoint"
+#define CHECKPOINT_MAGIC "BDREMUX-CHECKPOINT 1"
+
+typedef struct _CheckpointSettings
+{
+  guint interval;               /* ms between checkpoints, 0 for none */
+  gboolean resume;              /* continue from the last one */
+} CheckpointSettings;
+
+/* where the fast remuxer stood at the start of a GOP once everything
+ * before it is in the result: enough to carry on from there as if it had
+ * never stopped */
+typedef struct _CheckpointState
+{
+  guint64 spn;                  /* source packets written before the GOP */
+  guint64 input_offset;         /* of the GOP, counted within the ranges */
+  guint64 packet_index;
+  guint pat_cc, pmt_cc;
+  guint16 es_pids[MAX_PIDS];    /* source PIDs past their first unit start */
+  guint n_es_pids;
+  /* source PIDs written before, with what's added to their continuity
+   * counter since the last cut and the counter their next packet gets */
+  guint16 cc_pids[MAX_PIDS];
+  guint8 cc_delta[MAX_PIDS], next_cc[MAX_PIDS];
+  guint n_cc_pids;
+  gboolean have_pcr, pcr_discont, new_timebase;
+  gint64 last_pcr, last_arrival;
+  guint64 last_pcr_index;
+  gint64 rate_ticks, rate_packets;
+  gint64 first_ats, last_ats;   /* the latter of the packet before the GOP */
+  ClipStcSequence stc[CLIP_MAX_STC_SEQUENCES];
+  guint n_stc;
+} CheckpointState;
+
+/* the checkpoints are appended to a journal, each after the entry points
+ * written before it, and synced. whatever follows the last complete
+ * checkpoint is dropped on resume */
+typedef struct _CheckpointJournal
+{
+  gchar *filename;
+  FILE *f;
+} CheckpointJournal;
+
+CheckpointJournal *checkpoint_journal_open (const gchar * filename,
+    const gchar * job, gboolean resume, CheckpointState * state,
+    GArray * entries, gboolean * resumed, gchar ** error);
+gboolean checkpoint_journal_append (CheckpointJournal * j,
+    const EpMapEntry * entries, guint n_entries,
+    const CheckpointState * state, gchar ** error);
+void checkpoint_journal_close (CheckpointJournal * j, gboolean remove);
+
+#endif /* __BDREMUX_CHECKPOINT_H__ */
@@ -0,0 +1,497 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_CRC32C
+#include <immintrin.h>
+#define SSE42_TARGET __attribute__ ((target ("sse4.2")))
+#endif
+#if defined (__ARM_FEATURE_CRC32)
+#define HAVE_ARM_CRC32C
+#include <arm_acle.h>
+#endif
+
+#include "checksum.h"
+
+#define CRC32C_POLY 0x82F63B78  /* Castagnoli, reflected */
+
+#define XXH_P1 G_GUINT64_CONSTANT (11400714785074694791)
+#define XXH_P2 G_GUINT64_CONSTANT (14029467366897019727)
+#define XXH_P3 G_GUINT64_CONSTANT (1609587929392839161)
+#define XXH_P4 G_GUINT64_CONSTANT (9650029242287828579)
+#define XXH_P5 G_GUINT64_CONSTANT (2870177450012600261)
+
+static const gchar *const type_names[] = { "none", "xxh64", "crc32c",
+  "sha256"
+};
+
+const gchar *
+checksum_type_name (ChecksumType type)
+{
+  return type_names[type];
+}
+
+/* CHECKSUM_NONE for anything unknown */
+ChecksumType
+checksum_type_from_name (const gchar * name)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (type_names); i++)
+    if (!g_ascii_strcasecmp (name, type_names[i]))
+      return i;
+  return CHECKSUM_NONE;
+}
+
+/* CRC32C eight bytes at a time with the tables of each byte position,
+ * or with the instructions of SSE4.2 and ARMv8 where there are */
+static guint32 crc_table[8][256];
+static gboolean crc_hardware;
+
+static void
+crc32c_init (void)
+{
+  static gsize initialized = 0;
+  guint i, k;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+  for (i = 0; i < 256; i++) {
+    guint32 crc = i;
+    for (k = 0; k < 8; k++)
+      crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    crc_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++)
+    for (k = 1; k < 8; k++)
+      crc_table[k][i] = (crc_table[k - 1][i] >> 8)
+          ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+#if defined (HAVE_X86_CRC32C)
+  crc_hardware = __builtin_cpu_supports ("sse4.2");
+#elif defined (HAVE_ARM_CRC32C)
+  crc_hardware = TRUE;
+#endif
+  GST_DEBUG ("CRC32C in %s", crc_hardware ? "hardware" : "software");
+  g_once_init_leave (&initialized, 1);
+}
+
+static guint32
+crc32c_software (guint32 crc, const guint8 * p, gsize len)
+{
+  while (len >= 8) {
+    guint32 lo, hi;
+    memcpy (&lo, p, 4);
+    memcpy (&hi, p + 4, 4);
+    lo = GUINT32_FROM_LE (lo) ^ crc;
+    hi = GUINT32_FROM_LE (hi);
+    crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff]
+        ^ crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24]
+        ^ crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff]
+        ^ crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+#ifdef HAVE_X86_CRC32C
+SSE42_TARGET static guint32
+crc32c_hardware (guint32 crc, const guint8 * p, gsize len)
+{
+#ifdef __x86_64__
+  guint64 crc64 = crc;
+
+  while (len >= 8) {
+    guint64 v;
+    memcpy (&v, p, 8);
+    crc64 = _mm_crc32_u64 (crc64, v);
+    p += 8;
+    len -= 8;
+  }
+  crc = crc64;
+#endif
+  while (len >= 4) {
+    guint32 v;
+    memcpy (&v, p, 4);
+    crc = _mm_crc32_u32 (crc, v);
+    p += 4;
+    len -= 4;
+  }
+  while (len--)
+    crc = _mm_crc32_u8 (crc, *p++);
+  return crc;
+}
+#endif
+
+#ifdef HAVE_ARM_CRC32C
+static guint32
+crc32c_hardware (guint32 crc, const guint8 * p, gsize len)
+{
+  while (len >= 8) {
+    guint64 v;
+    memcpy (&v, p, 8);
+    crc = __crc32cd (crc, v);
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+    crc = __crc32cb (crc, *p++);
+  return crc;
+}
+#endif
+
+/* continues the CRC32C crc of the data before, 0 to start */
+guint32
+crc32c_update (guint32 crc, const guint8 * data, gsize len)
+{
+  crc32c_init ();
+  crc = ~crc;
+#if defined (HAVE_X86_CRC32C) || defined (HAVE_ARM_CRC32C)
+  if (crc_hardware)
+    return ~crc32c_hardware (crc, data, len);
+#endif
+  return ~crc32c_software (crc, data, len);
+}
+
+/* XXH64 with seed 0, as xxhsum prints it */
+static inline guint64
+rotl64 (guint64 x, guint r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64
+read64 (const guint8 * p)
+{
+  guint64 v;
+  memcpy (&v, p, 8);
+  return GUINT64_FROM_LE (v);
+}
+
+static inline guint64
+xxh_round (guint64 acc, guint64 input)
+{
+  acc += input * XXH_P2;
+  return rotl64 (acc, 31) * XXH_P1;
+}
+
+static inline guint64
+xxh_merge (guint64 acc, guint64 v)
+{
+  acc ^= xxh_round (0, v);
+  return acc * XXH_P1 + XXH_P4;
+}
+
+static void
+xxh_stripes (Checksum * c, const guint8 * p, gsize n)
+{
+  guint64 *v = c->xxh;
+
+  while (n--) {
+    v[0] = xxh_round (v[0], read64 (p));
+    v[1] = xxh_round (v[1], read64 (p + 8));
+    v[2] = xxh_round (v[2], read64 (p + 16));
+    v[3] = xxh_round (v[3], read64 (p + 24));
+    p += 32;
+  }
+}
+
+static void
+xxh_update (Checksum * c, const guint8 * data, gsize len)
+{
+  if (c->xxh_fill) {
+    gsize n = MIN (len, 32 - c->xxh_fill);
+    memcpy (c->xxh_buf + c->xxh_fill, data, n);
+    c->xxh_fill += n;
+    data += n;
+    len -= n;
+    if (c->xxh_fill < 32)
+      return;
+    xxh_stripes (c, c->xxh_buf, 1);
+    c->xxh_fill = 0;
+  }
+  xxh_stripes (c, data, len / 32);
+  memcpy (c->xxh_buf, data + len / 32 * 32, len % 32);
+  c->xxh_fill = len % 32;
+}
+
+static guint64
+xxh_digest (Checksum * c)
+{
+  const guint8 *p = c->xxh_buf, *end = p + c->xxh_fill;
+  guint64 *v = c->xxh, h;
+
+  if (c->size >= 32) {
+    h = rotl64 (v[0], 1) + rotl64 (v[1], 7) + rotl64 (v[2], 12)
+        + rotl64 (v[3], 18);
+    h = xxh_merge (h, v[0]);
+    h = xxh_merge (h, v[1]);
+    h = xxh_merge (h, v[2]);
+    h = xxh_merge (h, v[3]);
+  } else
+    h = XXH_P5;
+  h += c->size;
+  for (; p + 8 <= end; p += 8)
+    h = rotl64 (h ^ xxh_round (0, read64 (p)), 27) * XXH_P1 + XXH_P4;
+  if (p + 4 <= end) {
+    guint32 k;
+    memcpy (&k, p, 4);
+    h = rotl64 (h ^ (guint64) GUINT32_FROM_LE (k) * XXH_P1, 23) * XXH_P2
+        + XXH_P3;
+    p += 4;
+  }
+  for (; p < end; p++)
+    h = rotl64 (h ^ *p * XXH_P5, 11) * XXH_P1;
+  h ^= h >> 33;
+  h *= XXH_P2;
+  h ^= h >> 29;
+  h *= XXH_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+Checksum *
+checksum_new (ChecksumType type, gboolean unit_crcs)
+{
+  Checksum *c = g_new0 (Checksum, 1);
+
+  c->type = type;
+  if (type == CHECKSUM_SHA256)
+    c->sha256 = g_checksum_new (G_CHECKSUM_SHA256);
+  c->xxh[0] = XXH_P1 + XXH_P2;
+  c->xxh[1] = XXH_P2;
+  c->xxh[2] = 0;
+  c->xxh[3] = -XXH_P1;
+  if (unit_crcs)
+    c->units = g_array_new (FALSE, FALSE, sizeof (guint32));
+  return c;
+}
+
+void
+checksum_update (Checksum * c, const guint8 * data, gsize len)
+{
+  switch (c->type) {
+    case CHECKSUM_XXH64:
+      xxh_update (c, data, len);
+      break;
+    case CHECKSUM_CRC32C:
+      c->crc = crc32c_update (c->crc, data, len);
+      break;
+    case CHECKSUM_SHA256:
+      g_checksum_update (c->sha256, data, len);
+      break;
+    default:
+      break;
+  }
+  c->size += len;
+
+  while (c->units && len) {
+    gsize n = MIN (len, CHECKSUM_UNIT_SIZE - c->unit_fill);
+    c->unit_crc = crc32c_update (c->unit_crc, data, n);
+    c->unit_fill += n;
+    data += n;
+    len -= n;
+    if (c->unit_fill == CHECKSUM_UNIT_SIZE) {
+      g_array_append_val (c->units, c->unit_crc);
+      c->unit_crc = 0;
+      c->unit_fill = 0;
+    }
+  }
+}
+
+const gchar *
+checksum_finish (Checksum * c)
+{
+  if (c->digest)
+    return c->digest;
+  switch (c->type) {
+    case CHECKSUM_XXH64:
+      c->digest = g_strdup_printf ("%016" G_GINT64_MODIFIER "x",
+          xxh_digest (c));
+      break;
+    case CHECKSUM_CRC32C:
+      c->digest = g_strdup_printf ("%08x", c->crc);
+      break;
+    case CHECKSUM_SHA256:
+      c->digest = g_strdup (g_checksum_get_string (c->sha256));
+      break;
+    default:
+      c->digest = g_strdup ("");
+      break;
+  }
+  /* a result which isn't a whole number of units ends in a short one */
+  if (c->units && c->unit_fill) {
+    g_array_append_val (c->units, c->unit_crc);
+    c->unit_fill = 0;
+  }
+  return c->digest;
+}
+
+void
+checksum_free (Checksum * c)
+{
+  if (c->sha256)
+    g_checksum_free (c->sha256);
+  if (c->units)
+    g_array_free (c->units, TRUE);
+  g_free (c->digest);
+  g_free (c);
+}
+
+/* the manifest of the result filename: a line with its size, one with the
+ * checksum and, if taken, the number of unit CRCs followed by one line
+ * for each. it's written to a temporary name and renamed, so there is
+ * either a complete one or none */
+/* a rename only survives a crash once the directory is synced as well */
+static gboolean
+sync_dir_of (const gchar * filename)
+{
+  gchar *dir = g_path_get_dirname (filename);
+  int fd = open (dir, O_RDONLY | O_DIRECTORY);
+  gboolean ok = fd >= 0 && fsync (fd) == 0;
+  int err = errno;
+
+  if (fd >= 0)
+    close (fd);
+  g_free (dir);
+  errno = err;
+  return ok;
+}
+
+gboolean
+manifest_write (const gchar * filename, Checksum * c, gchar ** error)
+{
+  gchar *name = g_strconcat (filename, MANIFEST_SUFFIX, NULL);
+  gchar *tmp = g_strconcat (name, ".tmp", NULL);
+  const gchar *digest = checksum_finish (c);
+  gboolean ret = FALSE;
+  FILE *f;
+  guint i;
+
+  f = fopen (tmp, "w");
+  if (!f) {
+    *error = g_strdup_printf ("could not open %s for writing! (%i)", tmp,
+        errno);
+    goto out;
+  }
+  fprintf (f, "%s\nsize %" G_GUINT64_FORMAT "\n%s %s\n", MANIFEST_MAGIC,
+      c->size, checksum_type_name (c->type), digest);
+  if (c->units) {
+    fprintf (f, "units %u\n", c->units->len);
+    for (i = 0; i < c->units->len; i++)
+      fprintf (f, "%08x\n", g_array_index (c->units, guint32, i));
+  }
+  if (fflush (f) != 0 || fsync (fileno (f)) < 0) {
+    *error = g_strdup_printf ("could not write %s! (%i)", tmp, errno);
+    fclose (f);
+    unlink (tmp);
+    goto out;
+  }
+  fclose (f);
+  if (rename (tmp, name) < 0) {
+    *error = g_strdup_printf ("could not rename %s! (%i)", tmp, errno);
+    unlink (tmp);
+    goto out;
+  }
+  if (!sync_dir_of (name)) {
+    *error = g_strdup_printf ("could not sync the directory of %s! (%i)",
+        name, errno);
+    goto out;
+  }
+  GST_INFO ("%s: %s %s", name, checksum_type_name (c->type), digest);
+  ret = TRUE;
+out:
+  g_free (tmp);
+  g_free (name);
+  return ret;
+}
+
+void
+manifest_remove (const gchar * filename)
+{
+  gchar *name = g_strconcat (filename, MANIFEST_SUFFIX, NULL);
+
+  unlink (name);
+  g_free (name);
+}
+
+/* reads the manifest of the result filename */
+Manifest *
+manifest_read (const gchar * filename, gchar ** error)
+{
+  gchar *name = g_strconcat (filename, MANIFEST_SUFFIX, NULL);
+  Manifest *m = g_new0 (Manifest, 1);
+  gchar line[256], type[16], digest[80];
+  guint n_units = 0, i;
+  FILE *f;
+
+  f = fopen (name, "r");
+  if (!f) {
+    *error = g_strdup_printf ("could not open %s for reading! (%i)", name,
+        errno);
+    goto fail;
+  }
+  if (!fgets (line, sizeof (line), f)
+      || strncmp (line, MANIFEST_MAGIC, strlen (MANIFEST_MAGIC))
+      || !fgets (line, sizeof (line), f)
+      || sscanf (line, "size %" G_GUINT64_FORMAT, &m->size) != 1
+      || !fgets (line, sizeof (line), f)
+      || sscanf (line, "%15s %79s", type, digest) != 2
+      || (m->type = checksum_type_from_name (type)) == CHECKSUM_NONE)
+    goto broken;
+  m->digest = g_strdup (digest);
+  if (fgets (line, sizeof (line), f)) {
+    if (sscanf (line, "units %u", &n_units) != 1)
+      goto broken;
+    m->units = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_units);
+    for (i = 0; i < n_units; i++) {
+      guint32 crc;
+      if (!fgets (line, sizeof (line), f) || sscanf (line, "%x", &crc) != 1)
+        goto broken;
+      g_array_append_val (m->units, crc);
+    }
+  }
+  fclose (f);
+  g_free (name);
+  return m;
+
+broken:
+  *error = g_strdup_printf ("%s is not a valid manifest!", name);
+  fclose (f);
+fail:
+  g_free (name);
+  manifest_free (m);
+  return NULL;
+}
+
+void
+manifest_free (Manifest * m)
+{
+  if (m->units)
+    g_array_free (m->units, TRUE);
+  g_free (m->digest);
+  g_free (m);
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_CHECKSUM_H__
+#define __BDREMUX_CHECKSUM_H__
+
+#include "common.h"
+#include "tspacket.h"
+
+/* the manifest is written next to the result under this name */
+#define MANIFEST_SUFFIX ".manifest"
+#define MANIFEST_MAGIC "BDREMUX-MANIFEST 1"
+#define CHECKSUM_UNIT_SIZE M2TS_ALIGNED_UNIT_SIZE
+
+typedef enum
+{
+  CHECKSUM_NONE,
+  CHECKSUM_XXH64,
+  CHECKSUM_CRC32C,
+  CHECKSUM_SHA256
+} ChecksumType;
+
+/* hashes a stream handed over in pieces of any size, and optionally takes
+ * a CRC32C of every aligned unit on the way, so a damaged archive copy can
+ * be narrowed down to the units that changed */
+typedef struct _Checksum
+{
+  ChecksumType type;
+  guint64 size;
+  guint32 crc;
+  GChecksum *sha256;
+  guint64 xxh[4];
+  guint8 xxh_buf[32];
+  guint xxh_fill;
+  gchar *digest;                /* once finished */
+  GArray *units;                /* of guint32, NULL without unit CRCs */
+  guint32 unit_crc;
+  gsize unit_fill;
+} Checksum;
+
+/* what a manifest says about a result */
+typedef struct _Manifest
+{
+  ChecksumType type;
+  guint64 size;
+  gchar *digest;
+  GArray *units;                /* of guint32, NULL if none were taken */
+} Manifest;
+
+const gchar *checksum_type_name (ChecksumType type);
+ChecksumType checksum_type_from_name (const gchar * name);
+
+Checksum *checksum_new (ChecksumType type, gboolean unit_crcs);
+void checksum_update (Checksum * c, const guint8 * data, gsize len);
+/* the hex digest of everything so far, nothing can be added afterwards */
+const gchar *checksum_finish (Checksum * c);
+void checksum_free (Checksum * c);
+
+guint32 crc32c_update (guint32 crc, const guint8 * data, gsize len);
+
+/* the manifest of a result is found by the result's file name */
+gboolean manifest_write (const gchar * filename, Checksum * c,
+    gchar ** error);
+void manifest_remove (const gchar * filename);
+Manifest *manifest_read (const gchar * filename, gchar ** error);
+void manifest_free (Manifest * m);
+
+#endif /* __BDREMUX_CHECKSUM_H__ */
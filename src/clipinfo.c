@@ -0,0 +1,643 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "clipinfo.h"
+#include "tspsi.h"
+
+/* TS_recording_rate is announced as the BD-ROM maximum of 48 Mbit/s */
+#define CLIP_TS_RECORDING_RATE (48000000 / 8)
+#define CLIP_CHAPTER_INTERVAL (5 * 60 * 45000)
+/* number_of_PlayList_marks allows up to 999 */
+#define CLIP_MAX_MARKS 999
+#define CLIP_PTS_WRAP (G_GINT64_CONSTANT (1) << 33)
+
+#define VIDEO_FORMAT_480I 1
+#define VIDEO_FORMAT_576I 2
+#define VIDEO_FORMAT_480P 3
+#define VIDEO_FORMAT_1080I 4
+#define VIDEO_FORMAT_720P 5
+#define VIDEO_FORMAT_1080P 6
+#define VIDEO_FORMAT_576P 7
+
+#define AUDIO_FORMAT_MONO 1
+#define AUDIO_FORMAT_STEREO 3
+#define AUDIO_FORMAT_MULTI 6
+
+#define AUDIO_RATE_48K 1
+#define AUDIO_RATE_96K 4
+#define AUDIO_RATE_192K 5
+
+typedef struct _EpCoarse
+{
+  guint32 ref_fine_id;
+  guint32 pts;
+  guint32 spn;
+} EpCoarse;
+
+typedef struct _ByteWriter
+{
+  guint8 *data;
+  gsize len, size;
+} ByteWriter;
+
+static guint8 *
+bw_reserve (ByteWriter * bw, gsize n)
+{
+  guint8 *p;
+
+  if (bw->len + n > bw->size) {
+    bw->size = MAX (bw->size * 2, bw->len + n + 1024);
+    bw->data = g_realloc (bw->data, bw->size);
+  }
+  p = bw->data + bw->len;
+  memset (p, 0, n);
+  bw->len += n;
+  return p;
+}
+
+static void
+bw_put8 (ByteWriter * bw, guint8 val)
+{
+  *bw_reserve (bw, 1) = val;
+}
+
+static void
+bw_put16 (ByteWriter * bw, guint16 val)
+{
+  guint8 *p = bw_reserve (bw, 2);
+  p[0] = val >> 8;
+  p[1] = val;
+}
+
+static void
+bw_put32 (ByteWriter * bw, guint32 val)
+{
+  guint8 *p = bw_reserve (bw, 4);
+  p[0] = val >> 24;
+  p[1] = val >> 16;
+  p[2] = val >> 8;
+  p[3] = val;
+}
+
+static void
+bw_put_bytes (ByteWriter * bw, const void *data, gsize n)
+{
+  memcpy (bw_reserve (bw, n), data, n);
+}
+
+static void
+bw_patch32 (ByteWriter * bw, gsize pos, guint32 val)
+{
+  bw->data[pos] = val >> 24;
+  bw->data[pos + 1] = val >> 16;
+  bw->data[pos + 2] = val >> 8;
+  bw->data[pos + 3] = val;
+}
+
+/* patches a 32 bit length field at pos with the size of what follows it */
+static void
+bw_patch_length (ByteWriter * bw, gsize pos)
+{
+  bw_patch32 (bw, pos, bw->len - pos - 4);
+}
+
+static gboolean
+bw_write_file (ByteWriter * bw, const gchar * filename)
+{
+  FILE *f = fopen (filename, "wb");
+  gboolean ret;
+
+  if (!f) {
+    GST_ERROR ("could not open %s for writing!", filename);
+    return FALSE;
+  }
+  ret = fwrite (bw->data, bw->len, 1, f) == 1;
+  if (fclose (f) != 0)
+    ret = FALSE;
+  return ret;
+}
+
+ClipInfo *
+clip_info_new (void)
+{
+  ClipInfo *ci = g_new0 (ClipInfo, 1);
+
+  ci->ep_coarse = g_array_new (FALSE, FALSE, sizeof (EpCoarse));
+  ci->ep_fine = g_array_new (FALSE, FALSE, sizeof (guint32));
+  ci->stc[0].first_pts = ci->stc[0].last_pts = -1;
+  ci->n_stc = 1;
+  ci->pmt_pid = 0x0100;
+  ci->pcr_pid = 0x1001;
+  return ci;
+}
+
+void
+clip_info_free (ClipInfo * ci)
+{
+  g_array_free (ci->ep_coarse, TRUE);
+  g_array_free (ci->ep_fine, TRUE);
+  g_free (ci);
+}
+
+static ClipStream *
+find_stream (ClipInfo * ci, guint16 pid)
+{
+  guint i;
+
+  for (i = 0; i < ci->n_streams; i++)
+    if (ci->streams[i].pid == pid)
+      return &ci->streams[i];
+  return NULL;
+}
+
+ClipStream *
+clip_info_add_stream (ClipInfo * ci, guint16 pid, TsCodec codec,
+    guint8 stream_type, const gchar * lang)
+{
+  ClipStream *cs = find_stream (ci, pid);
+
+  if (!cs) {
+    if (ci->n_streams == MAX_PIDS)
+      return NULL;
+    cs = &ci->streams[ci->n_streams++];
+  }
+  memset (cs, 0, sizeof (ClipStream));
+  cs->pid = pid;
+  cs->coding_type = ts_codec_bd_stream_type (codec, stream_type);
+  if (TS_CODEC_IS_VIDEO (codec)) {
+    /* until the real attributes are known */
+    cs->format = VIDEO_FORMAT_1080I;
+    cs->rate = 3;
+    cs->aspect = 3;
+  } else {
+    cs->format = AUDIO_FORMAT_STEREO;
+    cs->rate = AUDIO_RATE_48K;
+    strncpy (cs->lang, lang ? lang : "und", 3);
+  }
+  return cs;
+}
+
+void
+clip_info_set_video (ClipInfo * ci, guint16 pid, const EsVideoInfo * info)
+{
+  ClipStream *cs = find_stream (ci, pid);
+  gdouble fps, dar;
+
+  if (!cs || !info->height)
+    return;
+
+  if (info->height <= 480)
+    cs->format = info->interlaced ? VIDEO_FORMAT_480I : VIDEO_FORMAT_480P;
+  else if (info->height <= 576)
+    cs->format = info->interlaced ? VIDEO_FORMAT_576I : VIDEO_FORMAT_576P;
+  else if (info->height <= 720)
+    cs->format = VIDEO_FORMAT_720P;
+  else
+    cs->format = info->interlaced ? VIDEO_FORMAT_1080I : VIDEO_FORMAT_1080P;
+
+  if (info->fps_n && info->fps_d) {
+    fps = (gdouble) info->fps_n / info->fps_d;
+    if (fps < 23.99)
+      cs->rate = 1;
+    else if (fps < 24.5)
+      cs->rate = 2;
+    else if (fps < 26)
+      cs->rate = 3;
+    else if (fps < 31)
+      cs->rate = 4;
+    else if (fps < 51)
+      cs->rate = 6;
+    else
+      cs->rate = 7;
+  }
+
+  dar = (gdouble) info->width * MAX (info->par_n, 1)
+      / ((gdouble) info->height * MAX (info->par_d, 1));
+  cs->aspect = dar >= 1.5 ? 3 : 2;
+
+  GST_DEBUG ("clip stream 0x%04x: video_format %i frame_rate %i aspect %i",
+      pid, cs->format, cs->rate, cs->aspect);
+}
+
+void
+clip_info_set_audio (ClipInfo * ci, guint16 pid, const EsAudioInfo * info)
+{
+  ClipStream *cs = find_stream (ci, pid);
+
+  if (!cs)
+    return;
+
+  if (info->channels == 1)
+    cs->format = AUDIO_FORMAT_MONO;
+  else if (info->channels == 2)
+    cs->format = AUDIO_FORMAT_STEREO;
+  else if (info->channels > 2)
+    cs->format = AUDIO_FORMAT_MULTI;
+
+  if (info->rate == 96000)
+    cs->rate = AUDIO_RATE_96K;
+  else if (info->rate == 192000)
+    cs->rate = AUDIO_RATE_192K;
+  else
+    cs->rate = AUDIO_RATE_48K;
+}
+
+/* picks up the video format or the audio parameters from the payload of a
+ * transport packet starting a PES packet, TRUE once they are known */
+gboolean
+clip_info_sniff_pes (ClipInfo * ci, guint16 pid, TsCodec codec,
+    const guint8 * payload, guint len)
+{
+  const guint8 *es;
+  guint es_len;
+
+  if (!(es = ts_pes_payload (payload, len, &es_len)))
+    return FALSE;
+  if (TS_CODEC_IS_VIDEO (codec)) {
+    EsVideoInfo info;
+    if (!es_parse_video_info (codec, es, es_len, &info))
+      return FALSE;
+    clip_info_set_video (ci, pid, &info);
+  } else {
+    EsAudioInfo info;
+    if (!es_parse_audio_info (codec, es, es_len, &info))
+      return FALSE;
+    clip_info_set_audio (ci, pid, &info);
+  }
+  return TRUE;
+}
+
+/* splits an entry point into the coarse/fine representation of the EP map,
+ * a new coarse entry starts whenever the upper PTS or SPN bits change */
+void
+clip_info_add_entry (ClipInfo * ci, guint64 spn, gint64 pts)
+{
+  guint32 fine;
+
+  pts &= (G_GINT64_CONSTANT (1) << 33) - 1;
+  if (ci->ep_coarse->len == 0
+      || g_array_index (ci->ep_coarse, EpCoarse,
+          ci->ep_coarse->len - 1).pts != ((pts >> 19) & 0x3FFF)
+      || (g_array_index (ci->ep_coarse, EpCoarse,
+              ci->ep_coarse->len - 1).spn & ~0x1FFFF) != (spn & ~0x1FFFF)) {
+    EpCoarse coarse;
+    coarse.ref_fine_id = ci->ep_fine->len;
+    coarse.pts = (pts >> 19) & 0x3FFF;
+    coarse.spn = spn;
+    g_array_append_val (ci->ep_coarse, coarse);
+  }
+
+  /* the I picture size isn't known here, announce the smallest class */
+  fine = (1 << 28) | (((pts >> 9) & 0x7FF) << 17) | (spn & 0x1FFFF);
+  g_array_append_val (ci->ep_fine, fine);
+  ci->n_entries++;
+
+  clip_info_update_pts (ci, pts);
+}
+
+/* takes PTS as they come from the stream or as unwrapped before, each is
+ * placed within half a wrap of the first one of its sequence */
+void
+clip_info_update_pts (ClipInfo * ci, gint64 pts)
+{
+  ClipStcSequence *seq = &ci->stc[ci->n_stc - 1];
+  gint64 delta;
+
+  if (pts < 0)
+    return;
+  if (seq->first_pts == -1) {
+    ci->pts_base = (pts & (CLIP_PTS_WRAP - 1)) + CLIP_PTS_WRAP;
+    seq->first_pts = seq->last_pts = ci->pts_base;
+    return;
+  }
+  delta = (pts - ci->pts_base) & (CLIP_PTS_WRAP - 1);
+  if (delta >= CLIP_PTS_WRAP / 2)
+    delta -= CLIP_PTS_WRAP;
+  pts = ci->pts_base + delta;
+  if (pts < seq->first_pts)
+    seq->first_pts = pts;
+  if (pts > seq->last_pts)
+    seq->last_pts = pts;
+}
+
+/* the PTS from the packet at spn on are of another clock, unless nothing
+ * has been seen of the current one yet */
+void
+clip_info_add_discontinuity (ClipInfo * ci, guint64 spn)
+{
+  ClipStcSequence *seq = &ci->stc[ci->n_stc - 1];
+
+  if (seq->first_pts != -1) {
+    if (ci->n_stc == CLIP_MAX_STC_SEQUENCES) {
+      GST_WARNING ("too many STC sequences, the last one goes on past SPN %"
+          G_GUINT64_FORMAT, spn);
+      return;
+    }
+    seq = &ci->stc[ci->n_stc++];
+  }
+  seq->spn = spn;
+  seq->first_pts = seq->last_pts = -1;
+}
+
+/* the presentation times of a sequence in 45 kHz, which wrap with the PTS.
+ * FALSE for a sequence without any, unless it is the only one */
+static gboolean
+stc_times (ClipInfo * ci, guint i, guint32 * start, guint32 * end)
+{
+  const ClipStcSequence *seq = &ci->stc[i];
+
+  if (seq->first_pts == -1) {
+    *start = *end = 0;
+    return ci->n_stc == 1;
+  }
+  *start = (seq->first_pts & (CLIP_PTS_WRAP - 1)) >> 1;
+  *end = (seq->last_pts & (CLIP_PTS_WRAP - 1)) >> 1;
+  return TRUE;
+}
+
+static void
+write_coding_info (ByteWriter * bw, const ClipStream * cs)
+{
+  gsize start;
+
+  /* StreamCodingInfo is padded to a fixed length of 21 bytes */
+  bw_put8 (bw, 21);
+  start = bw->len;
+  bw_put8 (bw, cs->coding_type);
+  bw_put8 (bw, (cs->format << 4) | (cs->rate & 0x0F));
+  if (cs->coding_type == 0x01 || cs->coding_type == 0x02
+      || cs->coding_type == 0x1B || cs->coding_type == 0xEA)
+    bw_put8 (bw, cs->aspect << 4);
+  else
+    bw_put_bytes (bw, cs->lang, 3);
+  bw_reserve (bw, 21 - (bw->len - start));
+}
+
+gboolean
+clip_info_write_clpi (ClipInfo * ci, const gchar * filename)
+{
+  ByteWriter bw = { NULL, 0, 0 };
+  gsize pos, ep_map_start, stream_start;
+  guint i, n;
+  guint32 start_time, end_time;
+  gboolean ret;
+
+  bw_put_bytes (&bw, "HDMV0200", 8);
+  bw_reserve (&bw, 5 * 4 + 12);
+
+  /* ClipInfo */
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put16 (&bw, 0);
+  bw_put8 (&bw, 1);             /* clip_stream_type: AV stream */
+  bw_put8 (&bw, 1);             /* application_type: main TS for a movie */
+  bw_put32 (&bw, 0);            /* is_ATC_delta */
+  bw_put32 (&bw, CLIP_TS_RECORDING_RATE);
+  bw_put32 (&bw, ci->n_packets);
+  bw_reserve (&bw, 128);
+  bw_put16 (&bw, 30);           /* TS_type_info_block */
+  bw_put8 (&bw, 0x80);
+  bw_put_bytes (&bw, "HDMV", 4);
+  bw_reserve (&bw, 25);
+  bw_patch_length (&bw, pos);
+
+  /* SequenceInfo: one ATC sequence, an STC sequence per cut */
+  bw_patch32 (&bw, 8, bw.len);
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put8 (&bw, 0);
+  bw_put8 (&bw, 1);
+  bw_put32 (&bw, 0);            /* SPN_ATC_start */
+  bw_put8 (&bw, 0);             /* number_of_STC_sequences */
+  bw_put8 (&bw, 0);             /* offset_STC_id */
+  for (i = 0, n = 0; i < ci->n_stc; i++) {
+    if (!stc_times (ci, i, &start_time, &end_time))
+      continue;
+    bw_put16 (&bw, ci->pcr_pid);
+    bw_put32 (&bw, ci->stc[i].spn);     /* SPN_STC_start */
+    bw_put32 (&bw, start_time);
+    bw_put32 (&bw, end_time);
+    n++;
+  }
+  bw.data[pos + 10] = n;
+  bw_patch_length (&bw, pos);
+
+  /* ProgramInfo */
+  bw_patch32 (&bw, 12, bw.len);
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put8 (&bw, 0);
+  bw_put8 (&bw, 1);
+  bw_put32 (&bw, 0);            /* SPN_program_sequence_start */
+  bw_put16 (&bw, ci->pmt_pid);
+  bw_put8 (&bw, ci->n_streams);
+  bw_put8 (&bw, 0);
+  for (i = 0; i < ci->n_streams; i++) {
+    bw_put16 (&bw, ci->streams[i].pid);
+    write_coding_info (&bw, &ci->streams[i]);
+  }
+  bw_patch_length (&bw, pos);
+
+  /* CPI with the EP map of the video stream */
+  bw_patch32 (&bw, 16, bw.len);
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  if (ci->n_streams && ci->n_entries) {
+    guint64 header;
+    gsize fine_start_pos;
+
+    bw_put16 (&bw, 1);          /* CPI_type: EP_map */
+    ep_map_start = bw.len;
+    bw_put8 (&bw, 0);
+    bw_put8 (&bw, 1);           /* number_of_stream_PID_entries */
+    bw_put16 (&bw, ci->streams[0].pid);
+    header = ((guint64) 1 << 34) | ((guint64) ci->ep_coarse->len << 18)
+        | (ci->ep_fine->len & 0x3FFFF);
+    bw_put16 (&bw, header >> 32);
+    bw_put32 (&bw, header);
+    bw_put32 (&bw, 0);
+    bw_patch32 (&bw, bw.len - 4, bw.len - ep_map_start);
+
+    stream_start = bw.len;
+    fine_start_pos = bw.len;
+    bw_put32 (&bw, 0);
+    for (i = 0; i < ci->ep_coarse->len; i++) {
+      EpCoarse *c = &g_array_index (ci->ep_coarse, EpCoarse, i);
+      bw_put32 (&bw, (c->ref_fine_id << 14) | c->pts);
+      bw_put32 (&bw, c->spn);
+    }
+    bw_patch32 (&bw, fine_start_pos, bw.len - stream_start);
+    for (i = 0; i < ci->ep_fine->len; i++)
+      bw_put32 (&bw, g_array_index (ci->ep_fine, guint32, i));
+    bw_patch_length (&bw, pos);
+  }
+
+  /* empty ClipMark */
+  bw_patch32 (&bw, 20, bw.len);
+  bw_put32 (&bw, 0);
+
+  ret = bw_write_file (&bw, filename);
+  GST_INFO ("wrote clip info %s: %u streams, %" G_GUINT64_FORMAT
+      " EP entries (%u coarse), %" G_GUINT64_FORMAT " source packets",
+      filename, ci->n_streams, ci->n_entries, ci->ep_coarse->len,
+      ci->n_packets);
+  g_free (bw.data);
+  return ret;
+}
+
+static void
+write_stn_stream (ByteWriter * bw, const ClipStream * cs, gboolean video)
+{
+  bw_put8 (bw, 9);              /* stream_entry */
+  bw_put8 (bw, 1);              /* stream of the main clip */
+  bw_put16 (bw, cs->pid);
+  bw_reserve (bw, 6);
+  bw_put8 (bw, 5);              /* stream_attributes */
+  bw_put8 (bw, cs->coding_type);
+  bw_put8 (bw, (cs->format << 4) | (cs->rate & 0x0F));
+  if (video)
+    bw_reserve (bw, 3);
+  else
+    bw_put_bytes (bw, cs->lang, 3);
+}
+
+/* a PlayItem playing one STC sequence of the clip */
+static void
+write_play_item (ByteWriter * bw, ClipInfo * ci, const gchar * name,
+    guint stc_id, guint32 in_time, guint32 out_time)
+{
+  gsize item_pos, stn_pos;
+  guint i, n_video = 0, n_audio = 0;
+
+  item_pos = bw->len;
+  bw_put16 (bw, 0);
+  bw_put_bytes (bw, name, 5);
+  bw_put_bytes (bw, "M2TS", 4);
+  bw_put16 (bw, 1);             /* connection_condition */
+  bw_put8 (bw, stc_id);         /* ref_to_STC_id */
+  bw_put32 (bw, in_time);
+  bw_put32 (bw, out_time);
+  bw_reserve (bw, 8);           /* UO_mask_table */
+  bw_put8 (bw, 0);
+  bw_put8 (bw, 0);              /* still_mode */
+  bw_put16 (bw, 0);
+
+  for (i = 0; i < ci->n_streams; i++) {
+    if (i == 0)
+      n_video++;
+    else
+      n_audio++;
+  }
+  stn_pos = bw->len;
+  bw_put16 (bw, 0);
+  bw_put16 (bw, 0);
+  bw_put8 (bw, n_video);
+  bw_put8 (bw, n_audio);
+  bw_reserve (bw, 5 + 5);       /* PG, IG, secondary audio/video, PiP PG */
+  for (i = 0; i < ci->n_streams; i++)
+    write_stn_stream (bw, &ci->streams[i], i == 0);
+  bw->data[stn_pos] = (bw->len - stn_pos - 2) >> 8;
+  bw->data[stn_pos + 1] = (bw->len - stn_pos - 2) & 0xFF;
+  bw->data[item_pos] = (bw->len - item_pos - 2) >> 8;
+  bw->data[item_pos + 1] = (bw->len - item_pos - 2) & 0xFF;
+}
+
+gboolean
+clip_info_write_mpls (ClipInfo * ci, const gchar * filename,
+    const gchar * clip_name)
+{
+  ByteWriter bw = { NULL, 0, 0 };
+  gsize pos;
+  guint32 in_time[CLIP_MAX_STC_SEQUENCES], out_time[CLIP_MAX_STC_SEQUENCES];
+  guint i, n_items = 0, n_marks = 0;
+  gchar name[6];
+  gboolean ret;
+
+  /* a PlayItem for every STC sequence written to the clip information,
+   * their STC ids count those */
+  for (i = 0; i < ci->n_stc; i++)
+    if (stc_times (ci, i, &in_time[n_items], &out_time[n_items]))
+      n_items++;
+
+  /* clip_Information_file_name is always five characters */
+  memset (name, '0', 5);
+  name[5] = '\0';
+  for (i = 0; i < 5 && clip_name[i] && clip_name[i] != '.'; i++)
+    name[i] = clip_name[i];
+
+  bw_put_bytes (&bw, "MPLS0200", 8);
+  bw_reserve (&bw, 3 * 4 + 20);
+
+  /* AppInfoPlayList */
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put8 (&bw, 0);
+  bw_put8 (&bw, 1);             /* sequential playback */
+  bw_put16 (&bw, 0);
+  bw_reserve (&bw, 8);          /* UO_mask_table */
+  bw_put16 (&bw, 0x4000);       /* audio_mix_app_flag */
+  bw_patch_length (&bw, pos);
+
+  /* PlayList */
+  bw_patch32 (&bw, 8, bw.len);
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put16 (&bw, 0);
+  bw_put16 (&bw, n_items);
+  bw_put16 (&bw, 0);
+  for (i = 0; i < n_items; i++)
+    write_play_item (&bw, ci, name, i, in_time[i], out_time[i]);
+  bw_patch_length (&bw, pos);
+
+  /* PlayListMark with a chapter at the start of every PlayItem and every
+   * five minutes within it */
+  bw_patch32 (&bw, 12, bw.len);
+  pos = bw.len;
+  bw_put32 (&bw, 0);
+  bw_put16 (&bw, 0);
+  for (i = 0; i < n_items; i++) {
+    guint32 duration = out_time[i] - in_time[i];
+    guint64 t = 0;
+
+    do {
+      if (n_marks == CLIP_MAX_MARKS)
+        break;
+      bw_put8 (&bw, 0);
+      bw_put8 (&bw, 1);         /* entry mark */
+      bw_put16 (&bw, i);        /* ref_to_PlayItem_id */
+      bw_put32 (&bw, in_time[i] + t);
+      bw_put16 (&bw, 0xFFFF);
+      bw_put32 (&bw, 0);
+      n_marks++;
+      t += CLIP_CHAPTER_INTERVAL;
+    } while (t < duration);
+  }
+  bw.data[pos + 4] = n_marks >> 8;
+  bw.data[pos + 5] = n_marks & 0xFF;
+  bw_patch_length (&bw, pos);
+
+  ret = bw_write_file (&bw, filename);
+  GST_INFO ("wrote playlist %s for clip %s with %u items and %u marks",
+      filename, name, n_items, n_marks);
+  g_free (bw.data);
+  return ret;
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_CLIPINFO_H__
+#define __BDREMUX_CLIPINFO_H__
+
+#include "common.h"
+#include "esinfo.h"
+
+/* attributes of one elementary stream as needed for ProgramInfo and the
+ * playlist STN table, coded the way BD-ROM part 3 expects them */
+typedef struct _ClipStream
+{
+  guint16 pid;
+  guint8 coding_type;
+  guint8 format;                /* video_format or audio presentation_type */
+  guint8 rate;                  /* frame_rate or sampling_frequency */
+  guint8 aspect;
+  gchar lang[4];
+} ClipStream;
+
+/* BD-ROM numbers the STC sequences of a clip with 8 bits */
+#define CLIP_MAX_STC_SEQUENCES 255
+
+/* a part of the clip with a continuous system time clock, a new one starts
+ * at every cut. the PTS are unwrapped around the first one seen, one wrap
+ * above it so they are never negative, -1 until there is one */
+typedef struct _ClipStcSequence
+{
+  guint64 spn;                  /* SPN_STC_start */
+  gint64 first_pts, last_pts;
+} ClipStcSequence;
+
+/* collects everything that goes into the clip information file while the
+ * remux runs. the EP map is kept in its packed on-disc form, 4 bytes per
+ * fine entry and 8 bytes per coarse entry */
+typedef struct _ClipInfo
+{
+  guint16 pcr_pid;
+  guint16 pmt_pid;
+  ClipStream streams[MAX_PIDS];
+  guint n_streams;
+
+  GArray *ep_coarse;
+  GArray *ep_fine;
+  guint64 n_entries;
+
+  ClipStcSequence stc[CLIP_MAX_STC_SEQUENCES];
+  guint n_stc;
+  gint64 pts_base;              /* the first PTS of the last sequence */
+  guint64 n_packets;
+} ClipInfo;
+
+ClipInfo *clip_info_new (void);
+void clip_info_free (ClipInfo * ci);
+
+ClipStream *clip_info_add_stream (ClipInfo * ci, guint16 pid, TsCodec codec,
+    guint8 stream_type, const gchar * lang);
+void clip_info_set_video (ClipInfo * ci, guint16 pid, const EsVideoInfo * info);
+void clip_info_set_audio (ClipInfo * ci, guint16 pid, const EsAudioInfo * info);
+gboolean clip_info_sniff_pes (ClipInfo * ci, guint16 pid, TsCodec codec,
+    const guint8 * payload, guint len);
+
+void clip_info_add_entry (ClipInfo * ci, guint64 spn, gint64 pts);
+void clip_info_update_pts (ClipInfo * ci, gint64 pts);
+void clip_info_add_discontinuity (ClipInfo * ci, guint64 spn);
+
+gboolean clip_info_write_clpi (ClipInfo * ci, const gchar * filename);
+gboolean clip_info_write_mpls (ClipInfo * ci, const gchar * filename,
+    const gchar * clip_name);
+
+#endif /* __BDREMUX_CLIPINFO_H__ */
@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_COMMON_H__
+#define __BDREMUX_COMMON_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#include "bdremux.h"
+
+#define MAX_PIDS BDREMUX_MAX_PIDS
+
+#define CLOCK_BASE 9LL
+#define CLOCK_FREQ (CLOCK_BASE * 10000)
+
+#define MPEGTIME_TO_GSTTIME(time) (gst_util_uint64_scale ((time), \
+            GST_MSECOND/10, CLOCK_BASE))
+#define GSTTIME_TO_MPEGTIME(time) (gst_util_uint64_scale ((time), \
+            CLOCK_BASE, GST_MSECOND/10))
+
+/* "-" stands for stdin or stdout and "fd:N" for an inherited descriptor.
+ * such streams can't be opened again by name */
+#define FD_PATH_PREFIX "fd:"
+#define IS_FD_PATH(path) (strcmp ((path), "-") == 0 \
+            || g_str_has_prefix ((path), FD_PATH_PREFIX))
+
+/* a descriptor of our own for an fd path, the caller keeps its copy */
+static inline int
+fd_path_dup (const gchar * path, int std_fd)
+{
+  if (strcmp (path, "-") == 0)
+    return dup (std_fd);
+  return dup (atoi (path + strlen (FD_PATH_PREFIX)));
+}
+
+/* GLib 2.32 embeds mutexes and conditions in their owner, older versions
+ * allocate them. the macros take the member the same way for both */
+#if GLIB_CHECK_VERSION(2,32,0)
+typedef GMutex CompatMutex;
+typedef GCond CompatCond;
+#define MUTEX_INIT(m) g_mutex_init (&(m))
+#define MUTEX_CLEAR(m) g_mutex_clear (&(m))
+#define MUTEX_LOCK(m) g_mutex_lock (&(m))
+#define MUTEX_UNLOCK(m) g_mutex_unlock (&(m))
+#define COND_INIT(c) g_cond_init (&(c))
+#define COND_CLEAR(c) g_cond_clear (&(c))
+#define COND_WAIT(c, m) g_cond_wait (&(c), &(m))
+#define COND_SIGNAL(c) g_cond_signal (&(c))
+#define COND_BROADCAST(c) g_cond_broadcast (&(c))
+#else
+typedef GMutex *CompatMutex;
+typedef GCond *CompatCond;
+#define MUTEX_INIT(m) ((m) = g_mutex_new ())
+#define MUTEX_CLEAR(m) g_mutex_free (m)
+#define MUTEX_LOCK(m) g_mutex_lock (m)
+#define MUTEX_UNLOCK(m) g_mutex_unlock (m)
+#define COND_INIT(c) ((c) = g_cond_new ())
+#define COND_CLEAR(c) g_cond_free (c)
+#define COND_WAIT(c, m) g_cond_wait ((c), (m))
+#define COND_SIGNAL(c) g_cond_signal (c)
+#define COND_BROADCAST(c) g_cond_broadcast (c)
+#endif
+
+GST_DEBUG_CATEGORY_EXTERN (bdremux_debug);
+#define GST_CAT_DEFAULT bdremux_debug
+
+#endif /* __BDREMUX_COMMON_H__ */
@@ -0,0 +1,117 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+#include <glib/gprintf.h>
+
+#include "common.h"
+#include "epmap.h"
+
+/* longest text line is "entrypoint: <20 digits> <20 digits>\n" */
+#define EPMAP_TEXT_LINE_MAX 64
+
+EpMapWriter *
+epmap_writer_new (FILE * f, EpMapFormat format)
+{
+  EpMapWriter *w = g_new0 (EpMapWriter, 1);
+
+  w->f = f;
+  w->format = format;
+  if (format == EPMAP_FORMAT_BINARY
+      && fwrite (EPMAP_BINARY_MAGIC, 8, 1, f) != 1)
+    w->failed = TRUE;
+  return w;
+}
+
+void
+epmap_writer_add (EpMapWriter * w, guint64 spn, gint64 pts)
+{
+  w->window[w->n_window].spn = spn;
+  w->window[w->n_window].pts = pts;
+  w->n_window++;
+  w->n_entries++;
+  if (w->n_window == EPMAP_WINDOW_ENTRIES)
+    epmap_writer_flush (w);
+}
+
+/* writes the window with a single fwrite, the file is only flushed by
+ * epmap_writer_finish() */
+gboolean
+epmap_writer_flush (EpMapWriter * w)
+{
+  gchar *buf, *p;
+  guint i;
+
+  if (w->n_window == 0)
+    return !w->failed;
+
+  p = buf = g_malloc (w->n_window * EPMAP_TEXT_LINE_MAX);
+  for (i = 0; i < w->n_window; i++) {
+    const EpMapEntry *e = &w->window[i];
+    if (w->format == EPMAP_FORMAT_TEXT) {
+      p += g_sprintf (p, "entrypoint: %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT
+          "\n", e->spn, e->pts);
+    } else {
+      guint32 spn = GUINT32_TO_BE ((guint32) e->spn);
+      guint64 pts = GUINT64_TO_BE ((guint64) e->pts);
+      memcpy (p, &spn, 4);
+      memcpy (p + 4, &pts, 8);
+      p += EPMAP_BINARY_RECORD_SIZE;
+    }
+  }
+  if (fwrite (buf, p - buf, 1, w->f) != 1) {
+    GST_ERROR ("writing %i entry points failed", w->n_window);
+    w->failed = TRUE;
+  }
+  g_free (buf);
+
+  GST_LOG ("wrote %i entry points (%" G_GUINT64_FORMAT " total)", w->n_window,
+      w->n_entries);
+  w->n_window = 0;
+  return !w->failed;
+}
+
+gboolean
+epmap_writer_finish (EpMapWriter * w)
+{
+  epmap_writer_flush (w);
+  if (fflush (w->f) != 0)
+    w->failed = TRUE;
+  GST_INFO ("entry point map finished with %" G_GUINT64_FORMAT " entries",
+      w->n_entries);
+  return !w->failed;
+}
+
+void
+epmap_writer_free (EpMapWriter * w)
+{
+  g_free (w);
+}
+
+gboolean
+epmap_parse_format (const gchar * string, EpMapFormat * format)
+{
+  if (!g_ascii_strcasecmp (string, "text"))
+    *format = EPMAP_FORMAT_TEXT;
+  else if (!g_ascii_strcasecmp (string, "binary"))
+    *format = EPMAP_FORMAT_BINARY;
+  else
+    return FALSE;
+  return TRUE;
+}
@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_EPMAP_H__
+#define __BDREMUX_EPMAP_H__
+
+#include <stdio.h>
+#include <glib.h>
+
+#define EPMAP_WINDOW_ENTRIES 512
+
+/* binary files start with this magic followed by 12 byte records of
+ * big endian 32 bit SPN and 64 bit PTS */
+#define EPMAP_BINARY_MAGIC "BDEPMAP1"
+#define EPMAP_BINARY_RECORD_SIZE 12
+
+typedef enum
+{
+  EPMAP_FORMAT_TEXT,
+  EPMAP_FORMAT_BINARY
+} EpMapFormat;
+
+typedef struct _EpMapEntry
+{
+  guint64 spn;
+  gint64 pts;
+} EpMapEntry;
+
+/* keeps at most EPMAP_WINDOW_ENTRIES entries in memory and writes them to
+ * the file in one go once the window is full. epmap_writer_finish() must be
+ * called on EOS, entries still in the window are lost otherwise */
+typedef struct _EpMapWriter
+{
+  FILE *f;
+  EpMapFormat format;
+  EpMapEntry window[EPMAP_WINDOW_ENTRIES];
+  guint n_window;
+  guint64 n_entries;
+  gboolean failed;
+} EpMapWriter;
+
+EpMapWriter *epmap_writer_new (FILE * f, EpMapFormat format);
+void epmap_writer_add (EpMapWriter * w, guint64 spn, gint64 pts);
+gboolean epmap_writer_flush (EpMapWriter * w);
+gboolean epmap_writer_finish (EpMapWriter * w);
+void epmap_writer_free (EpMapWriter * w);
+
+gboolean epmap_parse_format (const gchar * string, EpMapFormat * format);
+
+#endif /* __BDREMUX_EPMAP_H__ */
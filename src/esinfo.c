@@ -0,0 +1,461 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "common.h"
+#include "esinfo.h"
+#include "tsscan.h"
+
+#define SPS_MAX_SIZE 256
+
+typedef struct _BitReader
+{
+  const guint8 *data;
+  guint size;
+  guint pos;
+} BitReader;
+
+static guint32
+read_bits (BitReader * br, guint n)
+{
+  guint32 val = 0;
+
+  while (n--) {
+    val <<= 1;
+    if (br->pos < br->size * 8)
+      val |= (br->data[br->pos >> 3] >> (7 - (br->pos & 7))) & 1;
+    br->pos++;
+  }
+  return val;
+}
+
+static guint32
+read_ue (BitReader * br)
+{
+  guint zeros = 0;
+
+  /* more than 31 leading zeros don't fit, the stream is broken anyway */
+  while (read_bits (br, 1) == 0 && zeros < 31 && br->pos < br->size * 8)
+    zeros++;
+  return ((1 << zeros) - 1) + read_bits (br, zeros);
+}
+
+static gint32
+read_se (BitReader * br)
+{
+  guint32 val = read_ue (br);
+  return (val & 1) ? (gint32) ((val + 1) / 2) : -(gint32) (val / 2);
+}
+
+static void
+skip_scaling_list (BitReader * br, guint size)
+{
+  gint last = 8, next = 8;
+  guint i;
+
+  for (i = 0; i < size; i++) {
+    if (next != 0)
+      next = (last + read_se (br) + 256) % 256;
+    last = next ? next : last;
+  }
+}
+
+static const guint8 *
+find_start_code (const guint8 * data, guint len, guint8 code, guint8 mask)
+{
+  const guint8 *end = data + len, *sc = data;
+
+  while ((sc = ts_scan_start_code (sc, end - sc)) && sc + 4 <= end) {
+    if ((sc[3] & mask) == code)
+      return sc + 4;
+    sc += 3;
+  }
+  return NULL;
+}
+
+static gboolean
+parse_mpeg_video (const guint8 * data, guint len, EsVideoInfo * info)
+{
+  static const gint fps[][2] = { {0, 1}, {24000, 1001}, {24, 1}, {25, 1},
+  {30000, 1001}, {30, 1}, {50, 1}, {60000, 1001}, {60, 1}
+  };
+  const guint8 *seq, *ext;
+  guint aspect, frc;
+
+  seq = find_start_code (data, len, 0xB3, 0xFF);
+  if (!seq || seq + 4 > data + len)
+    return FALSE;
+
+  info->width = (seq[0] << 4) | (seq[1] >> 4);
+  info->height = ((seq[1] & 0x0F) << 8) | seq[2];
+  aspect = seq[3] >> 4;
+  frc = seq[3] & 0x0F;
+  if (frc == 0 || frc >= G_N_ELEMENTS (fps) || !info->width || !info->height)
+    return FALSE;
+  info->fps_n = fps[frc][0];
+  info->fps_d = fps[frc][1];
+
+  /* aspect_ratio_information is the display aspect ratio */
+  info->par_n = info->par_d = 1;
+  if (aspect == 2) {
+    info->par_n = 4 * info->height;
+    info->par_d = 3 * info->width;
+  } else if (aspect == 3) {
+    info->par_n = 16 * info->height;
+    info->par_d = 9 * info->width;
+  }
+
+  /* MPEG-1 has no sequence extension and is always progressive */
+  info->interlaced = FALSE;
+  ext = find_start_code (seq, data + len - seq, 0xB5, 0xFF);
+  if (ext && ext + 2 <= data + len && (ext[0] >> 4) == 1)
+    info->interlaced = !((ext[1] >> 3) & 1);
+  return TRUE;
+}
+
+static gboolean
+parse_h264_sps (const guint8 * data, guint len, EsVideoInfo * info)
+{
+  static const gint sar[][2] = { {1, 1}, {1, 1}, {12, 11}, {10, 11},
+  {16, 11}, {40, 33}, {24, 11}, {20, 11}, {32, 11}, {80, 33}, {18, 11},
+  {15, 11}, {64, 33}, {160, 99}, {4, 3}, {3, 2}, {2, 1}
+  };
+  guint8 rbsp[SPS_MAX_SIZE];
+  guint i, n = 0, zeros = 0;
+  guint profile_idc, poc_type, frame_mbs_only;
+  guint width_mbs, height_map_units;
+  guint crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+  BitReader br;
+
+  /* strip emulation prevention bytes */
+  for (i = 0; i < len && n < SPS_MAX_SIZE; i++) {
+    if (zeros >= 2 && data[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    if (zeros >= 2 && data[i] == 0x01)
+      break;                    /* next start code */
+    zeros = data[i] ? 0 : zeros + 1;
+    rbsp[n++] = data[i];
+  }
+  br.data = rbsp;
+  br.size = n;
+  br.pos = 0;
+
+  profile_idc = read_bits (&br, 8);
+  read_bits (&br, 16);          /* constraint flags, level_idc */
+  read_ue (&br);                /* seq_parameter_set_id */
+  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122
+      || profile_idc == 244 || profile_idc == 44 || profile_idc == 83
+      || profile_idc == 86 || profile_idc == 118 || profile_idc == 128) {
+    if (read_ue (&br) == 3)     /* chroma_format_idc */
+      read_bits (&br, 1);
+    read_ue (&br);              /* bit_depth_luma_minus8 */
+    read_ue (&br);              /* bit_depth_chroma_minus8 */
+    read_bits (&br, 1);
+    if (read_bits (&br, 1)) {   /* seq_scaling_matrix_present_flag */
+      for (i = 0; i < 8; i++)
+        if (read_bits (&br, 1))
+          skip_scaling_list (&br, i < 6 ? 16 : 64);
+    }
+  }
+  read_ue (&br);                /* log2_max_frame_num_minus4 */
+  poc_type = read_ue (&br);
+  if (poc_type == 0)
+    read_ue (&br);
+  else if (poc_type == 1) {
+    guint cycle;
+    read_bits (&br, 1);
+    read_se (&br);
+    read_se (&br);
+    cycle = read_ue (&br);
+    for (i = 0; i < cycle && i < 256; i++)
+      read_se (&br);
+  }
+  read_ue (&br);                /* max_num_ref_frames */
+  read_bits (&br, 1);
+  width_mbs = read_ue (&br) + 1;
+  height_map_units = read_ue (&br) + 1;
+  frame_mbs_only = read_bits (&br, 1);
+  if (!frame_mbs_only)
+    read_bits (&br, 1);
+  read_bits (&br, 1);           /* direct_8x8_inference_flag */
+  if (read_bits (&br, 1)) {
+    crop_left = read_ue (&br);
+    crop_right = read_ue (&br);
+    crop_top = read_ue (&br);
+    crop_bottom = read_ue (&br);
+  }
+
+  info->width = width_mbs * 16 - 2 * (crop_left + crop_right);
+  info->height = (2 - frame_mbs_only) * height_map_units * 16
+      - 2 * (2 - frame_mbs_only) * (crop_top + crop_bottom);
+  info->interlaced = !frame_mbs_only;
+  info->par_n = info->par_d = 1;
+  info->fps_n = 0;
+  info->fps_d = 1;
+
+  if (read_bits (&br, 1)) {     /* vui_parameters_present_flag */
+    if (read_bits (&br, 1)) {
+      guint idc = read_bits (&br, 8);
+      if (idc == 255) {
+        info->par_n = read_bits (&br, 16);
+        info->par_d = read_bits (&br, 16);
+      } else if (idc < G_N_ELEMENTS (sar)) {
+        info->par_n = sar[idc][0];
+        info->par_d = sar[idc][1];
+      }
+    }
+    if (read_bits (&br, 1))     /* overscan_info_present_flag */
+      read_bits (&br, 1);
+    if (read_bits (&br, 1)) {   /* video_signal_type_present_flag */
+      read_bits (&br, 4);
+      if (read_bits (&br, 1))
+        read_bits (&br, 24);
+    }
+    if (read_bits (&br, 1)) {   /* chroma_loc_info_present_flag */
+      read_ue (&br);
+      read_ue (&br);
+    }
+    if (read_bits (&br, 1)) {   /* timing_info_present_flag */
+      guint32 num_units_in_tick = read_bits (&br, 32);
+      guint32 time_scale = read_bits (&br, 32);
+      if (num_units_in_tick && time_scale) {
+        info->fps_n = time_scale;
+        info->fps_d = 2 * num_units_in_tick;
+      }
+    }
+  }
+  return info->width > 0 && info->height > 0 && br.pos <= br.size * 8;
+}
+
+gboolean
+es_parse_video_info (TsCodec codec, const guint8 * data, guint len,
+    EsVideoInfo * info)
+{
+  const guint8 *sps;
+
+  memset (info, 0, sizeof (EsVideoInfo));
+  switch (codec) {
+    case TS_CODEC_MPEG_VIDEO:
+      return parse_mpeg_video (data, len, info);
+    case TS_CODEC_H264:
+      sps = find_start_code (data, len, 0x07, 0x1F);
+      if (!sps)
+        return FALSE;
+      return parse_h264_sps (sps, data + len - sps, info);
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+parse_mpeg_audio (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint rates[] = { 44100, 48000, 32000 };
+  guint i;
+
+  for (i = 0; i + 4 <= len; i++) {
+    guint version, rate_index;
+    if (data[i] != 0xFF || (data[i + 1] & 0xE0) != 0xE0)
+      continue;
+    version = (data[i + 1] >> 3) & 0x03;
+    rate_index = (data[i + 2] >> 2) & 0x03;
+    if (version == 1 || rate_index == 3)
+      continue;
+    info->rate = rates[rate_index];
+    if (version == 2)
+      info->rate /= 2;
+    else if (version == 0)
+      info->rate /= 4;
+    info->channels = ((data[i + 3] >> 6) == 3) ? 1 : 2;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+parse_ac3 (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint rates[] = { 48000, 44100, 32000 };
+  static const gint channels[] = { 2, 1, 2, 3, 3, 4, 4, 5 };
+  guint i;
+
+  for (i = 0; i + 8 <= len; i++) {
+    BitReader br;
+    guint fscod, acmod;
+
+    if (data[i] != 0x0B || data[i + 1] != 0x77)
+      continue;
+    fscod = data[i + 4] >> 6;
+    if (fscod == 3)
+      continue;
+    br.data = data + i + 5;
+    br.size = 3;
+    br.pos = 8;                 /* bsid, bsmod */
+    acmod = read_bits (&br, 3);
+    if ((acmod & 1) && acmod != 1)
+      read_bits (&br, 2);
+    if (acmod & 4)
+      read_bits (&br, 2);
+    if (acmod == 2)
+      read_bits (&br, 2);
+    info->rate = rates[fscod];
+    info->channels = channels[acmod] + read_bits (&br, 1);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+parse_eac3 (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint rates[] = { 48000, 44100, 32000 };
+  static const gint channels[] = { 2, 1, 2, 3, 3, 4, 4, 5 };
+  guint i;
+
+  for (i = 0; i + 6 <= len; i++) {
+    guint fscod;
+
+    /* bsid 11 to 16 tells E-AC3 apart from AC3 behind the same sync word */
+    if (data[i] != 0x0B || data[i + 1] != 0x77 || (data[i + 5] >> 3) <= 10
+        || (data[i + 5] >> 3) > 16)
+      continue;
+    fscod = data[i + 4] >> 6;
+    if (fscod == 3) {
+      if (((data[i + 4] >> 4) & 0x03) == 3)
+        continue;
+      info->rate = rates[(data[i + 4] >> 4) & 0x03] / 2;
+    } else
+      info->rate = rates[fscod];
+    info->channels = channels[(data[i + 4] >> 1) & 0x07] + (data[i + 4] & 1);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+parse_adts (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint rates[] = { 96000, 88200, 64000, 48000, 44100, 32000,
+    24000, 22050, 16000, 12000, 11025, 8000, 7350
+  };
+  guint i;
+
+  for (i = 0; i + 4 <= len; i++) {
+    guint rate_index, config;
+
+    if (data[i] != 0xFF || (data[i + 1] & 0xF6) != 0xF0)
+      continue;
+    rate_index = (data[i + 2] >> 2) & 0x0F;
+    config = ((data[i + 2] & 0x01) << 2) | (data[i + 3] >> 6);
+    if (rate_index >= G_N_ELEMENTS (rates) || config == 0)
+      continue;
+    info->rate = rates[rate_index];
+    info->channels = config == 7 ? 8 : config;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+parse_dts (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint rates[] = { 0, 8000, 16000, 32000, 0, 0, 11025, 22050,
+    44100, 0, 0, 12000, 24000, 48000, 0, 0
+  };
+  static const gint channels[] = { 1, 2, 2, 2, 2, 3, 3, 4, 4, 5, 6, 6, 6, 7,
+    8, 8
+  };
+  guint i;
+
+  for (i = 0; i + 12 <= len; i++) {
+    BitReader br;
+    guint amode, sfreq;
+
+    if (data[i] != 0x7F || data[i + 1] != 0xFE || data[i + 2] != 0x80
+        || data[i + 3] != 0x01)
+      continue;
+    br.data = data + i + 4;
+    br.size = 8;
+    br.pos = 28;                /* frame type, deficit, crc, blocks, size */
+    amode = read_bits (&br, 6);
+    sfreq = read_bits (&br, 4);
+    if (amode >= G_N_ELEMENTS (channels) || !rates[sfreq])
+      continue;
+    br.pos += 15;               /* bit rate up to the aspf flag */
+    info->rate = rates[sfreq];
+    info->channels = channels[amode] + (read_bits (&br, 2) ? 1 : 0);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* the HDMV LPCM header in front of every PES payload, there is no sync */
+static gboolean
+parse_lpcm (const guint8 * data, guint len, EsAudioInfo * info)
+{
+  static const gint channels[] = { 0, 1, 0, 2, 3, 3, 4, 4, 5, 6, 7, 8 };
+  guint assignment;
+
+  if (len < 4)
+    return FALSE;
+  assignment = data[2] >> 4;
+  switch (data[2] & 0x0F) {
+    case 1:
+      info->rate = 48000;
+      break;
+    case 4:
+      info->rate = 96000;
+      break;
+    case 5:
+      info->rate = 192000;
+      break;
+    default:
+      return FALSE;
+  }
+  if (assignment >= G_N_ELEMENTS (channels) || !channels[assignment])
+    return FALSE;
+  info->channels = channels[assignment];
+  return TRUE;
+}
+
+gboolean
+es_parse_audio_info (TsCodec codec, const guint8 * data, guint len,
+    EsAudioInfo * info)
+{
+  memset (info, 0, sizeof (EsAudioInfo));
+  switch (codec) {
+    case TS_CODEC_MPEG_AUDIO:
+      return parse_mpeg_audio (data, len, info);
+    case TS_CODEC_AAC:
+      return parse_adts (data, len, info);
+    case TS_CODEC_AC3:
+      return parse_ac3 (data, len, info);
+    case TS_CODEC_EAC3:
+      return parse_eac3 (data, len, info);
+    case TS_CODEC_DTS:
+      return parse_dts (data, len, info);
+    case TS_CODEC_LPCM:
+      return parse_lpcm (data, len, info);
+    default:
+      return FALSE;
+  }
+}
@@ -0,0 +1,46 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_ESINFO_H__
+#define __BDREMUX_ESINFO_H__
+
+#include "tspacket.h"
+
+/* stream attributes sniffed from elementary stream headers, roughly what
+ * the parsers would put into their caps */
+typedef struct _EsVideoInfo
+{
+  gint width, height;
+  gint fps_n, fps_d;
+  gint par_n, par_d;
+  gboolean interlaced;
+} EsVideoInfo;
+
+typedef struct _EsAudioInfo
+{
+  gint rate;
+  gint channels;
+} EsAudioInfo;
+
+gboolean es_parse_video_info (TsCodec codec, const guint8 * data, guint len,
+    EsVideoInfo * info);
+gboolean es_parse_audio_info (TsCodec codec, const guint8 * data, guint len,
+    EsAudioInfo * info);
+
+#endif /* __BDREMUX_ESINFO_H__ */
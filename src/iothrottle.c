@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "common.h"
+#include "iothrottle.h"
+
+/* an I/O counts as slowed down when it takes this many times as long per
+ * MB as the fastest one, and at least IO_THROTTLE_SLOW_LATENCY */
+#define IO_THROTTLE_SLOWDOWN 3
+#define IO_THROTTLE_SLOW_LATENCY 20000  /* us per MB */
+/* the rate is halved at most this often and raised by an eighth of the
+ * maximum at most every IO_THROTTLE_RAISE_INTERVAL */
+#define IO_THROTTLE_LOWER_INTERVAL 250000       /* us */
+#define IO_THROTTLE_RAISE_INTERVAL 1000000
+/* an idle moment allows this much of a burst afterwards */
+#define IO_THROTTLE_BURST 100000
+#define IO_THROTTLE_MAX_PAUSE 500000
+
+/* not in the C library headers */
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+struct _IoThrottle
+{
+  CompatMutex lock;
+  const gchar *what;
+  guint64 max_rate, rate;
+  gdouble fastest, latency;     /* us per MB */
+  gint64 next;                  /* when the next I/O may start */
+  gint64 adjusted;              /* when the rate was last changed */
+};
+
+static gint64
+now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+IoThrottle *
+io_throttle_new (const gchar * what, guint64 max_rate)
+{
+  IoThrottle *t = g_new0 (IoThrottle, 1);
+
+  MUTEX_INIT (t->lock);
+  t->what = what;
+  t->max_rate = t->rate = MAX (max_rate, IO_THROTTLE_MIN_RATE);
+  return t;
+}
+
+void
+io_throttle_free (IoThrottle * t)
+{
+  MUTEX_CLEAR (t->lock);
+  g_free (t);
+}
+
+gint64
+io_throttle_begin (IoThrottle * t)
+{
+  return t ? now_us () : 0;
+}
+
+void
+io_throttle_end (IoThrottle * t, gint64 start, gssize bytes)
+{
+  gint64 now, latency, wait;
+  gdouble per_mb;
+  gboolean slow;
+
+  if (!t || bytes <= 0)
+    return;
+  now = now_us ();
+  latency = now - start;
+  per_mb = (gdouble) latency * 1024 * 1024 / bytes;
+
+  MUTEX_LOCK (t->lock);
+  /* the baseline drifts up slowly, so a disk which got slower for good
+   * isn't taken as busy forever */
+  if (!t->fastest || per_mb < t->fastest)
+    t->fastest = per_mb;
+  else
+    t->fastest *= 1.001;
+  t->latency = t->latency ? 0.8 * t->latency + 0.2 * per_mb : per_mb;
+  slow = t->latency > MAX (IO_THROTTLE_SLOWDOWN * t->fastest,
+      IO_THROTTLE_SLOW_LATENCY);
+
+  if (slow && now - t->adjusted > IO_THROTTLE_LOWER_INTERVAL) {
+    t->rate = MAX (t->rate / 2, IO_THROTTLE_MIN_RATE);
+    t->adjusted = now;
+    GST_DEBUG ("%s slowed down to %.0f us/MB, rate lowered to %"
+        G_GUINT64_FORMAT, t->what, t->latency, t->rate);
+  } else if (!slow && t->rate < t->max_rate
+      && now - t->adjusted > IO_THROTTLE_RAISE_INTERVAL) {
+    t->rate = MIN (t->rate + t->max_rate / 8, t->max_rate);
+    t->adjusted = now;
+    GST_DEBUG ("%s rate raised to %" G_GUINT64_FORMAT, t->what, t->rate);
+  }
+
+  if (t->next < now - IO_THROTTLE_BURST)
+    t->next = now - IO_THROTTLE_BURST;
+  t->next += bytes * G_USEC_PER_SEC / t->rate;
+  wait = t->next - now;
+  /* while the disk is busy, it's left alone for as long as the I/O took */
+  if (slow)
+    wait = MAX (wait, MIN (latency, IO_THROTTLE_MAX_PAUSE));
+  MUTEX_UNLOCK (t->lock);
+
+  if (wait > 0)
+    g_usleep (wait);
+}
+
+/* on Linux the scheduling class, nice value and I/O priority belong to the
+ * thread */
+void
+io_set_background_priority (IoPriority * saved)
+{
+  struct sched_param param = { 0 };
+
+  memset (saved, 0, sizeof (*saved));
+#ifdef SCHED_IDLE
+  saved->policy = sched_getscheduler (0);
+  if (saved->policy >= 0 && sched_getparam (0, &param) == 0) {
+    saved->sched_priority = param.sched_priority;
+    param.sched_priority = 0;
+    saved->policy_set = sched_setscheduler (0, SCHED_IDLE, &param) == 0;
+  }
+  if (!saved->policy_set)
+#endif
+  {
+    errno = 0;
+    saved->nice = getpriority (PRIO_PROCESS, 0);
+    if (errno)
+      GST_WARNING ("could not read the CPU priority (%i)", errno);
+    else if (setpriority (PRIO_PROCESS, 0, 19) < 0)
+      GST_WARNING ("could not lower the CPU priority (%i)", errno);
+    else
+      saved->nice_set = TRUE;
+  }
+#ifdef SYS_ioprio_set
+  saved->ioprio = syscall (SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+  if (saved->ioprio < 0)
+    GST_WARNING ("could not read the I/O priority (%i)", errno);
+  else if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+          IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) < 0)
+    GST_WARNING ("could not set the idle I/O priority (%i)", errno);
+  else
+    saved->ioprio_set = TRUE;
+#endif
+}
+
+/* leaving SCHED_IDLE and raising the nice value again may need
+ * RLIMIT_NICE, the thread then stays in the background */
+void
+io_restore_priority (const IoPriority * saved)
+{
+  struct sched_param param = { 0 };
+
+  if (saved->policy_set) {
+    param.sched_priority = saved->sched_priority;
+    if (sched_setscheduler (0, saved->policy, &param) < 0)
+      GST_WARNING ("could not restore the scheduling policy (%i)", errno);
+  }
+  if (saved->nice_set && setpriority (PRIO_PROCESS, 0, saved->nice) < 0)
+    GST_WARNING ("could not restore the CPU priority (%i)", errno);
+#ifdef SYS_ioprio_set
+  if (saved->ioprio_set
+      && syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, saved->ioprio) < 0)
+    GST_WARNING ("could not restore the I/O priority (%i)", errno);
+#endif
+}
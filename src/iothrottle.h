@@ -0,0 +1,63 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_IOTHROTTLE_H__
+#define __BDREMUX_IOTHROTTLE_H__
+
+#include <glib.h>
+
+/* the rate is never lowered below this, however busy the disk is */
+#define IO_THROTTLE_MIN_RATE (1024 * 1024)
+
+/* paces the reads or writes of a background job to a rate in bytes per
+ * second. the time each I/O takes is compared to the fastest seen so far:
+ * when the disk slows down because somebody else (a recording) is using
+ * it, the rate is halved and the job pauses, while it's idle the rate
+ * creeps back up to the maximum. several threads may share one */
+typedef struct _IoThrottle IoThrottle;
+
+IoThrottle *io_throttle_new (const gchar * what, guint64 max_rate);
+void io_throttle_free (IoThrottle * t);
+
+/* brackets one I/O of bytes, end sleeps as long as needed to keep to the
+ * rate. both do nothing without a throttle */
+gint64 io_throttle_begin (IoThrottle * t);
+void io_throttle_end (IoThrottle * t, gint64 start, gssize bytes);
+
+/* what io_set_background_priority changed on a thread and the values it
+ * had before, so they can be given back */
+typedef struct _IoPriority
+{
+  gboolean policy_set;
+  gint policy;
+  gint sched_priority;
+  gboolean nice_set;
+  gint nice;
+  gboolean ioprio_set;
+  gint ioprio;
+} IoPriority;
+
+/* gives the calling thread idle CPU and I/O priority. threads don't always
+ * inherit them (pooled ones are started elsewhere and reused), so every
+ * thread doing the job's I/O calls this itself and io_restore_priority
+ * when its part of the job is done */
+void io_set_background_priority (IoPriority * saved);
+void io_restore_priority (const IoPriority * saved);
+
+#endif /* __BDREMUX_IOTHROTTLE_H__ */
@@ -0,0 +1,224 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "jobstats.h"
+#include "tspacket.h"
+
+typedef struct _StreamCounters
+{
+  guint source_pid, sink_pid;
+  guint64 in_buffers, in_bytes;
+  guint64 out_buffers, out_bytes;
+  GstClockTime in_time, out_time;
+  gboolean blocked;
+  /* the totals of the previous snapshot, for the rates */
+  guint64 last_buffers, last_bytes;
+} StreamCounters;
+
+struct _JobStats
+{
+  CompatMutex lock;
+  GTimer *timer;
+  gdouble last_due, last_snapshot;
+  QueueCounters *queues;
+  StreamCounters streams[MAX_PIDS];
+  guint n_streams;
+  guint64 bytes_written;
+  guint entry_points;
+};
+
+JobStats *
+job_stats_new (void)
+{
+  JobStats *stats = g_new0 (JobStats, 1);
+
+  MUTEX_INIT (stats->lock);
+  stats->timer = g_timer_new ();
+  return stats;
+}
+
+void
+job_stats_free (JobStats * stats)
+{
+  g_timer_destroy (stats->timer);
+  MUTEX_CLEAR (stats->lock);
+  g_free (stats);
+}
+
+static StreamCounters *
+add_stream (JobStats * stats, guint source_pid, guint sink_pid)
+{
+  StreamCounters *c;
+
+  if (stats->n_streams == MAX_PIDS)
+    return NULL;
+  c = &stats->streams[stats->n_streams++];
+  c->source_pid = source_pid;
+  c->sink_pid = sink_pid;
+  c->in_time = c->out_time = GST_CLOCK_TIME_NONE;
+  return c;
+}
+
+/* takes over what the multiqueue counted, called with the lock held */
+static void
+copy_queues (JobStats * stats)
+{
+  QueuedStream streams[MAX_PIDS];
+  guint i;
+
+  stats->n_streams = queue_counters_get (stats->queues, streams);
+  for (i = 0; i < stats->n_streams; i++) {
+    StreamCounters *c = &stats->streams[i];
+    QueuedStream *s = &streams[i];
+
+    c->source_pid = s->source_pid;
+    c->sink_pid = s->sink_pid;
+    c->in_buffers = s->in_buffers;
+    c->in_bytes = s->in_bytes;
+    c->out_buffers = s->out_buffers;
+    c->out_bytes = s->out_bytes;
+    c->in_time = s->in_time;
+    c->out_time = s->out_time;
+    c->blocked = s->blocked;
+  }
+}
+
+void
+job_stats_set_queues (JobStats * stats, QueueCounters * queues)
+{
+  MUTEX_LOCK (stats->lock);
+  if (!queues && stats->queues)
+    copy_queues (stats);
+  stats->queues = queues;
+  MUTEX_UNLOCK (stats->lock);
+}
+
+void
+job_stats_add_stream (JobStats * stats, guint source_pid, guint sink_pid)
+{
+  MUTEX_LOCK (stats->lock);
+  add_stream (stats, source_pid, sink_pid);
+  MUTEX_UNLOCK (stats->lock);
+}
+
+/* without a queue in between, what goes in goes right out again */
+void
+job_stats_set_packets (JobStats * stats, const guint64 * packets)
+{
+  guint i;
+
+  MUTEX_LOCK (stats->lock);
+  for (i = 0; i < stats->n_streams; i++) {
+    StreamCounters *c = &stats->streams[i];
+    c->in_buffers = c->out_buffers = packets[c->source_pid];
+    c->in_bytes = c->out_bytes = packets[c->source_pid] * TS_PACKET_SIZE;
+  }
+  MUTEX_UNLOCK (stats->lock);
+}
+
+void
+job_stats_add_written (JobStats * stats, guint64 bytes)
+{
+  MUTEX_LOCK (stats->lock);
+  stats->bytes_written += bytes;
+  MUTEX_UNLOCK (stats->lock);
+}
+
+void
+job_stats_set_written (JobStats * stats, guint64 bytes)
+{
+  MUTEX_LOCK (stats->lock);
+  stats->bytes_written = bytes;
+  MUTEX_UNLOCK (stats->lock);
+}
+
+void
+job_stats_add_entry_point (JobStats * stats)
+{
+  MUTEX_LOCK (stats->lock);
+  stats->entry_points++;
+  MUTEX_UNLOCK (stats->lock);
+}
+
+gboolean
+job_stats_due (JobStats * stats, guint interval_ms)
+{
+  gboolean due = FALSE;
+  gdouble now;
+
+  MUTEX_LOCK (stats->lock);
+  now = g_timer_elapsed (stats->timer, NULL);
+  if ((now - stats->last_due) * 1000 >= interval_ms) {
+    stats->last_due = now;
+    due = TRUE;
+  }
+  MUTEX_UNLOCK (stats->lock);
+  return due;
+}
+
+void
+job_stats_snapshot (JobStats * stats, BdremuxStats * snapshot)
+{
+  gdouble interval;
+  guint i;
+
+  MUTEX_LOCK (stats->lock);
+  if (stats->queues)
+    copy_queues (stats);
+  snapshot->elapsed = g_timer_elapsed (stats->timer, NULL);
+  interval = snapshot->elapsed - stats->last_snapshot;
+  stats->last_snapshot = snapshot->elapsed;
+  snapshot->bytes_written = stats->bytes_written;
+  snapshot->entry_points = stats->entry_points;
+
+  snapshot->n_streams = stats->n_streams;
+  for (i = 0; i < stats->n_streams; i++) {
+    StreamCounters *c = &stats->streams[i];
+    BdremuxStreamStats *s = &snapshot->streams[i];
+
+    s->source_pid = c->source_pid;
+    s->sink_pid = c->sink_pid;
+    s->buffers = c->out_buffers;
+    s->bytes = c->out_bytes;
+    s->buffers_per_second = s->bytes_per_second = 0;
+    if (interval > 0) {
+      s->buffers_per_second = (c->out_buffers - c->last_buffers) / interval;
+      s->bytes_per_second = (c->out_bytes - c->last_bytes) / interval;
+    }
+    c->last_buffers = c->out_buffers;
+    c->last_bytes = c->out_bytes;
+    s->queue_buffers = c->in_buffers - c->out_buffers;
+    s->queue_bytes = c->in_bytes - c->out_bytes;
+    s->queue_time = -1;
+    if (GST_CLOCK_TIME_IS_VALID (c->in_time)
+        && GST_CLOCK_TIME_IS_VALID (c->out_time))
+      s->queue_time = c->in_time > c->out_time ?
+          GSTTIME_TO_MPEGTIME (c->in_time - c->out_time) : 0;
+    s->blocked = c->blocked;
+  }
+  MUTEX_UNLOCK (stats->lock);
+
+  /* the rest takes as long as the input consumed so far did */
+  snapshot->eta = -1;
+  if (snapshot->bytes_read && snapshot->bytes_total >= snapshot->bytes_read)
+    snapshot->eta = snapshot->elapsed *
+        (snapshot->bytes_total - snapshot->bytes_read) / snapshot->bytes_read;
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_JOBSTATS_H__
+#define __BDREMUX_JOBSTATS_H__
+
+#include "common.h"
+#include "queuecounters.h"
+
+typedef struct _JobStats JobStats;
+
+JobStats *job_stats_new (void);
+void job_stats_free (JobStats * stats);
+
+/* the streams are those counted at the multiqueue, NULL takes a last
+ * copy of them before the counters go away */
+void job_stats_set_queues (JobStats * stats, QueueCounters * queues);
+/* a stream counted by the fast remuxer, packets is indexed by PID */
+void job_stats_add_stream (JobStats * stats, guint source_pid,
+    guint sink_pid);
+void job_stats_set_packets (JobStats * stats, const guint64 * packets);
+
+void job_stats_add_written (JobStats * stats, guint64 bytes);
+void job_stats_set_written (JobStats * stats, guint64 bytes);
+void job_stats_add_entry_point (JobStats * stats);
+
+/* TRUE once every interval_ms, for exactly one of the callers */
+gboolean job_stats_due (JobStats * stats, guint interval_ms);
+/* fills everything but the input and timeline fields, which the caller
+ * sets before for the ETA */
+void job_stats_snapshot (JobStats * stats, BdremuxStats * snapshot);
+
+#endif /* __BDREMUX_JOBSTATS_H__ */
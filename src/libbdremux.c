@@ -0,0 +1,2681 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <gst/gst.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <byteswap.h>
+#include <netinet/in.h>
+
+#include "accesspoints.h"
+#include "bdremux.h"
+#include "bufpool.h"
+#include "checkpoint.h"
+#include "checksum.h"
+#include "clipinfo.h"
+#include "common.h"
+#include "esinfo.h"
+#include "iothrottle.h"
+#include "jobstats.h"
+#include "outwriter.h"
+#include "queuecounters.h"
+#include "queuelimits.h"
+#include "rangereader.h"
+#include "spscring.h"
+#include "tsfast.h"
+#include "tsindex.h"
+#include "tsparallel.h"
+#include "tsprobe.h"
+#include "tspsi.h"
+
+#ifndef BYTE_ORDER
+#error no byte order defined!
+#endif
+
+#define RANGE_CHUNK_SIZE (TS_PACKET_SIZE * 1024)
+#define PROGRESS_INTERVAL 500   /* ms */
+#define QUEUE_LIMITS_INTERVAL 1000      /* ms */
+/* the start of the result the PSI PIDs are looked up in */
+#define RESULT_SCAN_SIZE (M2TS_ALIGNED_UNIT_SIZE * 64)
+
+GST_DEBUG_CATEGORY (bdremux_debug);
+
+typedef struct _BdremuxJob App;
+
+typedef struct _Segment
+{
+  int index;
+  guint64 in_pts;
+  guint64 out_pts;
+} segment_t;
+
+/* a further result of the job, remuxed natively from the same read of the
+ * source as the first one */
+typedef struct _Result
+{
+  App *app;
+  guint index;
+  gchar *out_filename;
+  gchar *cuts_filename;
+  gint a_source_pids[MAX_PIDS], a_sink_pids[MAX_PIDS];
+  guint no_source_pids, no_sink_pids;
+  gboolean enable_indexing;
+  gchar *clpi_filename;
+  gchar *mpls_filename;
+
+  segment_t *segments;
+  int segment_count;
+  GArray *ranges;
+  ClipInfo *clip;
+  FastCounters *counters;
+} Result;
+
+struct _BdremuxJob
+{
+  gchar *in_filename;
+  gchar *out_filename;
+  gchar *cuts_filename;
+  gboolean enable_indexing;
+  gboolean enable_cutlist;
+  gboolean enable_fast;
+  gboolean index_only;
+  BdremuxAudioMode audio_mode;
+  guint n_jobs;
+  GPtrArray *results;           /* of Result, after the first one */
+  GstElement *pipeline;
+  GstElement *filesrc;
+  GstElement *tsdemux;
+  GstElement *queue;
+  GstElement *videoparser;
+  GstElement *audioparsers[MAX_PIDS];
+  GstElement *m2tsmux;
+  GstElement *sink;
+  GstIndex *index;
+  gulong buffer_handler_id;
+  gint a_source_pids[MAX_PIDS], a_sink_pids[MAX_PIDS];
+  guint no_source_pids, no_sink_pids;
+  guint requested_pid_count;
+  gboolean auto_pids;
+  gboolean discovered_pids;     /* source PIDs taken from the PMT */
+
+  GMainContext *context;
+  GMainLoop *loop;
+  GSource *bus_source;
+  gboolean is_seekable;
+  int current_segment;
+  int segment_count;
+  segment_t *seek_segments;
+  GArray *ranges;
+  RangeReader *reader;
+  int in_fd;
+  guint64 bytes_read, bytes_total;
+
+  guint queue_cb_handler_id;
+  guint queue_size;
+  guint queue_time;
+  QueueLimits *queue_limits;
+  QueueCounters *queue_counters;        /* for the stats and the limits */
+
+  gchar *clpi_filename;
+  gchar *mpls_filename;
+  ClipInfo *clip;
+
+  ReadAheadSettings input;
+  FollowSettings follow;
+  CheckpointSettings checkpoint;
+  OutWriterSettings output;
+  gboolean preallocate;
+  gboolean threaded;            /* reader, remux and writer threads */
+  gint remux_cpu;
+  gboolean background;          /* idle priority and paced I/O */
+  guint background_rate;        /* MB/s for reading and for writing */
+  OutWriter *writer;
+  BufPool *pool;                /* of the pipeline, sized by queue_size */
+  guint64 bytes_written;
+  GByteArray *result_head;      /* kept if the result can't be read back */
+
+  gboolean source_is_appsrc;
+  GstPad *queue_sinkpads[MAX_PIDS], *mux_sinkpads[MAX_PIDS];
+  guint n_request_pads;
+
+  BdremuxCallbacks callbacks;
+  gpointer user_data;
+  GThread *thread;
+  gchar *error;
+
+  guint stats_interval;
+  JobStats *stats;
+  FastCounters *counters;
+};
+
+/* keeps the first error of the job */
+static void
+job_set_error (App * app, const gchar * message)
+{
+  gchar *error = g_strdup (message);
+
+  if (!g_atomic_pointer_compare_and_exchange ((gpointer *) & app->error,
+          NULL, error))
+    g_free (error);
+}
+
+/* fails the job. a running pipeline is stopped by an error message on its
+ * bus, anywhere else the caller has to bail out on its own */
+static void
+job_error (App * app, const gchar * format, ...)
+{
+  va_list args;
+  gchar *message;
+
+  va_start (args, format);
+  message = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  GST_ERROR ("%s", message);
+  job_set_error (app, message);
+  if (app->loop) {
+    GError *gerror = g_error_new_literal (GST_CORE_ERROR,
+        GST_CORE_ERROR_FAILED, message);
+    gst_element_post_message (app->pipeline,
+        gst_message_new_error (GST_OBJECT (app->pipeline), gerror, message));
+    g_error_free (gerror);
+  }
+  g_free (message);
+}
+
+/* appends the segments between the IN and OUT marks of cuts_filename,
+ * returns how many there are */
+static int
+load_cutlist (const gchar * cuts_filename, segment_t ** segments)
+{
+  FILE *f;
+  int segment_i = 0, segment_count = 0;
+
+  f = fopen (cuts_filename, "rb");
+
+  if (f) {
+    GST_INFO ("cutfile found! loading cuts...");
+    while (1) {
+      unsigned long long where;
+      unsigned int what;
+
+      if (!fread (&where, sizeof (where), 1, f))
+        break;
+      if (!fread (&what, sizeof (what), 1, f))
+        break;
+
+#if BYTE_ORDER == LITTLE_ENDIAN
+      where = bswap_64 (where);
+#endif
+      what = ntohl (what);
+      GST_DEBUG ("where= %lld, what=%i", where, what);
+      if (what > 3)
+        break;
+
+      if (what == 0) {
+        segment_count++;
+        *segments =
+            (segment_t *) realloc (*segments,
+            segment_count * sizeof (segment_t));
+        (*segments)[segment_i].index = segment_i;
+        (*segments)[segment_i].in_pts = where;
+        (*segments)[segment_i].out_pts = -1;
+      }
+      if (what == 1 && segment_i < segment_count) {
+        (*segments)[segment_i].out_pts = where;
+        segment_i++;
+      }
+    }
+    fclose (f);
+  } else
+    GST_WARNING ("cutfile not found!");
+// 
+  return segment_count;
+}
+
+static gboolean
+do_seek (App * app)
+{
+  gint64 in_pos, out_pos;
+  gfloat rate = 1.0;
+  GstFormat fmt = GST_FORMAT_TIME;
+  GstSeekFlags flags = 0;
+  int ret;
+
+  if (app->current_segment >= app->segment_count) {
+    GST_WARNING ("seek segment not found!");
+    return FALSE;
+  }
+
+  GST_INFO ("do_seek...");
+  flags |= GST_SEEK_FLAG_FLUSH;
+//      flags |= GST_SEEK_FLAG_ACCURATE;
+  flags |= GST_SEEK_FLAG_KEY_UNIT;
+  flags |= GST_SEEK_FLAG_SEGMENT;
+
+  gst_element_query_position ((app->pipeline), &fmt, &in_pos);
+  GST_DEBUG ("do_seek::initial gst_element_query_position = %lld ms",
+      in_pos / 1000000);
+
+  in_pos =
+      MPEGTIME_TO_GSTTIME (app->seek_segments[app->current_segment].in_pts);
+  GST_DEBUG ("do_seek::in_time for segment %i = %lld ms", app->current_segment,
+      in_pos / 1000000);
+
+  out_pos = -1;
+  if (app->seek_segments[app->current_segment].out_pts != (guint64) -1)
+    out_pos =
+        MPEGTIME_TO_GSTTIME (app->seek_segments[app->current_segment].out_pts);
+  GST_DEBUG ("do_seek::out_time for segment %i = %lld ms", app->current_segment,
+      out_pos / 1000000);
+
+  ret = gst_element_seek ((app->pipeline), rate, GST_FORMAT_TIME, flags,
+      GST_SEEK_TYPE_SET, in_pos,
+      out_pos == -1 ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET, out_pos);
+
+  gst_element_query_position ((app->pipeline), &fmt, &in_pos);
+  GST_DEBUG
+      ("do_seek::seek command returned %i. new gst_element_query_position = %lld ms",
+      ret, in_pos / 1000000);
+
+  if (ret)
+    app->current_segment++;
+
+  return ret;
+}
+
+static void pipeline_done (App * app, gboolean ok);
+
+/* the streaming threads come from GStreamer's pool and are reused across
+ * jobs, so a background job lowers their priority when they enter its
+ * pipeline and gives it back when they leave. the messages are posted
+ * from the streaming thread itself */
+static GstBusSyncReply
+bus_sync_message (GstBus * bus, GstMessage * message, App * app)
+{
+  GstStreamStatusType type;
+  GstElement *owner;
+  const GValue *value;
+  GObject *task;
+  IoPriority *priority;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_STREAM_STATUS)
+    return GST_BUS_PASS;
+  gst_message_parse_stream_status (message, &type, &owner);
+  value = gst_message_get_stream_status_object (message);
+  if (!value || !G_VALUE_HOLDS_OBJECT (value))
+    return GST_BUS_PASS;
+  task = g_value_get_object (value);
+
+  if (type == GST_STREAM_STATUS_TYPE_ENTER && app->background) {
+    priority = g_new (IoPriority, 1);
+    io_set_background_priority (priority);
+    g_object_set_data_full (task, "bdremux-priority", priority, g_free);
+  } else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+    priority = g_object_get_data (task, "bdremux-priority");
+    if (priority) {
+      io_restore_priority (priority);
+      g_object_set_data (task, "bdremux-priority", NULL);
+    }
+  }
+  return GST_BUS_PASS;
+}
+
+static gboolean
+bus_message (GstBus * bus, GstMessage * message, App * app)
+{
+  gchar *sourceName;
+  GstObject *source;
+  gchar *string;
+  GstState current_state;
+
+  if (!message)
+    return FALSE;
+  source = GST_MESSAGE_SRC (message);
+  if (!GST_IS_OBJECT (source))
+    return FALSE;
+  sourceName = gst_object_get_name (source);
+
+  if (gst_message_get_structure (message))
+    string = gst_structure_to_string (gst_message_get_structure (message));
+  else
+    string = g_strdup (GST_MESSAGE_TYPE_NAME (message));
+  GST_DEBUG("gst_message from %s: %s", sourceName, string);
+  g_free (string);
+
+  switch (GST_MESSAGE_TYPE (message)) {
+    case GST_MESSAGE_ERROR:
+    {
+      GError *gerror;
+      gchar *debug;
+
+      gst_message_parse_error (message, &gerror, &debug);
+      gst_object_default_error (GST_MESSAGE_SRC (message), gerror, debug);
+      job_set_error (app, gerror->message);
+      g_error_free (gerror);
+      g_free (debug);
+
+      pipeline_done (app, FALSE);
+      break;
+    }
+    case GST_MESSAGE_WARNING:
+    {
+      GError *gerror;
+      gchar *debug;
+
+      gst_message_parse_warning (message, &gerror, &debug);
+      gst_object_default_error (GST_MESSAGE_SRC (message), gerror, debug);
+      g_error_free (gerror);
+      g_free (debug);
+
+//       g_main_loop_quit (app->loop);
+      break;
+    }
+    case GST_MESSAGE_EOS:
+      g_message ("received EOS");
+      pipeline_done (app, TRUE);
+      break;
+    case GST_MESSAGE_ASYNC_DONE:
+      break;
+    case GST_MESSAGE_ELEMENT:
+    {
+      const GstStructure *msgstruct = gst_message_get_structure (message);
+      if (msgstruct) {
+        const gchar *eventname = gst_structure_get_name (msgstruct);
+        if (!strcmp (eventname, "seekable"))
+          app->is_seekable = TRUE;
+      }
+      break;
+    }
+    case GST_MESSAGE_STATE_CHANGED:
+    {
+      GstState old_state, new_state;
+      GstStateChange transition;
+      if (GST_MESSAGE_SRC (message) != GST_OBJECT (app->tsdemux))
+        break;
+
+      gst_message_parse_state_changed (message, &old_state, &new_state, NULL);
+      transition = (GstStateChange) GST_STATE_TRANSITION (old_state, new_state);
+
+      switch (transition) {
+        case GST_STATE_CHANGE_NULL_TO_READY:
+          break;
+        case GST_STATE_CHANGE_READY_TO_PAUSED:
+          break;
+        case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+        {
+
+        }
+          break;
+        case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+          break;
+        case GST_STATE_CHANGE_PAUSED_TO_READY:
+          break;
+        case GST_STATE_CHANGE_READY_TO_NULL:
+          break;
+      }
+      break;
+    }
+    case GST_MESSAGE_SEGMENT_DONE:
+    {
+      GST_DEBUG ("GST_MESSAGE_SEGMENT_DONE!!!");
+      do_seek (app);
+    }
+    default:
+      break;
+  }
+  gst_element_get_state (app->pipeline, &current_state, NULL, 0);
+  if (app->current_segment == 0 && app->segment_count /*&& app->is_seekable*/
+      && !app->ranges && current_state == GST_STATE_PLAYING)
+    do_seek (app);
+  GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(app->pipeline),GST_DEBUG_GRAPH_SHOW_ALL,"bdremux_pipelinegraph_message");
+  return TRUE;
+}
+
+
+/* entry points are passed on as SPN and 90 kHz PTS, whatever formats the
+ * muxer put into the association */
+static void
+index_entry_added (App * app, GstIndexEntry * entry)
+{
+  gint64 spn = GST_INDEX_ASSOC_VALUE (entry, 0);
+  gint64 pts = GST_INDEX_ASSOC_VALUE (entry, 1);
+
+  if (GST_INDEX_ASSOC_FORMAT (entry, 0) == GST_FORMAT_TIME) {
+    spn = GST_INDEX_ASSOC_VALUE (entry, 1);
+    pts = GSTTIME_TO_MPEGTIME (GST_INDEX_ASSOC_VALUE (entry, 0));
+  } else if (GST_INDEX_ASSOC_FORMAT (entry, 1) == GST_FORMAT_TIME)
+    pts = GSTTIME_TO_MPEGTIME (pts);
+
+  if (app->enable_indexing && app->callbacks.entry_point) {
+    app->callbacks.entry_point (app, spn, pts, app->user_data);
+    if (app->stats)
+      job_stats_add_entry_point (app->stats);
+  }
+  if (app->clip)
+    clip_info_add_entry (app->clip, spn, pts);
+}
+
+static void
+entry_added (GstIndex * index, GstIndexEntry * entry, App * app)
+{
+  switch (entry->type) {
+    case GST_INDEX_ENTRY_ID:
+      GST_DEBUG ("id %d describes writer %s\n", entry->id,
+          GST_INDEX_ID_DESCRIPTION (entry));
+      break;
+    case GST_INDEX_ENTRY_FORMAT:
+      GST_DEBUG ("%d: registered format %d for %s\n", entry->id,
+          GST_INDEX_FORMAT_FORMAT (entry), GST_INDEX_FORMAT_KEY (entry));
+      break;
+    case GST_INDEX_ENTRY_ASSOCIATION:
+    {
+      gint i;
+      if (entry->id == 1 && GST_INDEX_NASSOCS (entry) == 2 && GST_INDEX_ASSOC_VALUE (entry, 1) != -1) {
+        index_entry_added (app, entry);
+      } else {
+        GST_DEBUG ("GST_INDEX_ENTRY_ASSOCIATION %p, %d: %08x ", entry, entry->id,
+            GST_INDEX_ASSOC_FLAGS (entry));
+        for (i = 0; i < GST_INDEX_NASSOCS (entry); i++) {
+          GST_DEBUG ("%d %" G_GINT64_FORMAT " ", GST_INDEX_ASSOC_FORMAT (entry,
+                  i), GST_INDEX_ASSOC_VALUE (entry, i));
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/* an index which only hands its entries to entry_added instead of
+ * collecting them like memindex, so it doesn't grow with the recording.
+ * GstIndex emits the signal after add_entry, so the last entry is kept
+ * alive until the next one arrives. the writer ID entries belong to
+ * GstIndex itself */
+typedef struct _DropIndex
+{
+  GstIndex index;
+  GstIndexEntry *last;
+} DropIndex;
+
+typedef struct _DropIndexClass
+{
+  GstIndexClass parent_class;
+} DropIndexClass;
+
+static GType drop_index_get_type (void);
+G_DEFINE_TYPE (DropIndex, drop_index, GST_TYPE_INDEX);
+
+static void
+drop_index_add_entry (GstIndex * index, GstIndexEntry * entry)
+{
+  DropIndex *di = (DropIndex *) index;
+
+  if (entry->type == GST_INDEX_ENTRY_ID)
+    return;
+  if (di->last)
+    gst_index_entry_free (di->last);
+  di->last = entry;
+}
+
+static void
+drop_index_finalize (GObject * object)
+{
+  DropIndex *di = (DropIndex *) object;
+
+  if (di->last)
+    gst_index_entry_free (di->last);
+  G_OBJECT_CLASS (drop_index_parent_class)->finalize (object);
+}
+
+static void
+drop_index_class_init (DropIndexClass * klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = drop_index_finalize;
+  GST_INDEX_CLASS (klass)->add_entry = drop_index_add_entry;
+}
+
+static void
+drop_index_init (DropIndex * di)
+{
+}
+
+static void
+pad_block_cb (GstPad * pad, gboolean blocked, App * app)
+{
+  GST_DEBUG("pad_block_cb %s:%s = %i", GST_DEBUG_PAD_NAME(pad), blocked);
+
+  if (!blocked)
+    return;
+
+//   gst_pad_set_blocked_async (pad, FALSE, pad_block_cb, NULL);
+}
+
+/* takes the stream attributes for the clip information from the caps the
+ * parsers negotiated on the mux sink pads */
+static void
+clip_info_set_caps (App * app, guint pid, GstCaps * caps)
+{
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  TsCodec codec;
+
+  if (app->auto_pids) {
+    /* no PMT was found up front, register the streams as they show up */
+    for (codec = TS_CODEC_MPEG_VIDEO; codec <= TS_CODEC_LPCM; codec++)
+      if (gst_structure_has_name (s, ts_codec_caps_name (codec)))
+        break;
+    if (codec <= TS_CODEC_LPCM)
+      clip_info_add_stream (app->clip, pid, codec,
+          codec == TS_CODEC_MPEG_AUDIO ? 0x03 : 0x00, NULL);
+  }
+
+  if (g_str_has_prefix (gst_structure_get_name (s), "video/")) {
+    EsVideoInfo info;
+
+    memset (&info, 0, sizeof (info));
+    gst_structure_get_int (s, "width", &info.width);
+    gst_structure_get_int (s, "height", &info.height);
+    if (!gst_structure_get_fraction (s, "framerate", &info.fps_n, &info.fps_d))
+      info.fps_d = 1;
+    if (!gst_structure_get_fraction (s, "pixel-aspect-ratio", &info.par_n,
+            &info.par_d))
+      info.par_n = info.par_d = 1;
+    /* broadcast SD and 1080 lines are interlaced unless told otherwise */
+    if (!gst_structure_get_boolean (s, "interlaced", &info.interlaced))
+      info.interlaced = info.height != 720
+          && (!info.fps_d || info.fps_n <= 30 * info.fps_d);
+    clip_info_set_video (app->clip, pid, &info);
+  } else if (g_str_has_prefix (gst_structure_get_name (s), "audio/")
+      && gst_structure_has_field (s, "rate")) {
+    /* unparsed streams are described by audio_buffer_probe_cb instead */
+    EsAudioInfo info;
+
+    memset (&info, 0, sizeof (info));
+    gst_structure_get_int (s, "rate", &info.rate);
+    gst_structure_get_int (s, "channels", &info.channels);
+    clip_info_set_audio (app->clip, pid, &info);
+  }
+}
+
+static void mux_pad_has_caps_cb(GstPad *pad, GParamSpec * unused, App * app)
+{
+        GstCaps *caps;
+        gchar *padname, *string;
+        guint pid;
+
+        g_object_get (G_OBJECT (pad), "caps", &caps, NULL);
+
+        if (caps)
+        {
+                 padname = gst_pad_get_name (pad);
+                 if (sscanf (padname, "sink_%u", &pid) == 1) {
+                   if (app->callbacks.caps) {
+                     string = gst_caps_to_string (caps);
+                     app->callbacks.caps (app, pid, string, app->user_data);
+                     g_free (string);
+                   }
+                   if (app->clip)
+                     clip_info_set_caps (app, pid, caps);
+                 }
+                 g_free (padname);
+                 gst_caps_unref (caps);
+        }
+}
+
+static gboolean
+video_buffer_probe_cb (GstPad * pad, GstBuffer * buffer, App * app)
+{
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+    clip_info_update_pts (app->clip,
+        GSTTIME_TO_MPEGTIME (GST_BUFFER_TIMESTAMP (buffer)));
+  return TRUE;
+}
+
+/* the codec of a demuxed audio stream, AAC shares the caps name of MPEG
+ * audio */
+static TsCodec
+audio_caps_codec (GstStructure * s)
+{
+  gint mpegversion = 1;
+  TsCodec codec;
+
+  if (gst_structure_has_name (s, "audio/mpeg")) {
+    gst_structure_get_int (s, "mpegversion", &mpegversion);
+    return mpegversion == 1 ? TS_CODEC_MPEG_AUDIO : TS_CODEC_AAC;
+  }
+  for (codec = TS_CODEC_AC3; codec <= TS_CODEC_LPCM; codec++)
+    if (gst_structure_has_name (s, ts_codec_caps_name (codec)))
+      return codec;
+  return TS_CODEC_UNKNOWN;
+}
+
+/* the demuxer caps of an audio stream passed through without a parser lack
+ * the rate and channels, the clip information takes them from the first
+ * frame header instead */
+static gboolean
+audio_buffer_probe_cb (GstPad * pad, GstBuffer * buffer, App * app)
+{
+  GstCaps *caps = GST_BUFFER_CAPS (buffer);
+  EsAudioInfo info;
+  gchar *padname;
+  guint pid;
+
+  if (!caps || !es_parse_audio_info (audio_caps_codec
+          (gst_caps_get_structure (caps, 0)), GST_BUFFER_DATA (buffer),
+          GST_BUFFER_SIZE (buffer), &info))
+    return TRUE;
+
+  padname = gst_pad_get_name (pad);
+  if (sscanf (padname, "sink_%u", &pid) == 1) {
+    GST_DEBUG ("PID 0x%04x: %i Hz, %i channels", pid, info.rate,
+        info.channels);
+    clip_info_set_audio (app->clip, pid, &info);
+  }
+  g_free (padname);
+  gst_pad_remove_buffer_probe (pad,
+      GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (pad), "audio-probe")));
+  return TRUE;
+}
+
+/* the parser framing an audio stream, NULL to hand its PES to the mux as
+ * they come from the demuxer */
+static const gchar *
+audio_parser_name (App * app, TsCodec codec)
+{
+  if (app->audio_mode == BDREMUX_AUDIO_PASSTHROUGH)
+    return NULL;
+  switch (codec) {
+    case TS_CODEC_MPEG_AUDIO:
+      return "mpegaudioparse";
+    case TS_CODEC_AC3:
+      return "ac3parse";
+    case TS_CODEC_DTS:
+      return "dcaparse";
+    default:
+      return NULL;
+  }
+}
+
+static void
+queue_filled_cb (GstElement * element, App * app)
+{
+  GST_DEBUG ("queue_filled_cb requested_pid_count=%i, no_sink_pids=%i app->no_source_pids=%i", app->requested_pid_count, app->no_sink_pids, app->no_source_pids);
+  /* a PMT stream that never carries data must not keep the others
+   * blocked, so discovered PIDs also start on the overrun */
+  if (app->auto_pids || app->discovered_pids
+      || app->requested_pid_count == app->no_sink_pids)
+  {
+    GstPad *queue_srcpad = NULL;
+    gchar srcpadname[9];
+    int i, ret;
+    GST_INFO ("First time queue overrun -> UNBLOCKING all pads and start muxing! (have %i PIDS @ mux)", app->requested_pid_count);
+     for (i = 0; i < app->no_sink_pids; i++)
+     {
+       g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
+       queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
+       if (!queue_srcpad) {
+         GST_WARNING ("source PID 0x%04x has no data yet, muxing without it",
+             app->a_source_pids[i]);
+         continue;
+       }
+       ret = gst_pad_set_blocked_async (queue_srcpad, FALSE, (GstPadBlockCallback) pad_block_cb, app);
+       GST_DEBUG ("UNBLOCKING %s returned %i", srcpadname, ret);
+       gst_object_unref (queue_srcpad);
+     }
+     if (app->queue_limits)
+       queue_limits_flowing (app->queue_limits);
+  }
+  if (app->requested_pid_count >= app->no_sink_pids)
+  {
+    GST_DEBUG
+        ("Disconnect queue_filled_cb! requested_pid_count=%i, no_sink_pids=%i", app->requested_pid_count, app->no_sink_pids);
+    g_signal_handler_disconnect(G_OBJECT(element), app->queue_cb_handler_id);
+    app->queue_cb_handler_id = 0;
+  }
+}
+
+/* keeps the request pads so they can be released before the next job */
+static void
+remember_request_pads (App * app, GstPad * queue_sinkpad, GstPad * mux_sinkpad)
+{
+  if (app->n_request_pads == MAX_PIDS)
+    return;
+  app->queue_sinkpads[app->n_request_pads] = gst_object_ref (queue_sinkpad);
+  app->mux_sinkpads[app->n_request_pads] = gst_object_ref (mux_sinkpad);
+  app->n_request_pads++;
+  buf_pool_serve_pad (app->pool, mux_sinkpad);
+}
+
+static void
+demux_pad_added_cb (GstElement * element, GstPad * demuxpad, App * app)
+{
+  GstPad *parser_sinkpad = NULL, *parser_srcpad = NULL, *queue_sinkpad = NULL, *queue_srcpad = NULL, *mux_sinkpad = NULL;
+  GstStructure *s;
+  GstCaps *caps = gst_pad_get_caps (demuxpad);
+
+  gchar *demuxpadname, sinkpadname[10], srcpadname[9];
+  guint sourcepid;
+  int i, ret;
+
+  s = gst_caps_get_structure (caps, 0);
+  demuxpadname = gst_pad_get_name (demuxpad);
+  GST_DEBUG ("demux_pad_added_cb %s:%s", GST_DEBUG_PAD_NAME(demuxpad));
+
+  if (g_ascii_strncasecmp (demuxpadname, "video", 5) == 0) {
+    sscanf (demuxpadname + 6, "%x", &sourcepid);
+    if (app->auto_pids) {
+      app->a_source_pids[0] = sourcepid;
+      if (app->a_sink_pids[0] == -1)
+      {
+        app->a_sink_pids[0] = sourcepid;
+        app->no_sink_pids++;
+      }
+      app->no_source_pids++;
+    }
+    if (sourcepid == app->a_source_pids[0] && app->videoparser == NULL) {
+      if (gst_structure_has_name (s, "video/mpeg")) {
+        app->videoparser = gst_element_factory_make ("mpegvideoparse", "videoparse");
+	if (!app->videoparser) {
+	  job_error (app, "mpegvideoparse not found! please install gst-plugin-mpegvideoparse!");
+	  goto out;
+	}
+      }
+      else if (gst_structure_has_name (s, "video/x-h264")) {
+        app->videoparser = gst_element_factory_make ("h264parse", "videoparse");
+	if (!app->videoparser) {
+	  job_error (app, "h264parse not found! please install gst-plugin-videoparsersbad!");
+	  goto out;
+	}
+      }
+      else {
+        job_error (app, "could not find parser for video stream with pid 0x%04x!", sourcepid);
+        goto out;
+      }
+      gst_bin_add (GST_BIN (app->pipeline), app->videoparser);
+      gst_element_set_state (app->videoparser, GST_STATE_PLAYING);
+      parser_sinkpad = gst_element_get_static_pad (app->videoparser, "sink");
+      parser_srcpad = gst_element_get_static_pad (app->videoparser, "src");
+      g_sprintf (sinkpadname, "sink%d", app->a_sink_pids[0]);
+      g_sprintf (srcpadname, "src%d", app->a_sink_pids[0]);
+      queue_sinkpad = gst_element_get_request_pad (app->queue, sinkpadname);
+      queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
+      g_sprintf (sinkpadname, "sink_%d", app->a_sink_pids[0]);
+      mux_sinkpad = gst_element_get_request_pad (app->m2tsmux, sinkpadname);
+      app->requested_pid_count++;
+      remember_request_pads (app, queue_sinkpad, mux_sinkpad);
+      if (app->requested_pid_count <= app->no_source_pids)
+	{
+	         ret = gst_pad_set_blocked_async (queue_srcpad, TRUE, (GstPadBlockCallback) pad_block_cb, app);
+		 GST_DEBUG ("BLOCKING %s returned %i", srcpadname, ret);
+	}
+      if (gst_pad_link (demuxpad, parser_sinkpad) == 0)
+      {
+        if (gst_pad_link (parser_srcpad, queue_sinkpad) == 0)
+        {
+          if (gst_pad_link (queue_srcpad, mux_sinkpad) == 0) {
+            if (app->callbacks.linked)
+              app->callbacks.linked (app, app->a_source_pids[0], app->a_sink_pids[0], app->user_data);
+            if (app->queue_counters)
+              queue_counters_watch (app->queue_counters,
+                  app->a_source_pids[0], app->a_sink_pids[0],
+                  queue_sinkpad, queue_srcpad);
+                g_signal_connect (G_OBJECT (mux_sinkpad), "notify::caps", G_CALLBACK (mux_pad_has_caps_cb), app);
+                if (app->clip)
+                  gst_pad_add_buffer_probe (mux_sinkpad, G_CALLBACK (video_buffer_probe_cb), app);
+          } else {
+	    job_error (app, "Couldn't link %s:%s to %s:%s", GST_DEBUG_PAD_NAME(queue_srcpad), GST_DEBUG_PAD_NAME(mux_sinkpad));
+	  }
+        } else {
+          job_error (app, "Couldn't link %s:%s to %s:%s @%p", GST_DEBUG_PAD_NAME(parser_srcpad), GST_DEBUG_PAD_NAME(queue_sinkpad), queue_sinkpad);
+	}
+      } else {
+        job_error (app, "Couldn't link %s:%s to %s:%s", GST_DEBUG_PAD_NAME(demuxpad), GST_DEBUG_PAD_NAME(parser_sinkpad));
+      }
+    }
+  } else if (g_ascii_strncasecmp (demuxpadname, "audio", 5) == 0) {
+    sscanf (demuxpadname + 6, "%x", &sourcepid);
+    if (app->auto_pids)
+    {
+      if (app->no_source_pids == 0)
+        i = 1;
+      else
+        i = app->no_source_pids;
+      app->a_source_pids[i] = sourcepid;
+      if (app->a_sink_pids[i] == -1)
+      {
+        app->a_sink_pids[i] = sourcepid;
+        app->no_sink_pids++;
+      }
+      app->no_source_pids++;
+    }
+    for (i = 1; i < app->no_source_pids; i++) {
+      if (sourcepid == app->a_source_pids[i]) {
+        TsCodec codec = audio_caps_codec (s);
+        const gchar *parser = audio_parser_name (app, codec);
+
+        if (codec == TS_CODEC_UNKNOWN) {
+	  job_error (app, "unknown codec of audio stream with pid 0x%04x!", sourcepid);
+	  goto out;
+	}
+        if (parser) {
+          app->audioparsers[i] = gst_element_factory_make (parser, NULL);
+          if (!app->audioparsers[i])
+            GST_WARNING ("%s not found, passing audio PID 0x%04x through",
+                parser, sourcepid);
+        } else
+          GST_INFO ("passing %s PID 0x%04x through", ts_codec_caps_name (codec),
+              sourcepid);
+        if (app->audioparsers[i]) {
+          gst_bin_add (GST_BIN (app->pipeline), app->audioparsers[i]);
+          gst_element_set_state (app->audioparsers[i], GST_STATE_PLAYING);
+          parser_sinkpad = gst_element_get_static_pad (app->audioparsers[i], "sink");
+          parser_srcpad = gst_element_get_static_pad (app->audioparsers[i], "src");
+        }
+        g_sprintf (sinkpadname, "sink%d", app->a_sink_pids[i]);
+        g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
+        queue_sinkpad = gst_element_get_request_pad (app->queue, sinkpadname);
+        queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
+        g_sprintf (sinkpadname, "sink_%d", app->a_sink_pids[i]);
+        mux_sinkpad = gst_element_get_request_pad (app->m2tsmux, sinkpadname);
+        app->requested_pid_count++;
+        remember_request_pads (app, queue_sinkpad, mux_sinkpad);
+        if (app->requested_pid_count <= app->no_source_pids)
+	{
+	         ret = gst_pad_set_blocked_async (queue_srcpad, TRUE, (GstPadBlockCallback) pad_block_cb, app);
+          GST_DEBUG ("BLOCKING %s returned %i", srcpadname, ret);
+	}
+        if ((parser_sinkpad ? gst_pad_link (demuxpad, parser_sinkpad) == 0
+                && gst_pad_link (parser_srcpad, queue_sinkpad) == 0
+                : gst_pad_link (demuxpad, queue_sinkpad) == 0)
+            && gst_pad_link (queue_srcpad, mux_sinkpad) == 0) {
+          if (app->callbacks.linked)
+            app->callbacks.linked (app, app->a_source_pids[i], app->a_sink_pids[i], app->user_data);
+          if (app->queue_counters)
+            queue_counters_watch (app->queue_counters, app->a_source_pids[i],
+                app->a_sink_pids[i], queue_sinkpad, queue_srcpad);
+              g_signal_connect (G_OBJECT (mux_sinkpad), "notify::caps", G_CALLBACK (mux_pad_has_caps_cb), app);
+          if (app->clip && !app->audioparsers[i])
+            g_object_set_data (G_OBJECT (mux_sinkpad), "audio-probe",
+                GUINT_TO_POINTER (gst_pad_add_buffer_probe (mux_sinkpad,
+                        G_CALLBACK (audio_buffer_probe_cb), app)));
+        } else
+          job_error (app, "Couldn't link audio PID 0x%04x to sink PID 0x%04x",
+              app->a_source_pids[i], app->a_sink_pids[i]);
+        break;
+      }
+    }
+  } else
+    GST_INFO ("Ignoring pad %s!", demuxpadname);
+
+out:
+  if (parser_sinkpad)
+    gst_object_unref (parser_sinkpad);
+  if (parser_srcpad)
+    gst_object_unref (parser_srcpad);
+  if (queue_sinkpad)
+    gst_object_unref (queue_sinkpad);
+  if (queue_srcpad)
+    gst_object_unref (queue_srcpad);
+  if (mux_sinkpad)
+    gst_object_unref (mux_sinkpad);
+  if (caps)
+    gst_caps_unref (caps);
+
+//   g_print("app->requested_pid_count = %i, app->no_source_pids = %i\n", app->requested_pid_count, app->no_source_pids);
+  if (!app->auto_pids && app->requested_pid_count == app->no_source_pids)
+  {
+     GST_INFO("All %i source PIDs have been linked to the mux -> UNBLOCKING all pads and start muxing", app->requested_pid_count);
+     for (i = 0; i < app->no_sink_pids; i++)
+     {
+       g_sprintf (srcpadname, "src%d", app->a_sink_pids[i]);
+       queue_srcpad = gst_element_get_static_pad(app->queue, srcpadname);
+       ret = gst_pad_set_blocked_async (queue_srcpad, FALSE, (GstPadBlockCallback) pad_block_cb, app);
+       GST_DEBUG ("UNBLOCKING %s returned %i", srcpadname, ret);
+     }
+     if (app->queue_limits)
+       queue_limits_flowing (app->queue_limits);
+  }
+
+  g_free (demuxpadname);
+  GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(app->pipeline),GST_DEBUG_GRAPH_SHOW_ALL,"bdremux_pipelinegraph_pad_added");
+}
+
+/* maps the cut segments to GOP aligned byte ranges of the source by means
+ * of enigma2's access point file, so only those have to be read and no
+ * flushing seeks are needed. returns NULL without access points */
+static GArray *
+load_cut_ranges (App * app, const gchar * cuts_filename,
+    const segment_t * segments, int segment_count)
+{
+  gchar *ap_filename;
+  GArray *points, *ranges;
+  ByteRange range;
+  int i;
+
+  /* a stream has no name, its access points go with the cutlist */
+  if (IS_FD_PATH (app->in_filename)
+      && g_str_has_suffix (cuts_filename, ".cuts"))
+    ap_filename = g_strdup_printf ("%.*s.ap",
+        (int) strlen (cuts_filename) - 5, cuts_filename);
+  else
+    ap_filename = g_strconcat (app->in_filename, ".ap", NULL);
+  points = access_points_load (ap_filename);
+  if (!points) {
+    GST_WARNING ("no access points in %s, falling back to seeking",
+        ap_filename);
+    g_free (ap_filename);
+    return NULL;
+  }
+  g_free (ap_filename);
+
+  ranges = g_array_new (FALSE, FALSE, sizeof (ByteRange));
+  for (i = 0; i < segment_count; i++) {
+    access_points_get_range (points, segments[i].in_pts,
+        segments[i].out_pts, &range);
+    GST_INFO ("segment %i: in_pts %" G_GUINT64_FORMAT " out_pts %"
+        G_GUINT64_FORMAT " -> bytes %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+        i, segments[i].in_pts, segments[i].out_pts, range.start, range.end);
+    if (ranges->len) {
+      ByteRange *last = &g_array_index (ranges, ByteRange, ranges->len - 1);
+      if (range.start <= last->end) {
+        last->end = MAX (last->end, range.end);
+        continue;
+      }
+    }
+    g_array_append_val (ranges, range);
+  }
+  g_array_free (points, TRUE);
+  return ranges;
+}
+
+static void
+range_need_data_cb (GstElement * appsrc, guint length, App * app)
+{
+  GstBuffer *buffer = buf_pool_new_buffer (app->pool, RANGE_CHUNK_SIZE);
+  GstFlowReturn flow;
+  gboolean discont;
+  gssize len;
+
+  len = range_reader_read (app->reader, GST_BUFFER_DATA (buffer),
+      RANGE_CHUNK_SIZE, &discont);
+  if (len < 0) {
+    gst_buffer_unref (buffer);
+    job_error (app, "could not read from %s! (%i)", app->in_filename, errno);
+    return;
+  }
+  if (len == 0) {
+    gst_buffer_unref (buffer);
+    g_signal_emit_by_name (appsrc, "end-of-stream", &flow);
+    return;
+  }
+  GST_BUFFER_SIZE (buffer) = len;
+  app->bytes_read += len;
+  if (discont)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+  g_signal_emit_by_name (appsrc, "push-buffer", buffer, &flow);
+  gst_buffer_unref (buffer);
+}
+
+/* learns the complete stream set from PAT/PMT before the pipeline starts,
+ * so auto PID mode can unblock the mux as soon as every pad is linked
+ * instead of waiting for the queue to overrun */
+static gboolean
+discover_pids (App * app)
+{
+  TsProgram *program;
+  int fd;
+  guint i;
+  gboolean found;
+
+  program = g_new0 (TsProgram, 1);
+  if (app->reader)
+    found = range_reader_scan_program (app->reader, -1, program);
+  else {
+    fd = open (app->in_filename, O_RDONLY);
+    if (fd < 0) {
+      g_free (program);
+      return FALSE;
+    }
+    found = ts_scan_program (fd, TS_PROGRAM_SCAN_SIZE, -1, program);
+    close (fd);
+  }
+
+  if (found) {
+    for (i = 0; i < program->n_streams; i++) {
+      if (TS_CODEC_IS_VIDEO (program->streams[i].codec)) {
+        app->a_source_pids[app->no_source_pids++] = program->streams[i].pid;
+        break;
+      }
+    }
+    for (i = 0; i < program->n_streams && app->no_source_pids < MAX_PIDS;
+        i++) {
+      switch (program->streams[i].codec) {
+        case TS_CODEC_MPEG_AUDIO:
+        case TS_CODEC_AC3:
+        case TS_CODEC_DTS:
+          app->a_source_pids[app->no_source_pids++] = program->streams[i].pid;
+          break;
+        case TS_CODEC_AAC:
+        case TS_CODEC_EAC3:
+        case TS_CODEC_LPCM:
+          /* there are no parsers for these, only passed through */
+          if (app->audio_mode == BDREMUX_AUDIO_PASSTHROUGH) {
+            app->a_source_pids[app->no_source_pids++] = program->streams[i].pid;
+            break;
+          }
+          /* fall through */
+        default:
+          GST_INFO ("not carrying over PID 0x%04x (stream type 0x%02x)",
+              program->streams[i].pid, program->streams[i].stream_type);
+          break;
+      }
+    }
+  }
+  g_free (program);
+
+  if (!found || app->no_source_pids == 0) {
+    GST_WARNING ("no PMT found, waiting for queue overrun to detect PIDs");
+    app->no_source_pids = 0;
+    return FALSE;
+  }
+
+  for (i = 0; i < app->no_source_pids; i++)
+    GST_INFO ("discovered source PID 0x%04x", app->a_source_pids[i]);
+  app->auto_pids = FALSE;
+  app->discovered_pids = TRUE;
+  return TRUE;
+}
+
+/* registers the selected streams with the clip information under their
+ * result PIDs, the video stream first since the EP map is built for it */
+static void
+setup_clip_info (App * app)
+{
+  TsProgram *program;
+  TsStream *stream;
+  gboolean found;
+  int fd = -1;
+  guint i;
+
+  app->clip = clip_info_new ();
+  if (app->enable_fast || app->auto_pids)
+    return;
+
+  program = g_new0 (TsProgram, 1);
+  if (app->reader)
+    found = range_reader_scan_program (app->reader, app->a_source_pids[0],
+        program);
+  else {
+    fd = open (app->in_filename, O_RDONLY);
+    found = fd >= 0 && ts_scan_program (fd, TS_PROGRAM_SCAN_SIZE,
+        app->a_source_pids[0], program);
+  }
+  if (found) {
+    for (i = 0; i < app->no_source_pids; i++) {
+      gchar lang[4];
+      stream = ts_program_find_stream (program, app->a_source_pids[i]);
+      if (stream)
+        clip_info_add_stream (app->clip, app->a_sink_pids[i], stream->codec,
+            stream->stream_type,
+            ts_stream_get_language (stream, lang) ? lang : NULL);
+    }
+  }
+  g_free (program);
+  if (fd >= 0)
+    close (fd);
+}
+
+/* writes the CLPI and MPLS files of a clip, if asked for */
+static gboolean
+write_clip_files (App * app, ClipInfo * clip, const gchar * stream_filename,
+    const gchar * clpi_filename, const gchar * mpls_filename)
+{
+  gchar *basename, *ext;
+
+  if (clpi_filename && !clip_info_write_clpi (clip, clpi_filename)) {
+    job_error (app, "could not write clip information %s!", clpi_filename);
+    return FALSE;
+  }
+
+  if (mpls_filename) {
+    /* the playlist refers to the clip by the name of the stream file */
+    basename = g_path_get_basename (stream_filename);
+    if ((ext = strrchr (basename, '.')))
+      *ext = '\0';
+    if (!clip_info_write_mpls (clip, mpls_filename, basename)) {
+      job_error (app, "could not write playlist %s!", mpls_filename);
+      g_free (basename);
+      return FALSE;
+    }
+    g_free (basename);
+  }
+  return TRUE;
+}
+
+static gboolean
+write_clip_info (App * app)
+{
+  TsProgram *program;
+  gboolean found;
+  int fd = -1;
+
+  /* a result written to a descriptor is only known by what went into it,
+   * an indexed stream has been counted by the scan */
+  if (app->index_only)
+    GST_DEBUG ("indexed %" G_GUINT64_FORMAT " packets", app->clip->n_packets);
+  else if (IS_FD_PATH (app->out_filename))
+    app->clip->n_packets = app->bytes_written / M2TS_PACKET_SIZE;
+  else {
+    struct stat st;
+
+    fd = open (app->out_filename, O_RDONLY);
+    if (fd < 0) {
+      job_error (app, "could not open %s for reading! (%i)",
+          app->out_filename, errno);
+      return FALSE;
+    }
+    if (fstat (fd, &st) == 0)
+      app->clip->n_packets = st.st_size / M2TS_PACKET_SIZE;
+  }
+  if (!app->enable_fast && !app->index_only) {
+    /* the muxer picks the PSI PIDs on its own, look them up in the result */
+    program = g_new0 (TsProgram, 1);
+    if (fd >= 0)
+      found = ts_scan_program (fd, RESULT_SCAN_SIZE, -1, program);
+    else
+      found = ts_scan_program_data (app->result_head->data,
+          app->result_head->len, -1, program);
+    if (found) {
+      app->clip->pmt_pid = program->pmt_pid;
+      app->clip->pcr_pid = program->pcr_pid;
+    }
+    g_free (program);
+  }
+  if (fd >= 0)
+    close (fd);
+
+  return write_clip_files (app, app->clip, app->index_only ?
+      app->in_filename : app->out_filename, app->clpi_filename,
+      app->mpls_filename);
+}
+
+/* the clip information of a further result, which the fast remuxer has
+ * filled in but for its length */
+static gboolean
+write_result_clip_info (App * app, Result * result)
+{
+  struct stat st;
+
+  if (IS_FD_PATH (result->out_filename))
+    result->clip->n_packets =
+        result->counters->bytes_written / M2TS_PACKET_SIZE;
+  else if (stat (result->out_filename, &st) == 0)
+    result->clip->n_packets = st.st_size / M2TS_PACKET_SIZE;
+  return write_clip_files (app, result->clip, result->out_filename,
+      result->clpi_filename, result->mpls_filename);
+}
+
+static void
+fast_entry_point_cb (guint64 spn, gint64 pts, App * app)
+{
+  app->callbacks.entry_point (app, spn, pts, app->user_data);
+  if (app->stats)
+    job_stats_add_entry_point (app->stats);
+}
+
+static void
+fast_linked_cb (guint source_pid, guint sink_pid, const gchar * caps,
+    App * app)
+{
+  if (app->callbacks.linked)
+    app->callbacks.linked (app, source_pid, sink_pid, app->user_data);
+  if (app->callbacks.caps)
+    app->callbacks.caps (app, sink_pid, caps, app->user_data);
+  if (app->stats)
+    job_stats_add_stream (app->stats, source_pid, sink_pid);
+}
+
+static void
+fast_result_entry_point_cb (guint64 spn, gint64 pts, Result * result)
+{
+  App *app = result->app;
+
+  app->callbacks.result_entry_point (app, result->index, spn, pts,
+      app->user_data);
+}
+
+static void report_stats (App * app, guint64 bytes_read);
+
+static void
+fast_progress_cb (guint64 position, App * app)
+{
+  app->bytes_read = position;
+  if (app->callbacks.progress)
+    app->callbacks.progress (app, position, app->bytes_total, app->user_data);
+  if (app->stats && job_stats_due (app->stats, app->stats_interval))
+    report_stats (app, position);
+}
+
+/* the same remux for a further result, with its own streams, cuts and
+ * entry points */
+static void
+setup_fast_result (App * app, Result * result, const FastRemux * first,
+    FastRemux * fr)
+{
+  *fr = *first;
+  fr->out_filename = result->out_filename;
+  memcpy (fr->a_source_pids, result->a_source_pids,
+      sizeof (fr->a_source_pids));
+  memcpy (fr->a_sink_pids, result->a_sink_pids, sizeof (fr->a_sink_pids));
+  fr->no_source_pids = result->no_source_pids;
+  fr->no_sink_pids = result->no_sink_pids;
+  fr->auto_pids = result->no_source_pids == 0;
+  fr->ranges = result->ranges;
+  fr->clip = result->clip;
+  memset (&fr->checkpoint, 0, sizeof (fr->checkpoint));
+  fr->entry_point = NULL;
+  if (result->enable_indexing && app->callbacks.result_entry_point)
+    fr->entry_point = (FastEntryPointFunc) fast_result_entry_point_cb;
+  fr->linked = NULL;
+  fr->progress = NULL;
+  fr->user_data = result;
+  fr->counters = result->counters = g_new0 (FastCounters, 1);
+}
+
+static gboolean
+run_fast_remux (App * app, gchar ** error)
+{
+  FastRemux fr;
+  gboolean parallel, ret;
+  guint i;
+
+  if (app->segment_count && !app->ranges) {
+    *error = g_strdup ("the fast remuxer needs the .ap file to apply cutlists!");
+    return FALSE;
+  }
+
+  memset (&fr, 0, sizeof (fr));
+  fr.in_filename = app->in_filename;
+  fr.out_filename = app->out_filename;
+  memcpy (fr.a_source_pids, app->a_source_pids, sizeof (fr.a_source_pids));
+  memcpy (fr.a_sink_pids, app->a_sink_pids, sizeof (fr.a_sink_pids));
+  fr.no_source_pids = app->no_source_pids;
+  fr.no_sink_pids = app->no_sink_pids;
+  fr.auto_pids = app->auto_pids;
+  fr.ranges = app->ranges;
+  fr.clip = app->clip;
+  fr.input = app->input;
+  fr.follow = app->follow;
+  fr.output = app->output;
+  fr.checkpoint = app->checkpoint;
+  if (app->enable_indexing && app->callbacks.entry_point)
+    fr.entry_point = (FastEntryPointFunc) fast_entry_point_cb;
+  if (app->callbacks.linked || app->callbacks.caps || app->stats)
+    fr.linked = (FastLinkedFunc) fast_linked_cb;
+  if (app->callbacks.progress || app->stats)
+    fr.progress = (FastProgressFunc) fast_progress_cb;
+  fr.user_data = app;
+  fr.counters = app->counters = g_new0 (FastCounters, 1);
+
+  /* streams are read and written in one go */
+  parallel = app->n_jobs > 1 && app->ranges && app->ranges->len > 1;
+  if (parallel && (IS_FD_PATH (app->in_filename)
+          || IS_FD_PATH (app->out_filename))) {
+    GST_WARNING ("can't remux the parts of a stream in parallel");
+    parallel = FALSE;
+  }
+  if (parallel && app->checkpoint.interval) {
+    GST_WARNING ("checkpoints need the parts remuxed in order");
+    parallel = FALSE;
+  }
+  if (parallel && app->results) {
+    GST_WARNING ("several results are remuxed from one sequential read");
+    parallel = FALSE;
+  }
+  if (parallel)
+    ret = fast_remux_run_parallel (&fr, app->n_jobs, error);
+  else if (app->results) {
+    FastRemux *results = g_new (FastRemux, app->results->len + 1);
+    FastRemux **list = g_new (FastRemux *, app->results->len + 1);
+
+    results[0] = fr;
+    list[0] = &results[0];
+    for (i = 0; i < app->results->len; i++) {
+      setup_fast_result (app, g_ptr_array_index (app->results, i), &fr,
+          &results[i + 1]);
+      list[i + 1] = &results[i + 1];
+    }
+    ret = fast_remux_run_multi (list, app->results->len + 1, error);
+    g_free (list);
+    g_free (results);
+  } else
+    ret = fast_remux_run (&fr, error);
+
+  app->bytes_written = app->counters->bytes_written;
+  if (app->stats)
+    report_stats (app, app->bytes_read);
+  g_free (app->counters);
+  app->counters = NULL;
+  return ret;
+}
+
+/* resets everything that is specific to one remux job, the pipeline and
+ * its elements are kept */
+static void
+app_init_job (App * app)
+{
+  int i;
+
+  app->in_filename = NULL;
+  app->out_filename = NULL;
+  app->cuts_filename = NULL;
+  app->is_seekable = FALSE;
+  app->enable_indexing = FALSE;
+  app->enable_cutlist = FALSE;
+  app->enable_fast = FALSE;
+  app->index_only = FALSE;
+  app->audio_mode = BDREMUX_AUDIO_PARSE;
+  app->n_jobs = 1;
+  app->results = NULL;
+  app->segment_count = 0;
+  app->current_segment = 0;
+  app->seek_segments = NULL;
+  app->ranges = NULL;
+  app->reader = NULL;
+  app->in_fd = -1;
+
+  app->clpi_filename = NULL;
+  app->mpls_filename = NULL;
+  app->clip = NULL;
+
+  app->videoparser = NULL;
+  for (i = 0; i < MAX_PIDS; i++)
+    app->audioparsers[i] = NULL;
+  app->no_source_pids = 0;
+  app->no_sink_pids = 0;
+  app->requested_pid_count = 0;
+  app->auto_pids = TRUE;
+  app->discovered_pids = FALSE;
+  for (i = 0; i < MAX_PIDS; i++) {
+    app->a_sink_pids[i] = -1;
+  }
+  app->queue_size = BDREMUX_DEFAULT_QUEUE_SIZE;
+  app->queue_time = BDREMUX_DEFAULT_QUEUE_TIME;
+  memset (&app->input, 0, sizeof (app->input));
+  memset (&app->follow, 0, sizeof (app->follow));
+  memset (&app->checkpoint, 0, sizeof (app->checkpoint));
+  memset (&app->output, 0, sizeof (app->output));
+  app->input.cpu = app->output.cpu = app->remux_cpu = BDREMUX_ANY_CPU;
+  app->threaded = FALSE;
+  app->background = FALSE;
+  app->background_rate = BDREMUX_DEFAULT_BACKGROUND_RATE;
+  app->preallocate = FALSE;
+  app->bytes_written = 0;
+  app->error = NULL;
+}
+
+static void
+result_free (Result * result)
+{
+  g_free (result->out_filename);
+  g_free (result->cuts_filename);
+  g_free (result->clpi_filename);
+  g_free (result->mpls_filename);
+  g_free (result);
+}
+
+static void
+app_clear_job (App * app)
+{
+  if (app->results) {
+    g_ptr_array_foreach (app->results, (GFunc) result_free, NULL);
+    g_ptr_array_free (app->results, TRUE);
+  }
+  g_free (app->in_filename);
+  g_free (app->out_filename);
+  g_free (app->cuts_filename);
+  g_free (app->clpi_filename);
+  g_free (app->mpls_filename);
+  g_free (app->error);
+}
+
+/* the source is read once for all results, restricted to the cut ranges
+ * only if they are the same for all */
+static gboolean
+results_share_ranges (App * app)
+{
+  guint i;
+
+  for (i = 0; app->results && i < app->results->len; i++) {
+    Result *result = g_ptr_array_index (app->results, i);
+    if (!byte_ranges_equal (app->ranges, result->ranges))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* the further results come with cutlists and clip information of their
+ * own, they are only written by the fast remuxer */
+static gboolean
+prepare_results (App * app)
+{
+  guint i;
+
+  if (!app->enable_fast) {
+    job_error (app, "several results can only be remuxed in fast mode!");
+    return FALSE;
+  }
+  for (i = 0; i < app->results->len; i++) {
+    Result *result = g_ptr_array_index (app->results, i);
+
+    if (result->cuts_filename)
+      result->segment_count = load_cutlist (result->cuts_filename,
+          &result->segments);
+    if (result->segment_count && !(result->ranges = load_cut_ranges (app,
+                result->cuts_filename, result->segments,
+                result->segment_count))) {
+      job_error (app, "the fast remuxer needs the .ap file to apply "
+          "cutlist %s!", result->cuts_filename);
+      return FALSE;
+    }
+    if (result->ranges && app->follow.enabled) {
+      GST_WARNING ("cut ranges can't be followed, remuxing what's there");
+      app->follow.enabled = FALSE;
+    }
+    if (result->clpi_filename || result->mpls_filename)
+      result->clip = clip_info_new ();
+  }
+  return TRUE;
+}
+
+/* the amount of input the job is going to read, for the progress */
+static guint64
+input_size (App * app)
+{
+  struct stat st;
+  guint64 total = 0;
+  guint i;
+
+  if (IS_FD_PATH (app->in_filename) ? fstat (app->in_fd, &st) < 0
+      || !S_ISREG (st.st_mode) : stat (app->in_filename, &st) < 0)
+    return 0;
+  if (!app->ranges || !results_share_ranges (app))
+    return st.st_size;
+  for (i = 0; i < app->ranges->len; i++) {
+    ByteRange *range = &g_array_index (app->ranges, ByteRange, i);
+    guint64 end = MIN (range->end, (guint64) st.st_size);
+    if (end > range->start)
+      total += end - range->start;
+  }
+  return total;
+}
+
+static gboolean
+prepare_job (App * app)
+{
+  int i;
+
+  if (app->enable_cutlist)
+    app->segment_count = load_cutlist (app->cuts_filename,
+        &app->seek_segments);
+
+  /* a stream can't be seeked in, cuts are only skipped over */
+  if (app->segment_count && !(app->ranges = load_cut_ranges (app,
+              app->cuts_filename, app->seek_segments, app->segment_count))
+      && IS_FD_PATH (app->in_filename)) {
+    job_error (app, "cutting a stream needs the .ap file next to %s!",
+        app->cuts_filename);
+    return FALSE;
+  }
+
+  if (app->follow.enabled && app->ranges) {
+    GST_WARNING ("cut ranges can't be followed, remuxing what's there");
+    app->follow.enabled = FALSE;
+  }
+
+  /* the state of mpegtsmux can't be restored, nor can a stream be seeked.
+   * the journal keeps track of a single result */
+  if (app->checkpoint.interval && (!app->enable_fast
+          || IS_FD_PATH (app->in_filename)
+          || IS_FD_PATH (app->out_filename) || app->results)) {
+    if (app->checkpoint.resume) {
+      job_error (app, "only the fast remuxer can resume, a single result "
+          "from and to regular files!");
+      return FALSE;
+    }
+    GST_WARNING ("checkpoints are only written by the fast remuxer for a "
+        "single result between regular files");
+    app->checkpoint.interval = 0;
+  }
+
+  /* cut ranges, read ahead, following and streams go through appsrc
+   * instead of filesrc */
+  if ((app->ranges || app->input.mode != READ_AHEAD_NONE
+          || app->follow.enabled || IS_FD_PATH (app->in_filename))
+      && !app->enable_fast) {
+    if (IS_FD_PATH (app->in_filename))
+      app->in_fd = fd_path_dup (app->in_filename, STDIN_FILENO);
+    else
+      app->in_fd = open (app->in_filename, O_RDONLY);
+    if (app->in_fd < 0) {
+      job_error (app, "could not open %s for reading! (%i)", app->in_filename,
+          errno);
+      return FALSE;
+    }
+    app->reader = range_reader_new (app->in_fd, app->ranges, &app->input,
+        &app->follow);
+  }
+
+  if (app->auto_pids && !app->enable_fast)
+    discover_pids (app);
+
+  for (i = 0; i < app->segment_count; i++) {
+    GST_INFO ("segment count %i index %i in_pts %lld out_pts %lld", i,
+        app->seek_segments[i].index, app->seek_segments[i].in_pts,
+        app->seek_segments[i].out_pts);
+  }
+
+  for (i = 0; i < app->no_source_pids; i++) {
+    if (app->no_sink_pids <= i)
+      app->a_sink_pids[app->no_sink_pids++] = app->a_source_pids[i];
+    GST_DEBUG
+        ("source pid [%i] = 0x%04x, sink pid [%i] = 0x%04x app->no_sink_pids=%i",
+        i, app->a_source_pids[i], i, app->a_sink_pids[i], app->no_sink_pids);
+  }
+
+  if (app->clpi_filename || app->mpls_filename)
+    setup_clip_info (app);
+  if (app->results && !prepare_results (app))
+    return FALSE;
+  if (app->clip && !app->enable_fast && IS_FD_PATH (app->out_filename))
+    app->result_head = g_byte_array_new ();
+
+  app->bytes_read = 0;
+  /* a followed source has no known end, so no ETA and no preallocation */
+  app->bytes_total = app->follow.enabled ? 0 : input_size (app);
+  /* every packet kept gains a 4 byte header, the dropped ones make up for
+   * the padding at the end */
+  if (app->preallocate)
+    app->output.preallocate = app->bytes_total / TS_PACKET_SIZE *
+        M2TS_PACKET_SIZE;
+  return TRUE;
+}
+
+static void
+sink_handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    App * app)
+{
+  gchar *error = NULL;
+
+  if (app->error)
+    return;
+  if (!out_writer_write (app->writer, GST_BUFFER_DATA (buffer),
+          GST_BUFFER_SIZE (buffer), &error)) {
+    job_error (app, "%s", error);
+    g_free (error);
+    return;
+  }
+  app->bytes_written += GST_BUFFER_SIZE (buffer);
+  if (app->result_head && app->result_head->len < RESULT_SCAN_SIZE)
+    g_byte_array_append (app->result_head, GST_BUFFER_DATA (buffer),
+        MIN (GST_BUFFER_SIZE (buffer),
+            RESULT_SCAN_SIZE - app->result_head->len));
+  if (app->stats)
+    job_stats_add_written (app->stats, GST_BUFFER_SIZE (buffer));
+}
+
+/* builds the static part of the pipeline on first use and configures it
+ * for the current job. the source element is only replaced when the job
+ * switches between reading the whole file and reading cut ranges */
+static gboolean
+setup_pipeline (App * app)
+{
+  GstBus *bus;
+  gchar *error = NULL;
+  gboolean want_appsrc = app->reader != NULL;
+
+  if (!app->pipeline) {
+    app->tsdemux = gst_element_factory_make ("mpegtsdemux", "tsdemux");
+    if (!app->tsdemux) {
+      job_error (app, "mpegtsdemux not found! please install gst-plugin-mpegtsdemux!");
+      return FALSE;
+    }
+
+    app->m2tsmux = gst_element_factory_make ("mpegtsmux", "m2tsmux");
+    if (!app->m2tsmux) {
+      job_error (app, "mpegtsmux not found! please install gst-plugin-mpegtsmux!");
+      gst_object_unref (app->tsdemux);
+      return FALSE;
+    }
+
+    app->pipeline = gst_pipeline_new ("blu-ray movie stream remuxer");
+    g_assert (app->pipeline);
+
+    /* the muxer output goes through the writer instead of filesink, which
+     * would write every buffer as it comes */
+    app->sink = gst_element_factory_make ("fakesink", "sink");
+    g_object_set (G_OBJECT (app->sink), "sync", FALSE, "silent", TRUE,
+        "signal-handoffs", TRUE, NULL);
+    g_signal_connect (app->sink, "handoff", G_CALLBACK (sink_handoff_cb),
+        app);
+
+    app->queue = gst_element_factory_make ("multiqueue", "multiqueue");
+
+    gst_bin_add_many (GST_BIN (app->pipeline), app->tsdemux, app->queue,
+        app->m2tsmux, app->sink, NULL);
+
+    g_object_set (G_OBJECT (app->queue), "max-size-buffers", 0, NULL);
+    g_object_set (G_OBJECT (app->queue), "max-size-time", 0, NULL);
+
+    g_object_set (G_OBJECT (app->m2tsmux), "m2ts-mode", TRUE, NULL);
+    g_object_set (G_OBJECT (app->m2tsmux), "alignment", 32, NULL);
+
+    gst_element_link (app->m2tsmux, app->sink);
+
+    g_signal_connect (app->tsdemux, "pad-added", G_CALLBACK (demux_pad_added_cb),
+        app);
+
+    /* the messages are handled by the job's own thread */
+    bus = gst_pipeline_get_bus (GST_PIPELINE (app->pipeline));
+    gst_bus_set_sync_handler (bus, (GstBusSyncHandler) bus_sync_message, app);
+    app->bus_source = gst_bus_create_watch (bus);
+    g_source_set_callback (app->bus_source, (GSourceFunc) bus_message, app,
+        NULL);
+    g_source_attach (app->bus_source, app->context);
+    gst_object_unref (bus);
+  }
+
+  if (app->filesrc && app->source_is_appsrc != want_appsrc) {
+    gst_bin_remove (GST_BIN (app->pipeline), app->filesrc);
+    app->filesrc = NULL;
+  }
+  if (!app->filesrc) {
+    if (want_appsrc) {
+      GstCaps *caps = gst_caps_new_simple ("video/mpegts",
+          "systemstream", G_TYPE_BOOLEAN, TRUE,
+          "packetsize", G_TYPE_INT, TS_PACKET_SIZE, NULL);
+      app->filesrc = gst_element_factory_make ("appsrc", "filesrc");
+      if (!app->filesrc) {
+        job_error (app, "appsrc not found! please install gst-plugins-base!");
+        gst_caps_unref (caps);
+        return FALSE;
+      }
+      g_object_set (G_OBJECT (app->filesrc), "caps", caps, NULL);
+      gst_caps_unref (caps);
+      g_signal_connect (app->filesrc, "need-data",
+          G_CALLBACK (range_need_data_cb), app);
+    } else
+      app->filesrc = gst_element_factory_make ("filesrc", "filesrc");
+    app->source_is_appsrc = want_appsrc;
+    gst_bin_add (GST_BIN (app->pipeline), app->filesrc);
+    gst_element_link (app->filesrc, app->tsdemux);
+  }
+
+  if (!want_appsrc)
+    g_object_set (G_OBJECT (app->filesrc), "location", app->in_filename, NULL);
+
+  /* a fixed byte limit unless the queues are sized by time, see
+   * run_pipeline */
+  g_object_set (G_OBJECT (app->queue), "max-size-bytes", app->queue_size,
+      "max-size-time", (guint64) 0, NULL);
+
+  app->writer = out_writer_open (app->out_filename, &app->output, &error);
+  if (!app->writer) {
+    job_error (app, "%s", error);
+    g_free (error);
+    return FALSE;
+  }
+
+  /* the queue holds up to queue_size, the slabs for it and what the
+   * parsers and the muxer keep may take as much again */
+  app->pool = buf_pool_new (2 * (gsize) app->queue_size);
+
+  app->queue_cb_handler_id = g_signal_connect (app->queue, "overrun", G_CALLBACK (queue_filled_cb), app);
+
+  if (app->enable_indexing || app->clip) {
+    if (!app->index) {
+      app->index = g_object_new (drop_index_get_type (), NULL);
+      if (app->index) {
+        g_signal_connect (G_OBJECT (app->index), "entry_added",
+            G_CALLBACK (entry_added), app);
+        g_object_set (G_OBJECT (app->index), "resolver", 1, NULL);
+      }
+    }
+    if (app->index)
+      gst_element_set_index (app->m2tsmux, app->index);
+  } else if (app->index)
+    gst_element_set_index (app->m2tsmux, NULL);
+  return TRUE;
+}
+
+/* stops the pipeline and takes out everything that was added for the
+ * streams of the last job */
+static void
+reset_pipeline (App * app)
+{
+  guint i;
+
+  gst_element_set_state (app->pipeline, GST_STATE_NULL);
+
+  if (app->queue_cb_handler_id) {
+    g_signal_handler_disconnect (G_OBJECT (app->queue), app->queue_cb_handler_id);
+    app->queue_cb_handler_id = 0;
+  }
+  for (i = 0; i < app->n_request_pads; i++) {
+    gst_element_release_request_pad (app->queue, app->queue_sinkpads[i]);
+    gst_element_release_request_pad (app->m2tsmux, app->mux_sinkpads[i]);
+    gst_object_unref (app->queue_sinkpads[i]);
+    gst_object_unref (app->mux_sinkpads[i]);
+  }
+  app->n_request_pads = 0;
+  if (app->pool) {
+    buf_pool_unref (app->pool);
+    app->pool = NULL;
+  }
+
+  if (app->videoparser)
+    gst_bin_remove (GST_BIN (app->pipeline), app->videoparser);
+  app->videoparser = NULL;
+  for (i = 0; i < MAX_PIDS; i++) {
+    if (app->audioparsers[i])
+      gst_bin_remove (GST_BIN (app->pipeline), app->audioparsers[i]);
+    app->audioparsers[i] = NULL;
+  }
+}
+
+static void
+finish_result (App * app, Result * result)
+{
+  if (result->clip) {
+    if (!app->error && result->counters)
+      write_result_clip_info (app, result);
+    clip_info_free (result->clip);
+    result->clip = NULL;
+  }
+  g_free (result->counters);
+  result->counters = NULL;
+  if (result->ranges)
+    g_array_free (result->ranges, TRUE);
+  result->ranges = NULL;
+  free (result->segments);
+  result->segments = NULL;
+  result->segment_count = 0;
+}
+
+/* writes what was collected during the job and frees its resources */
+static void
+finish_job (App * app)
+{
+  guint i;
+
+  if (app->reader) {
+    range_reader_free (app->reader);
+    close (app->in_fd);
+    app->reader = NULL;
+  }
+
+  if (app->clip) {
+    if (!app->error)
+      write_clip_info (app);
+    clip_info_free (app->clip);
+    app->clip = NULL;
+  }
+  if (app->result_head)
+    g_byte_array_free (app->result_head, TRUE);
+  app->result_head = NULL;
+
+  if (app->ranges)
+    g_array_free (app->ranges, TRUE);
+  app->ranges = NULL;
+  free (app->seek_segments);
+  app->seek_segments = NULL;
+
+  for (i = 0; app->results && i < app->results->len; i++)
+    finish_result (app, g_ptr_array_index (app->results, i));
+}
+
+/* called once the pipeline has posted EOS or an error */
+static void
+pipeline_done (App * app, gboolean ok)
+{
+  g_main_loop_quit (app->loop);
+}
+
+/* filesrc knows its position, the cut ranges are counted while read */
+static gboolean
+input_position (App * app, guint64 * position)
+{
+  GstFormat fmt = GST_FORMAT_BYTES;
+  gint64 bytes;
+
+  if (app->reader) {
+    *position = app->bytes_read;
+    return TRUE;
+  }
+  if (!gst_element_query_position (app->filesrc, &fmt, &bytes) || bytes < 0)
+    return FALSE;
+  *position = bytes;
+  return TRUE;
+}
+
+static gboolean
+progress_timeout_cb (App * app)
+{
+  guint64 position;
+
+  if (input_position (app, &position))
+    app->callbacks.progress (app, position, app->bytes_total,
+        app->user_data);
+  return TRUE;
+}
+
+/* hands a snapshot of the job to the stats callback. the fast remuxer
+ * counts on its own, the pipeline is asked where it is */
+static void
+report_stats (App * app, guint64 bytes_read)
+{
+  BdremuxStats stats;
+  GstFormat fmt = GST_FORMAT_TIME;
+  gint64 time;
+
+  memset (&stats, 0, sizeof (stats));
+  stats.bytes_read = bytes_read;
+  stats.bytes_total = app->bytes_total;
+  stats.position = stats.duration = -1;
+  if (app->counters) {
+    job_stats_set_packets (app->stats, app->counters->packets);
+    job_stats_set_written (app->stats, app->counters->bytes_written);
+    stats.position = app->counters->position;
+  } else if (!app->enable_fast) {
+    if (app->pool) {
+      BufPoolStats pool;
+      buf_pool_get_stats (app->pool, &pool);
+      stats.pool_size = pool.size;
+      stats.pool_in_use = pool.in_use;
+      stats.pool_peak = pool.peak;
+      stats.pool_allocs = pool.allocs;
+      stats.pool_fallbacks = pool.fallbacks;
+    }
+    if (gst_element_query_position (app->pipeline, &fmt, &time) && time >= 0)
+      stats.position = GSTTIME_TO_MPEGTIME (time);
+    fmt = GST_FORMAT_TIME;
+    if (gst_element_query_duration (app->pipeline, &fmt, &time) && time >= 0)
+      stats.duration = GSTTIME_TO_MPEGTIME (time);
+  }
+  job_stats_snapshot (app->stats, &stats);
+  app->callbacks.stats (app, &stats, app->user_data);
+}
+
+static gboolean
+stats_timeout_cb (App * app)
+{
+  guint64 position = 0;
+
+  input_position (app, &position);
+  report_stats (app, position);
+  return TRUE;
+}
+
+static gboolean
+queue_limits_timeout_cb (App * app)
+{
+  queue_limits_update (app->queue_limits);
+  return TRUE;
+}
+
+static void
+run_pipeline (App * app)
+{
+  GSource *progress = NULL, *stats = NULL, *limits = NULL;
+  gchar *error = NULL;
+  guint64 position = 0;
+
+  if (app->n_jobs > 1)
+    GST_WARNING ("threads only apply to fast mode, remuxing serially");
+
+  if (!setup_pipeline (app))
+    return;
+
+  app->loop = g_main_loop_new (app->context, FALSE);
+  if (app->callbacks.progress) {
+    progress = g_timeout_source_new (PROGRESS_INTERVAL);
+    g_source_set_callback (progress, (GSourceFunc) progress_timeout_cb, app,
+        NULL);
+    g_source_attach (progress, app->context);
+  }
+  if (app->stats || app->queue_time) {
+    app->queue_counters = queue_counters_new ();
+    if (app->stats)
+      job_stats_set_queues (app->stats, app->queue_counters);
+  }
+  if (app->stats) {
+    stats = g_timeout_source_new (app->stats_interval);
+    g_source_set_callback (stats, (GSourceFunc) stats_timeout_cb, app, NULL);
+    g_source_attach (stats, app->context);
+  }
+  if (app->queue_time) {
+    app->queue_limits = queue_limits_new (app->queue, app->queue_counters,
+        app->queue_size, app->queue_time);
+    limits = g_timeout_source_new (QUEUE_LIMITS_INTERVAL);
+    g_source_set_callback (limits, (GSourceFunc) queue_limits_timeout_cb,
+        app, NULL);
+    g_source_attach (limits, app->context);
+  }
+
+  gst_element_set_state (app->pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (app->loop);
+
+  g_message ("stopping");
+
+  if (progress) {
+    g_source_destroy (progress);
+    g_source_unref (progress);
+  }
+  if (stats) {
+    g_source_destroy (stats);
+    g_source_unref (stats);
+    /* the last one while the pipeline still knows where it ended */
+    if (!input_position (app, &position))
+      position = app->bytes_total;
+    report_stats (app, position);
+  }
+  if (limits) {
+    g_source_destroy (limits);
+    g_source_unref (limits);
+    queue_limits_free (app->queue_limits);
+    app->queue_limits = NULL;
+  }
+  if (app->queue_counters) {
+    if (app->stats)
+      job_stats_set_queues (app->stats, NULL);
+    queue_counters_free (app->queue_counters);
+    app->queue_counters = NULL;
+  }
+
+  reset_pipeline (app);
+
+  g_main_loop_unref (app->loop);
+  app->loop = NULL;
+
+  if (!out_writer_close (app->writer, app->error ? NULL : &error)) {
+    job_error (app, "%s", error);
+    g_free (error);
+  }
+  app->writer = NULL;
+}
+
+/* reads the entry point map and the clip information back from a stream
+ * that has been remuxed before */
+static gboolean
+run_index (App * app, gchar ** error)
+{
+  IndexScan is;
+
+  if (app->enable_cutlist || app->no_source_pids || app->results)
+    GST_WARNING ("an existing stream is indexed as it is, ignoring cuts, "
+        "PIDs and further results");
+  if (app->clpi_filename || app->mpls_filename)
+    app->clip = clip_info_new ();
+  app->bytes_read = 0;
+  app->bytes_total = input_size (app);
+
+  memset (&is, 0, sizeof (is));
+  is.filename = app->in_filename;
+  is.input = app->input;
+  is.clip = app->clip;
+  if (app->enable_indexing && app->callbacks.entry_point)
+    is.entry_point = (FastEntryPointFunc) fast_entry_point_cb;
+  if (app->callbacks.linked || app->callbacks.caps || app->stats)
+    is.linked = (FastLinkedFunc) fast_linked_cb;
+  if (app->callbacks.progress || app->stats)
+    is.progress = (FastProgressFunc) fast_progress_cb;
+  is.user_data = app;
+
+  if (!index_scan_run (&is, error))
+    return FALSE;
+  if (app->stats)
+    report_stats (app, app->bytes_read);
+  return TRUE;
+}
+
+static gpointer
+job_thread_func (App * app)
+{
+  gchar *error = NULL;
+  IoPriority priority;
+
+  if (app->callbacks.stats)
+    app->stats = job_stats_new ();
+  if (app->threaded) {
+    /* this thread demultiplexes, filters and muxes, at least in fast mode
+     * and for the index. GStreamer does so on its streaming threads */
+    thread_set_cpu (app->remux_cpu, "remux");
+    if (app->input.mode == READ_AHEAD_NONE)
+      app->input.mode = READ_AHEAD_THREAD;
+  }
+  app->input.background = app->output.background = app->background;
+  if (app->background) {
+    /* the reader, writer, part and streaming threads lower their own */
+    io_set_background_priority (&priority);
+    app->input.throttle = io_throttle_new ("input",
+        (guint64) app->background_rate * 1024 * 1024);
+    app->output.throttle = io_throttle_new ("output",
+        (guint64) app->background_rate * 1024 * 1024);
+    /* without writing back right behind, the kernel flushes the result
+     * whenever it likes and the throttle never sees it */
+    if (app->output.sync == OUT_SYNC_NONE)
+      app->output.sync = OUT_SYNC_STREAM;
+  }
+  if (app->index_only) {
+    if (run_index (app, &error))
+      g_message ("index rebuilt");
+    else {
+      job_set_error (app, error);
+      g_free (error);
+    }
+  } else if (prepare_job (app)) {
+    if (app->enable_fast) {
+      if (run_fast_remux (app, &error))
+        g_message ("fast remux finished");
+      else {
+        job_set_error (app, error);
+        g_free (error);
+      }
+    } else
+      run_pipeline (app);
+  }
+  finish_job (app);
+  if (app->stats) {
+    job_stats_free (app->stats);
+    app->stats = NULL;
+  }
+  if (app->input.throttle) {
+    io_throttle_free (app->input.throttle);
+    io_throttle_free (app->output.throttle);
+    app->input.throttle = app->output.throttle = NULL;
+  }
+  if (app->background)
+    io_restore_priority (&priority);
+
+  if (app->callbacks.finished)
+    app->callbacks.finished (app, app->error, app->user_data);
+  return NULL;
+}
+
+void
+bdremux_init (int *argc, char **argv[])
+{
+  gst_init (argc, argv);
+  GST_DEBUG_CATEGORY_INIT (bdremux_debug, "BDREMUX", GST_DEBUG_BOLD|GST_DEBUG_FG_YELLOW|GST_DEBUG_BG_BLUE, "blu-ray movie stream remuxer");
+}
+
+/* tells the streams of filename, their codecs, PTS range and the bitrate
+ * without running a job. only PAT/PMT and a few MB at the head and tail of
+ * the file are read */
+gboolean
+bdremux_probe (const gchar * filename, BdremuxProbe * probe, gchar ** error)
+{
+  TsProbe *tp;
+  gchar *reason = NULL;
+  gboolean ret;
+  guint i;
+  int fd;
+
+  if (IS_FD_PATH (filename))
+    fd = fd_path_dup (filename, STDIN_FILENO);
+  else
+    fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    if (error)
+      *error = g_strdup_printf ("could not open %s for reading! (%i)",
+          filename, errno);
+    return FALSE;
+  }
+  tp = g_new0 (TsProbe, 1);
+  ret = ts_probe (fd, tp, &reason);
+  close (fd);
+  if (!ret) {
+    if (error)
+      *error = g_strdup_printf ("could not probe %s: %s", filename, reason);
+    g_free (reason);
+    g_free (tp);
+    return FALSE;
+  }
+
+  memset (probe, 0, sizeof (BdremuxProbe));
+  probe->size = tp->size;
+  probe->packet_size = tp->packet_size;
+  probe->program_number = tp->program.program_number;
+  probe->pmt_pid = tp->program.pmt_pid;
+  probe->pcr_pid = tp->program.pcr_pid;
+  probe->duration = tp->duration;
+  probe->bitrate = tp->bitrate;
+  probe->n_streams = MIN (tp->program.n_streams, BDREMUX_MAX_PROBE_STREAMS);
+  for (i = 0; i < probe->n_streams; i++) {
+    TsStream *stream = &tp->program.streams[i];
+    BdremuxProbeStream *ps = &probe->streams[i];
+
+    ps->pid = stream->pid;
+    ps->stream_type = stream->stream_type;
+    ps->caps = ts_codec_caps_name (stream->codec);
+    if (!ts_stream_get_language (stream, ps->language))
+      ps->language[0] = '\0';
+    ps->first_pts = tp->streams[i].first_pts;
+    ps->last_pts = tp->streams[i].last_pts;
+  }
+  g_free (tp);
+  return TRUE;
+}
+
+/* reads filename once with read ahead and compares it with the manifest
+ * written next to it. FALSE only if it couldn't be checked, whether it
+ * matches is in verify */
+gboolean
+bdremux_verify (const gchar * filename, BdremuxVerify * verify,
+    gchar ** error)
+{
+  ReadAheadSettings input;
+  RangeReader *reader;
+  Manifest *m;
+  Checksum *c;
+  GTimer *timer;
+  guint8 *buf;
+  gchar *reason = NULL;
+  gboolean discont;
+  gssize len;
+  guint i, n;
+  int fd;
+
+  m = manifest_read (filename, &reason);
+  if (!m) {
+    if (error)
+      *error = reason;
+    else
+      g_free (reason);
+    return FALSE;
+  }
+  fd = open (filename, O_RDONLY);
+  if (fd < 0) {
+    if (error)
+      *error = g_strdup_printf ("could not open %s for reading! (%i)",
+          filename, errno);
+    manifest_free (m);
+    return FALSE;
+  }
+
+  memset (&input, 0, sizeof (input));
+  input.mode = READ_AHEAD_THREAD;
+  input.block_size = READ_AHEAD_BLOCK_SIZE;
+  input.depth = READ_AHEAD_DEPTH;
+  input.cpu = BDREMUX_ANY_CPU;
+  reader = range_reader_new (fd, NULL, &input, NULL);
+  c = checksum_new (m->type, m->units != NULL);
+  buf = g_malloc (input.block_size);
+  timer = g_timer_new ();
+  while ((len = range_reader_read (reader, buf, input.block_size,
+              &discont)) > 0)
+    checksum_update (c, buf, len);
+  if (len < 0 && error)
+    *error = g_strdup_printf ("could not read from %s! (%i)", filename,
+        errno);
+
+  memset (verify, 0, sizeof (BdremuxVerify));
+  verify->checksum = (BdremuxChecksum) m->type;
+  verify->size = c->size;
+  verify->expected_size = m->size;
+  verify->checksum_ok = !g_ascii_strcasecmp (checksum_finish (c), m->digest);
+  verify->first_bad_unit = -1;
+  if (m->units) {
+    /* units missing on either side count as bad */
+    verify->n_units = m->units->len;
+    n = MAX (m->units->len, c->units->len);
+    for (i = 0; i < n; i++) {
+      if (i < m->units->len && i < c->units->len
+          && g_array_index (m->units, guint32, i) ==
+          g_array_index (c->units, guint32, i))
+        continue;
+      if (verify->first_bad_unit < 0)
+        verify->first_bad_unit = i;
+      verify->bad_units++;
+    }
+  }
+  verify->ok = verify->size == verify->expected_size && verify->checksum_ok
+      && verify->bad_units == 0;
+  verify->seconds = g_timer_elapsed (timer, NULL);
+  GST_INFO ("verified %s: %" G_GUINT64_FORMAT " bytes in %.1f s, %s",
+      filename, verify->size, verify->seconds, verify->ok ? "ok" : "damaged");
+
+  g_timer_destroy (timer);
+  g_free (buf);
+  checksum_free (c);
+  range_reader_free (reader);
+  close (fd);
+  manifest_free (m);
+  return len == 0;
+}
+
+BdremuxJob *
+bdremux_job_new (const gchar * in_filename, const gchar * out_filename)
+{
+  App *app = g_new0 (App, 1);
+
+  app->context = g_main_context_new ();
+  app->stats_interval = BDREMUX_DEFAULT_STATS_INTERVAL;
+  app_init_job (app);
+  app->in_filename = g_strdup (in_filename);
+  app->out_filename = g_strdup (out_filename);
+  return app;
+}
+
+/* forgets the settings of the last run, the pipeline is kept for the next
+ * one. the job must not be running */
+void
+bdremux_job_reset (BdremuxJob * job, const gchar * in_filename,
+    const gchar * out_filename)
+{
+  g_return_if_fail (job->thread == NULL);
+
+  app_clear_job (job);
+  app_init_job (job);
+  job->in_filename = g_strdup (in_filename);
+  job->out_filename = g_strdup (out_filename);
+}
+
+void
+bdremux_job_free (BdremuxJob * job)
+{
+  if (job->thread)
+    bdremux_job_wait (job);
+
+  if (job->pipeline) {
+    gst_element_set_state (job->pipeline, GST_STATE_NULL);
+    g_source_destroy (job->bus_source);
+    g_source_unref (job->bus_source);
+    gst_object_unref (job->pipeline);
+  }
+  if (job->index)
+    gst_object_unref (job->index);
+  g_main_context_unref (job->context);
+  app_clear_job (job);
+  g_free (job);
+}
+
+/* without source PIDs the streams are taken from the PMT, without sink PIDs
+ * they keep their PIDs */
+void
+bdremux_job_set_pids (BdremuxJob * job, const gint * source_pids,
+    guint n_source_pids, const gint * sink_pids, guint n_sink_pids)
+{
+  guint i;
+
+  job->no_source_pids = MIN (n_source_pids, MAX_PIDS);
+  job->no_sink_pids = MIN (n_sink_pids, MAX_PIDS);
+  for (i = 0; i < MAX_PIDS; i++) {
+    job->a_source_pids[i] = i < job->no_source_pids ? source_pids[i] : 0;
+    job->a_sink_pids[i] = i < job->no_sink_pids ? sink_pids[i] : -1;
+  }
+  job->auto_pids = job->no_source_pids == 0;
+}
+
+/* enigma2 .cuts file to apply, NULL to remux everything */
+void
+bdremux_job_set_cutlist (BdremuxJob * job, const gchar * cuts_filename)
+{
+  g_free (job->cuts_filename);
+  job->cuts_filename = g_strdup (cuts_filename);
+  job->enable_cutlist = cuts_filename != NULL;
+}
+
+void
+bdremux_job_set_fast (BdremuxJob * job, gboolean fast)
+{
+  job->enable_fast = fast;
+}
+
+/* rebuilds the entry point map and clip information of a stream remuxed
+ * before instead of remuxing it, the result is not written */
+void
+bdremux_job_set_index_only (BdremuxJob * job, gboolean index_only)
+{
+  job->index_only = index_only;
+}
+
+/* whether audio is framed by the GStreamer parsers or its PES are handed
+ * to the mux as demuxed, fast mode never parses audio */
+void
+bdremux_job_set_audio_mode (BdremuxJob * job, BdremuxAudioMode mode)
+{
+  job->audio_mode = mode;
+}
+
+/* the number of cut segments remuxed at the same time in fast mode */
+void
+bdremux_job_set_threads (BdremuxJob * job, guint n_threads)
+{
+  job->n_jobs = MAX (n_threads, 1);
+}
+
+/* the most a stream may take in the multiqueue until all are linked, and
+ * with a queue time the upper limit afterwards */
+void
+bdremux_job_set_queue_size (BdremuxJob * job, guint queue_size)
+{
+  job->queue_size = queue_size;
+}
+
+/* how much of each stream is queued for the mux to interleave them once
+ * all are linked, in ms. the byte limit then follows the bitrates. 0 keeps
+ * the queue size as the only limit */
+void
+bdremux_job_set_queue_time (BdremuxJob * job, guint queue_time_ms)
+{
+  job->queue_time = queue_time_ms;
+}
+
+/* whether the entry_point callback is invoked */
+void
+bdremux_job_set_entry_points (BdremuxJob * job, gboolean enable)
+{
+  job->enable_indexing = enable;
+}
+
+/* how the source is read. block_size and depth may be 0 for the defaults */
+void
+bdremux_job_set_input (BdremuxJob * job, BdremuxReadAhead read_ahead,
+    gsize block_size, guint depth)
+{
+  job->input.mode = (ReadAheadMode) read_ahead;
+  job->input.block_size = block_size;
+  job->input.depth = depth;
+}
+
+/* remux a recording still in progress: at the end of the source wait for
+ * more data until the writer closes it or nothing has been appended for
+ * idle_timeout_ms, 0 for the default */
+void
+bdremux_job_set_follow (BdremuxJob * job, gboolean follow,
+    guint idle_timeout_ms)
+{
+  job->follow.enabled = follow;
+  job->follow.idle_timeout = idle_timeout_ms ? idle_timeout_ms :
+      BDREMUX_DEFAULT_FOLLOW_TIMEOUT;
+}
+
+/* with enable the fast remuxer notes where it could carry on every
+ * interval_ms (0 for the default) in a journal next to the result, which is
+ * removed once it's complete. with resume it continues from the last
+ * checkpoint there, if any. without enable neither happens */
+void
+bdremux_job_set_checkpoint (BdremuxJob * job, gboolean enable,
+    guint interval_ms, gboolean resume)
+{
+  if (!enable) {
+    job->checkpoint.interval = 0;
+    job->checkpoint.resume = FALSE;
+    return;
+  }
+  job->checkpoint.interval = interval_ms ? interval_ms :
+      BDREMUX_DEFAULT_CHECKPOINT_INTERVAL;
+  job->checkpoint.resume = resume;
+}
+
+/* how the result is written. direct_io bypasses the page cache, preallocate
+ * reserves the estimated size up front */
+void
+bdremux_job_set_output (BdremuxJob * job, gboolean direct_io,
+    gboolean preallocate, BdremuxSyncPolicy sync)
+{
+  job->output.direct = direct_io;
+  job->output.sync = (OutSyncPolicy) sync;
+  job->preallocate = preallocate;
+}
+
+/* reads ahead, remuxes and writes on three threads which hand the blocks
+ * of their pools on through lock-free rings, each pinned to its CPU unless
+ * that is BDREMUX_ANY_CPU */
+void
+bdremux_job_set_pipeline (BdremuxJob * job, gboolean threaded,
+    gint reader_cpu, gint remux_cpu, gint writer_cpu)
+{
+  job->threaded = threaded;
+  job->input.cpu = reader_cpu;
+  job->remux_cpu = remux_cpu;
+  job->output.threaded = threaded;
+  job->output.cpu = writer_cpu;
+}
+
+/* runs the job with idle CPU and I/O priority, reading and writing at
+ * most max_rate MB/s each and less while the disk is busy */
+void
+bdremux_job_set_background (BdremuxJob * job, gboolean background,
+    guint max_rate)
+{
+  job->background = background;
+  job->background_rate = max_rate ? max_rate :
+      BDREMUX_DEFAULT_BACKGROUND_RATE;
+}
+
+/* hashes the result while it's written and puts the checksum, and with
+ * unit_crcs a CRC32C of every aligned unit, into a manifest next to it */
+void
+bdremux_job_set_checksum (BdremuxJob * job, BdremuxChecksum checksum,
+    gboolean unit_crcs)
+{
+  job->output.checksum = (ChecksumType) checksum;
+  job->output.unit_crcs = unit_crcs;
+}
+
+void
+bdremux_job_set_clip_info (BdremuxJob * job, const gchar * clpi_filename,
+    const gchar * mpls_filename)
+{
+  g_free (job->clpi_filename);
+  g_free (job->mpls_filename);
+  job->clpi_filename = g_strdup (clpi_filename);
+  job->mpls_filename = g_strdup (mpls_filename);
+}
+
+void
+bdremux_job_set_callbacks (BdremuxJob * job,
+    const BdremuxCallbacks * callbacks, gpointer user_data)
+{
+  if (callbacks)
+    job->callbacks = *callbacks;
+  else
+    memset (&job->callbacks, 0, sizeof (job->callbacks));
+  job->user_data = user_data;
+}
+
+/* how often the stats callback gets a snapshot while the job runs */
+void
+bdremux_job_set_stats_interval (BdremuxJob * job, guint interval_ms)
+{
+  job->stats_interval = interval_ms ? interval_ms :
+      BDREMUX_DEFAULT_STATS_INTERVAL;
+}
+
+/* adds a further result remuxed from the same pass over the source, in
+ * fast mode only. returns the number the result is set up with and
+ * reported by, the first result of the job being 0 */
+guint
+bdremux_job_add_result (BdremuxJob * job, const gchar * out_filename)
+{
+  Result *result;
+  guint i;
+
+  g_return_val_if_fail (!job->results
+      || job->results->len + 1 < BDREMUX_MAX_RESULTS, 0);
+
+  result = g_new0 (Result, 1);
+  result->app = job;
+  result->out_filename = g_strdup (out_filename);
+  for (i = 0; i < MAX_PIDS; i++)
+    result->a_sink_pids[i] = -1;
+  if (!job->results)
+    job->results = g_ptr_array_new ();
+  g_ptr_array_add (job->results, result);
+  result->index = job->results->len;
+  return result->index;
+}
+
+static Result *
+get_result (BdremuxJob * job, guint result)
+{
+  g_return_val_if_fail (job->results && result > 0
+      && result <= job->results->len, NULL);
+  return g_ptr_array_index (job->results, result - 1);
+}
+
+void
+bdremux_job_set_result_pids (BdremuxJob * job, guint result,
+    const gint * source_pids, guint n_source_pids, const gint * sink_pids,
+    guint n_sink_pids)
+{
+  Result *r;
+  guint i;
+
+  if (result == 0) {
+    bdremux_job_set_pids (job, source_pids, n_source_pids, sink_pids,
+        n_sink_pids);
+    return;
+  }
+  if (!(r = get_result (job, result)))
+    return;
+  r->no_source_pids = MIN (n_source_pids, MAX_PIDS);
+  r->no_sink_pids = MIN (n_sink_pids, MAX_PIDS);
+  for (i = 0; i < MAX_PIDS; i++) {
+    r->a_source_pids[i] = i < r->no_source_pids ? source_pids[i] : 0;
+    r->a_sink_pids[i] = i < r->no_sink_pids ? sink_pids[i] : -1;
+  }
+}
+
+void
+bdremux_job_set_result_cutlist (BdremuxJob * job, guint result,
+    const gchar * cuts_filename)
+{
+  Result *r;
+
+  if (result == 0) {
+    bdremux_job_set_cutlist (job, cuts_filename);
+    return;
+  }
+  if (!(r = get_result (job, result)))
+    return;
+  g_free (r->cuts_filename);
+  r->cuts_filename = g_strdup (cuts_filename);
+}
+
+void
+bdremux_job_set_result_entry_points (BdremuxJob * job, guint result,
+    gboolean enable)
+{
+  Result *r;
+
+  if (result == 0) {
+    bdremux_job_set_entry_points (job, enable);
+    return;
+  }
+  if ((r = get_result (job, result)))
+    r->enable_indexing = enable;
+}
+
+void
+bdremux_job_set_result_clip_info (BdremuxJob * job, guint result,
+    const gchar * clpi_filename, const gchar * mpls_filename)
+{
+  Result *r;
+
+  if (result == 0) {
+    bdremux_job_set_clip_info (job, clpi_filename, mpls_filename);
+    return;
+  }
+  if (!(r = get_result (job, result)))
+    return;
+  g_free (r->clpi_filename);
+  g_free (r->mpls_filename);
+  r->clpi_filename = g_strdup (clpi_filename);
+  r->mpls_filename = g_strdup (mpls_filename);
+}
+
+const gchar *
+bdremux_job_get_in_filename (BdremuxJob * job)
+{
+  return job->in_filename;
+}
+
+const gchar *
+bdremux_job_get_out_filename (BdremuxJob * job)
+{
+  return job->out_filename;
+}
+
+/* runs the job on a thread of its own, finished is called at the end */
+gboolean
+bdremux_job_start (BdremuxJob * job, gchar ** error)
+{
+  GError *gerror = NULL;
+
+  g_return_val_if_fail (job->thread == NULL, FALSE);
+
+  g_free (job->error);
+  job->error = NULL;
+#if GLIB_CHECK_VERSION(2,32,0)
+  job->thread = g_thread_try_new ("bdremux", (GThreadFunc) job_thread_func,
+      job, &gerror);
+#else
+  job->thread = g_thread_create ((GThreadFunc) job_thread_func, job, TRUE,
+      &gerror);
+#endif
+  if (!job->thread) {
+    if (error)
+      *error = g_strdup_printf ("could not start job thread! (%s)",
+          gerror->message);
+    g_error_free (gerror);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* waits for the job to end, returns FALSE if it failed */
+gboolean
+bdremux_job_wait (BdremuxJob * job)
+{
+  if (job->thread) {
+    g_thread_join (job->thread);
+    job->thread = NULL;
+  }
+  return job->error == NULL;
+}
+
+const gchar *
+bdremux_job_get_error (BdremuxJob * job)
+{
+  return job->error;
+}
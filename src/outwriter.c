@@ -0,0 +1,480 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "outwriter.h"
+
+static gboolean
+write_all (OutWriter * w, const guint8 * data, gsize len, gchar ** error)
+{
+  while (len) {
+    gssize ret = write (w->fd, data, len);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (error)
+        *error = g_strdup_printf ("could not write to %s! (%i)", w->filename,
+            errno);
+      return FALSE;
+    }
+    data += ret;
+    len -= ret;
+  }
+  return TRUE;
+}
+
+/* starts the write back of the block just written and waits for the one
+ * before, which is then dropped from the page cache. the dirty data of a
+ * long remux thus never piles up and pushes out everybody else's pages */
+static void
+write_back (OutWriter * w, guint64 start, guint64 end)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+  sync_file_range (w->fd, start, end - start, SYNC_FILE_RANGE_WRITE);
+  if (start > w->written_back) {
+    sync_file_range (w->fd, w->written_back, start - w->written_back,
+        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+        SYNC_FILE_RANGE_WAIT_AFTER);
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise (w->fd, w->written_back, start - w->written_back,
+        POSIX_FADV_DONTNEED);
+#endif
+  }
+  w->written_back = start;
+#else
+  fdatasync (w->fd);
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise (w->fd, w->written_back, end - w->written_back,
+      POSIX_FADV_DONTNEED);
+#endif
+  w->written_back = end;
+#endif
+}
+
+static gpointer
+writer_thread (OutWriter * w)
+{
+  OutBlock *block;
+  IoPriority priority;
+
+  thread_set_cpu (w->settings.cpu, "writer");
+  if (w->settings.background)
+    io_set_background_priority (&priority);
+  while ((block = spsc_ring_pop (w->full_blocks, &w->stop))) {
+    /* after a failure the blocks only go round until the job ends */
+    if (!g_atomic_int_get (&w->failed)) {
+      gint64 start = io_throttle_begin (w->settings.throttle);
+      if (w->checksum)
+        checksum_update (w->checksum, block->data, block->len);
+      if (!write_all (w, block->data, block->len, NULL))
+        g_atomic_int_set (&w->failed, errno);
+      else if (w->settings.sync == OUT_SYNC_STREAM && !w->settings.direct)
+        write_back (w, block->offset, block->offset + block->len);
+      io_throttle_end (w->settings.throttle, start, block->len);
+    }
+    spsc_ring_push (w->free_blocks, block);
+    if (g_atomic_int_dec_and_test (&w->in_flight)
+        && g_atomic_int_get (&w->draining)) {
+      MUTEX_LOCK (w->lock);
+      COND_SIGNAL (w->drained);
+      MUTEX_UNLOCK (w->lock);
+    }
+  }
+  if (w->settings.background)
+    io_restore_priority (&priority);
+  return NULL;
+}
+
+static gboolean
+thread_failed (OutWriter * w, gchar ** error)
+{
+  gint failed = g_atomic_int_get (&w->failed);
+
+  if (failed && error)
+    *error = g_strdup_printf ("could not write to %s! (%i)", w->filename,
+        failed);
+  return failed != 0;
+}
+
+/* waits until the thread has written every block handed to it */
+static gboolean
+drain (OutWriter * w, gchar ** error)
+{
+  if (g_atomic_int_get (&w->in_flight)) {
+    MUTEX_LOCK (w->lock);
+    g_atomic_int_set (&w->draining, 1);
+    while (g_atomic_int_get (&w->in_flight))
+      COND_WAIT (w->drained, w->lock);
+    g_atomic_int_set (&w->draining, 0);
+    MUTEX_UNLOCK (w->lock);
+  }
+  return !thread_failed (w, error);
+}
+
+/* hands the block to the thread and continues in the next free one,
+ * waiting for it while all are being written */
+static gboolean
+queue_block (OutWriter * w, gchar ** error)
+{
+  if (thread_failed (w, error))
+    return FALSE;
+  w->current->len = w->fill;
+  w->current->offset = w->offset;
+  g_atomic_int_add (&w->in_flight, 1);
+  spsc_ring_push (w->full_blocks, w->current);
+  w->current = spsc_ring_pop (w->free_blocks, NULL);
+  w->block = w->current->data;
+  w->offset += w->fill;
+  w->fill = 0;
+  return TRUE;
+}
+
+static void
+writer_start (OutWriter * w)
+{
+  GError *gerror = NULL;
+  void *data;
+  guint i;
+
+  w->blocks = g_new0 (OutBlock, OUT_WRITER_DEPTH);
+  w->full_blocks = spsc_ring_new (OUT_WRITER_DEPTH);
+  w->free_blocks = spsc_ring_new (OUT_WRITER_DEPTH);
+  w->blocks[0].data = w->block;
+  w->current = &w->blocks[0];
+  for (i = 1; i < OUT_WRITER_DEPTH; i++) {
+    if (posix_memalign (&data, OUT_WRITER_ALIGNMENT, OUT_WRITER_BLOCK_SIZE))
+      break;
+    w->blocks[i].data = data;
+    spsc_ring_push (w->free_blocks, &w->blocks[i]);
+  }
+  if (i < OUT_WRITER_DEPTH) {
+    GST_WARNING ("could not allocate the blocks of the writer thread");
+    return;
+  }
+  MUTEX_INIT (w->lock);
+  COND_INIT (w->drained);
+#if GLIB_CHECK_VERSION(2,32,0)
+  w->thread = g_thread_try_new ("writer", (GThreadFunc) writer_thread, w,
+      &gerror);
+#else
+  w->thread = g_thread_create ((GThreadFunc) writer_thread, w, TRUE, &gerror);
+#endif
+  if (!w->thread) {
+    GST_WARNING ("could not start the writer thread (%s)", gerror->message);
+    g_error_free (gerror);
+    MUTEX_CLEAR (w->lock);
+    COND_CLEAR (w->drained);
+  }
+}
+
+static void
+writer_stop (OutWriter * w)
+{
+  guint i;
+
+  if (w->thread) {
+    g_atomic_int_set (&w->stop, 1);
+    spsc_ring_wake (w->full_blocks);
+    g_thread_join (w->thread);
+    w->thread = NULL;
+    MUTEX_CLEAR (w->lock);
+    COND_CLEAR (w->drained);
+  }
+  for (i = 0; i < OUT_WRITER_DEPTH; i++)
+    if (w->blocks[i].data != w->block)
+      free (w->blocks[i].data);
+  spsc_ring_free (w->full_blocks);
+  spsc_ring_free (w->free_blocks);
+  g_free (w->blocks);
+  w->blocks = NULL;
+}
+
+static gboolean
+flush_block (OutWriter * w, gchar ** error)
+{
+  gint64 start;
+
+  if (w->thread)
+    return queue_block (w, error);
+  start = io_throttle_begin (w->settings.throttle);
+  if (w->checksum)
+    checksum_update (w->checksum, w->block, w->fill);
+  if (!write_all (w, w->block, w->fill, error))
+    return FALSE;
+  w->offset += w->fill;
+  /* O_DIRECT doesn't go through the page cache anyway */
+  if (w->settings.sync == OUT_SYNC_STREAM && !w->settings.direct)
+    write_back (w, w->offset - w->fill, w->offset);
+  /* the write back waited for is what tells how busy the disk is */
+  io_throttle_end (w->settings.throttle, start, w->fill);
+  w->fill = 0;
+  return TRUE;
+}
+
+/* a resumed result is hashed from the start, the whole blocks before the
+ * one it continues in have to be read once more */
+static gboolean
+hash_written (OutWriter * w, gchar ** error)
+{
+  guint64 offset;
+
+  for (offset = 0; offset < w->offset; offset += w->block_size) {
+    if (pread (w->fd, w->block, w->block_size, offset) <
+        (gssize) w->block_size) {
+      *error = g_strdup_printf ("could not read back %s! (%i)", w->filename,
+          errno);
+      return FALSE;
+    }
+    checksum_update (w->checksum, w->block, w->block_size);
+  }
+  return TRUE;
+}
+
+/* continues a result written up to size before: the block it ends in is
+ * read back, so the blocks are written where they would have been */
+static gboolean
+resume_at (OutWriter * w, guint64 size, gchar ** error)
+{
+  struct stat st;
+  gsize len;
+
+  if (fstat (w->fd, &st) < 0 || (guint64) st.st_size < size) {
+    *error = g_strdup_printf ("%s ends before the checkpoint!", w->filename);
+    return FALSE;
+  }
+  w->offset = size - size % w->block_size;
+  w->fill = size - w->offset;
+  if (w->checksum && !hash_written (w, error))
+    return FALSE;
+  /* O_DIRECT reads whole pages as well */
+  len = (w->fill + OUT_WRITER_ALIGNMENT - 1) & ~(OUT_WRITER_ALIGNMENT - 1);
+  if ((w->fill && pread (w->fd, w->block, len, w->offset) < (gssize) w->fill)
+      || ftruncate (w->fd, size) < 0
+      || lseek (w->fd, w->offset, SEEK_SET) < 0) {
+    *error = g_strdup_printf ("could not resume %s! (%i)", w->filename,
+        errno);
+    return FALSE;
+  }
+  w->written_back = w->offset;
+  GST_INFO ("resuming %s at %" G_GUINT64_FORMAT, w->filename, size);
+  return TRUE;
+}
+
+OutWriter *
+out_writer_open (const gchar * filename, const OutWriterSettings * settings,
+    gchar ** error)
+{
+  OutWriter *w = g_new0 (OutWriter, 1);
+  int flags = settings->resume ? O_RDWR | O_CREAT : O_WRONLY | O_CREAT
+      | O_TRUNC;
+  struct stat st;
+  void *block;
+
+  w->filename = g_strdup (filename);
+  w->settings = *settings;
+  w->fd = -1;
+  w->block_size = OUT_WRITER_BLOCK_SIZE;
+
+  /* an inherited descriptor is written as it is, buffered */
+  if (IS_FD_PATH (filename)) {
+    w->settings.direct = FALSE;
+    w->fd = fd_path_dup (filename, STDOUT_FILENO);
+  }
+#ifdef O_DIRECT
+  else if (settings->direct) {
+    w->fd = open (filename, flags | O_DIRECT, 0644);
+    if (w->fd < 0 && errno == EINVAL)
+      GST_WARNING ("%s doesn't support O_DIRECT, writing buffered", filename);
+  }
+#endif
+  if (w->fd < 0 && !IS_FD_PATH (filename)) {
+    w->settings.direct = FALSE;
+    w->fd = open (filename, flags, 0644);
+  }
+  if (w->fd < 0) {
+    *error = g_strdup_printf ("could not open %s for writing! (%i)",
+        filename, errno);
+    g_free (w->filename);
+    g_free (w);
+    return NULL;
+  }
+
+  if (fstat (w->fd, &st) == 0 && !S_ISREG (st.st_mode)
+      && !S_ISBLK (st.st_mode)) {
+    w->stream = TRUE;
+    w->block_size = OUT_WRITER_STREAM_BLOCK_SIZE;
+    w->settings.direct = FALSE;
+    w->settings.sync = OUT_SYNC_NONE;
+  }
+
+#ifdef HAVE_FALLOCATE
+  /* reserved, but not part of the file until written */
+  if (settings->preallocate && !w->stream) {
+    if (fallocate (w->fd, FALLOC_FL_KEEP_SIZE, 0, settings->preallocate) == 0)
+      w->preallocated = TRUE;
+    else
+      GST_INFO ("could not preallocate %" G_GUINT64_FORMAT " bytes for %s"
+          " (%i)", settings->preallocate, filename, errno);
+  }
+#endif
+
+  if (posix_memalign (&block, OUT_WRITER_ALIGNMENT, OUT_WRITER_BLOCK_SIZE)) {
+    *error = g_strdup ("could not allocate the output buffer!");
+    close (w->fd);
+    g_free (w->filename);
+    g_free (w);
+    return NULL;
+  }
+  w->block = block;
+
+  if (settings->checksum != CHECKSUM_NONE) {
+    /* an old manifest mustn't vouch for a result that is being replaced */
+    if (w->stream || IS_FD_PATH (filename))
+      GST_WARNING ("%s isn't a regular file, no manifest is written",
+          filename);
+    else {
+      manifest_remove (filename);
+      w->checksum = checksum_new (settings->checksum, settings->unit_crcs);
+    }
+  }
+
+  if (settings->resume && (w->stream || !resume_at (w, settings->resume,
+              error))) {
+    if (w->stream)
+      *error = g_strdup_printf ("can't resume writing to %s!", filename);
+    close (w->fd);
+    if (w->checksum)
+      checksum_free (w->checksum);
+    free (w->block);
+    g_free (w->filename);
+    g_free (w);
+    return NULL;
+  }
+
+  if (settings->threaded)
+    writer_start (w);
+
+  GST_DEBUG ("writing %s%s%s%s%s, sync policy %i", filename,
+      w->stream ? " as a stream" : "",
+      w->settings.direct ? " with O_DIRECT" : "",
+      w->preallocated ? ", preallocated" : "",
+      w->thread ? " on a thread" : "", w->settings.sync);
+  return w;
+}
+
+gboolean
+out_writer_write (OutWriter * w, const guint8 * data, gsize len,
+    gchar ** error)
+{
+  while (len) {
+    gsize n = MIN (len, w->block_size - w->fill);
+
+    memcpy (w->block + w->fill, data, n);
+    w->fill += n;
+    data += n;
+    len -= n;
+    if (w->fill == w->block_size && !flush_block (w, error))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* makes what has been written to the file so far durable, not what is
+ * still collected in the block */
+gboolean
+out_writer_sync (OutWriter * w, gchar ** error)
+{
+  if (w->thread && !drain (w, error))
+    return FALSE;
+  if (fdatasync (w->fd) < 0) {
+    *error = g_strdup_printf ("could not sync %s! (%i)", w->filename, errno);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* writes what is left and closes the file. the writer is freed in any
+ * case, error may be NULL if the result doesn't matter anymore */
+gboolean
+out_writer_close (OutWriter * w, gchar ** error)
+{
+  gboolean ret = TRUE;
+
+  if (w->thread)
+    ret = drain (w, error);
+  if (w->blocks)
+    writer_stop (w);
+
+  if (ret && w->fill) {
+#ifdef O_DIRECT
+    /* the tail usually isn't a multiple of the page size */
+    if (w->settings.direct)
+      fcntl (w->fd, F_SETFL, fcntl (w->fd, F_GETFL) & ~O_DIRECT);
+#endif
+    if (w->checksum)
+      checksum_update (w->checksum, w->block, w->fill);
+    ret = write_all (w, w->block, w->fill, error);
+    w->offset += w->fill;
+  }
+
+  /* give back what was reserved beyond the end */
+  if (ret && w->preallocated && ftruncate (w->fd, w->offset) < 0) {
+    if (error)
+      *error = g_strdup_printf ("could not truncate %s! (%i)", w->filename,
+          errno);
+    ret = FALSE;
+  }
+
+  if (ret && w->settings.sync != OUT_SYNC_NONE) {
+    if (fdatasync (w->fd) < 0) {
+      if (error)
+        *error = g_strdup_printf ("could not sync %s! (%i)", w->filename,
+            errno);
+      ret = FALSE;
+    }
+#ifdef HAVE_POSIX_FADVISE
+    if (w->settings.sync == OUT_SYNC_STREAM)
+      posix_fadvise (w->fd, w->written_back, 0, POSIX_FADV_DONTNEED);
+#endif
+  }
+
+  if (close (w->fd) < 0 && ret) {
+    if (error)
+      *error = g_strdup_printf ("could not close %s! (%i)", w->filename,
+          errno);
+    ret = FALSE;
+  }
+
+  /* only a result that matters gets a manifest, once it's complete */
+  if (ret && error && w->checksum)
+    ret = manifest_write (w->filename, w->checksum, error);
+  if (w->checksum)
+    checksum_free (w->checksum);
+
+  free (w->block);
+  g_free (w->filename);
+  g_free (w);
+  return ret;
+}
@@ -0,0 +1,109 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_OUTWRITER_H__
+#define __BDREMUX_OUTWRITER_H__
+
+#include "checksum.h"
+#include "common.h"
+#include "iothrottle.h"
+#include "spscring.h"
+#include "tspacket.h"
+
+/* a whole number of aligned units which is also a multiple of the page
+ * size, as O_DIRECT wants it */
+#define OUT_WRITER_BLOCK_SIZE (M2TS_ALIGNED_UNIT_SIZE * 512)
+#define OUT_WRITER_ALIGNMENT 4096
+/* a pipe gets its data in smaller pieces, so whatever reads it doesn't
+ * wait for megabytes to pile up */
+#define OUT_WRITER_STREAM_BLOCK_SIZE (M2TS_ALIGNED_UNIT_SIZE * 16)
+/* blocks filled while the writer thread writes the others */
+#define OUT_WRITER_DEPTH 4
+
+typedef enum
+{
+  OUT_SYNC_NONE,                /* leave the write back to the kernel */
+  OUT_SYNC_CLOSE,               /* fdatasync before closing */
+  OUT_SYNC_STREAM               /* write back right behind the writer and
+                                 * drop the data from the page cache */
+} OutSyncPolicy;
+
+typedef struct _OutWriterSettings
+{
+  gboolean direct;              /* O_DIRECT, buffered if not supported */
+  guint64 preallocate;          /* expected size in bytes, 0 for none */
+  OutSyncPolicy sync;
+  guint64 resume;               /* continue a result of this size instead
+                                 * of truncating it, 0 to start over */
+  gboolean threaded;            /* write the blocks on a thread of their own */
+  gint cpu;                     /* the writer thread is pinned to, -1 for
+                                 * any */
+  IoThrottle *throttle;         /* paces the blocks, NULL for full speed */
+  gboolean background;          /* the writer thread runs at idle priority */
+  ChecksumType checksum;        /* hashed while written, for the manifest */
+  gboolean unit_crcs;           /* and a CRC32C of every aligned unit */
+} OutWriterSettings;
+
+typedef struct _OutBlock
+{
+  guint8 *data;
+  gsize len;
+  guint64 offset;
+} OutBlock;
+
+/* collects the output into large page aligned blocks, so the storage sees
+ * a few big sequential writes whatever size the producer hands over */
+typedef struct _OutWriter
+{
+  gchar *filename;
+  int fd;
+  OutWriterSettings settings;
+  gboolean preallocated;
+  gboolean stream;              /* a pipe or device, no seeking or syncing */
+
+  guint8 *block;
+  gsize block_size;
+  gsize fill;
+  guint64 offset;               /* of the block in the file */
+  guint64 written_back;         /* start of the data not yet written back */
+  Checksum *checksum;           /* of everything written so far */
+
+  /* writer thread: the full blocks go to it through a lock-free ring and
+   * come back through another one once written */
+  GThread *thread;
+  OutBlock *blocks;
+  OutBlock *current;
+  SpscRing *full_blocks, *free_blocks;
+  volatile gint in_flight;
+  volatile gint failed;         /* errno of a failed write */
+  volatile gint stop;
+  /* a drain waiting for the last block to be written */
+  volatile gint draining;
+  CompatMutex lock;
+  CompatCond drained;
+} OutWriter;
+
+OutWriter *out_writer_open (const gchar * filename,
+    const OutWriterSettings * settings, gchar ** error);
+gboolean out_writer_write (OutWriter * w, const guint8 * data, gsize len,
+    gchar ** error);
+gboolean out_writer_sync (OutWriter * w, gchar ** error);
+gboolean out_writer_close (OutWriter * w, gchar ** error);
+
+#endif /* __BDREMUX_OUTWRITER_H__ */
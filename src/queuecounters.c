@@ -0,0 +1,138 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "queuecounters.h"
+
+typedef struct _WatchedStream
+{
+  QueuedStream counts;
+  QueueCounters *counters;
+  GstPad *queue_sinkpad, *queue_srcpad;
+  gulong in_probe, out_probe;
+} WatchedStream;
+
+struct _QueueCounters
+{
+  CompatMutex lock;
+  WatchedStream streams[MAX_PIDS];
+  guint n_streams;
+};
+
+QueueCounters *
+queue_counters_new (void)
+{
+  QueueCounters *counters = g_new0 (QueueCounters, 1);
+
+  MUTEX_INIT (counters->lock);
+  return counters;
+}
+
+void
+queue_counters_free (QueueCounters * counters)
+{
+  guint i;
+
+  for (i = 0; i < counters->n_streams; i++) {
+    WatchedStream *w = &counters->streams[i];
+    gst_pad_remove_buffer_probe (w->queue_sinkpad, w->in_probe);
+    gst_pad_remove_buffer_probe (w->queue_srcpad, w->out_probe);
+    gst_object_unref (w->queue_sinkpad);
+    gst_object_unref (w->queue_srcpad);
+  }
+  MUTEX_CLEAR (counters->lock);
+  g_free (counters);
+}
+
+/* the probes get their stream, there is nothing to look up */
+static gboolean
+queue_in_probe_cb (GstPad * pad, GstBuffer * buffer, WatchedStream * w)
+{
+  QueuedStream *s = &w->counts;
+
+  MUTEX_LOCK (w->counters->lock);
+  s->in_buffers++;
+  s->in_bytes += GST_BUFFER_SIZE (buffer);
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer)) {
+    s->in_time = GST_BUFFER_TIMESTAMP (buffer);
+    if (!GST_CLOCK_TIME_IS_VALID (s->first_time)) {
+      s->first_time = s->in_time;
+      s->first_bytes = s->in_bytes;
+    }
+  }
+  MUTEX_UNLOCK (w->counters->lock);
+  return TRUE;
+}
+
+static gboolean
+queue_out_probe_cb (GstPad * pad, GstBuffer * buffer, WatchedStream * w)
+{
+  QueuedStream *s = &w->counts;
+
+  MUTEX_LOCK (w->counters->lock);
+  s->out_buffers++;
+  s->out_bytes += GST_BUFFER_SIZE (buffer);
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+    s->out_time = GST_BUFFER_TIMESTAMP (buffer);
+  MUTEX_UNLOCK (w->counters->lock);
+  return TRUE;
+}
+
+void
+queue_counters_watch (QueueCounters * counters, guint source_pid,
+    guint sink_pid, GstPad * queue_sinkpad, GstPad * queue_srcpad)
+{
+  WatchedStream *w;
+
+  MUTEX_LOCK (counters->lock);
+  if (counters->n_streams == MAX_PIDS) {
+    MUTEX_UNLOCK (counters->lock);
+    return;
+  }
+  w = &counters->streams[counters->n_streams];
+  w->counters = counters;
+  w->counts.source_pid = source_pid;
+  w->counts.sink_pid = sink_pid;
+  w->counts.in_time = w->counts.out_time = GST_CLOCK_TIME_NONE;
+  w->counts.first_time = GST_CLOCK_TIME_NONE;
+  w->queue_sinkpad = gst_object_ref (queue_sinkpad);
+  w->queue_srcpad = gst_object_ref (queue_srcpad);
+  counters->n_streams++;
+  MUTEX_UNLOCK (counters->lock);
+  w->in_probe = gst_pad_add_buffer_probe (queue_sinkpad,
+      G_CALLBACK (queue_in_probe_cb), w);
+  w->out_probe = gst_pad_add_buffer_probe (queue_srcpad,
+      G_CALLBACK (queue_out_probe_cb), w);
+}
+
+guint
+queue_counters_get (QueueCounters * counters, QueuedStream * streams)
+{
+  guint i, n;
+
+  MUTEX_LOCK (counters->lock);
+  n = counters->n_streams;
+  for (i = 0; i < n; i++)
+    streams[i] = counters->streams[i].counts;
+  MUTEX_UNLOCK (counters->lock);
+  /* the pads don't change once watched */
+  for (i = 0; i < n; i++)
+    streams[i].blocked =
+        gst_pad_is_blocked (counters->streams[i].queue_srcpad);
+  return n;
+}
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_QUEUECOUNTERS_H__
+#define __BDREMUX_QUEUECOUNTERS_H__
+
+#include "common.h"
+
+/* what went in and out of the multiqueue for a stream */
+typedef struct _QueuedStream
+{
+  guint source_pid, sink_pid;
+  guint64 in_buffers, in_bytes;
+  guint64 out_buffers, out_bytes;
+  GstClockTime in_time, out_time;       /* of the last timestamped buffer */
+  /* the first timestamped buffer going in and the bytes up to it, the
+   * bitrate is measured from there */
+  GstClockTime first_time;
+  guint64 first_bytes;
+  gboolean blocked;             /* the source pad, when copied */
+} QueuedStream;
+
+typedef struct _QueueCounters QueueCounters;
+
+/* counts the buffers of every stream in the multiqueue with one probe per
+ * pad, for the stats and the queue limits alike */
+QueueCounters *queue_counters_new (void);
+void queue_counters_free (QueueCounters * counters);
+
+void queue_counters_watch (QueueCounters * counters, guint source_pid,
+    guint sink_pid, GstPad * queue_sinkpad, GstPad * queue_srcpad);
+/* copies the counters of all streams, streams holds MAX_PIDS */
+guint queue_counters_get (QueueCounters * counters, QueuedStream * streams);
+
+#endif /* __BDREMUX_QUEUECOUNTERS_H__ */
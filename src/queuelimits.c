@@ -0,0 +1,147 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "queuelimits.h"
+
+struct _QueueLimits
+{
+  CompatMutex lock;
+  GstElement *multiqueue;
+  QueueCounters *counters;
+  gulong overrun_handler;
+  guint max_bytes;
+  guint interleave_time;        /* ms */
+  guint bytes;                  /* the byte limit set */
+  gboolean flowing;
+};
+
+static void
+set_limits (QueueLimits * limits, guint bytes, guint time)
+{
+  GST_INFO ("multiqueue limits: %u bytes, %u ms per stream", bytes, time);
+  limits->bytes = bytes;
+  g_object_set (G_OBJECT (limits->multiqueue), "max-size-bytes", bytes,
+      "max-size-time", (guint64) time * GST_MSECOND, NULL);
+}
+
+/* a full queue while another one is empty stalls the mux, the interleave
+ * is wider than expected then */
+static void
+overrun_cb (GstElement * multiqueue, QueueLimits * limits)
+{
+  QueuedStream streams[MAX_PIDS];
+  guint i, n, time = 0;
+
+  n = queue_counters_get (limits->counters, streams);
+  MUTEX_LOCK (limits->lock);
+  if (limits->flowing && limits->interleave_time < QUEUE_MAX_TIME) {
+    for (i = 0; i < n; i++) {
+      if (streams[i].in_buffers == streams[i].out_buffers) {
+        limits->interleave_time = MIN (limits->interleave_time * 2,
+            QUEUE_MAX_TIME);
+        time = limits->interleave_time;
+        break;
+      }
+    }
+  }
+  MUTEX_UNLOCK (limits->lock);
+  if (time) {
+    GST_WARNING ("a stream ran dry while another queue was full, widening "
+        "the interleave to %u ms", time);
+    set_limits (limits, limits->max_bytes, time);
+  }
+}
+
+QueueLimits *
+queue_limits_new (GstElement * multiqueue, QueueCounters * counters,
+    guint max_bytes, guint interleave_time)
+{
+  QueueLimits *limits = g_new0 (QueueLimits, 1);
+
+  MUTEX_INIT (limits->lock);
+  limits->multiqueue = gst_object_ref (multiqueue);
+  limits->counters = counters;
+  limits->max_bytes = max_bytes;
+  limits->interleave_time = MIN (interleave_time, QUEUE_MAX_TIME);
+  /* the first pads are blocked until the last one is linked */
+  set_limits (limits, max_bytes, 0);
+  limits->overrun_handler = g_signal_connect (multiqueue, "overrun",
+      G_CALLBACK (overrun_cb), limits);
+  return limits;
+}
+
+void
+queue_limits_free (QueueLimits * limits)
+{
+  g_signal_handler_disconnect (limits->multiqueue, limits->overrun_handler);
+  gst_object_unref (limits->multiqueue);
+  MUTEX_CLEAR (limits->lock);
+  g_free (limits);
+}
+
+/* what had piled up while the pads were blocked drains now, the queues
+ * are held to the interleave time from here on */
+void
+queue_limits_flowing (QueueLimits * limits)
+{
+  gboolean was_flowing;
+
+  MUTEX_LOCK (limits->lock);
+  was_flowing = limits->flowing;
+  limits->flowing = TRUE;
+  MUTEX_UNLOCK (limits->lock);
+  if (was_flowing)
+    return;
+  set_limits (limits, limits->max_bytes, limits->interleave_time);
+  queue_limits_update (limits);
+}
+
+void
+queue_limits_update (QueueLimits * limits)
+{
+  QueuedStream streams[MAX_PIDS];
+  guint64 rate, max_rate = 0, bytes;
+  guint i, n, time;
+
+  n = queue_counters_get (limits->counters, streams);
+  for (i = 0; i < n; i++) {
+    QueuedStream *s = &streams[i];
+    /* a second of the stream at least, for a meaningful bitrate */
+    if (!GST_CLOCK_TIME_IS_VALID (s->first_time)
+        || s->in_time < s->first_time + GST_SECOND)
+      continue;
+    rate = gst_util_uint64_scale (s->in_bytes - s->first_bytes, GST_SECOND,
+        s->in_time - s->first_time);
+    max_rate = MAX (max_rate, rate);
+  }
+  MUTEX_LOCK (limits->lock);
+  time = limits->interleave_time;
+  MUTEX_UNLOCK (limits->lock);
+
+  if (!limits->flowing || !max_rate)
+    return;
+  bytes = max_rate * time / 1000 * QUEUE_BYTES_HEADROOM;
+  bytes = CLAMP (bytes, MIN (QUEUE_MIN_BYTES, limits->max_bytes),
+      limits->max_bytes);
+  /* not for every little change of a VBR stream */
+  if (bytes < limits->bytes * 9 / 10 || bytes > limits->bytes * 11 / 10) {
+    GST_DEBUG ("fastest stream at %" G_GUINT64_FORMAT " bytes/s", max_rate);
+    set_limits (limits, bytes, time);
+  }
+}
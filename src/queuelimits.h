@@ -0,0 +1,48 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_QUEUELIMITS_H__
+#define __BDREMUX_QUEUELIMITS_H__
+
+#include "common.h"
+#include "queuecounters.h"
+
+/* the interleave never needs more than this, whatever the overruns say */
+#define QUEUE_MAX_TIME 30000    /* ms */
+/* the byte limit in steady state, as a multiple of what the fastest
+ * stream brings in over the interleave time */
+#define QUEUE_BYTES_HEADROOM 2
+#define QUEUE_MIN_BYTES (1024*1024)
+
+typedef struct _QueueLimits QueueLimits;
+
+/* sizes the multiqueue by mux interleave time instead of a fixed number
+ * of bytes: until all pads are linked it may take up to max_bytes per
+ * stream, afterwards interleave_time ms and what the bitrates counted
+ * need for that */
+QueueLimits *queue_limits_new (GstElement * multiqueue,
+    QueueCounters * counters, guint max_bytes, guint interleave_time);
+void queue_limits_free (QueueLimits * limits);
+
+/* all streams are linked and flowing into the mux */
+void queue_limits_flowing (QueueLimits * limits);
+/* fits the byte limit to the bitrates seen so far */
+void queue_limits_update (QueueLimits * limits);
+
+#endif /* __BDREMUX_QUEUELIMITS_H__ */
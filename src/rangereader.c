@@ -0,0 +1,719 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "common.h"
+#include "rangereader.h"
+
+/* longest sleep while following, so a stopped reader doesn't hang around */
+#define FOLLOW_POLL_INTERVAL 200        /* ms */
+
+/* how much of a stream is looked at first for the PSI, doubled up to
+ * TS_PROGRAM_SCAN_SIZE while none is found */
+#define STREAM_SCAN_STEP (TS_PACKET_SIZE * 512)
+
+struct _ReadBlock
+{
+  guint8 *data;
+  guint64 offset;
+  gsize len;
+  gssize result;                /* bytes read or -1 */
+  int error;
+  gboolean discont;
+  gboolean ready;
+  gint64 submitted;             /* for the throttle, with io_uring */
+};
+
+/* the writer is seen closing the file by inotify, without it only the
+ * idle timeout ends following */
+static void
+follow_start (RangeReader * rr)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  gchar path[32];
+
+  rr->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (rr->inotify_fd >= 0) {
+    g_snprintf (path, sizeof (path), "/proc/self/fd/%i", rr->fd);
+    if (inotify_add_watch (rr->inotify_fd, path,
+            IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+      close (rr->inotify_fd);
+      rr->inotify_fd = -1;
+    }
+  }
+  if (rr->inotify_fd < 0)
+    GST_WARNING ("can't watch the source (%i), following it until it "
+        "doesn't grow anymore", errno);
+#endif
+  if (!rr->follow.idle_timeout)
+    rr->follow.idle_timeout = FOLLOW_IDLE_TIMEOUT;
+  GST_INFO ("following the source, idle timeout %u ms",
+      rr->follow.idle_timeout);
+}
+
+/* sleeps until something happens to the file or the interval is over */
+static void
+follow_sleep (RangeReader * rr, guint interval)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  if (rr->inotify_fd >= 0) {
+    struct pollfd pfd = { rr->inotify_fd, POLLIN, 0 };
+    union
+    {
+      struct inotify_event event;
+      gchar data[1024];
+    } events;
+    gssize len, i;
+
+    if (poll (&pfd, 1, interval) <= 0)
+      return;
+    while ((len = read (rr->inotify_fd, &events, sizeof (events))) > 0) {
+      for (i = 0; i < len; i += sizeof (struct inotify_event) +
+          ((struct inotify_event *) (events.data + i))->len) {
+        struct inotify_event *event =
+            (struct inotify_event *) (events.data + i);
+        if (event->mask & IN_CLOSE_WRITE) {
+          GST_INFO ("the writer has closed the source");
+          rr->writer_closed = TRUE;
+        }
+      }
+    }
+    return;
+  }
+#endif
+  g_usleep (interval * 1000);
+}
+
+/* waits for the file to grow beyond offset. FALSE once the writer has
+ * closed it, nothing has been appended for the idle timeout or the reader
+ * is stopped */
+static gboolean
+follow_wait (RangeReader * rr, guint64 offset)
+{
+  GTimer *timer = g_timer_new ();
+  gboolean grown = FALSE;
+
+  for (;;) {
+    struct stat st;
+    gdouble idle;
+
+    if (fstat (rr->fd, &st) == 0 && (guint64) st.st_size > offset) {
+      rr->file_size = st.st_size;
+      grown = TRUE;
+      break;
+    }
+    if (rr->writer_closed || g_atomic_int_get (&rr->stop))
+      break;
+    idle = g_timer_elapsed (timer, NULL) * 1000;
+    if (idle >= rr->follow.idle_timeout) {
+      GST_INFO ("nothing appended to the source for %u ms",
+          rr->follow.idle_timeout);
+      break;
+    }
+    follow_sleep (rr, MIN (FOLLOW_POLL_INTERVAL,
+            rr->follow.idle_timeout - (guint) idle));
+  }
+  g_timer_destroy (timer);
+  return grown;
+}
+
+/* pread for a source which can only be read forward: the head kept by
+ * peek_stream() is served again, gaps are read and dropped */
+static gssize
+stream_pread (RangeReader * rr, guint8 * buf, gsize len, guint64 offset)
+{
+  gssize ret;
+
+  if (rr->stream_head && offset < rr->stream_head_len) {
+    len = MIN (len, rr->stream_head_len - offset);
+    memcpy (buf, rr->stream_head + offset, len);
+    return len;
+  }
+  if (rr->stream_head) {
+    g_free (rr->stream_head);
+    rr->stream_head = NULL;
+  }
+  if (offset < rr->position) {
+    errno = ESPIPE;
+    return -1;
+  }
+  while (rr->position < offset) {
+    ret = read (rr->fd, buf, MIN (len, offset - rr->position));
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return ret;
+    rr->position += ret;
+  }
+  do
+    ret = read (rr->fd, buf, len);
+  while (ret < 0 && errno == EINTR);
+  if (ret > 0)
+    rr->position += ret;
+  return ret;
+}
+
+static gssize
+source_pread (RangeReader * rr, guint8 * buf, gsize len, guint64 offset)
+{
+  if (rr->stream)
+    return stream_pread (rr, buf, len, offset);
+  return pread (rr->fd, buf, len, offset);
+}
+
+/* reads the first len bytes of a stream before the remux starts, returns
+ * how many there are */
+static gsize
+peek_stream (RangeReader * rr, gsize len)
+{
+  if (len > rr->stream_head_len)
+    rr->stream_head = g_realloc (rr->stream_head, len);
+  while (rr->stream_head_len < len) {
+    gssize ret = read (rr->fd, rr->stream_head + rr->stream_head_len,
+        len - rr->stream_head_len);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      break;
+    rr->stream_head_len += ret;
+  }
+  rr->position = rr->stream_head_len;
+  return rr->stream_head_len;
+}
+
+/* the next block to read in file order, FALSE after the last one */
+static gboolean
+plan_block (RangeReader * rr, ReadBlock * block)
+{
+  guint n_ranges = rr->ranges ? rr->ranges->len : 1;
+
+  while (rr->current < n_ranges) {
+    guint64 start = 0, end = G_MAXUINT64;
+
+    if (rr->ranges) {
+      ByteRange *range = &g_array_index (rr->ranges, ByteRange, rr->current);
+      start = range->start;
+      end = range->end;
+    }
+    end = MIN (end, rr->file_size);
+    if (rr->offset >= end && rr->follow.enabled
+        && follow_wait (rr, rr->offset))
+      continue;
+    if (rr->offset < end) {
+      block->offset = rr->offset;
+      block->len = MIN (rr->settings.block_size, end - rr->offset);
+      block->discont = rr->offset == start && rr->current > 0;
+      rr->offset += block->len;
+      return TRUE;
+    }
+    if (++rr->current < n_ranges)
+      rr->offset = g_array_index (rr->ranges, ByteRange, rr->current).start;
+  }
+  return FALSE;
+}
+
+/* reads the rest of a block after a short read */
+static void
+read_block (RangeReader * rr, ReadBlock * block, gsize done)
+{
+  while (done < block->len) {
+    gint64 start = io_throttle_begin (rr->settings.throttle);
+    gssize len = source_pread (rr, block->data + done, block->len - done,
+        block->offset + done);
+    io_throttle_end (rr->settings.throttle, start, len);
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len < 0) {
+      block->result = -1;
+      block->error = errno;
+      return;
+    }
+    if (len == 0)
+      break;
+    done += len;
+    /* what has arrived of a stream is handed on right away */
+    if (rr->stream)
+      break;
+  }
+  block->result = done;
+}
+
+static gpointer
+read_ahead_thread (RangeReader * rr)
+{
+  ReadBlock *block;
+  IoPriority priority;
+
+  thread_set_cpu (rr->settings.cpu, "reader");
+  if (rr->settings.background)
+    io_set_background_priority (&priority);
+  while ((block = spsc_ring_pop (rr->free_blocks, &rr->stop))) {
+    if (g_atomic_int_get (&rr->stop))
+      break;
+    if (!plan_block (rr, block)) {
+      /* a block without data marks the end */
+      block->len = 0;
+      block->result = 0;
+      spsc_ring_push (rr->full_blocks, block);
+      break;
+    }
+    read_block (rr, block, 0);
+    if (rr->stream && block->result >= 0
+        && (gsize) block->result < block->len) {
+      /* the next block continues right behind the short one, an empty
+       * read is the end of the stream */
+      rr->offset = block->offset + block->result;
+      if (block->result == 0)
+        rr->file_size = rr->offset;
+    }
+    spsc_ring_push (rr->full_blocks, block);
+  }
+  if (rr->settings.background)
+    io_restore_priority (&priority);
+  return NULL;
+}
+
+#ifdef HAVE_LIBURING
+static void
+uring_submit (RangeReader * rr)
+{
+  struct io_uring *ring = rr->ring;
+  guint submitted = 0;
+
+  while (rr->n_pending < rr->settings.depth && !rr->planned_all) {
+    ReadBlock *block = &rr->blocks[(rr->head + rr->n_pending) %
+        rr->settings.depth];
+    struct io_uring_sqe *sqe;
+
+    if (!plan_block (rr, block)) {
+      rr->planned_all = TRUE;
+      break;
+    }
+    sqe = io_uring_get_sqe (ring);
+    io_uring_prep_read (sqe, rr->fd, block->data, block->len, block->offset);
+    io_uring_sqe_set_data (sqe, block);
+    block->ready = FALSE;
+    block->submitted = io_throttle_begin (rr->settings.throttle);
+    rr->n_pending++;
+    rr->n_inflight++;
+    submitted++;
+  }
+  if (submitted)
+    io_uring_submit (ring);
+}
+
+/* the completions may come in any order, the blocks are consumed in the
+ * order they were submitted */
+static ReadBlock *
+uring_next_block (RangeReader * rr)
+{
+  struct io_uring *ring = rr->ring;
+  struct io_uring_cqe *cqe;
+  ReadBlock *block, *done;
+  int ret;
+
+  uring_submit (rr);
+  if (!rr->n_pending)
+    return NULL;
+
+  block = &rr->blocks[rr->head];
+  while (!block->ready) {
+    ret = io_uring_wait_cqe (ring, &cqe);
+    if (ret == -EINTR)
+      continue;
+    if (ret < 0) {
+      /* the block is still the kernel's, it stays pending */
+      rr->failed = -ret;
+      return NULL;
+    }
+    done = io_uring_cqe_get_data (cqe);
+    /* the time in the queue counts as well, the others in front of it
+     * are what it waited for */
+    io_throttle_end (rr->settings.throttle, done->submitted, cqe->res);
+    if (cqe->res < 0) {
+      done->result = -1;
+      done->error = -cqe->res;
+    } else if ((gsize) cqe->res < done->len && cqe->res > 0)
+      read_block (rr, done, cqe->res);
+    else
+      done->result = cqe->res;
+    done->ready = TRUE;
+    io_uring_cqe_seen (ring, cqe);
+    rr->n_inflight--;
+  }
+  return block;
+}
+#endif
+
+static ReadBlock *
+next_block (RangeReader * rr)
+{
+  ReadBlock *block;
+
+#ifdef HAVE_LIBURING
+  if (rr->ring)
+    return uring_next_block (rr);
+#endif
+  block = spsc_ring_pop (rr->full_blocks, NULL);
+  if (block->len == 0) {
+    spsc_ring_push (rr->free_blocks, block);
+    return NULL;
+  }
+  return block;
+}
+
+/* the data has been handed on, nobody is going to read it again */
+static void
+release_block (RangeReader * rr, ReadBlock * block)
+{
+#ifdef HAVE_POSIX_FADVISE
+  if (block->result > 0)
+    posix_fadvise (rr->fd, block->offset, block->result, POSIX_FADV_DONTNEED);
+#endif
+  if (rr->ring) {
+    rr->head = (rr->head + 1) % rr->settings.depth;
+    rr->n_pending--;
+  } else
+    spsc_ring_push (rr->free_blocks, block);
+}
+
+static gssize
+read_ahead (RangeReader * rr, guint8 * buf, gsize size, gboolean * discont)
+{
+  ReadBlock *block;
+  gsize len;
+
+  if (rr->failed) {
+    errno = rr->failed;
+    return -1;
+  }
+
+  while (!rr->block || rr->consumed == (gsize) rr->block->result) {
+    if (rr->block)
+      release_block (rr, rr->block);
+    rr->block = NULL;
+    if (rr->ended || !(block = next_block (rr))) {
+      if (rr->failed) {
+        errno = rr->failed;
+        return -1;
+      }
+      rr->ended = TRUE;
+      return 0;
+    }
+    if (block->result < 0) {
+      rr->failed = block->error;
+      release_block (rr, block);
+      errno = rr->failed;
+      return -1;
+    }
+    rr->block = block;
+    rr->consumed = 0;
+  }
+
+  block = rr->block;
+  len = MIN (size, block->result - rr->consumed);
+  memcpy (buf, block->data + rr->consumed, len);
+  *discont = block->discont && rr->consumed == 0;
+  rr->consumed += len;
+  return len;
+}
+
+static gboolean
+read_ahead_start (RangeReader * rr)
+{
+  GError *gerror = NULL;
+  struct stat st;
+  guint i;
+
+  if (fstat (rr->fd, &st) < 0)
+    return FALSE;
+  rr->file_size = rr->stream ? G_MAXUINT64 : st.st_size;
+  if (!rr->settings.block_size)
+    rr->settings.block_size = READ_AHEAD_BLOCK_SIZE;
+  if (!rr->settings.depth)
+    rr->settings.depth = READ_AHEAD_DEPTH;
+
+  rr->blocks = g_new0 (ReadBlock, rr->settings.depth);
+  for (i = 0; i < rr->settings.depth; i++)
+    rr->blocks[i].data = g_malloc (rr->settings.block_size);
+
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise (rr->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+#ifdef HAVE_LIBURING
+  /* the end of a followed file is waited out by the thread, which also
+   * takes what arrives of a stream without waiting for whole blocks */
+  if (rr->settings.mode == READ_AHEAD_URING
+      && (rr->follow.enabled || rr->stream))
+    GST_INFO ("%s the source, using a reader thread",
+        rr->stream ? "streaming" : "following");
+  else if (rr->settings.mode == READ_AHEAD_URING) {
+    struct io_uring *ring = g_new0 (struct io_uring, 1);
+    int ret = io_uring_queue_init (rr->settings.depth, ring, 0);
+    if (ret == 0) {
+      rr->ring = ring;
+      GST_DEBUG ("reading %u blocks of %" G_GSIZE_FORMAT " bytes ahead with "
+          "io_uring", rr->settings.depth, rr->settings.block_size);
+      return TRUE;
+    }
+    GST_WARNING ("io_uring not available (%i), using a reader thread", -ret);
+    g_free (ring);
+  }
+#else
+  if (rr->settings.mode == READ_AHEAD_URING)
+    GST_WARNING ("built without io_uring, using a reader thread");
+#endif
+
+  rr->free_blocks = spsc_ring_new (rr->settings.depth);
+  rr->full_blocks = spsc_ring_new (rr->settings.depth);
+  for (i = 0; i < rr->settings.depth; i++)
+    spsc_ring_push (rr->free_blocks, &rr->blocks[i]);
+#if GLIB_CHECK_VERSION(2,32,0)
+  rr->thread = g_thread_try_new ("readahead", (GThreadFunc) read_ahead_thread,
+      rr, &gerror);
+#else
+  rr->thread = g_thread_create ((GThreadFunc) read_ahead_thread, rr, TRUE,
+      &gerror);
+#endif
+  if (!rr->thread) {
+    GST_WARNING ("could not start the reader thread (%s)", gerror->message);
+    g_error_free (gerror);
+    return FALSE;
+  }
+  GST_DEBUG ("reading %u blocks of %" G_GSIZE_FORMAT " bytes ahead",
+      rr->settings.depth, rr->settings.block_size);
+  return TRUE;
+}
+
+static void
+read_ahead_stop (RangeReader * rr)
+{
+  guint i;
+
+  if (rr->thread) {
+    /* a thread waiting for a free block sees the flag as well */
+    g_atomic_int_set (&rr->stop, 1);
+    spsc_ring_wake (rr->free_blocks);
+    g_thread_join (rr->thread);
+    rr->thread = NULL;
+  }
+#ifdef HAVE_LIBURING
+  if (rr->ring) {
+    /* the kernel may still be writing into the blocks, the completions
+     * already reaped are only waiting to be consumed */
+    while (rr->n_inflight) {
+      struct io_uring_cqe *cqe;
+      int ret = io_uring_wait_cqe (rr->ring, &cqe);
+      if (ret == -EINTR)
+        continue;
+      if (ret < 0)
+        break;
+      io_uring_cqe_seen (rr->ring, cqe);
+      rr->n_inflight--;
+    }
+    io_uring_queue_exit (rr->ring);
+    g_free (rr->ring);
+    rr->ring = NULL;
+    if (rr->n_inflight) {
+      /* better leaked than written into after being handed out again */
+      GST_WARNING ("%u reads didn't complete, leaving their blocks",
+          rr->n_inflight);
+      rr->blocks = NULL;
+    }
+  }
+#endif
+  if (rr->free_blocks)
+    spsc_ring_free (rr->free_blocks);
+  if (rr->full_blocks)
+    spsc_ring_free (rr->full_blocks);
+  for (i = 0; rr->blocks && i < rr->settings.depth; i++)
+    g_free (rr->blocks[i].data);
+  g_free (rr->blocks);
+  rr->blocks = NULL;
+}
+
+RangeReader *
+range_reader_new (int fd, GArray * ranges, const ReadAheadSettings * settings,
+    const FollowSettings * follow)
+{
+  RangeReader *rr = g_new0 (RangeReader, 1);
+  struct stat st;
+
+  rr->fd = fd;
+  rr->ranges = ranges;
+  rr->inotify_fd = -1;
+  if (fstat (fd, &st) == 0 && !S_ISREG (st.st_mode)
+      && !S_ISBLK (st.st_mode)) {
+    GST_INFO ("the source is a stream, reading it forward only");
+    rr->stream = TRUE;
+  }
+  if (ranges && ranges->len)
+    rr->offset = g_array_index (ranges, ByteRange, 0).start;
+  if (follow && follow->enabled && !ranges && !rr->stream) {
+    rr->follow = *follow;
+    follow_start (rr);
+  }
+  /* read ahead starts with the first read, after the PSI scan */
+  if (settings)
+    rr->settings = *settings;
+  return rr;
+}
+
+/* finds the program like ts_scan_program() does, a stream is read only as
+ * far as needed and kept for the remux */
+gboolean
+range_reader_scan_program (RangeReader * rr, gint want_pid,
+    TsProgram * program)
+{
+  gsize want, len;
+
+  if (!rr->stream)
+    return ts_scan_program (rr->fd, TS_PROGRAM_SCAN_SIZE, want_pid, program);
+
+  g_return_val_if_fail (rr->blocks == NULL
+      && rr->position == rr->stream_head_len, FALSE);
+  for (want = STREAM_SCAN_STEP;; want = MIN (want * 2, TS_PROGRAM_SCAN_SIZE)) {
+    len = peek_stream (rr, want);
+    if (ts_scan_program_data (rr->stream_head, len, want_pid, program))
+      return TRUE;
+    if (len < want || want == TS_PROGRAM_SCAN_SIZE)
+      return FALSE;
+  }
+}
+
+/* continues position bytes into the ranges (or the file), as counted by
+ * the reads. only before the first read and not on streams */
+gboolean
+range_reader_seek (RangeReader * rr, guint64 position)
+{
+  g_return_val_if_fail (rr->blocks == NULL && !rr->stream, FALSE);
+
+  if (!rr->ranges) {
+    if (lseek (rr->fd, position, SEEK_SET) < 0)
+      return FALSE;
+    rr->offset = position;
+    return TRUE;
+  }
+  for (rr->current = 0; rr->current < rr->ranges->len; rr->current++) {
+    ByteRange *range = &g_array_index (rr->ranges, ByteRange, rr->current);
+
+    if (position < range->end - range->start) {
+      rr->offset = range->start + position;
+      return TRUE;
+    }
+    position -= range->end - range->start;
+  }
+  return FALSE;
+}
+
+/* returns the number of bytes read, 0 at the end of the last range and -1
+ * with errno set on errors. discont is set when the data starts a range
+ * which doesn't continue the previous one */
+gssize
+range_reader_read (RangeReader * rr, guint8 * buf, gsize size,
+    gboolean * discont)
+{
+  gssize len;
+
+  *discont = FALSE;
+  if (rr->settings.mode != READ_AHEAD_NONE && !rr->blocks
+      && !read_ahead_start (rr)) {
+    read_ahead_stop (rr);
+    rr->settings.mode = READ_AHEAD_NONE;
+  }
+  if (rr->settings.mode != READ_AHEAD_NONE)
+    return read_ahead (rr, buf, size, discont);
+
+  if (!rr->ranges) {
+    do {
+      gint64 start = io_throttle_begin (rr->settings.throttle);
+      len = rr->stream ? source_pread (rr, buf, size, rr->offset) :
+          read (rr->fd, buf, size);
+      io_throttle_end (rr->settings.throttle, start, len);
+    } while ((len < 0 && errno == EINTR) || (len == 0 && rr->follow.enabled
+            && follow_wait (rr, rr->offset)));
+    if (len > 0)
+      rr->offset += len;
+    return len;
+  }
+
+  while (rr->current < rr->ranges->len) {
+    ByteRange *range = &g_array_index (rr->ranges, ByteRange, rr->current);
+
+    if (rr->offset < range->end) {
+      gsize want = MIN (size, range->end - rr->offset);
+      do {
+        gint64 start = io_throttle_begin (rr->settings.throttle);
+        len = source_pread (rr, buf, want, rr->offset);
+        io_throttle_end (rr->settings.throttle, start, len);
+      } while (len < 0 && errno == EINTR);
+      if (len < 0)
+        return -1;
+      if (len > 0) {
+        if (rr->offset == range->start && rr->current > 0)
+          *discont = TRUE;
+        rr->offset += len;
+        return len;
+      }
+    }
+    /* range exhausted or the file ended early */
+    if (++rr->current < rr->ranges->len) {
+      range = &g_array_index (rr->ranges, ByteRange, rr->current);
+      GST_DEBUG ("next input range %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+          range->start, range->end);
+      rr->offset = range->start;
+    }
+  }
+  return 0;
+}
+
+void
+range_reader_free (RangeReader * rr)
+{
+  if (rr->settings.mode != READ_AHEAD_NONE)
+    read_ahead_stop (rr);
+  if (rr->inotify_fd >= 0)
+    close (rr->inotify_fd);
+  g_free (rr->stream_head);
+  g_free (rr);
+}
+
+/* whether two range lists (NULL for everything) select the same bytes */
+gboolean
+byte_ranges_equal (GArray * a, GArray * b)
+{
+  if (!a || !b)
+    return a == b;
+  return a->len == b->len && memcmp (a->data, b->data,
+      a->len * sizeof (ByteRange)) == 0;
+}
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_RANGEREADER_H__
+#define __BDREMUX_RANGEREADER_H__
+
+#include <glib.h>
+
+#include "bdremux.h"
+#include "iothrottle.h"
+#include "spscring.h"
+#include "tspsi.h"
+
+#define READ_AHEAD_BLOCK_SIZE BDREMUX_DEFAULT_READ_BLOCK_SIZE
+#define READ_AHEAD_DEPTH BDREMUX_DEFAULT_READ_DEPTH
+#define FOLLOW_IDLE_TIMEOUT BDREMUX_DEFAULT_FOLLOW_TIMEOUT
+
+typedef struct _ByteRange
+{
+  guint64 start;
+  guint64 end;                  /* exclusive, G_MAXUINT64 reads up to EOF */
+} ByteRange;
+
+typedef enum
+{
+  READ_AHEAD_NONE,              /* read on demand */
+  READ_AHEAD_THREAD,            /* a reader thread fills the blocks */
+  READ_AHEAD_URING              /* the blocks are read with io_uring */
+} ReadAheadMode;
+
+typedef struct _ReadAheadSettings
+{
+  ReadAheadMode mode;
+  gsize block_size;
+  guint depth;                  /* number of blocks read ahead */
+  gint cpu;                     /* the reader thread is pinned to, -1 for
+                                 * any */
+  IoThrottle *throttle;         /* paces the reads, NULL for full speed */
+  gboolean background;          /* the reader thread runs at idle priority */
+} ReadAheadSettings;
+
+/* a source still being written: at its end the reader waits for more
+ * data until the writer closes the file or nothing has been appended for
+ * idle_timeout ms. only whole files can be followed, not cut ranges */
+typedef struct _FollowSettings
+{
+  gboolean enabled;
+  guint idle_timeout;
+} FollowSettings;
+
+typedef struct _ReadBlock ReadBlock;
+
+/* reads the input either sequentially or restricted to a list of byte
+ * ranges, so cuts can be applied without seeking in the pipeline. with
+ * read ahead, large blocks are read in advance and dropped from the page
+ * cache once consumed. pipes and devices are read forward only, skipping
+ * what lies between the ranges */
+typedef struct _RangeReader
+{
+  int fd;
+  GArray *ranges;               /* of ByteRange, NULL reads everything */
+  guint current;
+  guint64 offset;
+
+  /* stream: the start kept for scanning the PSI is served again, position
+   * is how far the descriptor has been read */
+  gboolean stream;
+  guint8 *stream_head;
+  gsize stream_head_len;
+  guint64 position;
+
+  ReadAheadSettings settings;
+  guint64 file_size;
+  ReadBlock *blocks;
+  ReadBlock *block;             /* being consumed */
+  gsize consumed;
+  gboolean ended;
+  int failed;
+
+  /* thread: blocks travel between the lock-free rings */
+  GThread *thread;
+  SpscRing *free_blocks, *full_blocks;
+  gint stop;
+
+  /* io_uring: blocks[head] and the n_pending after it are submitted or
+   * done, n_inflight of them still belong to the kernel */
+  gpointer ring;
+  guint head, n_pending, n_inflight;
+  gboolean planned_all;
+
+  /* following a growing file */
+  FollowSettings follow;
+  int inotify_fd;
+  gboolean writer_closed;
+} RangeReader;
+
+RangeReader *range_reader_new (int fd, GArray * ranges,
+    const ReadAheadSettings * settings, const FollowSettings * follow);
+gboolean range_reader_seek (RangeReader * rr, guint64 position);
+gssize range_reader_read (RangeReader * rr, guint8 * buf, gsize size,
+    gboolean * discont);
+gboolean range_reader_scan_program (RangeReader * rr, gint want_pid,
+    TsProgram * program);
+void range_reader_free (RangeReader * rr);
+
+gboolean byte_ranges_equal (GArray * a, GArray * b);
+
+#endif /* __BDREMUX_RANGEREADER_H__ */
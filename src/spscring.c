@@ -0,0 +1,146 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+
+#include "common.h"
+#include "spscring.h"
+
+/* how an empty ring is waited out: busy, then yielding, then parked */
+#define RING_SPINS 128
+#define RING_YIELDS 16
+
+/* the capacity is rounded up to a power of two */
+SpscRing *
+spsc_ring_new (guint capacity)
+{
+  SpscRing *ring = g_new0 (SpscRing, 1);
+  guint size = 1;
+
+  while (size < capacity)
+    size <<= 1;
+  ring->slots = g_new0 (gpointer, size);
+  ring->mask = size - 1;
+  MUTEX_INIT (ring->lock);
+  COND_INIT (ring->cond);
+  return ring;
+}
+
+void
+spsc_ring_free (SpscRing * ring)
+{
+  MUTEX_CLEAR (ring->lock);
+  COND_CLEAR (ring->cond);
+  g_free (ring->slots);
+  g_free (ring);
+}
+
+/* FALSE if the ring is full. the rings hold every block of a pool, so
+ * this doesn't happen for them */
+gboolean
+spsc_ring_push (SpscRing * ring, gpointer item)
+{
+  guint tail = (guint) ring->tail;
+
+  if (tail - (guint) g_atomic_int_get (&ring->head) > ring->mask)
+    return FALSE;
+  ring->slots[tail & ring->mask] = item;
+  /* the slot is filled before the consumer can see it */
+  g_atomic_int_set (&ring->tail, (gint) (tail + 1));
+  /* the consumer raises the flag before it looks at the tail a last
+   * time, one of the two sees the other */
+  if (g_atomic_int_get (&ring->waiting))
+    spsc_ring_wake (ring);
+  return TRUE;
+}
+
+/* NULL if the ring is empty */
+gpointer
+spsc_ring_try_pop (SpscRing * ring)
+{
+  guint head = (guint) ring->head;
+  gpointer item;
+
+  if (head == (guint) g_atomic_int_get (&ring->tail))
+    return NULL;
+  item = ring->slots[head & ring->mask];
+  g_atomic_int_set (&ring->head, (gint) (head + 1));
+  return item;
+}
+
+/* waits for the next item, NULL once stop is set */
+gpointer
+spsc_ring_pop (SpscRing * ring, volatile gint * stop)
+{
+  guint waited = 0;
+  gpointer item;
+
+  while (!(item = spsc_ring_try_pop (ring))) {
+    if (stop && g_atomic_int_get (stop))
+      return NULL;
+    if (++waited < RING_SPINS)
+      continue;
+    if (waited < RING_SPINS + RING_YIELDS) {
+      g_thread_yield ();
+      continue;
+    }
+    MUTEX_LOCK (ring->lock);
+    g_atomic_int_set (&ring->waiting, 1);
+    while ((guint) ring->head == (guint) g_atomic_int_get (&ring->tail)
+        && !(stop && g_atomic_int_get (stop)))
+      COND_WAIT (ring->cond, ring->lock);
+    g_atomic_int_set (&ring->waiting, 0);
+    MUTEX_UNLOCK (ring->lock);
+  }
+  return item;
+}
+
+void
+spsc_ring_wake (SpscRing * ring)
+{
+  MUTEX_LOCK (ring->lock);
+  COND_SIGNAL (ring->cond);
+  MUTEX_UNLOCK (ring->lock);
+}
+
+void
+thread_set_cpu (gint cpu, const gchar * what)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t set;
+
+  if (cpu < 0)
+    return;
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  /* 0 is the calling thread */
+  if (sched_setaffinity (0, sizeof (set), &set) < 0)
+    GST_WARNING ("could not pin the %s thread to CPU %i (%i)", what, cpu,
+        errno);
+  else
+    GST_DEBUG ("pinned the %s thread to CPU %i", what, cpu);
+#else
+  if (cpu >= 0)
+    GST_WARNING ("built without CPU affinity, the %s thread isn't pinned",
+        what);
+#endif
+}
@@ -0,0 +1,55 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_SPSCRING_H__
+#define __BDREMUX_SPSCRING_H__
+
+#include "common.h"
+
+/* a bounded queue of pointers between exactly one producer and one
+ * consumer thread. each side only writes its own index and reads the
+ * other's, so neither takes a lock while items flow; a consumer that
+ * finds the ring empty spins briefly, yields and finally parks on the
+ * condition, which the producer only signals when it's parked. the
+ * indices sit on cache lines of their own */
+typedef struct _SpscRing
+{
+  gpointer *slots;
+  guint mask;
+  volatile gint head;           /* next slot to pop, the consumer's */
+  gchar pad[64 - sizeof (gint)];
+  volatile gint tail;           /* next slot to push, the producer's */
+  gchar pad2[64 - sizeof (gint)];
+  volatile gint waiting;        /* the consumer is parked */
+  CompatMutex lock;
+  CompatCond cond;
+} SpscRing;
+
+SpscRing *spsc_ring_new (guint capacity);
+void spsc_ring_free (SpscRing * ring);
+gboolean spsc_ring_push (SpscRing * ring, gpointer item);
+gpointer spsc_ring_try_pop (SpscRing * ring);
+gpointer spsc_ring_pop (SpscRing * ring, volatile gint * stop);
+/* lets a parked consumer see that stop was set */
+void spsc_ring_wake (SpscRing * ring);
+
+/* pins the calling thread to a CPU, -1 leaves it to the scheduler */
+void thread_set_cpu (gint cpu, const gchar * what);
+
+#endif /* __BDREMUX_SPSCRING_H__ */
@@ -0,0 +1,1101 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "tsfast.h"
+#include "tspsi.h"
+
+#define FAST_READ_SIZE (TS_PACKET_SIZE * 4096)
+#define FAST_WRITE_PACKETS (M2TS_ALIGNED_UNIT_PACKETS * 128)
+#define FAST_MAX_QUEUED (64 * 1024)
+/* a single source packet may expand to PAT + PMT + itself */
+#define FAST_QUEUE_SLACK 4
+/* a PES packet started longer ago is written before it's complete */
+#define FAST_MAX_PES_HOLD (FAST_MAX_QUEUED / 4)
+
+/* output PIDs of the rewritten PSI, as used by mpegtsmux */
+#define FAST_PROGRAM_NUMBER 1
+#define FAST_PMT_PID 0x0100
+#define FAST_PCR_PID 0x1001
+
+/* PCR gaps beyond this are handled as timebase discontinuity */
+#define FAST_MAX_PCR_GAP (10 * PCR_CLOCK_FREQ)
+/* arrival time per packet when the stream carries no usable PCR yet,
+ * corresponds to 20 Mbit/s */
+#define FAST_DEFAULT_PACKET_TICKS (PCR_CLOCK_FREQ * TS_PACKET_SIZE * 8 / 20000000)
+
+typedef enum
+{
+  PID_DROP = 0,
+  PID_ES_WAIT,
+  PID_ES,
+  PID_PCR,
+  PID_PAT,
+  PID_PMT
+} PidAction;
+
+typedef struct _FastState
+{
+  FastRemux *fr;
+  OutWriter *writer;
+  RangeReader *reader;
+
+  guint8 pid_action[TS_MAX_PID];
+  guint16 pid_remap[TS_MAX_PID];
+  TsProgram source, target;
+  guint16 video_pid;
+  TsCodec video_codec;
+  /* PIDs whose stream attributes the clip information still lacks */
+  guint8 pid_sniff[TS_MAX_PID];
+  /* continuity counters carry on across cuts as they do where the parallel
+   * remux joins its parts: once a PID has been written, delta is added to
+   * the counter of its packets after every cut */
+  guint8 pid_written[TS_MAX_PID];
+  guint8 cc_delta[TS_MAX_PID], next_cc[TS_MAX_PID];
+  /* with cuts: where the PES packet of every PID starts and how many of
+   * its bytes are still to come, 0 once complete or of open length */
+  guint64 pes_start[TS_MAX_PID];
+  guint pes_left[TS_MAX_PID];
+  gboolean started;
+  guint8 pat_cc, pmt_cc;
+
+  /* source packet counter, the byte position in units of packets */
+  guint64 packet_index;
+
+  /* PCR interpolation, new_timebase flags the next PCR written */
+  gboolean have_pcr, pcr_discont, new_timebase;
+  gint64 last_pcr, last_arrival;
+  guint64 last_pcr_index;
+  gint64 rate_ticks, rate_packets;
+
+  /* source packets queued for output, the first n_resolved of them already
+   * carry their arrival timestamp */
+  guint8 *queue;
+  guint64 *queue_index;
+  guint n_queued, n_resolved;
+  gint64 first_ats, last_ats;
+
+  guint64 spn;
+  guint64 bytes_read, bytes_written;
+
+  /* the ranges of this result are applied here instead of by the reader
+   * when it reads more of the source for other results */
+  gboolean gated;
+  guint range_index;
+  gboolean in_range, entered_range, done;
+
+  /* once due, a checkpoint is taken at the next GOP start and goes to the
+   * journal as soon as the result holds everything before it */
+  CheckpointJournal *journal;
+  GTimer *checkpoint_timer;
+  gboolean checkpoint_due, snapshot_taken;
+  CheckpointState snapshot;
+  GArray *entries;              /* of EpMapEntry since the last checkpoint */
+} FastState;
+
+static gboolean commit_checkpoint (FastState * st, gchar ** error);
+
+/* how many of the queued packets may be written: with cuts the start of a
+ * PES packet stays queued until it's complete, so finish_pes() can still
+ * shorten it if a cut comes first */
+static guint
+writable_packets (FastState * st)
+{
+  guint64 first = st->spn - st->n_queued, limit = st->spn;
+  guint i;
+
+  for (i = 0; i < st->source.n_streams; i++) {
+    guint16 pid = st->source.streams[i].pid;
+    if (!st->pes_left[pid] || st->pes_start[pid] < first)
+      continue;
+    if (st->spn - st->pes_start[pid] > FAST_MAX_PES_HOLD) {
+      GST_DEBUG ("PES packet of PID 0x%04x at SPN %" G_GUINT64_FORMAT
+          " still incomplete, not holding it back", pid, st->pes_start[pid]);
+      st->pes_left[pid] = 0;
+      continue;
+    }
+    limit = MIN (limit, st->pes_start[pid]);
+  }
+  return limit - first;
+}
+
+static gboolean
+write_out (FastState * st, const guint8 * data, gsize len, gchar ** error)
+{
+  if (st->fr->sink) {
+    if (!st->fr->sink (data, len, st->fr->user_data, error))
+      return FALSE;
+  } else if (!out_writer_write (st->writer, data, len, error))
+    return FALSE;
+  st->bytes_written += len;
+  if (st->fr->counters) {
+    st->fr->counters->bytes_written = st->bytes_written;
+    st->fr->counters->position = (st->last_ats - st->first_ats) / 300;
+  }
+  if (st->snapshot_taken
+      && st->writer->offset >= st->snapshot.spn * M2TS_PACKET_SIZE)
+    return commit_checkpoint (st, error);
+  return TRUE;
+}
+
+/* writes all resolved aligned units, everything if flush is set */
+static gboolean
+flush_queue (FastState * st, gboolean flush, gchar ** error)
+{
+  guint n = st->n_resolved;
+
+  /* aligned to the start of the result, which a resumed remux doesn't
+   * queue */
+  if (!flush) {
+    guint rest;
+    if (st->fr->ranges)
+      n = MIN (n, writable_packets (st));
+    rest = (st->spn - st->n_queued + n) % M2TS_ALIGNED_UNIT_PACKETS;
+    n = n > rest ? n - rest : 0;
+  }
+  if (n == 0)
+    return TRUE;
+
+  if (!write_out (st, st->queue, n * M2TS_PACKET_SIZE, error))
+    return FALSE;
+
+  memmove (st->queue, st->queue + n * M2TS_PACKET_SIZE,
+      (st->n_queued - n) * M2TS_PACKET_SIZE);
+  memmove (st->queue_index, st->queue_index + n,
+      (st->n_queued - n) * sizeof (guint64));
+  st->n_queued -= n;
+  st->n_resolved -= n;
+  return TRUE;
+}
+
+static inline void
+set_ats (guint8 * slot, gint64 ats)
+{
+  guint32 header = (guint32) ats & M2TS_ATS_MASK;
+  slot[0] = header >> 24;
+  slot[1] = header >> 16;
+  slot[2] = header >> 8;
+  slot[3] = header;
+}
+
+/* interpolates the arrival time of all queued packets linearly between the
+ * last two PCRs, packets before the first PCR are extrapolated backwards */
+static void
+resolve_queue (FastState * st)
+{
+  guint i;
+
+  for (i = st->n_resolved; i < st->n_queued; i++) {
+    gint64 k = (gint64) st->queue_index[i] - (gint64) st->last_pcr_index;
+    gint64 ats = st->last_arrival + k * st->rate_ticks / st->rate_packets;
+    if (ats < st->last_ats)
+      ats = st->last_ats;
+    if (st->last_ats == G_MININT64)
+      st->first_ats = ats;
+    set_ats (st->queue + i * M2TS_PACKET_SIZE, ats);
+    st->last_ats = ats;
+    if (G_UNLIKELY (st->snapshot_taken)
+        && st->spn - st->n_queued + i + 1 == st->snapshot.spn)
+      st->snapshot.last_ats = ats;
+  }
+  st->n_resolved = st->n_queued;
+}
+
+static void
+handle_pcr (FastState * st, const guint8 * p, gint64 pcr)
+{
+  gint64 arrival;
+  guint64 packets;
+
+  if (!st->have_pcr) {
+    st->have_pcr = TRUE;
+    st->last_pcr = pcr;
+    st->last_arrival = pcr;
+    st->last_pcr_index = st->packet_index;
+    return;
+  }
+
+  packets = st->packet_index - st->last_pcr_index;
+  if (packets == 0)
+    return;
+
+  if (pcr < st->last_pcr && st->last_pcr - pcr > PCR_WRAP / 2)
+    arrival = pcr + PCR_WRAP - st->last_pcr;
+  else
+    arrival = pcr - st->last_pcr;
+
+  if (arrival <= 0 || arrival > FAST_MAX_PCR_GAP || st->pcr_discont
+      || ts_discontinuity_indicator (p)) {
+    GST_INFO ("PCR discontinuity at packet %" G_GUINT64_FORMAT,
+        st->packet_index);
+    if (st->rate_packets)
+      arrival = packets * st->rate_ticks / st->rate_packets;
+    else
+      arrival = packets * FAST_DEFAULT_PACKET_TICKS;
+  }
+
+  st->pcr_discont = FALSE;
+  st->rate_ticks = arrival;
+  st->rate_packets = packets;
+  st->last_arrival += arrival;
+  st->last_pcr = pcr;
+  st->last_pcr_index = st->packet_index;
+}
+
+static guint8 *
+queue_packet (FastState * st, const guint8 * p)
+{
+  guint8 *slot;
+
+  slot = st->queue + st->n_queued * M2TS_PACKET_SIZE;
+  memcpy (slot + 4, p, TS_PACKET_SIZE);
+  st->queue_index[st->n_queued++] = st->packet_index;
+  st->spn++;
+  return slot + 4;
+}
+
+static void
+queue_psi (FastState * st)
+{
+  guint8 packet[TS_PACKET_SIZE];
+
+  ts_write_pat (packet, FAST_PROGRAM_NUMBER, st->target.pmt_pid,
+      st->pat_cc++);
+  queue_packet (st, packet);
+  ts_write_pmt (packet, &st->target, st->pmt_cc++);
+  queue_packet (st, packet);
+}
+
+/* carries the PCR of a PID that isn't remuxed itself as adaptation-only
+ * packet. the adaptation field is built from the PCR alone, the rest of
+ * the source's isn't looked at */
+static void
+queue_pcr_packet (FastState * st, const guint8 * p)
+{
+  guint8 *out = queue_packet (st, p);
+
+  ts_set_pid (out, st->target.pcr_pid);
+  out[1] &= ~0x40;
+  out[3] = 0x20;
+  out[4] = TS_PACKET_SIZE - 5;
+  out[5] = (p[5] & 0x80) | 0x10;
+  /* out[6..11] is the PCR copied along with the packet */
+  memset (out + 12, 0xFF, TS_PACKET_SIZE - 12);
+  if (st->new_timebase) {
+    out[5] |= 0x80;             /* discontinuity_indicator */
+    st->new_timebase = FALSE;
+  }
+}
+
+/* carries an elementary stream packet over with its continuity counter
+ * following on from before the last cut */
+static void
+queue_es_packet (FastState * st, guint16 pid, const guint8 * p)
+{
+  guint8 *out = queue_packet (st, p);
+  gint64 pcr;
+
+  ts_set_pid (out, st->pid_remap[pid]);
+  out[3] = (out[3] & 0xF0) | ((ts_cc (out) + st->cc_delta[pid]) & 0x0F);
+  if (ts_has_payload (out))
+    st->next_cc[pid] = (ts_cc (out) + 1) & 0x0F;
+  if (st->new_timebase && pid == st->source.pcr_pid && ts_get_pcr (out, &pcr)) {
+    out[5] |= 0x80;             /* discontinuity_indicator */
+    st->new_timebase = FALSE;
+  }
+}
+
+/* follows the PES packets by their length, see writable_packets() */
+static void
+track_pes (FastState * st, guint16 pid, const guint8 * p)
+{
+  const guint8 *payload;
+  guint len, pes_len;
+
+  if (!(payload = ts_payload (p, &len)))
+    return;
+  if (!ts_pusi (p)) {
+    st->pes_left[pid] -= MIN (len, st->pes_left[pid]);
+    return;
+  }
+  st->pes_start[pid] = st->spn;
+  st->pes_left[pid] = 0;
+  if (len >= 6 && payload[0] == 0 && payload[1] == 0 && payload[2] == 1
+      && (payload[4] || payload[5])) {
+    pes_len = ((payload[4] << 8) | payload[5]) + 6;
+    st->pes_left[pid] = pes_len - MIN (len, pes_len);
+  }
+}
+
+/* a PES packet cut short is shortened to what it got, so it ends where its
+ * data does instead of taking the start of the next one along */
+static void
+finish_pes (FastState * st)
+{
+  guint64 first = st->spn - st->n_queued;
+  guint8 *out, *payload;
+  guint i, len, pes_len;
+
+  for (i = 0; i < st->source.n_streams; i++) {
+    guint16 pid = st->source.streams[i].pid;
+    if (!st->pes_left[pid])
+      continue;
+    if (st->pes_start[pid] < first)
+      GST_WARNING ("PES packet of PID 0x%04x at SPN %" G_GUINT64_FORMAT
+          " cut short after it was written", pid, st->pes_start[pid]);
+    else {
+      out = st->queue + (st->pes_start[pid] - first) * M2TS_PACKET_SIZE + 4;
+      payload = (guint8 *) ts_payload (out, &len);
+      pes_len = ((payload[4] << 8) | payload[5]) - st->pes_left[pid];
+      GST_DEBUG ("PES packet of PID 0x%04x at SPN %" G_GUINT64_FORMAT
+          " cut short by %u bytes", pid, st->pes_start[pid],
+          st->pes_left[pid]);
+      payload[4] = pes_len >> 8;
+      payload[5] = pes_len;
+    }
+    st->pes_left[pid] = 0;
+  }
+}
+
+
+static void
+add_entrypoint (FastState * st, guint64 spn, gint64 pts)
+{
+  if (st->fr->entry_point)
+    st->fr->entry_point (spn, pts, st->fr->user_data);
+  if (st->fr->clip)
+    clip_info_add_entry (st->fr->clip, spn, pts);
+}
+
+static void
+write_entrypoint (FastState * st, gint64 pts)
+{
+  add_entrypoint (st, st->spn, pts);
+  if (st->entries) {
+    EpMapEntry e = { st->spn, pts };
+    g_array_append_val (st->entries, e);
+  }
+}
+
+/* picks up video format and audio parameters from the first PES packets */
+static void
+sniff_stream_info (FastState * st, guint16 pid, const guint8 * payload,
+    guint len)
+{
+  TsStream *stream = ts_program_find_stream (&st->source, pid);
+
+  if (stream && clip_info_sniff_pes (st->fr->clip, st->pid_remap[pid],
+          stream->codec, payload, len))
+    st->pid_sniff[pid] = FALSE;
+}
+
+static void
+inspect_pes (FastState * st, guint16 pid, const guint8 * p)
+{
+  const guint8 *payload;
+  guint len;
+  gint64 pts;
+
+  if (!(payload = ts_payload (p, &len)))
+    return;
+  if (st->pid_sniff[pid])
+    sniff_stream_info (st, pid, payload, len);
+  if (pid != st->video_pid || !ts_pes_get_pts (payload, len, &pts))
+    return;
+  if (st->fr->clip)
+    clip_info_update_pts (st->fr->clip, pts);
+  if (ts_is_random_access (p, st->video_codec))
+    write_entrypoint (st, pts);
+}
+
+static void
+process_packet (FastState * st, const guint8 * p)
+{
+  guint16 pid = ts_pid (p);
+  gint64 pcr;
+
+  if (pid == st->source.pcr_pid && ts_get_pcr (p, &pcr))
+    handle_pcr (st, p, pcr);
+
+  switch (st->pid_action[pid]) {
+    case PID_DROP:
+      break;
+    case PID_PAT:
+      if (st->started && ts_pusi (p)) {
+        guint8 packet[TS_PACKET_SIZE];
+        ts_write_pat (packet, FAST_PROGRAM_NUMBER, st->target.pmt_pid,
+            st->pat_cc++);
+        queue_packet (st, packet);
+      }
+      break;
+    case PID_PMT:
+      if (st->started && ts_pusi (p)) {
+        guint8 packet[TS_PACKET_SIZE];
+        ts_write_pmt (packet, &st->target, st->pmt_cc++);
+        queue_packet (st, packet);
+      }
+      break;
+    case PID_PCR:
+      if (st->started && ts_has_adaptation (p) && ts_get_pcr (p, &pcr))
+        queue_pcr_packet (st, p);
+      break;
+    case PID_ES_WAIT:
+      if (!ts_pusi (p))
+        break;
+      if (pid == st->video_pid) {
+        if (!ts_is_random_access (p, st->video_codec))
+          break;
+        GST_INFO ("first video random access point at packet %"
+            G_GUINT64_FORMAT " -> start muxing", st->packet_index);
+        st->started = TRUE;
+        queue_psi (st);
+      } else if (!st->started)
+        break;
+      st->pid_action[pid] = PID_ES;
+      if (st->pid_written[pid])
+        st->cc_delta[pid] = (st->next_cc[pid] - ts_cc (p)) & 0x0F;
+      st->pid_written[pid] = TRUE;
+      /* fall through */
+    case PID_ES:
+      if (ts_pusi (p))
+        inspect_pes (st, pid, p);
+      if (st->fr->counters)
+        st->fr->counters->packets[pid]++;
+      if (st->fr->ranges)
+        track_pes (st, pid, p);
+      queue_es_packet (st, pid, p);
+      break;
+  }
+}
+
+/* the PSI PIDs must not clash with kept elementary stream PIDs */
+static guint16
+unused_pid (FastState * st, guint16 pid)
+{
+  guint i = 0;
+
+  while (i < st->target.n_streams) {
+    if (st->target.streams[i].pid == pid) {
+      pid++;
+      i = 0;
+    } else
+      i++;
+  }
+  return pid;
+}
+
+static gboolean
+select_streams (FastState * st, gchar ** error)
+{
+  FastRemux *fr = st->fr;
+  TsStream *selected[MAX_PIDS];
+  guint n_selected = 0, i;
+  gboolean pcr_carried = FALSE;
+
+  if (fr->auto_pids) {
+    TsStream *video = NULL;
+    for (i = 0; i < st->source.n_streams; i++)
+      if (TS_CODEC_IS_VIDEO (st->source.streams[i].codec)) {
+        video = &st->source.streams[i];
+        break;
+      }
+    if (!video) {
+      *error = g_strdup_printf ("no video stream found in %s!",
+          fr->in_filename);
+      return FALSE;
+    }
+    selected[n_selected++] = video;
+    for (i = 0; i < st->source.n_streams && n_selected < MAX_PIDS; i++)
+      if (TS_CODEC_IS_AUDIO (st->source.streams[i].codec))
+        selected[n_selected++] = &st->source.streams[i];
+  } else {
+    for (i = 0; i < fr->no_source_pids; i++) {
+      TsStream *stream = ts_program_find_stream (&st->source,
+          fr->a_source_pids[i]);
+      if (!stream) {
+        *error = g_strdup_printf ("source PID 0x%04x not found in PMT!",
+            fr->a_source_pids[i]);
+        return FALSE;
+      }
+      if ((i == 0 && !TS_CODEC_IS_VIDEO (stream->codec))
+          || (i > 0 && !TS_CODEC_IS_AUDIO (stream->codec))) {
+        *error = g_strdup_printf ("unsupported %s stream type 0x%02x on "
+            "PID 0x%04x!", i ? "audio" : "video", stream->stream_type,
+            stream->pid);
+        return FALSE;
+      }
+      selected[n_selected++] = stream;
+    }
+  }
+
+  if (n_selected == 0) {
+    *error = g_strdup ("no source PIDs given!");
+    return FALSE;
+  }
+
+  st->target.program_number = FAST_PROGRAM_NUMBER;
+  st->target.version = 0;
+  st->target.n_streams = n_selected;
+  st->video_pid = selected[0]->pid;
+  st->video_codec = selected[0]->codec;
+
+  for (i = 0; i < n_selected; i++) {
+    TsStream *out = &st->target.streams[i];
+    guint16 sink_pid = selected[i]->pid;
+
+    if (i < fr->no_sink_pids && fr->a_sink_pids[i] != -1)
+      sink_pid = fr->a_sink_pids[i];
+    *out = *selected[i];
+    out->pid = sink_pid;
+    out->stream_type = ts_codec_bd_stream_type (out->codec, out->stream_type);
+
+    st->pid_action[selected[i]->pid] = PID_ES_WAIT;
+    st->pid_remap[selected[i]->pid] = sink_pid;
+    if (fr->clip) {
+      gchar lang[4];
+      clip_info_add_stream (fr->clip, sink_pid, selected[i]->codec,
+          selected[i]->stream_type,
+          ts_stream_get_language (selected[i], lang) ? lang : NULL);
+      st->pid_sniff[selected[i]->pid] = TRUE;
+    }
+    if (selected[i]->pid == st->source.pcr_pid) {
+      st->target.pcr_pid = sink_pid;
+      pcr_carried = TRUE;
+    }
+    if (fr->linked)
+      fr->linked (selected[i]->pid, sink_pid, ts_codec_caps_name (out->codec),
+          fr->user_data);
+  }
+
+  st->target.pmt_pid = unused_pid (st, FAST_PMT_PID);
+  if (!pcr_carried) {
+    st->pid_action[st->source.pcr_pid] = PID_PCR;
+    st->target.pcr_pid = unused_pid (st, FAST_PCR_PID);
+  }
+  st->pid_action[TS_PID_PAT] = PID_PAT;
+  st->pid_action[st->source.pmt_pid] = PID_PMT;
+  if (fr->clip) {
+    fr->clip->pmt_pid = st->target.pmt_pid;
+    fr->clip->pcr_pid = st->target.pcr_pid;
+  }
+  return TRUE;
+}
+
+/* the data following a cut doesn't continue any PES packet nor the PCR
+ * timeline, wait for the next unit start of every stream again. the PES
+ * packets cut short are finished and the next PCR written is flagged as
+ * the start of a new timebase */
+static void
+start_range (FastState * st)
+{
+  guint i;
+
+  GST_DEBUG ("input range starts at packet %" G_GUINT64_FORMAT,
+      st->packet_index);
+  st->pcr_discont = TRUE;
+  if (st->fr->clip)
+    clip_info_add_discontinuity (st->fr->clip, st->spn);
+  st->new_timebase = st->started;
+  finish_pes (st);
+  for (i = 0; i < st->source.n_streams; i++)
+    if (st->pid_action[st->source.streams[i].pid] == PID_ES)
+      st->pid_action[st->source.streams[i].pid] = PID_ES_WAIT;
+}
+
+/* whether the packet at offset of the source belongs to the result, these
+ * are the packets the reader passes if the result is remuxed on its own */
+static gboolean
+in_ranges (FastState * st, guint64 offset)
+{
+  GArray *ranges = st->fr->ranges;
+  ByteRange *range = NULL;
+
+  while (st->range_index < ranges->len) {
+    range = &g_array_index (ranges, ByteRange, st->range_index);
+    if (offset + TS_PACKET_SIZE <= range->end)
+      break;
+    st->range_index++;
+    st->in_range = FALSE;
+  }
+  if (st->range_index == ranges->len) {
+    st->done = TRUE;
+    return FALSE;
+  }
+  if (offset < range->start)
+    return FALSE;
+  if (!st->in_range) {
+    if (st->entered_range)
+      start_range (st);
+    st->in_range = st->entered_range = TRUE;
+  }
+  return TRUE;
+}
+
+/* a remux can be continued at any video random access point once the
+ * result has begun */
+static inline gboolean
+is_resume_point (FastState * st, const guint8 * p)
+{
+  return st->started && st->spn > 0 && ts_pid (p) == st->video_pid
+      && ts_pusi (p) && ts_is_random_access (p, st->video_codec);
+}
+
+/* notes the state right before the packet at input_offset is processed */
+static void
+take_snapshot (FastState * st, guint64 input_offset)
+{
+  CheckpointState *cp = &st->snapshot;
+  guint i;
+
+  memset (cp, 0, sizeof (*cp));
+  cp->spn = st->spn;
+  cp->input_offset = input_offset;
+  cp->packet_index = st->packet_index;
+  cp->pat_cc = st->pat_cc;
+  cp->pmt_cc = st->pmt_cc;
+  for (i = 0; i < st->source.n_streams; i++) {
+    guint16 pid = st->source.streams[i].pid;
+    if (st->pid_action[pid] == PID_ES)
+      cp->es_pids[cp->n_es_pids++] = pid;
+    if (st->pid_written[pid]) {
+      cp->cc_pids[cp->n_cc_pids] = pid;
+      cp->cc_delta[cp->n_cc_pids] = st->cc_delta[pid];
+      cp->next_cc[cp->n_cc_pids++] = st->next_cc[pid];
+    }
+  }
+  cp->have_pcr = st->have_pcr;
+  cp->pcr_discont = st->pcr_discont;
+  cp->new_timebase = st->new_timebase;
+  cp->last_pcr = st->last_pcr;
+  cp->last_arrival = st->last_arrival;
+  cp->last_pcr_index = st->last_pcr_index;
+  cp->rate_ticks = st->rate_ticks;
+  cp->rate_packets = st->rate_packets;
+  /* otherwise set by resolve_queue() */
+  if (st->n_resolved == st->n_queued)
+    cp->last_ats = st->last_ats;
+  if (st->fr->clip) {
+    cp->n_stc = st->fr->clip->n_stc;
+    memcpy (cp->stc, st->fr->clip->stc, cp->n_stc * sizeof (ClipStcSequence));
+  } else {
+    cp->n_stc = 1;
+    cp->stc[0].first_pts = cp->stc[0].last_pts = -1;
+  }
+  st->checkpoint_due = FALSE;
+  st->snapshot_taken = TRUE;
+}
+
+static gboolean
+commit_checkpoint (FastState * st, gchar ** error)
+{
+  guint n = 0;
+
+  st->snapshot_taken = FALSE;
+  st->snapshot.first_ats = st->first_ats;
+  while (n < st->entries->len
+      && g_array_index (st->entries, EpMapEntry, n).spn < st->snapshot.spn)
+    n++;
+  /* the journal must never get ahead of the result */
+  if (!out_writer_sync (st->writer, error)
+      || !checkpoint_journal_append (st->journal,
+          (EpMapEntry *) st->entries->data, n, &st->snapshot, error))
+    return FALSE;
+  if (n)
+    g_array_remove_range (st->entries, 0, n);
+  g_timer_start (st->checkpoint_timer);
+  GST_DEBUG ("checkpoint at SPN %" G_GUINT64_FORMAT ", input offset %"
+      G_GUINT64_FORMAT, st->snapshot.spn, st->snapshot.input_offset);
+  return TRUE;
+}
+
+/* describes the job, so the journal of the result isn't applied to
+ * another source or stream selection */
+static gchar *
+describe_job (FastState * st)
+{
+  GString *job = g_string_new (NULL);
+  guint i;
+
+  g_string_append (job, st->fr->in_filename);
+  for (i = 0; i < st->source.n_streams; i++) {
+    guint16 pid = st->source.streams[i].pid;
+    if (st->pid_action[pid] == PID_ES_WAIT)
+      g_string_append_printf (job, " 0x%04x:0x%04x", pid, st->pid_remap[pid]);
+  }
+  for (i = 0; st->fr->ranges && i < st->fr->ranges->len; i++) {
+    ByteRange *range = &g_array_index (st->fr->ranges, ByteRange, i);
+    g_string_append_printf (job, " %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+        range->start, range->end);
+  }
+  return g_string_free (job, FALSE);
+}
+
+/* continues where the checkpoint was taken, the entry points before it are
+ * reported once more */
+static gboolean
+restore_checkpoint (FastState * st, gchar ** error)
+{
+  CheckpointState *cp = &st->snapshot;
+  guint i;
+
+  if (!range_reader_seek (st->reader, cp->input_offset)) {
+    *error = g_strdup_printf ("%s ends before the checkpoint!",
+        st->fr->in_filename);
+    return FALSE;
+  }
+  st->bytes_read = cp->input_offset;
+  st->spn = cp->spn;
+  st->bytes_written = cp->spn * M2TS_PACKET_SIZE;
+  st->packet_index = cp->packet_index;
+  st->started = TRUE;
+  st->pat_cc = cp->pat_cc;
+  st->pmt_cc = cp->pmt_cc;
+  for (i = 0; i < cp->n_es_pids; i++)
+    if (st->pid_action[cp->es_pids[i]] == PID_ES_WAIT)
+      st->pid_action[cp->es_pids[i]] = PID_ES;
+  for (i = 0; i < cp->n_cc_pids; i++) {
+    st->pid_written[cp->cc_pids[i]] = TRUE;
+    st->cc_delta[cp->cc_pids[i]] = cp->cc_delta[i];
+    st->next_cc[cp->cc_pids[i]] = cp->next_cc[i];
+  }
+  st->new_timebase = cp->new_timebase;
+  st->have_pcr = cp->have_pcr;
+  st->pcr_discont = cp->pcr_discont;
+  st->last_pcr = cp->last_pcr;
+  st->last_arrival = cp->last_arrival;
+  st->last_pcr_index = cp->last_pcr_index;
+  st->rate_ticks = cp->rate_ticks;
+  st->rate_packets = cp->rate_packets;
+  st->first_ats = cp->first_ats;
+  st->last_ats = cp->last_ats;
+  for (i = 0; st->fr->clip && i < cp->n_stc; i++) {
+    if (i > 0)
+      clip_info_add_discontinuity (st->fr->clip, cp->stc[i].spn);
+    clip_info_update_pts (st->fr->clip, cp->stc[i].first_pts);
+    clip_info_update_pts (st->fr->clip, cp->stc[i].last_pts);
+  }
+  for (i = 0; i < st->entries->len; i++) {
+    EpMapEntry *e = &g_array_index (st->entries, EpMapEntry, i);
+    add_entrypoint (st, e->spn, e->pts);
+  }
+  g_array_set_size (st->entries, 0);
+  return TRUE;
+}
+
+static gboolean
+open_journal (FastState * st, gchar ** error)
+{
+  gchar *filename, *job;
+  gboolean resumed = FALSE;
+
+  filename = g_strconcat (st->fr->out_filename, CHECKPOINT_SUFFIX, NULL);
+  job = describe_job (st);
+  st->entries = g_array_new (FALSE, FALSE, sizeof (EpMapEntry));
+  st->journal = checkpoint_journal_open (filename, job,
+      st->fr->checkpoint.resume, &st->snapshot, st->entries, &resumed, error);
+  g_free (filename);
+  g_free (job);
+  if (!st->journal || (resumed && !restore_checkpoint (st, error)))
+    return FALSE;
+  st->checkpoint_timer = g_timer_new ();
+  return TRUE;
+}
+
+/* runs the source packet at offset through the remuxer of one result */
+static gboolean
+feed_packet (FastState * st, const guint8 * p, guint64 offset,
+    gchar ** error)
+{
+  if (st->gated && !in_ranges (st, offset))
+    return TRUE;
+  if (G_UNLIKELY (st->checkpoint_due) && is_resume_point (st, p))
+    take_snapshot (st, offset);
+  process_packet (st, p);
+  st->packet_index++;
+
+  if (G_UNLIKELY (st->n_queued >= FAST_MAX_QUEUED)) {
+    GST_WARNING ("no PCR for %i packets, extrapolating arrival times",
+        FAST_MAX_QUEUED);
+    if (!st->rate_packets) {
+      st->rate_ticks = FAST_DEFAULT_PACKET_TICKS;
+      st->rate_packets = 1;
+    }
+    if (!st->have_pcr) {
+      st->have_pcr = TRUE;
+      st->last_pcr_index = st->queue_index[0];
+      st->last_arrival = st->last_pcr = 0;
+    }
+    resolve_queue (st);
+  } else if (st->have_pcr && st->rate_packets
+      && st->packet_index - 1 == st->last_pcr_index)
+    resolve_queue (st);
+
+  if (st->n_resolved >= FAST_WRITE_PACKETS)
+    return flush_queue (st, FALSE, error);
+  return TRUE;
+}
+
+/* the rest of the source is of no use once every result has got all of
+ * its ranges */
+static gboolean
+all_done (FastState ** states, guint n_states)
+{
+  guint i;
+
+  for (i = 0; i < n_states; i++)
+    if (!states[i]->done)
+      return FALSE;
+  return TRUE;
+}
+
+/* reads the source once and hands every packet to all results */
+static gboolean
+remux_loop (FastState ** states, guint n_states, gchar ** error)
+{
+  FastState *st = states[0];
+  guint8 *buf = g_malloc (FAST_READ_SIZE);
+  gsize fill = 0;
+  guint64 bytes_read = st->bytes_read;
+  gboolean ret = TRUE;
+  guint i;
+
+  while (ret && !all_done (states, n_states)) {
+    gboolean discont;
+    gssize len = range_reader_read (st->reader, buf + fill,
+        FAST_READ_SIZE - fill, &discont);
+    gsize pos = 0;
+
+    if (len < 0) {
+      *error = g_strdup_printf ("could not read from %s! (%i)",
+          st->fr->in_filename, errno);
+      ret = FALSE;
+      break;
+    }
+    if (len == 0)
+      break;
+    if (st->journal && !st->snapshot_taken && st->fr->checkpoint.interval
+        && g_timer_elapsed (st->checkpoint_timer, NULL) * 1000 >=
+        st->fr->checkpoint.interval)
+      st->checkpoint_due = TRUE;
+    if (discont) {
+      /* drop the incomplete packet the previous range ended with */
+      memmove (buf, buf + fill, len);
+      fill = 0;
+      for (i = 0; i < n_states; i++)
+        start_range (states[i]);
+    }
+    fill += len;
+    bytes_read += len;
+    for (i = 0; i < n_states; i++)
+      states[i]->bytes_read = bytes_read;
+    if (st->fr->progress)
+      st->fr->progress (bytes_read, st->fr->user_data);
+
+    while (pos + TS_PACKET_SIZE <= fill && ret) {
+      if (G_UNLIKELY (buf[pos] != TS_SYNC_BYTE)) {
+        gint skip = ts_find_sync (buf + pos, fill - pos);
+        GST_WARNING ("lost sync at packet %" G_GUINT64_FORMAT,
+            st->packet_index);
+        if (skip < 0) {
+          pos = fill;
+          break;
+        }
+        pos += skip;
+        continue;
+      }
+      for (i = 0; i < n_states && ret; i++)
+        ret = feed_packet (states[i], buf + pos, bytes_read - (fill - pos),
+            error);
+      pos += TS_PACKET_SIZE;
+    }
+    memmove (buf, buf + pos, fill - pos);
+    fill -= pos;
+  }
+
+  g_free (buf);
+  return ret;
+}
+
+/* resolves the tail with the last known rate and pads the last aligned unit
+ * with null packets */
+static gboolean
+finish_output (FastState * st, gchar ** error)
+{
+  guint8 null_packet[TS_PACKET_SIZE];
+
+  if (!st->rate_packets) {
+    st->rate_ticks = FAST_DEFAULT_PACKET_TICKS;
+    st->rate_packets = 1;
+  }
+  if (!st->have_pcr && st->n_queued) {
+    st->last_pcr_index = st->queue_index[0];
+    st->last_arrival = 0;
+  }
+  resolve_queue (st);
+  if (st->fr->ranges)
+    finish_pes (st);
+
+  memset (null_packet, 0xFF, TS_PACKET_SIZE);
+  null_packet[0] = TS_SYNC_BYTE;
+  null_packet[1] = 0x1F;
+  null_packet[2] = 0xFF;
+  null_packet[3] = 0x10;
+  while (st->spn % M2TS_ALIGNED_UNIT_PACKETS) {
+    queue_packet (st, null_packet);
+    set_ats (st->queue + (st->n_queued - 1) * M2TS_PACKET_SIZE, st->last_ats);
+    st->n_resolved = st->n_queued;
+  }
+  return flush_queue (st, TRUE, error);
+}
+
+/* sets up the remuxer of one result of the source program */
+static gboolean
+open_result (FastState * st, gchar ** error)
+{
+  FastRemux *fr = st->fr;
+  OutWriterSettings output;
+
+  if (!select_streams (st, error))
+    return FALSE;
+  /* before the journal, a resumed remux continues from its checkpoint */
+  st->last_ats = G_MININT64;
+  if ((fr->checkpoint.interval || fr->checkpoint.resume)
+      && !open_journal (st, error))
+    return FALSE;
+
+  if (!fr->sink) {
+    output = fr->output;
+    output.resume = st->bytes_written;
+    st->writer = out_writer_open (fr->out_filename, &output, error);
+    if (!st->writer)
+      return FALSE;
+  }
+
+  st->queue = g_malloc ((FAST_MAX_QUEUED + FAST_QUEUE_SLACK) *
+      M2TS_PACKET_SIZE);
+  st->queue_index = g_new (guint64, FAST_MAX_QUEUED + FAST_QUEUE_SLACK);
+  return TRUE;
+}
+
+static gboolean
+close_result (FastState * st, gboolean ret, gchar ** error)
+{
+  if (st->writer && !out_writer_close (st->writer, ret ? error : NULL))
+    ret = FALSE;
+  if (st->journal)
+    checkpoint_journal_close (st->journal, ret);
+  if (st->checkpoint_timer)
+    g_timer_destroy (st->checkpoint_timer);
+  if (st->entries)
+    g_array_free (st->entries, TRUE);
+  g_free (st->queue);
+  g_free (st->queue_index);
+  g_free (st);
+  return ret;
+}
+
+gboolean
+fast_remux_run (FastRemux * fr, gchar ** error)
+{
+  return fast_remux_run_multi (&fr, 1, error);
+}
+
+/* remuxes several results from a single read of the source, which is
+ * named, read ahead and followed as by the first one. the reader skips
+ * the cuts if all results share them, otherwise every result picks its
+ * ranges from the whole source */
+gboolean
+fast_remux_run_multi (FastRemux ** results, guint n_results, gchar ** error)
+{
+  FastRemux *fr = results[0];
+  FastState **states;
+  TsProgram *source;
+  RangeReader *reader = NULL;
+  GArray *ranges = fr->ranges;
+  gboolean ret = FALSE;
+  int in_fd;
+  guint i;
+
+  for (i = 1; i < n_results; i++)
+    if (!byte_ranges_equal (ranges, results[i]->ranges))
+      ranges = NULL;
+  states = g_new0 (FastState *, n_results);
+  source = g_new0 (TsProgram, 1);
+
+  if (IS_FD_PATH (fr->in_filename))
+    in_fd = fd_path_dup (fr->in_filename, STDIN_FILENO);
+  else
+    in_fd = open (fr->in_filename, O_RDONLY);
+  if (in_fd < 0) {
+    *error = g_strdup_printf ("could not open %s for reading! (%i)",
+        fr->in_filename, errno);
+    goto out;
+  }
+
+  reader = range_reader_new (in_fd, ranges, &fr->input, &fr->follow);
+  if (!range_reader_scan_program (reader,
+          fr->auto_pids ? -1 : fr->a_source_pids[0], source)) {
+    *error = g_strdup_printf ("no suitable PAT/PMT found in %s!",
+        fr->in_filename);
+    goto out;
+  }
+  GST_INFO ("using program %i (PMT PID 0x%04x, PCR PID 0x%04x, %i streams)"
+      " for %u results", source->program_number, source->pmt_pid,
+      source->pcr_pid, source->n_streams, n_results);
+
+  for (i = 0; i < n_results; i++) {
+    FastState *st = states[i] = g_new0 (FastState, 1);
+
+    st->fr = results[i];
+    st->reader = reader;
+    st->source = *source;
+    st->gated = !ranges && results[i]->ranges;
+    if (!open_result (st, error))
+      goto out;
+  }
+
+  if (!remux_loop (states, n_results, error))
+    goto out;
+  for (i = 0; i < n_results; i++) {
+    if (!finish_output (states[i], error))
+      goto out;
+    GST_INFO ("fast remux of %s done: %" G_GUINT64_FORMAT " packets read, %"
+        G_GUINT64_FORMAT " bytes written", results[i]->out_filename,
+        states[i]->packet_index, states[i]->bytes_written);
+  }
+  ret = TRUE;
+
+out:
+  if (reader)
+    range_reader_free (reader);
+  if (in_fd >= 0)
+    close (in_fd);
+  for (i = 0; i < n_results; i++)
+    if (states[i] && !close_result (states[i], ret, error))
+      ret = FALSE;
+  g_free (states);
+  g_free (source);
+  return ret;
+}
@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSFAST_H__
+#define __BDREMUX_TSFAST_H__
+
+#include "checkpoint.h"
+#include "clipinfo.h"
+#include "common.h"
+#include "outwriter.h"
+#include "rangereader.h"
+
+/* called for every video random access point written to the output */
+typedef void (*FastEntryPointFunc) (guint64 spn, gint64 pts, gpointer user_data);
+/* called for every elementary stream carried over */
+typedef void (*FastLinkedFunc) (guint source_pid, guint sink_pid,
+    const gchar * caps, gpointer user_data);
+/* called after every read with the number of input bytes consumed */
+typedef void (*FastProgressFunc) (guint64 position, gpointer user_data);
+/* takes the output instead of a file, FALSE with the error set fails the
+ * remux */
+typedef gboolean (*FastSinkFunc) (const guint8 * data, gsize len,
+    gpointer user_data, gchar ** error);
+
+/* kept up to date while remuxing if the caller hands them in */
+typedef struct _FastCounters
+{
+  guint64 packets[TS_MAX_PID];  /* source packets carried over per PID */
+  guint64 bytes_written;
+  gint64 position;              /* 90 kHz of arrival time written */
+} FastCounters;
+
+/* native TS -> M2TS remuxer working on transport packets directly:
+ * PIDs are filtered and remapped by table lookup, PAT/PMT are rewritten and
+ * the arrival timestamps are interpolated from the PCR */
+typedef struct _FastRemux
+{
+  const gchar *in_filename;
+  const gchar *out_filename;
+  gint a_source_pids[MAX_PIDS], a_sink_pids[MAX_PIDS];
+  guint no_source_pids, no_sink_pids;
+  gboolean auto_pids;
+  GArray *ranges;               /* of ByteRange to remux, NULL for all */
+  ClipInfo *clip;
+  ReadAheadSettings input;
+  FollowSettings follow;        /* only without ranges */
+  OutWriterSettings output;
+  CheckpointSettings checkpoint;        /* RESULT.checkpoint, not for streams */
+
+  FastEntryPointFunc entry_point;
+  FastLinkedFunc linked;
+  FastProgressFunc progress;
+  /* out_filename only names the output if it goes to the sink, which
+   * doesn't take checkpoints */
+  FastSinkFunc sink;
+  gpointer user_data;
+  FastCounters *counters;
+} FastRemux;
+
+gboolean fast_remux_run (FastRemux * fr, gchar ** error);
+gboolean fast_remux_run_multi (FastRemux ** results, guint n_results,
+    gchar ** error);
+
+#endif /* __BDREMUX_TSFAST_H__ */
@@ -0,0 +1,247 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tsindex.h"
+#include "tspsi.h"
+#include "tsscan.h"
+
+#define INDEX_READ_SIZE (M2TS_PACKET_SIZE * 8192)
+/* packets classified in one go, their headers stay on the stack */
+#define INDEX_CLASSIFY_PACKETS 256
+
+typedef struct _IndexState
+{
+  IndexScan *is;
+  TsProgram program;
+  TsStream *video;
+  /* PIDs whose stream attributes the clip information still lacks */
+  guint8 sniff[TS_MAX_PID];
+  guint64 n_entries;
+} IndexState;
+
+/* the offset of the next source packet, judged by the sync bytes of the
+ * transport packets in it and the one after */
+static gint
+find_source_packet (const guint8 * data, gsize len)
+{
+  gsize i;
+
+  for (i = 0; i + 4 < len; i++) {
+    if (data[i + 4] != TS_SYNC_BYTE)
+      continue;
+    if (i + 4 + M2TS_PACKET_SIZE < len
+        && data[i + 4 + M2TS_PACKET_SIZE] != TS_SYNC_BYTE)
+      continue;
+    return i;
+  }
+  return -1;
+}
+
+static void
+inspect_unit_start (IndexState * ix, const guint8 * p, guint64 spn)
+{
+  IndexScan *is = ix->is;
+  guint16 pid = ts_pid (p);
+  const guint8 *payload;
+  guint len;
+  gint64 pts;
+
+  if (!(payload = ts_payload (p, &len)))
+    return;
+  if (ix->sniff[pid]) {
+    TsStream *stream = ts_program_find_stream (&ix->program, pid);
+    if (clip_info_sniff_pes (is->clip, pid, stream->codec, payload, len))
+      ix->sniff[pid] = FALSE;
+  }
+  if (pid != ix->video->pid || !ts_pes_get_pts (payload, len, &pts))
+    return;
+  if (is->clip)
+    clip_info_update_pts (is->clip, pts);
+  if (!ts_is_random_access (p, ix->video->codec))
+    return;
+  if (is->entry_point)
+    is->entry_point (spn, pts, is->user_data);
+  if (is->clip)
+    clip_info_add_entry (is->clip, spn, pts);
+  ix->n_entries++;
+}
+
+static gboolean
+select_streams (IndexState * ix, gchar ** error)
+{
+  IndexScan *is = ix->is;
+  guint i;
+
+  for (i = 0; i < ix->program.n_streams; i++) {
+    TsStream *stream = &ix->program.streams[i];
+    gchar lang[4];
+
+    if (!TS_CODEC_IS_VIDEO (stream->codec)
+        && !TS_CODEC_IS_AUDIO (stream->codec))
+      continue;
+    if (!ix->video && TS_CODEC_IS_VIDEO (stream->codec))
+      ix->video = stream;
+    if (is->linked)
+      is->linked (stream->pid, stream->pid, ts_codec_caps_name (stream->codec),
+          is->user_data);
+    if (is->clip) {
+      clip_info_add_stream (is->clip, stream->pid, stream->codec,
+          stream->stream_type,
+          ts_stream_get_language (stream, lang) ? lang : NULL);
+      ix->sniff[stream->pid] = TRUE;
+    }
+  }
+  if (!ix->video) {
+    *error = g_strdup_printf ("no video stream found in %s!", is->filename);
+    return FALSE;
+  }
+  if (is->clip) {
+    is->clip->pmt_pid = ix->program.pmt_pid;
+    is->clip->pcr_pid = ix->program.pcr_pid;
+  }
+  return TRUE;
+}
+
+static gboolean
+scan_loop (IndexState * ix, RangeReader * reader, gchar ** error)
+{
+  IndexScan *is = ix->is;
+  guint8 *buf = g_malloc (INDEX_READ_SIZE);
+  guint64 offset = 0;
+  gsize fill = 0;
+  gboolean ret = TRUE;
+
+  for (;;) {
+    gboolean discont;
+    gssize len = range_reader_read (reader, buf + fill,
+        INDEX_READ_SIZE - fill, &discont);
+    gsize pos = 0;
+
+    if (len < 0) {
+      *error = g_strdup_printf ("could not read from %s! (%i)", is->filename,
+          errno);
+      ret = FALSE;
+      break;
+    }
+    if (len == 0)
+      break;
+    fill += len;
+    if (is->progress)
+      is->progress (offset + fill, is->user_data);
+    if (offset == 0 && find_source_packet (buf, fill) != 0) {
+      *error = g_strdup_printf ("%s isn't a BDAV M2TS stream!", is->filename);
+      ret = FALSE;
+      break;
+    }
+
+    while (pos + M2TS_PACKET_SIZE <= fill) {
+      guint16 packets[INDEX_CLASSIFY_PACKETS];
+      guint n = MIN ((fill - pos) / M2TS_PACKET_SIZE, INDEX_CLASSIFY_PACKETS);
+      guint i;
+      gint skip;
+
+      /* everything but the unit starts of the streams looked at is
+       * skipped by its header */
+      ts_scan_classify (buf + pos + 4, n, M2TS_PACKET_SIZE, packets);
+      for (i = 0; i < n && !(packets[i] & TS_SCAN_LOST); i++) {
+        guint16 pid = packets[i] & TS_SCAN_PID_MASK;
+        const guint8 *p = buf + pos + i * M2TS_PACKET_SIZE + 4;
+        guint64 spn = (offset + pos) / M2TS_PACKET_SIZE + i;
+
+        /* a cut restarts the clock, the PCR tells */
+        if (pid == ix->program.pcr_pid && is->clip
+            && ts_discontinuity_indicator (p))
+          clip_info_add_discontinuity (is->clip, spn);
+        if ((packets[i] & TS_SCAN_PUSI) && (pid == ix->video->pid
+                || ix->sniff[pid]))
+          inspect_unit_start (ix, p, spn);
+      }
+      pos += i * M2TS_PACKET_SIZE;
+      if (G_LIKELY (i == n))
+        continue;
+
+      skip = find_source_packet (buf + pos, fill - pos);
+      GST_WARNING ("lost sync at SPN %" G_GUINT64_FORMAT,
+          (offset + pos) / M2TS_PACKET_SIZE);
+      if (skip < 0) {
+        pos = fill;
+        break;
+      }
+      pos += skip;
+    }
+    memmove (buf, buf + pos, fill - pos);
+    offset += pos;
+    fill -= pos;
+  }
+
+  if (is->clip)
+    is->clip->n_packets = (offset + fill) / M2TS_PACKET_SIZE;
+  g_free (buf);
+  return ret;
+}
+
+gboolean
+index_scan_run (IndexScan * is, gchar ** error)
+{
+  IndexState *ix;
+  RangeReader *reader = NULL;
+  gboolean ret = FALSE;
+  int fd;
+
+  ix = g_new0 (IndexState, 1);
+  ix->is = is;
+
+  if (IS_FD_PATH (is->filename))
+    fd = fd_path_dup (is->filename, STDIN_FILENO);
+  else
+    fd = open (is->filename, O_RDONLY);
+  if (fd < 0) {
+    *error = g_strdup_printf ("could not open %s for reading! (%i)",
+        is->filename, errno);
+    goto out;
+  }
+
+  reader = range_reader_new (fd, NULL, &is->input, NULL);
+  if (!range_reader_scan_program (reader, -1, &ix->program)) {
+    *error = g_strdup_printf ("no suitable PAT/PMT found in %s!",
+        is->filename);
+    goto out;
+  }
+  if (!select_streams (ix, error))
+    goto out;
+
+  if (scan_loop (ix, reader, error)) {
+    GST_INFO ("indexed %s: %" G_GUINT64_FORMAT " entry points", is->filename,
+        ix->n_entries);
+    ret = TRUE;
+  }
+
+out:
+  if (reader)
+    range_reader_free (reader);
+  if (fd >= 0)
+    close (fd);
+  g_free (ix);
+  return ret;
+}
@@ -0,0 +1,44 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSINDEX_H__
+#define __BDREMUX_TSINDEX_H__
+
+#include "tsfast.h"
+
+/* rebuilds the entry point map of an existing M2TS file without remuxing
+ * it: the source packets are read in large blocks and only the ones of the
+ * video PID starting a PES packet are looked at. the entry points are the
+ * ones the fast remuxer reports, with the SPN counted from the start of
+ * the file. the clip information is filled in as far as the file tells */
+typedef struct _IndexScan
+{
+  const gchar *filename;
+  ReadAheadSettings input;
+  ClipInfo *clip;
+
+  FastEntryPointFunc entry_point;
+  FastLinkedFunc linked;
+  FastProgressFunc progress;
+  gpointer user_data;
+} IndexScan;
+
+gboolean index_scan_run (IndexScan * is, gchar ** error);
+
+#endif /* __BDREMUX_TSINDEX_H__ */
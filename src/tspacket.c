@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "tspacket.h"
+#include "tsscan.h"
+
+static guint32 crc_table[256];
+
+gint
+ts_find_sync (const guint8 * data, gsize len)
+{
+  const guint8 *candidate;
+  gsize i = 0;
+
+  /* memchr of the C library is vectorized already */
+  while ((candidate = memchr (data + i, TS_SYNC_BYTE, len - i))) {
+    i = candidate - data;
+    if ((i + TS_PACKET_SIZE < len && data[i + TS_PACKET_SIZE] != TS_SYNC_BYTE)
+        || (i + 2 * TS_PACKET_SIZE < len
+            && data[i + 2 * TS_PACKET_SIZE] != TS_SYNC_BYTE)) {
+      i++;
+      continue;
+    }
+    return i;
+  }
+  return -1;
+}
+
+/* the parts of a parallel remux scan their PSI at the same time */
+static void
+crc_table_init (void)
+{
+  static gsize initialized = 0;
+  guint32 n, k, c;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+  for (n = 0; n < 256; n++) {
+    c = n << 24;
+    for (k = 0; k < 8; k++)
+      c = (c & 0x80000000) ? (c << 1) ^ 0x04C11DB7 : (c << 1);
+    crc_table[n] = c;
+  }
+  g_once_init_leave (&initialized, 1);
+}
+
+/* MPEG-2 systems CRC (poly 0x04C11DB7, no reflection) as used by PSI */
+guint32
+ts_crc32 (const guint8 * data, gsize len)
+{
+  guint32 crc = 0xFFFFFFFF;
+  gsize i;
+
+  crc_table_init ();
+  for (i = 0; i < len; i++)
+    crc = (crc << 8) ^ crc_table[((crc >> 24) ^ data[i]) & 0xFF];
+  return crc;
+}
+
+gboolean
+ts_pes_get_pts (const guint8 * payload, guint len, gint64 * pts)
+{
+  const guint8 *p = payload;
+
+  if (len < 14 || p[0] != 0 || p[1] != 0 || p[2] != 1)
+    return FALSE;
+  if ((p[6] & 0xC0) != 0x80 || !(p[7] & 0x80))
+    return FALSE;
+  *pts = ((gint64) (p[9] & 0x0E) << 29) | (p[10] << 22) | ((p[11] & 0xFE) << 14)
+      | (p[12] << 7) | (p[13] >> 1);
+  return TRUE;
+}
+
+/* decides whether a video packet starts a random access point, either by
+ * the adaptation field flag or by looking for sequence/GOP headers, I
+ * pictures (MPEG-2) or SPS/IDR NAL units (H.264) in its payload */
+gboolean
+ts_is_random_access (const guint8 * p, TsCodec codec)
+{
+  const guint8 *es, *sc;
+  guint len, i;
+
+  if (ts_random_access_indicator (p))
+    return TRUE;
+  if (!ts_pusi (p) || !(es = ts_payload (p, &len)))
+    return FALSE;
+  if (len < 9 || es[0] != 0 || es[1] != 0 || es[2] != 1)
+    return FALSE;
+  i = 9 + es[8];
+  if (i >= len)
+    return FALSE;
+
+  for (sc = es + i; (sc = ts_scan_start_code (sc, es + len - sc))
+      && sc + 6 <= es + len; sc += 3) {
+    if (codec == TS_CODEC_MPEG_VIDEO) {
+      if (sc[3] == 0xB3 || sc[3] == 0xB8)
+        return TRUE;
+      if (sc[3] == 0x00)
+        return ((sc[5] >> 3) & 0x07) == 1;
+    } else if (codec == TS_CODEC_H264) {
+      guint8 nal_type = sc[3] & 0x1F;
+      if (nal_type == 5 || nal_type == 7)
+        return TRUE;
+      if (nal_type == 1)
+        return FALSE;
+    }
+  }
+  return FALSE;
+}
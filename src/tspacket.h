@@ -0,0 +1,158 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSPACKET_H__
+#define __BDREMUX_TSPACKET_H__
+
+#include <glib.h>
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_PAT 0x0000
+#define TS_PID_NULL 0x1FFF
+#define TS_MAX_PID 0x2000
+
+/* BDAV source packet: 4 byte TP_extra_header + transport packet */
+#define M2TS_PACKET_SIZE 192
+#define M2TS_ALIGNED_UNIT_PACKETS 32
+#define M2TS_ALIGNED_UNIT_SIZE (M2TS_ALIGNED_UNIT_PACKETS * M2TS_PACKET_SIZE)
+#define M2TS_ATS_MASK 0x3FFFFFFF
+
+/* 27 MHz system clock, PCR wraps after 2^33 base ticks */
+#define PCR_CLOCK_FREQ 27000000LL
+#define PCR_WRAP ((G_GINT64_CONSTANT (1) << 33) * 300)
+
+typedef enum
+{
+  TS_CODEC_UNKNOWN = 0,
+  TS_CODEC_MPEG_VIDEO,
+  TS_CODEC_H264,
+  TS_CODEC_MPEG_AUDIO,
+  TS_CODEC_AAC,
+  TS_CODEC_AC3,
+  TS_CODEC_EAC3,
+  TS_CODEC_DTS,
+  TS_CODEC_LPCM
+} TsCodec;
+
+#define TS_CODEC_IS_VIDEO(c) ((c) == TS_CODEC_MPEG_VIDEO || (c) == TS_CODEC_H264)
+#define TS_CODEC_IS_AUDIO(c) ((c) >= TS_CODEC_MPEG_AUDIO)
+
+static inline guint16
+ts_pid (const guint8 * p)
+{
+  return ((p[1] & 0x1F) << 8) | p[2];
+}
+
+static inline void
+ts_set_pid (guint8 * p, guint16 pid)
+{
+  p[1] = (p[1] & 0xE0) | ((pid >> 8) & 0x1F);
+  p[2] = pid & 0xFF;
+}
+
+static inline gboolean
+ts_pusi (const guint8 * p)
+{
+  return (p[1] & 0x40) != 0;
+}
+
+static inline gboolean
+ts_has_adaptation (const guint8 * p)
+{
+  return (p[3] & 0x20) != 0;
+}
+
+static inline gboolean
+ts_has_payload (const guint8 * p)
+{
+  return (p[3] & 0x10) != 0;
+}
+
+static inline guint8
+ts_cc (const guint8 * p)
+{
+  return p[3] & 0x0F;
+}
+
+/* returns the payload of a transport packet or NULL if it has none */
+static inline const guint8 *
+ts_payload (const guint8 * p, guint * len)
+{
+  guint offset = 4;
+
+  if (!ts_has_payload (p))
+    return NULL;
+  if (ts_has_adaptation (p))
+    offset += 1 + p[4];
+  if (offset >= TS_PACKET_SIZE)
+    return NULL;
+  *len = TS_PACKET_SIZE - offset;
+  return p + offset;
+}
+
+/* skips the PES header of a payload that starts a PES packet */
+static inline const guint8 *
+ts_pes_payload (const guint8 * payload, guint len, guint * es_len)
+{
+  guint offset;
+
+  if (len < 9 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1)
+    return NULL;
+  offset = 9 + payload[8];
+  if (offset >= len)
+    return NULL;
+  *es_len = len - offset;
+  return payload + offset;
+}
+
+static inline gboolean
+ts_random_access_indicator (const guint8 * p)
+{
+  return ts_has_adaptation (p) && p[4] > 0 && (p[5] & 0x40);
+}
+
+static inline gboolean
+ts_discontinuity_indicator (const guint8 * p)
+{
+  return ts_has_adaptation (p) && p[4] > 0 && (p[5] & 0x80);
+}
+
+/* extracts the PCR in 27 MHz units, returns FALSE if the packet has none */
+static inline gboolean
+ts_get_pcr (const guint8 * p, gint64 * pcr)
+{
+  guint64 base;
+  guint ext;
+
+  if (!ts_has_adaptation (p) || p[4] < 7 || !(p[5] & 0x10))
+    return FALSE;
+  base = ((guint64) p[6] << 25) | (p[7] << 17) | (p[8] << 9) | (p[9] << 1)
+      | (p[10] >> 7);
+  ext = ((p[10] & 0x01) << 8) | p[11];
+  *pcr = base * 300 + ext;
+  return TRUE;
+}
+
+gint ts_find_sync (const guint8 * data, gsize len);
+guint32 ts_crc32 (const guint8 * data, gsize len);
+gboolean ts_pes_get_pts (const guint8 * payload, guint len, gint64 * pts);
+gboolean ts_is_random_access (const guint8 * p, TsCodec codec);
+
+#endif /* __BDREMUX_TSPACKET_H__ */
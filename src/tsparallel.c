@@ -0,0 +1,427 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "common.h"
+#include "tsparallel.h"
+#include "tspsi.h"
+
+#define JOIN_BLOCK_PACKETS (M2TS_ALIGNED_UNIT_PACKETS * 128)
+#define JOIN_BLOCK_SIZE (JOIN_BLOCK_PACKETS * M2TS_PACKET_SIZE)
+/* blocks per thread the parts ahead of the join may hold */
+#define JOIN_QUEUED_BLOCKS 16
+
+typedef struct _SegmentJob SegmentJob;
+typedef struct _ParallelState ParallelState;
+
+/* the parts hand their output to the join in blocks of whole packets */
+typedef struct _JoinBlock
+{
+  gsize len;
+  guint8 data[JOIN_BLOCK_SIZE];
+} JoinBlock;
+
+struct _SegmentJob
+{
+  FastRemux fr;
+  GArray *ranges;
+  guint index;
+  ParallelState *ps;
+
+  /* the rest is under the lock of ps */
+  GQueue blocks;
+  JoinBlock *block;             /* being filled, only by the part */
+  guint64 position;
+  gboolean finished, ok;
+  gchar *error;
+};
+
+struct _ParallelState
+{
+  CompatMutex lock;
+  CompatCond cond;
+  FastRemux *fr;
+  ClipInfo *attributes;         /* the streams, as the first part sees them */
+  SegmentJob *jobs;
+  guint n_parts;
+
+  guint joining;                /* the part being joined doesn't wait */
+  guint queued, max_queued;     /* blocks of the parts ahead */
+  gboolean join_failed;
+};
+
+/* state carried across the joins */
+typedef struct _JoinState
+{
+  FastRemux *fr;
+  OutWriter *writer;
+  gboolean have_streams;
+  guint16 video_pid, pcr_pid;
+  TsCodec video_codec;
+
+  guint8 next_cc[TS_MAX_PID];
+  guint8 cc_delta[TS_MAX_PID];
+  guint8 pid_state[TS_MAX_PID];
+
+  guint64 spn;
+  gboolean have_ats;
+  guint32 last_ats, ats_step, ats_offset;
+} JoinState;
+
+#define PID_SEEN 1              /* in an earlier part */
+#define PID_MAPPED 2            /* cc_delta is valid for the current part */
+
+/* queues a filled block, the parts ahead of the join wait while they hold
+ * too many */
+static gboolean
+segment_queue_block (SegmentJob * job, gchar ** error)
+{
+  ParallelState *ps = job->ps;
+
+  MUTEX_LOCK (ps->lock);
+  while (job->index != ps->joining && ps->queued >= ps->max_queued
+      && !ps->join_failed)
+    COND_WAIT (ps->cond, ps->lock);
+  if (ps->join_failed) {
+    MUTEX_UNLOCK (ps->lock);
+    *error = g_strdup ("the join of the parts failed");
+    return FALSE;
+  }
+  g_queue_push_tail (&job->blocks, job->block);
+  if (job->index != ps->joining)
+    ps->queued++;
+  job->block = NULL;
+  COND_BROADCAST (ps->cond);
+  MUTEX_UNLOCK (ps->lock);
+  return TRUE;
+}
+
+static gboolean
+segment_sink (const guint8 * data, gsize len, SegmentJob * job,
+    gchar ** error)
+{
+  while (len) {
+    gsize n;
+
+    if (!job->block) {
+      job->block = g_malloc (sizeof (JoinBlock));
+      job->block->len = 0;
+    }
+    n = MIN (len, JOIN_BLOCK_SIZE - job->block->len);
+    memcpy (job->block->data + job->block->len, data, n);
+    job->block->len += n;
+    data += n;
+    len -= n;
+    if (job->block->len == JOIN_BLOCK_SIZE
+        && !segment_queue_block (job, error))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+segment_job_func (SegmentJob * job, gpointer unused)
+{
+  ParallelState *ps = job->ps;
+  gchar *error = NULL;
+  gboolean ok;
+  IoPriority priority;
+
+  /* the pool's threads don't inherit the job thread's priority */
+  if (job->fr.input.background)
+    io_set_background_priority (&priority);
+  ok = fast_remux_run (&job->fr, &error);
+  if (ok && job->block && job->block->len)
+    ok = segment_queue_block (job, &error);
+  if (job->fr.input.background)
+    io_restore_priority (&priority);
+  MUTEX_LOCK (ps->lock);
+  g_free (job->block);
+  job->block = NULL;
+  job->ok = ok;
+  job->error = error;
+  job->finished = TRUE;
+  COND_BROADCAST (ps->cond);
+  MUTEX_UNLOCK (ps->lock);
+}
+
+static void
+segment_linked (guint source_pid, guint sink_pid, const gchar * caps,
+    SegmentJob * job)
+{
+  job->ps->fr->linked (source_pid, sink_pid, caps, job->ps->fr->user_data);
+}
+
+/* every part notes how far it got, the join reports the sum */
+static void
+segment_progress (guint64 position, SegmentJob * job)
+{
+  MUTEX_LOCK (job->ps->lock);
+  job->position = position;
+  MUTEX_UNLOCK (job->ps->lock);
+}
+
+static void
+report_progress (ParallelState * ps)
+{
+  guint64 total = 0;
+  guint i;
+
+  MUTEX_LOCK (ps->lock);
+  for (i = 0; i < ps->n_parts; i++)
+    total += ps->jobs[i].position;
+  MUTEX_UNLOCK (ps->lock);
+  ps->fr->progress (total, ps->fr->user_data);
+}
+
+static void
+join_packet (JoinState * js, guint8 * slot, gboolean first_part,
+    gboolean * pcr_pending)
+{
+  guint8 *p = slot + 4;
+  guint16 pid = ts_pid (p);
+  guint32 header = (slot[0] << 24) | (slot[1] << 16) | (slot[2] << 8) | slot[3];
+  guint32 ats = header & M2TS_ATS_MASK;
+  const guint8 *payload;
+  guint len;
+  gint64 pts;
+
+  /* arrival time continues one packet interval after the previous part */
+  if (!first_part) {
+    if (!js->have_ats) {
+      js->ats_offset = (js->last_ats + js->ats_step - ats) & M2TS_ATS_MASK;
+      js->have_ats = TRUE;
+    }
+    ats = (ats + js->ats_offset) & M2TS_ATS_MASK;
+    header = (header & ~M2TS_ATS_MASK) | ats;
+    slot[0] = header >> 24;
+    slot[1] = header >> 16;
+    slot[2] = header >> 8;
+    slot[3] = header;
+  }
+  if (js->spn)
+    js->ats_step = MAX ((ats - js->last_ats) & M2TS_ATS_MASK, 1);
+  js->last_ats = ats;
+
+  if (pid != TS_PID_NULL && ts_has_payload (p)) {
+    if (!(js->pid_state[pid] & PID_MAPPED)) {
+      js->cc_delta[pid] = (js->pid_state[pid] & PID_SEEN)
+          ? (js->next_cc[pid] - ts_cc (p)) & 0x0F : 0;
+      js->pid_state[pid] |= PID_SEEN | PID_MAPPED;
+    }
+    p[3] = (p[3] & 0xF0) | ((ts_cc (p) + js->cc_delta[pid]) & 0x0F);
+    js->next_cc[pid] = (ts_cc (p) + 1) & 0x0F;
+  }
+
+  if (*pcr_pending && pid == js->pcr_pid && ts_get_pcr (p, &pts)) {
+    p[5] |= 0x80;               /* discontinuity_indicator */
+    *pcr_pending = FALSE;
+  }
+
+  if (pid == js->video_pid && ts_pusi (p)
+      && (payload = ts_payload (p, &len)) && ts_pes_get_pts (payload, len,
+          &pts)) {
+    if (js->fr->clip)
+      clip_info_update_pts (js->fr->clip, pts);
+    if (ts_is_random_access (p, js->video_codec)) {
+      if (js->fr->entry_point)
+        js->fr->entry_point (js->spn, pts, js->fr->user_data);
+      if (js->fr->clip)
+        clip_info_add_entry (js->fr->clip, js->spn, pts);
+    }
+  }
+  js->spn++;
+}
+
+/* the streams are selected before any output is written */
+static void
+join_learn_streams (JoinState * js, ClipInfo * attributes)
+{
+  js->video_pid = attributes->streams[0].pid;
+  js->video_codec = attributes->streams[0].coding_type == 0x1B
+      ? TS_CODEC_H264 : TS_CODEC_MPEG_VIDEO;
+  js->pcr_pid = attributes->pcr_pid;
+  js->have_streams = TRUE;
+}
+
+/* takes the blocks of a part as it remuxes them */
+static gboolean
+join_part (JoinState * js, ParallelState * ps, SegmentJob * job,
+    gboolean first_part, gchar ** error)
+{
+  gboolean pcr_pending = !first_part, ret = TRUE;
+  guint i;
+
+  for (i = 0; i < TS_MAX_PID; i++)
+    js->pid_state[i] &= ~PID_MAPPED;
+  js->have_ats = FALSE;
+  if (!first_part && js->fr->clip)
+    clip_info_add_discontinuity (js->fr->clip, js->spn);
+
+  MUTEX_LOCK (ps->lock);
+  ps->joining = job->index;
+  ps->queued -= g_queue_get_length (&job->blocks);
+  COND_BROADCAST (ps->cond);
+  MUTEX_UNLOCK (ps->lock);
+
+  while (ret) {
+    JoinBlock *block;
+    gsize n, pos;
+
+    MUTEX_LOCK (ps->lock);
+    while (g_queue_is_empty (&job->blocks) && !job->finished)
+      COND_WAIT (ps->cond, ps->lock);
+    block = g_queue_pop_head (&job->blocks);
+    MUTEX_UNLOCK (ps->lock);
+    if (!block) {
+      if (!job->ok) {
+        *error = job->error;
+        job->error = NULL;
+        ret = FALSE;
+      }
+      break;
+    }
+    if (!js->have_streams)
+      join_learn_streams (js, ps->attributes);
+
+    n = block->len / M2TS_PACKET_SIZE;
+    for (pos = 0; pos < n; pos++)
+      join_packet (js, block->data + pos * M2TS_PACKET_SIZE, first_part,
+          &pcr_pending);
+    if (!out_writer_write (js->writer, block->data, n * M2TS_PACKET_SIZE,
+            error))
+      ret = FALSE;
+    else if (js->fr->counters)
+      js->fr->counters->bytes_written += n * M2TS_PACKET_SIZE;
+    g_free (block);
+    if (js->fr->progress)
+      report_progress (ps);
+  }
+  return ret;
+}
+
+/* the parts are joined while they are remuxed, in order. those ahead of
+ * the join queue a bounded number of blocks, the one being joined never
+ * waits for it */
+gboolean
+fast_remux_run_parallel (FastRemux * fr, guint n_jobs, gchar ** error)
+{
+  ParallelState *ps;
+  SegmentJob *jobs;
+  GThreadPool *pool;
+  JoinState *js = NULL;
+  ClipInfo *attributes;
+  GError *gerror = NULL;
+  gboolean ret = FALSE;
+  guint i, n_parts = fr->ranges->len;
+
+  ps = g_new0 (ParallelState, 1);
+  MUTEX_INIT (ps->lock);
+  COND_INIT (ps->cond);
+  ps->fr = fr;
+  ps->n_parts = n_parts;
+  ps->max_queued = n_jobs * JOIN_QUEUED_BLOCKS;
+
+  /* the first part learns the stream attributes for the clip information,
+   * the entry points are collected while joining */
+  attributes = ps->attributes = clip_info_new ();
+  jobs = ps->jobs = g_new0 (SegmentJob, n_parts);
+  for (i = 0; i < n_parts; i++) {
+    SegmentJob *job = &jobs[i];
+    job->fr = *fr;
+    job->ranges = g_array_new (FALSE, FALSE, sizeof (ByteRange));
+    g_array_append_val (job->ranges, g_array_index (fr->ranges, ByteRange, i));
+    job->fr.ranges = job->ranges;
+    job->fr.clip = i == 0 ? attributes : NULL;
+    /* the parts are remuxed side by side, not on the pinned CPUs */
+    job->fr.input.cpu = -1;
+    memset (&job->fr.checkpoint, 0, sizeof (job->fr.checkpoint));
+    job->fr.entry_point = NULL;
+    job->fr.counters = NULL;
+    job->fr.linked = i == 0 && fr->linked
+        ? (FastLinkedFunc) segment_linked : NULL;
+    job->fr.progress = fr->progress
+        ? (FastProgressFunc) segment_progress : NULL;
+    job->fr.sink = (FastSinkFunc) segment_sink;
+    job->fr.user_data = job;
+    job->index = i;
+    job->ps = ps;
+    g_queue_init (&job->blocks);
+  }
+
+  GST_INFO ("remuxing %u segments on %u threads", n_parts, n_jobs);
+  pool = g_thread_pool_new ((GFunc) segment_job_func, NULL, n_jobs, TRUE,
+      &gerror);
+  if (!pool) {
+    *error = g_strdup_printf ("could not start worker threads! (%s)",
+        gerror->message);
+    g_error_free (gerror);
+    goto out;
+  }
+  js = g_new0 (JoinState, 1);
+  js->fr = fr;
+  js->writer = out_writer_open (fr->out_filename, &fr->output, error);
+  if (!js->writer) {
+    g_thread_pool_free (pool, TRUE, TRUE);
+    goto out;
+  }
+  /* the pool starts them in order, so the part being joined is running
+   * while those after it wait */
+  for (i = 0; i < n_parts; i++)
+    g_thread_pool_push (pool, &jobs[i], NULL);
+
+  ret = TRUE;
+  for (i = 0; i < n_parts && ret; i++)
+    ret = join_part (js, ps, &jobs[i], i == 0, error);
+  if (!ret) {
+    MUTEX_LOCK (ps->lock);
+    ps->join_failed = TRUE;
+    COND_BROADCAST (ps->cond);
+    MUTEX_UNLOCK (ps->lock);
+  }
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (ret && fr->clip) {
+    memcpy (fr->clip->streams, attributes->streams,
+        sizeof (attributes->streams));
+    fr->clip->n_streams = attributes->n_streams;
+    fr->clip->pmt_pid = attributes->pmt_pid;
+    fr->clip->pcr_pid = attributes->pcr_pid;
+  }
+  if (!out_writer_close (js->writer, ret ? error : NULL))
+    ret = FALSE;
+  GST_INFO ("joined %u parts, %" G_GUINT64_FORMAT " packets", n_parts,
+      js->spn);
+
+out:
+  for (i = 0; i < n_parts; i++) {
+    g_queue_foreach (&jobs[i].blocks, (GFunc) g_free, NULL);
+    g_queue_clear (&jobs[i].blocks);
+    g_free (jobs[i].error);
+    g_array_free (jobs[i].ranges, TRUE);
+  }
+  g_free (jobs);
+  g_free (js);
+  clip_info_free (attributes);
+  MUTEX_CLEAR (ps->lock);
+  COND_CLEAR (ps->cond);
+  g_free (ps);
+  return ret;
+}
@@ -0,0 +1,32 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSPARALLEL_H__
+#define __BDREMUX_TSPARALLEL_H__
+
+#include "tsfast.h"
+
+/* remuxes every range of fr->ranges as a separate job on up to n_jobs
+ * threads and joins the parts: continuity counters and arrival timestamps
+ * are made continuous, the first PCR of each part is flagged as
+ * discontinuity and the entry points are numbered for the joined file */
+gboolean fast_remux_run_parallel (FastRemux * fr, guint n_jobs,
+    gchar ** error);
+
+#endif /* __BDREMUX_TSPARALLEL_H__ */
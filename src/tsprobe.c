@@ -0,0 +1,210 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "tsprobe.h"
+
+/* the PCR seen first in the head window or last in the tail window and
+ * where in the file it was */
+typedef struct _ProbePcr
+{
+  gboolean valid;
+  guint64 offset;
+  gint64 pcr;
+} ProbePcr;
+
+/* the offset of the first packet whose sync bytes repeat every stride
+ * bytes, -1 if there is none */
+static gssize
+find_grid (const guint8 * data, gsize len, guint stride, guint header)
+{
+  gsize i;
+
+  for (i = header; i + 2 * stride < len; i++) {
+    if (data[i] == TS_SYNC_BYTE && data[i + stride] == TS_SYNC_BYTE
+        && data[i + 2 * stride] == TS_SYNC_BYTE)
+      return i - header;
+  }
+  return -1;
+}
+
+/* notes the PTS of every PES packet started in the window, the first ones
+ * in the head and the last ones in the tail, and a PCR for the bitrate */
+static void
+scan_window (TsProbe * probe, const guint8 * data, gsize len,
+    guint64 offset, gboolean tail, ProbePcr * pcr)
+{
+  guint header = probe->packet_size - TS_PACKET_SIZE;
+  gssize pos = find_grid (data, len, probe->packet_size, header);
+
+  while (pos >= 0 && pos + probe->packet_size <= len) {
+    const guint8 *p = data + pos + header;
+    const guint8 *payload;
+    TsStream *stream;
+    guint16 pid;
+    guint plen;
+    gint64 value;
+
+    if (p[0] != TS_SYNC_BYTE) {
+      gssize next = find_grid (data + pos + 1, len - pos - 1,
+          probe->packet_size, header);
+      pos = next < 0 ? -1 : pos + 1 + next;
+      continue;
+    }
+    pid = ts_pid (p);
+    if (pid == probe->program.pcr_pid && (tail || !pcr->valid)
+        && ts_get_pcr (p, &value)) {
+      pcr->valid = TRUE;
+      pcr->offset = offset + pos;
+      pcr->pcr = value;
+    }
+    if (ts_pusi (p) && (stream = ts_program_find_stream (&probe->program,
+                pid)) && (payload = ts_payload (p, &plen))
+        && ts_pes_get_pts (payload, plen, &value)) {
+      TsProbeStream *ps = &probe->streams[stream - probe->program.streams];
+      if (tail)
+        ps->last_pts = value;
+      else if (ps->first_pts < 0)
+        ps->first_pts = value;
+    }
+    pos += probe->packet_size;
+  }
+}
+
+static gssize
+read_window (int fd, guint8 * buf, gsize len, guint64 offset)
+{
+  gsize done = 0;
+  gssize n = 0;
+
+  while (done < len) {
+    n = pread (fd, buf + done, len - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  return n < 0 ? -1 : (gssize) done;
+}
+
+/* the durations and the bitrate, PTS and PCR may have wrapped once between
+ * head and tail */
+static void
+estimate (TsProbe * probe, const ProbePcr * head, const ProbePcr * tail)
+{
+  guint i;
+
+  probe->duration = -1;
+  for (i = 0; i < probe->program.n_streams; i++) {
+    TsProbeStream *ps = &probe->streams[i];
+    gint64 duration;
+
+    if (ps->first_pts < 0 || ps->last_pts < 0)
+      continue;
+    if (ps->last_pts < ps->first_pts)
+      ps->last_pts += G_GINT64_CONSTANT (1) << 33;
+    duration = ps->last_pts - ps->first_pts;
+    /* the video stream decides, the audio ones only if there is none */
+    if (TS_CODEC_IS_VIDEO (probe->program.streams[i].codec)) {
+      probe->duration = duration;
+      break;
+    }
+    probe->duration = MAX (probe->duration, duration);
+  }
+
+  probe->bitrate = 0;
+  if (head->valid && tail->valid && tail->offset > head->offset) {
+    gint64 ticks = tail->pcr - head->pcr;
+    if (ticks < 0)
+      ticks += PCR_WRAP;
+    if (ticks > 0)
+      probe->bitrate = (gdouble) (tail->offset - head->offset) * 8
+          * PCR_CLOCK_FREQ / ticks;
+  }
+  if (!probe->bitrate && probe->duration > 0)
+    probe->bitrate = (gdouble) probe->size * 8 * CLOCK_FREQ / probe->duration;
+}
+
+/* looks at PAT/PMT and at a window at either end of fd, which must be a
+ * regular file. everything in between is never read, so this takes the
+ * same time for any length of recording */
+gboolean
+ts_probe (int fd, TsProbe * probe, gchar ** error)
+{
+  struct stat st;
+  ProbePcr head_pcr, tail_pcr;
+  guint8 *buf;
+  gssize len;
+  guint64 tail;
+  guint i;
+
+  memset (probe, 0, sizeof (TsProbe));
+  if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode)) {
+    *error = g_strdup ("only regular files can be probed!");
+    return FALSE;
+  }
+  probe->size = st.st_size;
+  if (!ts_scan_program (fd, TS_PROGRAM_SCAN_SIZE, -1, &probe->program)) {
+    *error = g_strdup_printf ("found no program in the first %i MB!",
+        TS_PROGRAM_SCAN_SIZE >> 20);
+    return FALSE;
+  }
+  for (i = 0; i < probe->program.n_streams; i++)
+    probe->streams[i].first_pts = probe->streams[i].last_pts = -1;
+
+  buf = g_malloc (TS_PROBE_WINDOW);
+  len = read_window (fd, buf, MIN (probe->size, TS_PROBE_WINDOW), 0);
+  if (len < 0) {
+    *error = g_strdup_printf ("could not read the stream! (%i)", errno);
+    g_free (buf);
+    return FALSE;
+  }
+  probe->packet_size = find_grid (buf, len, M2TS_PACKET_SIZE, 4) == 0 ?
+      M2TS_PACKET_SIZE : TS_PACKET_SIZE;
+
+  memset (&head_pcr, 0, sizeof (head_pcr));
+  memset (&tail_pcr, 0, sizeof (tail_pcr));
+  scan_window (probe, buf, len, 0, FALSE, &head_pcr);
+  /* a short stream is all head and tail */
+  tail = 0;
+  if (probe->size > TS_PROBE_WINDOW) {
+    tail = probe->size - TS_PROBE_WINDOW;
+    tail -= tail % probe->packet_size;
+    len = read_window (fd, buf, TS_PROBE_WINDOW, tail);
+    if (len < 0) {
+      *error = g_strdup_printf ("could not read the stream! (%i)", errno);
+      g_free (buf);
+      return FALSE;
+    }
+  }
+  scan_window (probe, buf, len, tail, TRUE, &tail_pcr);
+  g_free (buf);
+
+  estimate (probe, &head_pcr, &tail_pcr);
+  GST_DEBUG ("probed %u streams, duration %" G_GINT64_FORMAT " bitrate %"
+      G_GUINT64_FORMAT, probe->program.n_streams, probe->duration,
+      probe->bitrate);
+  return TRUE;
+}
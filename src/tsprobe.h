@@ -0,0 +1,48 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSPROBE_H__
+#define __BDREMUX_TSPROBE_H__
+
+#include "tspsi.h"
+
+/* how much of the head and of the tail of a stream is looked at */
+#define TS_PROBE_WINDOW (2*1024*1024)
+
+typedef struct _TsProbeStream
+{
+  gint64 first_pts;             /* 90 kHz, -1 if none in the head window */
+  gint64 last_pts;              /* -1 if none in the tail window */
+} TsProbeStream;
+
+/* what PAT/PMT and the head and tail windows of a stream tell about it,
+ * the streams are in the order of the PMT */
+typedef struct _TsProbe
+{
+  guint64 size;
+  guint packet_size;            /* 188 for TS, 192 for M2TS */
+  TsProgram program;
+  TsProbeStream streams[TS_MAX_STREAMS];
+  gint64 duration;              /* 90 kHz, -1 if unknown */
+  guint64 bitrate;              /* bits per second, 0 if unknown */
+} TsProbe;
+
+gboolean ts_probe (int fd, TsProbe * probe, gchar ** error);
+
+#endif /* __BDREMUX_TSPROBE_H__ */
@@ -0,0 +1,500 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <string.h>
+
+#include "common.h"
+#include "tspsi.h"
+
+#define SCAN_BLOCK_SIZE (TS_PACKET_SIZE * 1024)
+
+gboolean
+ts_section_push (TsSection * section, const guint8 * packet)
+{
+  const guint8 *payload;
+  guint len, section_length;
+
+  if (!(payload = ts_payload (packet, &len)))
+    return FALSE;
+
+  if (ts_pusi (packet)) {
+    guint pointer = payload[0];
+    if (1 + pointer >= len)
+      return FALSE;
+    payload += 1 + pointer;
+    len -= 1 + pointer;
+    section->len = 0;
+    section->started = TRUE;
+  } else if (!section->started)
+    return FALSE;
+
+  if (section->len + len > sizeof (section->data)) {
+    section->started = FALSE;
+    return FALSE;
+  }
+  memcpy (section->data + section->len, payload, len);
+  section->len += len;
+
+  if (section->len < 3)
+    return FALSE;
+  section_length = ((section->data[1] & 0x0F) << 8) | section->data[2];
+  if (section_length > TS_MAX_SECTION_SIZE - 3) {
+    section->started = FALSE;
+    return FALSE;
+  }
+  if (section->len < 3 + section_length)
+    return FALSE;
+
+  section->started = FALSE;
+  section->len = 3 + section_length;
+  if (ts_crc32 (section->data, section->len) != 0) {
+    GST_DEBUG ("dropping PSI section with broken CRC (table_id 0x%02x)",
+        section->data[0]);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+guint
+ts_parse_pat (const TsSection * section, guint16 * program_numbers,
+    guint16 * pmt_pids, guint max)
+{
+  const guint8 *p = section->data;
+  guint i, count = 0;
+
+  if (p[0] != 0x00 || section->len < 12)
+    return 0;
+
+  for (i = 8; i + 4 + 4 <= section->len && count < max; i += 4) {
+    guint16 program_number = (p[i] << 8) | p[i + 1];
+    if (program_number == 0)
+      continue;                 /* network PID */
+    program_numbers[count] = program_number;
+    pmt_pids[count] = ((p[i + 2] & 0x1F) << 8) | p[i + 3];
+    count++;
+  }
+  return count;
+}
+
+static gboolean
+descriptor_is_carried (guint8 tag)
+{
+  switch (tag) {
+    case 0x05:                 /* registration */
+    case 0x0A:                 /* ISO 639 language */
+    case 0x6A:                 /* DVB AC-3 */
+    case 0x7A:                 /* DVB enhanced AC-3 */
+    case 0x7B:                 /* DVB DTS */
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+gboolean
+ts_parse_pmt (const TsSection * section, TsProgram * program)
+{
+  const guint8 *p = section->data;
+  guint i, end, program_info_length;
+
+  if (p[0] != 0x02 || section->len < 16)
+    return FALSE;
+
+  program->program_number = (p[3] << 8) | p[4];
+  program->version = (p[5] >> 1) & 0x1F;
+  program->pcr_pid = ((p[8] & 0x1F) << 8) | p[9];
+  program_info_length = ((p[10] & 0x0F) << 8) | p[11];
+  program->n_streams = 0;
+
+  end = section->len - 4;
+  for (i = 12 + program_info_length; i + 5 <= end;) {
+    guint es_info_length = ((p[i + 3] & 0x0F) << 8) | p[i + 4];
+    const guint8 *desc = p + i + 5;
+    TsStream *stream;
+    guint d;
+
+    if (i + 5 + es_info_length > end)
+      break;
+    if (program->n_streams == TS_MAX_STREAMS) {
+      GST_WARNING ("PMT of program %i has too many streams",
+          program->program_number);
+      break;
+    }
+
+    stream = &program->streams[program->n_streams++];
+    stream->stream_type = p[i];
+    stream->pid = ((p[i + 1] & 0x1F) << 8) | p[i + 2];
+    stream->codec = ts_stream_codec (stream->stream_type, desc, es_info_length);
+    stream->descriptors_len = 0;
+    for (d = 0; d + 2 <= es_info_length && d + 2 + desc[d + 1] <= es_info_length;
+        d += 2 + desc[d + 1]) {
+      guint dlen = 2 + desc[d + 1];
+      if (!descriptor_is_carried (desc[d]))
+        continue;
+      if (stream->descriptors_len + dlen > TS_MAX_DESCRIPTORS)
+        break;
+      memcpy (stream->descriptors + stream->descriptors_len, desc + d, dlen);
+      stream->descriptors_len += dlen;
+    }
+    i += 5 + es_info_length;
+  }
+  return TRUE;
+}
+
+TsStream *
+ts_program_find_stream (TsProgram * program, guint16 pid)
+{
+  guint i;
+
+  for (i = 0; i < program->n_streams; i++)
+    if (program->streams[i].pid == pid)
+      return &program->streams[i];
+  return NULL;
+}
+
+/* copies the ISO 639 code of the stream into lang[4] if there is one */
+gboolean
+ts_stream_get_language (const TsStream * stream, gchar * lang)
+{
+  const guint8 *d = stream->descriptors;
+  guint i;
+
+  for (i = 0; i + 2 <= stream->descriptors_len; i += 2 + d[i + 1]) {
+    if (d[i] == 0x0A && d[i + 1] >= 3 && i + 5 <= stream->descriptors_len) {
+      memcpy (lang, d + i + 2, 3);
+      lang[3] = '\0';
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+TsCodec
+ts_stream_codec (guint8 stream_type, const guint8 * desc, guint desc_len)
+{
+  guint d;
+
+  switch (stream_type) {
+    case 0x01:
+    case 0x02:
+      return TS_CODEC_MPEG_VIDEO;
+    case 0x1B:
+      return TS_CODEC_H264;
+    case 0x03:
+    case 0x04:
+      return TS_CODEC_MPEG_AUDIO;
+    case 0x0F:
+    case 0x11:
+      return TS_CODEC_AAC;
+    case 0x80:
+      return TS_CODEC_LPCM;
+    case 0x81:
+      return TS_CODEC_AC3;
+    case 0x84:
+    case 0x87:
+    case 0xA1:
+      return TS_CODEC_EAC3;
+    case 0x82:
+    case 0x85:
+    case 0x86:
+    case 0x8A:
+    case 0xA2:
+      return TS_CODEC_DTS;
+    case 0x06:
+      /* DVB signals private audio by descriptor */
+      for (d = 0; d + 2 <= desc_len; d += 2 + desc[d + 1]) {
+        switch (desc[d]) {
+          case 0x6A:
+            return TS_CODEC_AC3;
+          case 0x7A:
+            return TS_CODEC_EAC3;
+          case 0x7B:
+            return TS_CODEC_DTS;
+          case 0x05:
+            if (d + 6 <= desc_len && !memcmp (desc + d + 2, "AC-3", 4))
+              return TS_CODEC_AC3;
+            if (d + 6 <= desc_len && !memcmp (desc + d + 2, "DTS", 3))
+              return TS_CODEC_DTS;
+            break;
+          default:
+            break;
+        }
+      }
+      return TS_CODEC_UNKNOWN;
+    default:
+      return TS_CODEC_UNKNOWN;
+  }
+}
+
+/* the caps names mpegtsdemux reports for the same streams */
+const gchar *
+ts_codec_caps_name (TsCodec codec)
+{
+  switch (codec) {
+    case TS_CODEC_MPEG_VIDEO:
+      return "video/mpeg";
+    case TS_CODEC_H264:
+      return "video/x-h264";
+    case TS_CODEC_MPEG_AUDIO:
+    case TS_CODEC_AAC:
+      return "audio/mpeg";
+    case TS_CODEC_AC3:
+      return "audio/x-ac3";
+    case TS_CODEC_EAC3:
+      return "audio/x-eac3";
+    case TS_CODEC_DTS:
+      return "audio/x-dts";
+    case TS_CODEC_LPCM:
+      return "audio/x-lpcm";
+    default:
+      return "unknown";
+  }
+}
+
+/* stream_type values as used on BD-ROM (HDMV) */
+guint8
+ts_codec_bd_stream_type (TsCodec codec, guint8 stream_type)
+{
+  switch (codec) {
+    case TS_CODEC_MPEG_VIDEO:
+      return 0x02;
+    case TS_CODEC_H264:
+      return 0x1B;
+    case TS_CODEC_LPCM:
+      return 0x80;
+    case TS_CODEC_AC3:
+      return 0x81;
+    case TS_CODEC_EAC3:
+      return 0x84;
+    case TS_CODEC_DTS:
+      return 0x82;
+    default:
+      return stream_type;
+  }
+}
+
+static gboolean
+program_matches (TsProgram * program, gint want_pid)
+{
+  guint i;
+
+  if (want_pid >= 0)
+    return ts_program_find_stream (program, want_pid) != NULL;
+  for (i = 0; i < program->n_streams; i++)
+    if (TS_CODEC_IS_VIDEO (program->streams[i].codec))
+      return TRUE;
+  return FALSE;
+}
+
+/* reads the block at offset either from fd or from data */
+static gssize
+scan_read (int fd, const guint8 * data, gsize max_bytes, guint8 * buf,
+    guint64 offset)
+{
+  gsize len;
+
+  if (!data)
+    return pread (fd, buf, SCAN_BLOCK_SIZE, offset);
+  len = MIN (SCAN_BLOCK_SIZE, max_bytes - offset);
+  memcpy (buf, data + offset, len);
+  return len;
+}
+
+static gboolean
+scan_program (int fd, const guint8 * data, gsize max_bytes, gint want_pid,
+    TsProgram * program)
+{
+  guint8 *buf;
+  TsSection *pat, *pmt;
+  guint16 program_numbers[TS_MAX_PROGRAMS], pmt_pids[TS_MAX_PROGRAMS];
+  guint n_programs = 0, i;
+  guint64 offset = 0;
+  gssize len, pos;
+  guint stride = TS_PACKET_SIZE;
+  gboolean found = FALSE;
+
+  buf = g_malloc (SCAN_BLOCK_SIZE);
+  pat = g_new0 (TsSection, 1);
+  pmt = g_new0 (TsSection, TS_MAX_PROGRAMS);
+
+  while (!found && offset < max_bytes
+      && (len = scan_read (fd, data, max_bytes, buf,
+              offset)) >= TS_PACKET_SIZE) {
+    if (offset == 0 && len > 2 * M2TS_PACKET_SIZE && buf[4] == TS_SYNC_BYTE
+        && buf[4 + M2TS_PACKET_SIZE] == TS_SYNC_BYTE
+        && buf[4 + 2 * M2TS_PACKET_SIZE] == TS_SYNC_BYTE)
+      stride = M2TS_PACKET_SIZE;
+    if (stride == M2TS_PACKET_SIZE) {
+      if (buf[4] != TS_SYNC_BYTE)
+        break;                  /* lost the source packet grid */
+      pos = 4;
+    } else if ((pos = ts_find_sync (buf, len)) < 0) {
+      offset += len;
+      continue;
+    }
+    for (; pos + TS_PACKET_SIZE <= len && !found; pos += stride) {
+      guint8 *p = buf + pos;
+      guint16 pid;
+
+      if (p[0] != TS_SYNC_BYTE)
+        break;
+      pid = ts_pid (p);
+      if (pid == TS_PID_PAT) {
+        if (ts_section_push (pat, p))
+          n_programs = ts_parse_pat (pat, program_numbers, pmt_pids,
+              TS_MAX_PROGRAMS);
+        continue;
+      }
+      for (i = 0; i < n_programs; i++) {
+        if (pid != pmt_pids[i] || !ts_section_push (&pmt[i], p))
+          continue;
+        if (ts_parse_pmt (&pmt[i], program)
+            && program->program_number == program_numbers[i]) {
+          program->pmt_pid = pid;
+          found = program_matches (program, want_pid);
+        }
+      }
+    }
+    offset += pos - (stride - TS_PACKET_SIZE);
+  }
+
+  GST_DEBUG ("ts_scan_program: %sfound program %i (pmt 0x%04x) in %"
+      G_GUINT64_FORMAT " bytes", found ? "" : "NOT ",
+      found ? program->program_number : -1, found ? program->pmt_pid : 0,
+      offset);
+
+  g_free (pmt);
+  g_free (pat);
+  g_free (buf);
+  return found;
+}
+
+/* looks at the first max_bytes of fd for PAT and PMTs and fills in the
+ * program carrying want_pid (or the first one with video if want_pid < 0).
+ * works on TS as well as on M2TS files, the file offset of fd is not
+ * modified */
+gboolean
+ts_scan_program (int fd, gsize max_bytes, gint want_pid, TsProgram * program)
+{
+  return scan_program (fd, NULL, max_bytes, want_pid, program);
+}
+
+/* the same for the len bytes at data, the start of a stream which can't be
+ * read again */
+gboolean
+ts_scan_program_data (const guint8 * data, gsize len, gint want_pid,
+    TsProgram * program)
+{
+  return scan_program (-1, data, len, want_pid, program);
+}
+
+static guint8 *
+write_section_header (guint8 * packet, guint16 pid, guint8 cc)
+{
+  memset (packet, 0xFF, TS_PACKET_SIZE);
+  packet[0] = TS_SYNC_BYTE;
+  packet[1] = 0x40 | ((pid >> 8) & 0x1F);
+  packet[2] = pid & 0xFF;
+  packet[3] = 0x10 | (cc & 0x0F);
+  packet[4] = 0x00;             /* pointer_field */
+  return packet + 5;
+}
+
+static void
+finish_section (guint8 * section, guint length)
+{
+  guint32 crc;
+
+  section[1] = 0xB0 | (((length + 4 - 3) >> 8) & 0x0F);
+  section[2] = (length + 4 - 3) & 0xFF;
+  crc = ts_crc32 (section, length);
+  section[length] = crc >> 24;
+  section[length + 1] = crc >> 16;
+  section[length + 2] = crc >> 8;
+  section[length + 3] = crc;
+}
+
+void
+ts_write_pat (guint8 * packet, guint16 program_number, guint16 pmt_pid,
+    guint8 cc)
+{
+  guint8 *s = write_section_header (packet, TS_PID_PAT, cc);
+
+  s[0] = 0x00;                  /* table_id */
+  s[3] = 0x00;                  /* transport_stream_id */
+  s[4] = 0x01;
+  s[5] = 0xC1;                  /* version 0, current_next */
+  s[6] = 0x00;
+  s[7] = 0x00;
+  s[8] = program_number >> 8;
+  s[9] = program_number & 0xFF;
+  s[10] = 0xE0 | (pmt_pid >> 8);
+  s[11] = pmt_pid & 0xFF;
+  finish_section (s, 12);
+}
+
+/* writes a single-packet PMT with an HDMV registration descriptor, the
+ * elementary stream descriptors are dropped if they wouldn't fit */
+gboolean
+ts_write_pmt (guint8 * packet, const TsProgram * program, guint8 cc)
+{
+  static const guint8 hdmv[] = { 0x05, 0x04, 'H', 'D', 'M', 'V' };
+  guint8 *s = write_section_header (packet, program->pmt_pid, cc);
+  guint max = TS_PACKET_SIZE - 5 - 4;
+  guint i, len, needed;
+  gboolean with_descriptors = TRUE;
+
+  needed = 12 + sizeof (hdmv);
+  for (i = 0; i < program->n_streams; i++)
+    needed += 5 + program->streams[i].descriptors_len;
+  if (needed > max) {
+    with_descriptors = FALSE;
+    needed = 12 + sizeof (hdmv) + 5 * program->n_streams;
+    if (needed > max)
+      return FALSE;
+  }
+
+  s[0] = 0x02;
+  s[3] = program->program_number >> 8;
+  s[4] = program->program_number & 0xFF;
+  s[5] = 0xC1 | ((program->version & 0x1F) << 1);
+  s[6] = 0x00;
+  s[7] = 0x00;
+  s[8] = 0xE0 | (program->pcr_pid >> 8);
+  s[9] = program->pcr_pid & 0xFF;
+  s[10] = 0xF0;
+  s[11] = sizeof (hdmv);
+  memcpy (s + 12, hdmv, sizeof (hdmv));
+  len = 12 + sizeof (hdmv);
+
+  for (i = 0; i < program->n_streams; i++) {
+    const TsStream *stream = &program->streams[i];
+    guint dlen = with_descriptors ? stream->descriptors_len : 0;
+    s[len] = stream->stream_type;
+    s[len + 1] = 0xE0 | (stream->pid >> 8);
+    s[len + 2] = stream->pid & 0xFF;
+    s[len + 3] = 0xF0 | (dlen >> 8);
+    s[len + 4] = dlen & 0xFF;
+    memcpy (s + len + 5, stream->descriptors, dlen);
+    len += 5 + dlen;
+  }
+  finish_section (s, len);
+  return TRUE;
+}
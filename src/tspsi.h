@@ -0,0 +1,79 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSPSI_H__
+#define __BDREMUX_TSPSI_H__
+
+#include "tspacket.h"
+
+#define TS_MAX_STREAMS 32
+#define TS_MAX_PROGRAMS 64
+#define TS_MAX_DESCRIPTORS 64
+#define TS_MAX_SECTION_SIZE 1024
+
+#define TS_PROGRAM_SCAN_SIZE (8*1024*1024)
+
+typedef struct _TsStream
+{
+  guint16 pid;
+  guint8 stream_type;
+  TsCodec codec;
+  guint8 descriptors[TS_MAX_DESCRIPTORS];
+  guint descriptors_len;
+} TsStream;
+
+typedef struct _TsProgram
+{
+  guint16 program_number;
+  guint16 pmt_pid;
+  guint16 pcr_pid;
+  guint8 version;
+  TsStream streams[TS_MAX_STREAMS];
+  guint n_streams;
+} TsProgram;
+
+typedef struct _TsSection
+{
+  guint8 data[TS_MAX_SECTION_SIZE + TS_PACKET_SIZE];
+  guint len;
+  gboolean started;
+} TsSection;
+
+gboolean ts_section_push (TsSection * section, const guint8 * packet);
+guint ts_parse_pat (const TsSection * section, guint16 * program_numbers,
+    guint16 * pmt_pids, guint max);
+gboolean ts_parse_pmt (const TsSection * section, TsProgram * program);
+TsStream *ts_program_find_stream (TsProgram * program, guint16 pid);
+gboolean ts_stream_get_language (const TsStream * stream, gchar * lang);
+
+TsCodec ts_stream_codec (guint8 stream_type, const guint8 * descriptors,
+    guint descriptors_len);
+const gchar *ts_codec_caps_name (TsCodec codec);
+guint8 ts_codec_bd_stream_type (TsCodec codec, guint8 stream_type);
+
+gboolean ts_scan_program (int fd, gsize max_bytes, gint want_pid,
+    TsProgram * program);
+gboolean ts_scan_program_data (const guint8 * data, gsize len,
+    gint want_pid, TsProgram * program);
+
+void ts_write_pat (guint8 * packet, guint16 program_number, guint16 pmt_pid,
+    guint8 cc);
+gboolean ts_write_pmt (guint8 * packet, const TsProgram * program, guint8 cc);
+
+#endif /* __BDREMUX_TSPSI_H__ */
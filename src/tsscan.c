@@ -0,0 +1,329 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <string.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#define SSE2_TARGET __attribute__ ((target ("sse2")))
+#define AVX2_TARGET __attribute__ ((target ("avx2")))
+#endif
+#if (defined (__ARM_NEON) || defined (__ARM_NEON__)) \
+    && !defined (__ARM_BIG_ENDIAN)
+#define HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+#include "tsscan.h"
+
+#define HEADER_MASK (TS_SCAN_PID_MASK | TS_SCAN_PUSI)
+
+typedef void (*ClassifyFunc) (const guint8 * p, guint n, guint stride,
+    guint16 * out);
+typedef const guint8 *(*StartCodeFunc) (const guint8 * data, gsize len);
+
+typedef struct _ScanKernel
+{
+  const gchar *name;
+  ClassifyFunc classify;
+  StartCodeFunc start_code;
+} ScanKernel;
+
+static inline guint16
+classify_packet (const guint8 * p)
+{
+  return (((p[1] << 8) | p[2]) & HEADER_MASK)
+      | (p[0] != TS_SYNC_BYTE ? TS_SCAN_LOST : 0);
+}
+
+static void
+classify_scalar (const guint8 * p, guint n, guint stride, guint16 * out)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+    out[i] = classify_packet (p + i * stride);
+}
+
+/* a byte above 1 rules out a prefix ending on it or the two before */
+static const guint8 *
+start_code_scalar (const guint8 * data, gsize len)
+{
+  gsize i = 0;
+
+  while (i + 3 <= len) {
+    if (data[i + 2] > 1)
+      i += 3;
+    else if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0)
+      return data + i;
+    else
+      i++;
+  }
+  return NULL;
+}
+
+#if defined (HAVE_X86_KERNELS) || defined (HAVE_NEON_KERNELS)
+/* the first four header bytes of a packet, sync byte lowest */
+static inline guint32
+load_header (const guint8 * p)
+{
+  guint32 word;
+
+  memcpy (&word, p, sizeof (word));
+  return word;
+}
+#endif
+
+#ifdef HAVE_X86_KERNELS
+/* header words to classified packets, sign extended so that the signed
+ * saturation of the 16 bit pack keeps TS_SCAN_LOST */
+SSE2_TARGET static inline __m128i
+classify_words_sse2 (__m128i w)
+{
+  __m128i header, sync, lost;
+
+  header = _mm_or_si128 (_mm_and_si128 (w, _mm_set1_epi32 (0xFF00)),
+      _mm_and_si128 (_mm_srli_epi32 (w, 16), _mm_set1_epi32 (0xFF)));
+  header = _mm_and_si128 (header, _mm_set1_epi32 (HEADER_MASK));
+  sync = _mm_cmpeq_epi32 (_mm_and_si128 (w, _mm_set1_epi32 (0xFF)),
+      _mm_set1_epi32 (TS_SYNC_BYTE));
+  lost = _mm_andnot_si128 (sync, _mm_set1_epi32 (TS_SCAN_LOST));
+  return _mm_srai_epi32 (_mm_slli_epi32 (_mm_or_si128 (header, lost), 16),
+      16);
+}
+
+SSE2_TARGET static inline __m128i
+classify4_sse2 (const guint8 * p, guint stride)
+{
+  return classify_words_sse2 (_mm_set_epi32 (load_header (p + 3 * stride),
+          load_header (p + 2 * stride), load_header (p + stride),
+          load_header (p)));
+}
+
+SSE2_TARGET static void
+classify_sse2 (const guint8 * p, guint n, guint stride, guint16 * out)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm_storeu_si128 ((__m128i *) (out + i),
+        _mm_packs_epi32 (classify4_sse2 (p + i * stride, stride),
+            classify4_sse2 (p + (i + 4) * stride, stride)));
+  classify_scalar (p + i * stride, n - i, stride, out + i);
+}
+
+SSE2_TARGET static const guint8 *
+start_code_sse2 (const guint8 * data, gsize len)
+{
+  const __m128i zero = _mm_setzero_si128 (), one = _mm_set1_epi8 (1);
+  gsize i;
+
+  for (i = 0; i + 18 <= len; i += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (data + i));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+    __m128i c = _mm_loadu_si128 ((const __m128i *) (data + i + 2));
+    guint mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_and_si128
+            (_mm_cmpeq_epi8 (a, zero), _mm_cmpeq_epi8 (b, zero)),
+            _mm_cmpeq_epi8 (c, one)));
+    if (mask)
+      return data + i + __builtin_ctz (mask);
+  }
+  return start_code_scalar (data + i, len - i);
+}
+
+/* AVX2 gathers the headers of eight packets at once */
+AVX2_TARGET static void
+classify_avx2 (const guint8 * p, guint n, guint stride, guint16 * out)
+{
+  const __m256i offsets = _mm256_mullo_epi32 (_mm256_setr_epi32 (0, 1, 2, 3,
+          4, 5, 6, 7), _mm256_set1_epi32 (stride));
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i w, header, sync, lost, v;
+
+    w = _mm256_i32gather_epi32 ((const int *) (p + i * stride), offsets, 1);
+    header = _mm256_or_si256 (_mm256_and_si256 (w, _mm256_set1_epi32
+            (0xFF00)), _mm256_and_si256 (_mm256_srli_epi32 (w, 16),
+            _mm256_set1_epi32 (0xFF)));
+    header = _mm256_and_si256 (header, _mm256_set1_epi32 (HEADER_MASK));
+    sync = _mm256_cmpeq_epi32 (_mm256_and_si256 (w, _mm256_set1_epi32 (0xFF)),
+        _mm256_set1_epi32 (TS_SYNC_BYTE));
+    lost = _mm256_andnot_si256 (sync, _mm256_set1_epi32 (TS_SCAN_LOST));
+    v = _mm256_srai_epi32 (_mm256_slli_epi32 (_mm256_or_si256 (header, lost),
+            16), 16);
+    _mm_storeu_si128 ((__m128i *) (out + i),
+        _mm_packs_epi32 (_mm256_castsi256_si128 (v),
+            _mm256_extracti128_si256 (v, 1)));
+  }
+  classify_scalar (p + i * stride, n - i, stride, out + i);
+}
+
+AVX2_TARGET static const guint8 *
+start_code_avx2 (const guint8 * data, gsize len)
+{
+  const __m256i zero = _mm256_setzero_si256 (), one = _mm256_set1_epi8 (1);
+  gsize i;
+
+  for (i = 0; i + 34 <= len; i += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (data + i));
+    __m256i b = _mm256_loadu_si256 ((const __m256i *) (data + i + 1));
+    __m256i c = _mm256_loadu_si256 ((const __m256i *) (data + i + 2));
+    guint mask = _mm256_movemask_epi8 (_mm256_and_si256 (_mm256_and_si256
+            (_mm256_cmpeq_epi8 (a, zero), _mm256_cmpeq_epi8 (b, zero)),
+            _mm256_cmpeq_epi8 (c, one)));
+    if (mask)
+      return data + i + __builtin_ctz (mask);
+  }
+  return start_code_scalar (data + i, len - i);
+}
+#endif /* HAVE_X86_KERNELS */
+
+#ifdef HAVE_NEON_KERNELS
+static void
+classify_neon (const guint8 * p, guint n, guint stride, guint16 * out)
+{
+  const uint32x4_t byte = vdupq_n_u32 (0xFF);
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    const guint8 *q = p + i * stride;
+    guint32 words[4] = { load_header (q), load_header (q + stride),
+      load_header (q + 2 * stride), load_header (q + 3 * stride)
+    };
+    uint32x4_t w = vld1q_u32 (words), header, lost;
+
+    header = vorrq_u32 (vandq_u32 (w, vdupq_n_u32 (0xFF00)),
+        vandq_u32 (vshrq_n_u32 (w, 16), byte));
+    header = vandq_u32 (header, vdupq_n_u32 (HEADER_MASK));
+    lost = vbicq_u32 (vdupq_n_u32 (TS_SCAN_LOST),
+        vceqq_u32 (vandq_u32 (w, byte), vdupq_n_u32 (TS_SYNC_BYTE)));
+    vst1_u16 (out + i, vmovn_u32 (vorrq_u32 (header, lost)));
+  }
+  classify_scalar (p + i * stride, n - i, stride, out + i);
+}
+
+/* NEON has no movemask, a hit is located by the scalar search within the
+ * 16 positions of the vector */
+static const guint8 *
+start_code_neon (const guint8 * data, gsize len)
+{
+  const uint8x16_t zero = vdupq_n_u8 (0), one = vdupq_n_u8 (1);
+  gsize i;
+
+  for (i = 0; i + 18 <= len; i += 16) {
+    uint8x16_t m = vandq_u8 (vandq_u8 (vceqq_u8 (vld1q_u8 (data + i), zero),
+            vceqq_u8 (vld1q_u8 (data + i + 1), zero)),
+        vceqq_u8 (vld1q_u8 (data + i + 2), one));
+    uint64x2_t m64 = vreinterpretq_u64_u8 (m);
+    if (vgetq_lane_u64 (m64, 0) | vgetq_lane_u64 (m64, 1))
+      return start_code_scalar (data + i, 18);
+  }
+  return start_code_scalar (data + i, len - i);
+}
+#endif /* HAVE_NEON_KERNELS */
+
+static const ScanKernel kernels[TS_SCAN_N_KERNELS] = {
+  {"scalar", classify_scalar, start_code_scalar},
+#ifdef HAVE_X86_KERNELS
+  {"sse2", classify_sse2, start_code_sse2},
+  {"avx2", classify_avx2, start_code_avx2},
+#else
+  {"sse2", NULL, NULL},
+  {"avx2", NULL, NULL},
+#endif
+#ifdef HAVE_NEON_KERNELS
+  {"neon", classify_neon, start_code_neon},
+#else
+  {"neon", NULL, NULL},
+#endif
+};
+
+static volatile gint active_kernel;
+
+/* whether the kernel is built in and the CPU runs it */
+gboolean
+ts_scan_kernel_supported (TsScanKernel kernel)
+{
+  if (kernel >= TS_SCAN_N_KERNELS || !kernels[kernel].classify)
+    return FALSE;
+#ifdef HAVE_X86_KERNELS
+  if (kernel == TS_SCAN_SSE2)
+    return __builtin_cpu_supports ("sse2");
+  if (kernel == TS_SCAN_AVX2)
+    return __builtin_cpu_supports ("avx2");
+#endif
+  return TRUE;
+}
+
+const gchar *
+ts_scan_kernel_name (TsScanKernel kernel)
+{
+  return kernel < TS_SCAN_N_KERNELS ? kernels[kernel].name : "unknown";
+}
+
+/* picks the widest supported kernel the first time a scan is done */
+static const ScanKernel *
+get_kernel (void)
+{
+  static gsize picked = 0;
+
+  if (g_once_init_enter (&picked)) {
+    TsScanKernel kernel = TS_SCAN_N_KERNELS - 1;
+
+    while (kernel > TS_SCAN_SCALAR && !ts_scan_kernel_supported (kernel))
+      kernel--;
+    g_atomic_int_set (&active_kernel, kernel);
+    g_once_init_leave (&picked, 1);
+  }
+  return &kernels[g_atomic_int_get (&active_kernel)];
+}
+
+TsScanKernel
+ts_scan_get_kernel (void)
+{
+  return get_kernel () - kernels;
+}
+
+/* overrides the pick, to compare the kernels. FALSE if it can't run here */
+gboolean
+ts_scan_set_kernel (TsScanKernel kernel)
+{
+  if (!ts_scan_kernel_supported (kernel))
+    return FALSE;
+  get_kernel ();
+  g_atomic_int_set (&active_kernel, kernel);
+  return TRUE;
+}
+
+/* classifies n packets stride bytes apart, p pointing to the sync byte of
+ * the first */
+void
+ts_scan_classify (const guint8 * p, guint n, guint stride, guint16 * out)
+{
+  get_kernel ()->classify (p, n, stride, out);
+}
+
+/* the first 00 00 01 start code prefix in data, NULL if there is none */
+const guint8 *
+ts_scan_start_code (const guint8 * data, gsize len)
+{
+  return get_kernel ()->start_code (data, len);
+}
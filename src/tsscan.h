@@ -0,0 +1,54 @@
+/***************************************************************************
+ *   Copyright (C) 2011 by Andreas Frisch                                  *
+ *   fraxinas@opendreambox.org                                             *
+ *                                                                         *
+ * This program is licensed under the Creative Commons                     *
+ * Attribution-NonCommercial-ShareAlike 3.0 Unported                       *
+ * License. To view a copy of this license, visit                          *
+ * http://creativecommons.org/licenses/by-nc-sa/3.0/ or send a letter to   *
+ * Creative Commons,559 Nathan Abbott Way,Stanford,California 94305,USA.   *
+ *                                                                         *
+ * Alternatively, this program may be distributed and executed on          *
+ * hardware which is licensed by Dream Multimedia GmbH.                    *
+ *                                                                         *
+ * This program is NOT free software. It is open source, you are allowed   *
+ * to modify it (if you keep the license), but it may not be commercially  *
+ * distributed other than under the conditions noted above.                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef __BDREMUX_TSSCAN_H__
+#define __BDREMUX_TSSCAN_H__
+
+#include "tspacket.h"
+
+/* the packet classification and start code search every native scan of a
+ * stream boils down to, with SSE2/AVX2/NEON kernels picked by what the CPU
+ * supports and a scalar fallback */
+
+/* a classified packet is the second and third byte of its header with the
+ * PID and payload_unit_start_indicator kept and the top bit telling that
+ * the sync byte is missing */
+#define TS_SCAN_PID_MASK 0x1FFF
+#define TS_SCAN_PUSI 0x4000
+#define TS_SCAN_LOST 0x8000
+
+typedef enum
+{
+  TS_SCAN_SCALAR,
+  TS_SCAN_SSE2,
+  TS_SCAN_AVX2,
+  TS_SCAN_NEON,
+  TS_SCAN_N_KERNELS
+} TsScanKernel;
+
+TsScanKernel ts_scan_get_kernel (void);
+gboolean ts_scan_set_kernel (TsScanKernel kernel);
+gboolean ts_scan_kernel_supported (TsScanKernel kernel);
+const gchar *ts_scan_kernel_name (TsScanKernel kernel);
+
+void ts_scan_classify (const guint8 * p, guint n, guint stride,
+    guint16 * out);
+const guint8 *ts_scan_start_code (const guint8 * data, gsize len);
+
+#endif /* __BDREMUX_TSSCAN_H__ */